@@ -0,0 +1,100 @@
+#include "allocation_counter.h"
+
+#include <cerrno>
+#include <cstdlib>
+
+namespace {
+
+// Number of allocations made by this thread.
+__thread size_t num_allocations = 0;
+
+// Number of active ScopedAllocationCounterPause objects in this thread.
+__thread int pause_depth = 0;
+
+inline void CountAllocation() {
+  if (pause_depth == 0) {
+    num_allocations++;
+  }
+}
+
+} // namespace
+
+#if defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+
+// Wrap the glibc allocation functions.  Operator new and cv::fastMalloc both
+// end up in one of these.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+
+void* malloc(size_t size) {
+  CountAllocation();
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) {
+  CountAllocation();
+  return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  CountAllocation();
+  return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  CountAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+  CountAllocation();
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : ENOMEM;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  CountAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+void* valloc(size_t size) {
+  CountAllocation();
+  return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) {
+  CountAllocation();
+  return __libc_pvalloc(size);
+}
+
+} // extern "C"
+
+bool AllocationCounter::enabled() {
+  return true;
+}
+
+#else
+
+bool AllocationCounter::enabled() {
+  return false;
+}
+
+#endif
+
+size_t AllocationCounter::count() {
+  return num_allocations;
+}
+
+ScopedAllocationCounterPause::ScopedAllocationCounterPause() {
+  pause_depth++;
+}
+
+ScopedAllocationCounterPause::~ScopedAllocationCounterPause() {
+  pause_depth--;
+}
@@ -0,0 +1,33 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Counts the heap allocations made by the current thread, for checking that
+// code paths which should not allocate (such as tracking after the first frame)
+// really do not.
+//
+// Allocations are only counted when built with COUNT_ALLOCATIONS
+// (cmake -DCOUNT_ALLOCATIONS=ON), which wraps malloc and related functions;
+// otherwise enabled() returns false and the count is always 0.
+// test_allocations uses it to check the tracking loop.
+class AllocationCounter
+{
+public:
+  // Whether allocations are being counted in this build.
+  static bool enabled();
+
+  // Number of heap allocations made by the current thread so far.
+  static size_t count();
+};
+
+// Stop counting the allocations made by the current thread while this object exists.
+// Used around calls into external libraries whose allocations we do not control.
+class ScopedAllocationCounterPause
+{
+public:
+  ScopedAllocationCounterPause();
+  ~ScopedAllocationCounterPause();
+};
+
+#endif // ALLOCATION_COUNTER_H
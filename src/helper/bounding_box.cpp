@@ -94,10 +94,14 @@ void BoundingBox::Print() const {
 }
 
 void BoundingBox::Scale(const cv::Mat& image, BoundingBox* bbox_scaled) const {
+  Scale(image.size(), bbox_scaled);
+}
+
+void BoundingBox::Scale(const cv::Size& image_size, BoundingBox* bbox_scaled) const {
   *bbox_scaled = *this;
 
-  const int width = image.cols;
-  const int height = image.rows;
+  const int width = image_size.width;
+  const int height = image_size.height;
 
   // Scale the bounding box so that the coordinates range from 0 to 1.
   bbox_scaled->x1_ /= width;
@@ -113,10 +117,14 @@ void BoundingBox::Scale(const cv::Mat& image, BoundingBox* bbox_scaled) const {
 }
 
 void BoundingBox::Unscale(const cv::Mat& image, BoundingBox* bbox_unscaled) const {
+  Unscale(image.size(), bbox_unscaled);
+}
+
+void BoundingBox::Unscale(const cv::Size& image_size, BoundingBox* bbox_unscaled) const {
   *bbox_unscaled = *this;
 
-  const int image_width = image.cols;
-  const int image_height = image.rows;
+  const int image_width = image_size.width;
+  const int image_height = image_size.height;
 
   // Unscale the bounding box so that the coordinates range from 0 to 1.
   bbox_unscaled->x1_ /= scale_factor_;
@@ -132,6 +140,16 @@ void BoundingBox::Unscale(const cv::Mat& image, BoundingBox* bbox_unscaled) cons
   bbox_unscaled->y2_ *= image_height;
 }
 
+void BoundingBox::Rescale(const double factor, BoundingBox* bbox_rescaled) const {
+  *bbox_rescaled = *this;
+
+  // Scale the coordinates with the image.
+  bbox_rescaled->x1_ *= factor;
+  bbox_rescaled->y1_ *= factor;
+  bbox_rescaled->x2_ *= factor;
+  bbox_rescaled->y2_ *= factor;
+}
+
 double BoundingBox::compute_output_width() const {
   // Get the bounding box width.
   const double bbox_width = (x2_ - x1_);
@@ -347,6 +365,12 @@ double BoundingBox::compute_intersection(const BoundingBox& bbox) const {
   return area;
 }
 
+double BoundingBox::compute_iou(const BoundingBox& bbox) const {
+  const double intersection = compute_intersection(bbox);
+  const double union_area = compute_area() + bbox.compute_area() - intersection;
+  return union_area > 0 ? intersection / union_area : 0;
+}
+
 double BoundingBox::compute_area() const {
   return get_width() * get_height();
 }
@@ -35,10 +35,15 @@ public:
 
   // Normalize the size of the bounding box based on the size of the image.
   void Scale(const cv::Mat& image, BoundingBox* bbox_scaled) const;
+  void Scale(const cv::Size& image_size, BoundingBox* bbox_scaled) const;
 
   // Unnormalize the size of the bounding box based on the size of the image.
   // (Undoes the effect of Scale).
   void Unscale(const cv::Mat& image, BoundingBox* bbox_unscaled) const;
+  void Unscale(const cv::Size& image_size, BoundingBox* bbox_unscaled) const;
+
+  // Get the location of the bounding box in the image resized by the given factor.
+  void Rescale(const double factor, BoundingBox* bbox_rescaled) const;
 
   // Compute location of bounding box relative to search region
   // edge_spacing_x and edge_spacing_y is the spaving of the image within the search region to account for edge effects.
@@ -82,6 +87,9 @@ public:
   // Area of intersection between two bounding boxes.
   double compute_intersection(const BoundingBox& bbox) const;
 
+  // Intersection over union of two bounding boxes.
+  double compute_iou(const BoundingBox& bbox) const;
+
   // Bounding box coordiantes: top left, bottom right.
   double x1_, y1_, x2_, y2_;
 
@@ -1,13 +1,158 @@
 #include "image_proc.h"
 
+namespace {
+
+// Weights to convert BGR to grayscale (as in cv::cvtColor).
+const float kGrayWeightB = 0.114f;
+const float kGrayWeightG = 0.587f;
+const float kGrayWeightR = 0.299f;
+
+// Compute the two input taps and weights used to bilinearly resample one axis
+// from input_length to output_length pixels, matching cv::resize with INTER_LINEAR.
+// Only input pixels in [valid_begin, valid_end) come from the image; the rest are
+// black padding.  Taps are returned relative to valid_begin and clamped to the valid
+// range, and taps that fall in the padding are given a weight of 0.
+void ComputeLinearTaps(const int input_length, const int output_length,
+                       const int valid_begin, const int valid_end,
+                       std::vector<int>* taps, std::vector<float>* weights) {
+  taps->resize(2 * output_length);
+  weights->resize(2 * output_length);
+
+  const double scale = static_cast<double>(input_length) / output_length;
+  for (int i = 0; i < output_length; ++i) {
+    // Location of the output pixel center in the input.
+    double frac = (i + 0.5) * scale - 0.5;
+    int tap = static_cast<int>(floor(frac));
+    frac -= tap;
+
+    // Replicate the border pixels.
+    if (tap < 0) {
+      tap = 0;
+      frac = 0;
+    }
+    if (tap >= input_length - 1) {
+      tap = input_length - 1;
+      frac = 0;
+    }
+
+    const int input_taps[2] = { tap, std::min(tap + 1, input_length - 1) };
+    const float input_weights[2] = { static_cast<float>(1 - frac), static_cast<float>(frac) };
+    for (int k = 0; k < 2; ++k) {
+      const bool is_valid = input_taps[k] >= valid_begin && input_taps[k] < valid_end;
+      (*taps)[2 * i + k] = std::min(std::max(input_taps[k], valid_begin), valid_end - 1) - valid_begin;
+      (*weights)[2 * i + k] = is_valid ? input_weights[k] : 0;
+    }
+  }
+}
+
+// Resample the rows of the padded image, for a fixed number of image and output channels
+// (so that the inner loop has no branches).
+template <int kImageChannels, int kNumChannels>
+void ResampleRows(const cv::Mat& image, const cv::Rect& roi, const cv::Size& output_size,
+                  const std::vector<int>& x_taps, const std::vector<float>& x_weights,
+                  const std::vector<int>& y_taps, const std::vector<float>& y_weights,
+                  const cv::Scalar& mean, float* output) {
+  const int plane_size = output_size.width * output_size.height;
+  const float mean_b = mean[0];
+  const float mean_g = mean[1];
+  const float mean_r = mean[2];
+
+  for (int y = 0; y < output_size.height; ++y) {
+    const uchar* row0 = image.ptr<uchar>(roi.y + y_taps[2 * y]) + roi.x * kImageChannels;
+    const uchar* row1 = image.ptr<uchar>(roi.y + y_taps[2 * y + 1]) + roi.x * kImageChannels;
+    const float wy0 = y_weights[2 * y];
+    const float wy1 = y_weights[2 * y + 1];
+
+    float* out_b = output + y * output_size.width;
+    float* out_g = out_b + plane_size;
+    float* out_r = out_g + plane_size;
+
+    for (int x = 0; x < output_size.width; ++x) {
+      const int x0 = x_taps[2 * x] * kImageChannels;
+      const int x1 = x_taps[2 * x + 1] * kImageChannels;
+      const float w00 = wy0 * x_weights[2 * x];
+      const float w01 = wy0 * x_weights[2 * x + 1];
+      const float w10 = wy1 * x_weights[2 * x];
+      const float w11 = wy1 * x_weights[2 * x + 1];
+
+      // Interpolate each image channel (for grayscale images, only the first).
+      float value[3];
+      for (int c = 0; c < 3 && c < kImageChannels; ++c) {
+        value[c] = w00 * row0[x0 + c] + w01 * row0[x1 + c] +
+                   w10 * row1[x0 + c] + w11 * row1[x1 + c];
+      }
+      if (kImageChannels == 1) {
+        value[1] = value[0];
+        value[2] = value[0];
+      }
+
+      // Convert to the output channels, subtract the mean and write each channel to its own plane.
+      if (kNumChannels == 1) {
+        out_b[x] = kGrayWeightB * value[0] + kGrayWeightG * value[1] + kGrayWeightR * value[2] - mean_b;
+      } else {
+        out_b[x] = value[0] - mean_b;
+        out_g[x] = value[1] - mean_g;
+        out_r[x] = value[2] - mean_r;
+      }
+    }
+  }
+}
+
+// Resample a padded image to output_size and write it to output as mean-subtracted planar floats.
+// The padded image has size pad_image_size and is black except for the region of the image
+// given by roi, which is placed at roi_offset within the padded image.
+void ResamplePadded(const cv::Mat& image, const cv::Rect& roi, const cv::Point& roi_offset,
+                    const cv::Size& pad_image_size, const cv::Size& output_size,
+                    const cv::Scalar& mean, const int num_channels,
+                    ResampleBuffers* buffers, float* output) {
+  if (image.depth() != CV_8U) {
+    printf("Error - image must have 8-bit channels\n");
+    return;
+  }
+
+  // Compute the bilinear taps of the padded image along each axis.
+  const std::vector<int>& x_taps = buffers->x_taps;
+  const std::vector<int>& y_taps = buffers->y_taps;
+  const std::vector<float>& x_weights = buffers->x_weights;
+  const std::vector<float>& y_weights = buffers->y_weights;
+  ComputeLinearTaps(pad_image_size.width, output_size.width,
+                    roi_offset.x, roi_offset.x + roi.width, &buffers->x_taps, &buffers->x_weights);
+  ComputeLinearTaps(pad_image_size.height, output_size.height,
+                    roi_offset.y, roi_offset.y + roi.height, &buffers->y_taps, &buffers->y_weights);
+
+  const int image_channels = image.channels();
+  if (image_channels == 1 && num_channels == 1) {
+    ResampleRows<1, 1>(image, roi, output_size, x_taps, x_weights, y_taps, y_weights, mean, output);
+  } else if (image_channels == 1 && num_channels == 3) {
+    ResampleRows<1, 3>(image, roi, output_size, x_taps, x_weights, y_taps, y_weights, mean, output);
+  } else if (image_channels == 3 && num_channels == 1) {
+    ResampleRows<3, 1>(image, roi, output_size, x_taps, x_weights, y_taps, y_weights, mean, output);
+  } else if (image_channels == 3 && num_channels == 3) {
+    ResampleRows<3, 3>(image, roi, output_size, x_taps, x_weights, y_taps, y_weights, mean, output);
+  } else if (image_channels == 4 && num_channels == 1) {
+    ResampleRows<4, 1>(image, roi, output_size, x_taps, x_weights, y_taps, y_weights, mean, output);
+  } else if (image_channels == 4 && num_channels == 3) {
+    ResampleRows<4, 3>(image, roi, output_size, x_taps, x_weights, y_taps, y_weights, mean, output);
+  } else {
+    printf("Error - cannot convert an image with %d channels to %d channels\n",
+           image_channels, num_channels);
+  }
+}
+
+} // namespace
+
 void ComputeCropPadImageLocation(const BoundingBox& bbox_tight, const cv::Mat& image, BoundingBox* pad_image_location) {
+  ComputeCropPadImageLocation(bbox_tight, image.size(), pad_image_location);
+}
+
+void ComputeCropPadImageLocation(const BoundingBox& bbox_tight, const cv::Size& image_size, BoundingBox* pad_image_location) {
   // Get the bounding box center.
   const double bbox_center_x = bbox_tight.get_center_x();
   const double bbox_center_y = bbox_tight.get_center_y();
 
   // Get the image size.
-  const double image_width = image.cols;
-  const double image_height = image.rows;
+  const double image_width = image_size.width;
+  const double image_height = image_size.height;
 
   // Get size of output image, which is given by the bounding box + some padding.
   const double output_width = bbox_tight.compute_output_width();
@@ -59,48 +204,136 @@ void CropPadImage(const BoundingBox& bbox_tight, const cv::Mat& image, cv::Mat*
                   BoundingBox* pad_image_location, double* edge_spacing_x, double* edge_spacing_y) {
   // Crop the image based on the bounding box location, adding some padding.
 
-  // Get the location of the cropped and padded image.
-  ComputeCropPadImageLocation(bbox_tight, image, pad_image_location);
-
-  // Compute the ROI, ensuring that the crop stays within the boundaries of the image.
-  const double roi_left = std::min(pad_image_location->x1_, static_cast<double>(image.cols - 1));
-  const double roi_bottom = std::min(pad_image_location->y1_, static_cast<double>(image.rows - 1));
-  const double roi_width = std::min(static_cast<double>(image.cols), std::max(1.0, ceil(pad_image_location->x2_ - pad_image_location->x1_)));
-  const double roi_height = std::min(static_cast<double>(image.rows), std::max(1.0, ceil(pad_image_location->y2_ - pad_image_location->y1_)));
+  // Get the location of the cropped and padded image, and the region of the image to copy into it.
+  cv::Rect roi;
+  cv::Size pad_image_size;
+  ComputeCropPadImageGeometry(bbox_tight, image.size(), pad_image_location,
+                              edge_spacing_x, edge_spacing_y, &roi, &pad_image_size);
 
   // Crop the image based on the ROI.
-  cv::Rect myROI(roi_left, roi_bottom, roi_width, roi_height);
-  cv::Mat cropped_image = image(myROI);
+  cv::Mat cropped_image = image(roi);
 
   // Now we need to place the crop in a new image of the appropriate size,
   // adding a black border where necessary to account for edge effects.
+  cv::Mat output_image = cv::Mat(pad_image_size, image.type(), cv::Scalar(0, 0, 0));
+
+  // Get the location within the output to put the cropped image (accounting for edge effects).
+  cv::Rect output_rect(*edge_spacing_x, *edge_spacing_y, roi.width, roi.height);
+  cv::Mat output_image_roi = output_image(output_rect);
+
+  // Copy the cropped image to the specified location within the output.
+  // Without edge effects, this will fill the output.
+  // With edge effects, this will comprise a subset of the output, with black
+  // being placed around the crop to account for edge effects.
+  cropped_image.copyTo(output_image_roi);
+
+  // Set the output.
+  *pad_image = output_image;
+}
+
+void CropPadResize(const BoundingBox& bbox_tight, const cv::Mat& image,
+                   const cv::Size& output_size, cv::Mat* pad_image) {
+  BoundingBox pad_image_location;
+  double edge_spacing_x, edge_spacing_y;
+  cv::Size pad_image_size;
+  CropPadResize(bbox_tight, image, output_size, pad_image, &pad_image_location,
+                &edge_spacing_x, &edge_spacing_y, &pad_image_size);
+}
+
+void CropPadResize(const BoundingBox& bbox_tight, const cv::Mat& image,
+                   const cv::Size& output_size, cv::Mat* pad_image,
+                   BoundingBox* pad_image_location, double* edge_spacing_x, double* edge_spacing_y,
+                   cv::Size* pad_image_size) {
+  // Get the location of the cropped and padded image, and the region of the image that
+  // CropPadImage would copy into it.
+  cv::Rect roi;
+  ComputeCropPadImageGeometry(bbox_tight, image.size(), pad_image_location,
+                              edge_spacing_x, edge_spacing_y, &roi, pad_image_size);
+
+  // Map each output pixel to the padded image as cv::resize does (matching pixel centers),
+  // and from there to the region of the image, which CropPadImage places at
+  // (edge_spacing_x, edge_spacing_y), rounded down.
+  const double scale_x = static_cast<double>(pad_image_size->width) / output_size.width;
+  const double scale_y = static_cast<double>(pad_image_size->height) / output_size.height;
+  const int roi_offset_x = *edge_spacing_x;
+  const int roi_offset_y = *edge_spacing_y;
+  const cv::Matx23d output_to_roi(scale_x, 0, 0.5 * scale_x - 0.5 - roi_offset_x,
+                                  0, scale_y, 0.5 * scale_y - 0.5 - roi_offset_y);
+
+  // Sample the region of the image, with a black border where the padded image extends
+  // beyond it to account for edge effects.
+  // (Into a new image, as in CropPadImage, since pad_image may share its data with other images).
+  cv::Mat output_image;
+  cv::warpAffine(image(roi), output_image, output_to_roi, output_size,
+                 cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
+
+  // Set the output.
+  *pad_image = output_image;
+}
+
+void ComputeCropPadImageGeometry(const BoundingBox& bbox_tight, const cv::Size& image_size,
+                                 BoundingBox* pad_image_location,
+                                 double* edge_spacing_x, double* edge_spacing_y,
+                                 cv::Rect* roi, cv::Size* pad_image_size) {
+  // Get the location of the cropped and padded image.
+  ComputeCropPadImageLocation(bbox_tight, image_size, pad_image_location);
+
+  // Compute the ROI, ensuring that the crop stays within the boundaries of the image.
+  const double roi_left = std::min(pad_image_location->x1_, static_cast<double>(image_size.width - 1));
+  const double roi_bottom = std::min(pad_image_location->y1_, static_cast<double>(image_size.height - 1));
+  const double roi_width = std::min(static_cast<double>(image_size.width), std::max(1.0, ceil(pad_image_location->x2_ - pad_image_location->x1_)));
+  const double roi_height = std::min(static_cast<double>(image_size.height), std::max(1.0, ceil(pad_image_location->y2_ - pad_image_location->y1_)));
+  *roi = cv::Rect(roi_left, roi_bottom, roi_width, roi_height);
 
-  // Make a new image to store the output.
-  // The new image should have size: get_output_width(), get_output_height(), but
+  // The padded image should have size: get_output_width(), get_output_height(), but
   // to be safe we ensure that the output is not smaller than roi_width, roi_height.
   const double output_width = std::max(ceil(bbox_tight.compute_output_width()), roi_width);
   const double output_height = std::max(ceil(bbox_tight.compute_output_height()), roi_height);
-  cv::Mat output_image = cv::Mat(output_height, output_width, image.type(), cv::Scalar(0, 0, 0));
+  *pad_image_size = cv::Size(output_width, output_height);
 
   // Compute the location to place the crop so that it will be centered at the
   // center of the bounding box (accounting for edge effects).
 
   // Get the amount that the output "sticks out" beyond the left and bottom edges of the image.
   // This might be 0, but it might be > 0 if the output is near the edge of the image.
-  *edge_spacing_x = std::min(bbox_tight.edge_spacing_x(), static_cast<double>(output_image.cols - 1));
-  *edge_spacing_y = std::min(bbox_tight.edge_spacing_y(), static_cast<double>(output_image.rows - 1));
+  *edge_spacing_x = std::min(bbox_tight.edge_spacing_x(), static_cast<double>(pad_image_size->width - 1));
+  *edge_spacing_y = std::min(bbox_tight.edge_spacing_y(), static_cast<double>(pad_image_size->height - 1));
+}
 
-  // Get the location within the output to put the cropped image (accounting for edge effects).
-  cv::Rect output_rect(*edge_spacing_x, *edge_spacing_y, roi_width, roi_height);
-  cv::Mat output_image_roi = output_image(output_rect);
+void CropPadResizePlanar(const BoundingBox& bbox_tight, const cv::Mat& image,
+                         const cv::Size& output_size, const cv::Scalar& mean,
+                         const int num_channels, float* output) {
+  ResampleBuffers buffers;
+  CropPadResizePlanar(bbox_tight, image, output_size, mean, num_channels, &buffers, output);
+}
 
-  // Copy the cropped image to the specified location within the output.
-  // Without edge effects, this will fill the output.
-  // With edge effects, this will comprise a subset of the output, with black
-  // being placed around the crop to account for edge effects.
-  cropped_image.copyTo(output_image_roi);
+void CropPadResizePlanar(const BoundingBox& bbox_tight, const cv::Mat& image,
+                         const cv::Size& output_size, const cv::Scalar& mean,
+                         const int num_channels, ResampleBuffers* buffers, float* output) {
+  // Get the region of the image that CropPadImage would copy, and where it would be placed.
+  BoundingBox pad_image_location;
+  double edge_spacing_x, edge_spacing_y;
+  cv::Rect roi;
+  cv::Size pad_image_size;
+  ComputeCropPadImageGeometry(bbox_tight, image.size(), &pad_image_location,
+                              &edge_spacing_x, &edge_spacing_y, &roi, &pad_image_size);
 
-  // Set the output.
-  *pad_image = output_image;
+  // Sample the padded image directly from the image.
+  const cv::Point roi_offset(edge_spacing_x, edge_spacing_y);
+  ResamplePadded(image, roi, roi_offset, pad_image_size, output_size, mean, num_channels,
+                 buffers, output);
+}
+
+void ResizePlanar(const cv::Mat& image, const cv::Size& output_size, const cv::Scalar& mean,
+                  const int num_channels, float* output) {
+  ResampleBuffers buffers;
+  ResizePlanar(image, output_size, mean, num_channels, &buffers, output);
 }
 
+void ResizePlanar(const cv::Mat& image, const cv::Size& output_size, const cv::Scalar& mean,
+                  const int num_channels, ResampleBuffers* buffers, float* output) {
+  // The whole image is used, without any padding.
+  const cv::Rect roi(0, 0, image.cols, image.rows);
+  ResamplePadded(image, roi, cv::Point(0, 0), image.size(), output_size, mean, num_channels,
+                 buffers, output);
+}
@@ -1,6 +1,8 @@
 #ifndef IMAGE_PROC_H
 #define IMAGE_PROC_H
 
+#include <vector>
+
 #include "bounding_box.h"
 
 // Functions to process images for tracking.
@@ -12,9 +14,60 @@ void CropPadImage(const BoundingBox& bbox_tight, const cv::Mat& image, cv::Mat*
 void CropPadImage(const BoundingBox& bbox_tight, const cv::Mat& image, cv::Mat* pad_image,
                   BoundingBox* pad_image_location, double* edge_spacing_x, double* edge_spacing_y);
 
+// Crop and pad the image as in CropPadImage and resize the padded image to output_size, in a
+// single (bilinear) affine warp from the image, with a black border for the space beyond the
+// border of the image.  This avoids building the full-size padded image, which is large for
+// large targets.  pad_image_location, edge_spacing_x and edge_spacing_y are the same as in
+// CropPadImage, and pad_image_size is the size of the padded image before resizing (so that
+// locations within it can be scaled as for CropPadImage).
+void CropPadResize(const BoundingBox& bbox_tight, const cv::Mat& image,
+                   const cv::Size& output_size, cv::Mat* pad_image);
+void CropPadResize(const BoundingBox& bbox_tight, const cv::Mat& image,
+                   const cv::Size& output_size, cv::Mat* pad_image,
+                   BoundingBox* pad_image_location, double* edge_spacing_x, double* edge_spacing_y,
+                   cv::Size* pad_image_size);
+
 // Compute the location of the cropped image, which is centered on the bounding box center
 // but has a size given by (output_width, output_height) to account for additional padding.
 // The cropped image location is also limited by the edge of the image.
 void ComputeCropPadImageLocation(const BoundingBox& bbox_tight, const cv::Mat& image, BoundingBox* pad_image_location);
+void ComputeCropPadImageLocation(const BoundingBox& bbox_tight, const cv::Size& image_size, BoundingBox* pad_image_location);
+
+// Compute the geometry of the padded image produced by CropPadImage, without copying any pixels.
+// pad_image_location, edge_spacing_x and edge_spacing_y are the same as in CropPadImage;
+// roi is the region of the image that is copied into the padded image, and pad_image_size
+// is the size of the padded image.
+void ComputeCropPadImageGeometry(const BoundingBox& bbox_tight, const cv::Size& image_size,
+                                 BoundingBox* pad_image_location,
+                                 double* edge_spacing_x, double* edge_spacing_y,
+                                 cv::Rect* roi, cv::Size* pad_image_size);
+
+// Buffers used by CropPadResizePlanar and ResizePlanar.  Passing the same buffers to
+// repeated calls with the same output size avoids allocating memory on each call.
+struct ResampleBuffers {
+  std::vector<int> x_taps;
+  std::vector<int> y_taps;
+  std::vector<float> x_weights;
+  std::vector<float> y_weights;
+};
+
+// Crop and pad the image as in CropPadImage, resize the padded image to output_size
+// (bilinear), convert it to float, subtract the per-channel mean, and write the result
+// to output as planar floats (num_channels planes of output_size, in BGR order).
+// All of this is done in a single pass over the output, sampling directly from the
+// image without building the padded image or any other intermediate image.
+// The image must be 8-bit with 1, 3 or 4 channels; num_channels must be 1 or 3.
+void CropPadResizePlanar(const BoundingBox& bbox_tight, const cv::Mat& image,
+                         const cv::Size& output_size, const cv::Scalar& mean,
+                         const int num_channels, float* output);
+void CropPadResizePlanar(const BoundingBox& bbox_tight, const cv::Mat& image,
+                         const cv::Size& output_size, const cv::Scalar& mean,
+                         const int num_channels, ResampleBuffers* buffers, float* output);
+
+// Same as CropPadResizePlanar, for an image that has already been cropped.
+void ResizePlanar(const cv::Mat& image, const cv::Size& output_size, const cv::Scalar& mean,
+                  const int num_channels, float* output);
+void ResizePlanar(const cv::Mat& image, const cv::Size& output_size, const cv::Scalar& mean,
+                  const int num_channels, ResampleBuffers* buffers, float* output);
 
 #endif // IMAGE_PROC_H
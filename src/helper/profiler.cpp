@@ -0,0 +1,112 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+// Get the p-th percentile of sorted values (nearest-rank method).
+double Percentile(const std::vector<double>& sorted_values, const double p) {
+  const size_t rank = static_cast<size_t>(ceil(p / 100 * sorted_values.size()));
+  return sorted_values[std::max(rank, static_cast<size_t>(1)) - 1];
+}
+
+// Whether str ends with suffix.
+bool EndsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() &&
+      str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+Profiler::Profiler()
+{
+}
+
+int Profiler::AddStage(const std::string& name) {
+  names_.push_back(name);
+  samples_ms_.push_back(std::vector<double>());
+  return names_.size() - 1;
+}
+
+void Profiler::AddSample(const int stage, const double ms) {
+  samples_ms_[stage].push_back(ms);
+}
+
+void Profiler::ClearSamples() {
+  for (size_t i = 0; i < samples_ms_.size(); ++i) {
+    samples_ms_[i].clear();
+  }
+}
+
+Profiler::StageStats Profiler::ComputeStats(const int stage) const {
+  std::vector<double> sorted_samples = samples_ms_[stage];
+  std::sort(sorted_samples.begin(), sorted_samples.end());
+
+  StageStats stats;
+  stats.count = sorted_samples.size();
+  stats.total_ms = 0;
+  for (size_t i = 0; i < sorted_samples.size(); ++i) {
+    stats.total_ms += sorted_samples[i];
+  }
+  stats.mean_ms = stats.count > 0 ? stats.total_ms / stats.count : 0;
+  stats.p50_ms = stats.count > 0 ? Percentile(sorted_samples, 50) : 0;
+  stats.p99_ms = stats.count > 0 ? Percentile(sorted_samples, 99) : 0;
+  return stats;
+}
+
+void Profiler::Print() const {
+  printf("%-20s %8s %10s %10s %10s %12s\n", "Stage", "Count", "Mean (ms)", "p50 (ms)", "p99 (ms)", "Total (ms)");
+  for (size_t i = 0; i < names_.size(); ++i) {
+    const StageStats& stats = ComputeStats(i);
+    if (stats.count == 0) {
+      continue;
+    }
+    printf("%-20s %8zu %10.3lf %10.3lf %10.3lf %12.1lf\n", names_[i].c_str(), stats.count,
+           stats.mean_ms, stats.p50_ms, stats.p99_ms, stats.total_ms);
+  }
+}
+
+bool Profiler::Save(const std::string& path) const {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    printf("Error - could not open %s for writing\n", path.c_str());
+    return false;
+  }
+
+  const bool json = EndsWith(path, ".json");
+  if (json) {
+    fprintf(file, "{\n  \"stages\": [");
+  } else {
+    fprintf(file, "stage,count,mean_ms,p50_ms,p99_ms,total_ms\n");
+  }
+
+  bool first = true;
+  for (size_t i = 0; i < names_.size(); ++i) {
+    const StageStats& stats = ComputeStats(i);
+    if (stats.count == 0) {
+      continue;
+    }
+    if (json) {
+      fprintf(file, "%s\n    {\"name\": \"%s\", \"count\": %zu, \"mean_ms\": %lf, \"p50_ms\": %lf, "
+              "\"p99_ms\": %lf, \"total_ms\": %lf}", first ? "" : ",", names_[i].c_str(),
+              stats.count, stats.mean_ms, stats.p50_ms, stats.p99_ms, stats.total_ms);
+    } else {
+      fprintf(file, "%s,%zu,%lf,%lf,%lf,%lf\n", names_[i].c_str(), stats.count,
+              stats.mean_ms, stats.p50_ms, stats.p99_ms, stats.total_ms);
+    }
+    first = false;
+  }
+
+  if (json) {
+    fprintf(file, "\n  ]\n}\n");
+  }
+
+  const bool success = !ferror(file);
+  if (fclose(file) != 0 || !success) {
+    printf("Error - could not write %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+
+// Collects timing samples for the named stages of a computation that is run many times
+// (e.g. the layers of a network), and reports the mean, median and 99th percentile of each.
+class Profiler
+{
+public:
+  Profiler();
+
+  // Add a stage to profile, and return its index (for AddSample).
+  // Stages are reported in the order in which they are added.
+  int AddStage(const std::string& name);
+
+  // Number of stages.
+  size_t num_stages() const { return names_.size(); }
+
+  // Record that one run of the given stage took the given number of milliseconds.
+  void AddSample(const int stage, const double ms);
+
+  // Remove all of the samples (but keep the stages).
+  void ClearSamples();
+
+  // Print the statistics of each stage that has samples.
+  void Print() const;
+
+  // Save the statistics of each stage that has samples, in JSON format if
+  // path ends in ".json" and in CSV format otherwise.
+  // Returns false if the file could not be written.
+  bool Save(const std::string& path) const;
+
+private:
+  // Statistics of the samples of a stage.
+  struct StageStats {
+    size_t count;
+    double mean_ms;
+    double p50_ms;
+    double p99_ms;
+    double total_ms;
+  };
+
+  // Compute the statistics of the given stage.
+  StageStats ComputeStats(const int stage) const;
+
+  // Name of each stage.
+  std::vector<std::string> names_;
+
+  // Time of each run of each stage, in milliseconds.
+  std::vector<std::vector<double> > samples_ms_;
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+ThreadPool::ThreadPool(const size_t num_threads) :
+  num_threads_(num_threads > 0 ? num_threads : std::max(boost::thread::hardware_concurrency(), 1u)),
+  task_(NULL),
+  num_iterations_(0),
+  grain_(1),
+  loop_id_(0),
+  num_running_(0),
+  stop_(false)
+{
+  // The calling thread acts as thread 0, so only start the other threads.
+  for (size_t i = 1; i < num_threads_; ++i) {
+    workers_.create_thread(boost::bind(&ThreadPool::WorkerLoop, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  start_condition_.notify_all();
+  workers_.join_all();
+}
+
+void ThreadPool::ParallelFor(const size_t num_iterations, const size_t grain, ParallelTask* task) {
+  if (num_iterations == 0) {
+    return;
+  }
+
+  // Small loops are not worth waking up the workers for.
+  if (num_threads_ == 1 || num_iterations <= grain) {
+    task->Run(0, num_iterations);
+    return;
+  }
+
+  // Start the workers on the loop.
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    task_ = task;
+    num_iterations_ = num_iterations;
+    grain_ = std::max(grain, static_cast<size_t>(1));
+    num_running_ = num_threads_ - 1;
+    loop_id_++;
+  }
+  start_condition_.notify_all();
+
+  // Run this thread's part of the loop.
+  RunPart(0);
+
+  // Wait for the workers to finish.
+  boost::mutex::scoped_lock lock(mutex_);
+  while (num_running_ > 0) {
+    done_condition_.wait(lock);
+  }
+  task_ = NULL;
+}
+
+void ThreadPool::RunPart(const size_t thread_num) {
+  // Split the loop into num_threads_ ranges of whole grains.
+  const size_t num_grains = (num_iterations_ + grain_ - 1) / grain_;
+  const size_t begin_grain = num_grains * thread_num / num_threads_;
+  const size_t end_grain = num_grains * (thread_num + 1) / num_threads_;
+  const size_t begin = std::min(begin_grain * grain_, num_iterations_);
+  const size_t end = std::min(end_grain * grain_, num_iterations_);
+  if (begin < end) {
+    task_->Run(begin, end);
+  }
+}
+
+void ThreadPool::WorkerLoop(const size_t worker_num) {
+  size_t last_loop_id = 0;
+  while (true) {
+    // Wait for a new loop.
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (!stop_ && loop_id_ == last_loop_id) {
+        start_condition_.wait(lock);
+      }
+      if (stop_) {
+        return;
+      }
+      last_loop_id = loop_id_;
+    }
+
+    // Run this worker's part of the loop.
+    RunPart(worker_num);
+
+    // Signal that this worker has finished.
+    boost::mutex::scoped_lock lock(mutex_);
+    num_running_--;
+    if (num_running_ == 0) {
+      done_condition_.notify_one();
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+// A loop body that can be run in parallel by a ThreadPool.
+class ParallelTask
+{
+public:
+  virtual ~ParallelTask() {}
+
+  // Run the loop for the iterations in [begin, end).
+  virtual void Run(const size_t begin, const size_t end) = 0;
+};
+
+// A fixed set of worker threads for running loops in parallel.
+// The calling thread also runs part of each loop, so a pool with 1 thread has no workers
+// and runs everything on the calling thread.
+class ThreadPool
+{
+public:
+  // Create a pool that runs loops on num_threads threads (including the calling thread).
+  // If num_threads is 0, use one thread per CPU.
+  explicit ThreadPool(const size_t num_threads);
+  ~ThreadPool();
+
+  // Number of threads that loops are run on.
+  size_t num_threads() const { return num_threads_; }
+
+  // Run task for the iterations [0, num_iterations), split into contiguous ranges that
+  // are run in parallel (each range is a multiple of grain iterations, except the last).
+  // Returns once all iterations have finished.  Does not allocate memory.
+  // Only one thread may run loops on a pool at a time.
+  void ParallelFor(const size_t num_iterations, const size_t grain, ParallelTask* task);
+
+private:
+  // Worker thread: wait for loops and run the part of each that belongs to this worker.
+  void WorkerLoop(const size_t worker_num);
+
+  // Run the part of the current loop that belongs to thread thread_num.
+  void RunPart(const size_t thread_num);
+
+  size_t num_threads_;
+  boost::thread_group workers_;
+
+  // Protects the state of the current loop.
+  boost::mutex mutex_;
+  boost::condition_variable start_condition_;
+  boost::condition_variable done_condition_;
+
+  // The current loop.  Each new loop increments loop_id_, which signals the workers to start.
+  ParallelTask* task_;
+  size_t num_iterations_;
+  size_t grain_;
+  size_t loop_id_;
+
+  // Number of workers that have not yet finished the current loop.
+  size_t num_running_;
+
+  // Whether the workers should exit.
+  bool stop_;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,118 @@
+#include "frame_prefetcher.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <boost/bind.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "loader/video.h"
+
+FramePrefetcher::FramePrefetcher(const size_t num_threads, const size_t max_frames,
+                                 const size_t max_bytes) :
+  max_frames_(std::max<size_t>(max_frames, 1)),
+  max_bytes_(max_bytes),
+  next_frame_(0),
+  frame_bytes_(0),
+  generation_(0),
+  stop_(false)
+{
+  // Start the decode threads.
+  for (size_t i = 0; i < std::max<size_t>(num_threads, 1); ++i) {
+    threads_.create_thread(boost::bind(&FramePrefetcher::DecodeLoop, this));
+  }
+}
+
+FramePrefetcher::~FramePrefetcher() {
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  threads_.join_all();
+}
+
+void FramePrefetcher::Attach(std::vector<Video>* videos) {
+  for (size_t i = 0; i < videos->size(); ++i) {
+    (*videos)[i].set_prefetcher(this);
+  }
+}
+
+void FramePrefetcher::Load(const std::string& folder, const std::vector<std::string>& files,
+                           const size_t frame_num, cv::Mat* image) {
+  if (frame_num >= files.size()) {
+    printf("Error - cannot load frame %zu; only %zu image files were found at %s\n",
+           frame_num, files.size(), folder.c_str());
+    image->release();
+    return;
+  }
+
+  boost::lock_guard<boost::mutex> load_lock(load_mutex_);
+  boost::unique_lock<boost::mutex> lock(mutex_);
+
+  // Unless this is the next frame of the video being read ahead, discard the frames read ahead
+  // and start reading ahead from this frame.
+  if (frame_num != next_frame_ || folder != folder_ || files.size() != files_.size()) {
+    folder_ = folder;
+    files_ = files;
+    next_frame_ = frame_num;
+    frames_.clear();
+    generation_++;
+    condition_.notify_all();
+  }
+
+  // Wait for the frame to be decoded.
+  while (frames_.empty() || !frames_.front().ready) {
+    condition_.wait(lock);
+  }
+
+  // Hand out the frame, making room to read ahead another.
+  *image = frames_.front().image;
+  frames_.pop_front();
+  next_frame_++;
+  condition_.notify_all();
+}
+
+bool FramePrefetcher::CanDecode() const {
+  // Decode the frames after the last one being read ahead, up to the end of the video,
+  // the maximum number of frames and the memory budget (except for the next frame to load,
+  // which is always decoded).
+  return next_frame_ + frames_.size() < files_.size() && frames_.size() < max_frames_ &&
+      (frames_.empty() || (frames_.size() + 1) * frame_bytes_ <= max_bytes_);
+}
+
+void FramePrefetcher::DecodeLoop() {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (true) {
+    // Wait for a frame to decode.
+    while (!stop_ && !CanDecode()) {
+      condition_.wait(lock);
+    }
+    if (stop_) {
+      return;
+    }
+
+    // Take the next frame to read ahead.
+    const size_t frame_num = next_frame_ + frames_.size();
+    const size_t generation = generation_;
+    const std::string image_file = folder_ + "/" + files_[frame_num];
+    frames_.push_back(PrefetchedFrame());
+
+    // Decode it without holding the lock.
+    lock.unlock();
+    cv::Mat image = cv::imread(image_file);
+    lock.lock();
+
+    // Drop the frame if the frames read ahead were discarded in the meantime.
+    if (generation != generation_) {
+      continue;
+    }
+
+    // (The frames before this one may have been loaded in the meantime, but not this one).
+    PrefetchedFrame& frame = frames_[frame_num - next_frame_];
+    frame.image = image;
+    frame.ready = true;
+    frame_bytes_ = image.total() * image.elemSize();
+    condition_.notify_all();
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef FRAME_PREFETCHER_H
+#define FRAME_PREFETCHER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <boost/thread.hpp>
+
+class Video;
+
+// Number of decode threads, frames read ahead and bytes of decoded frames used by the tools.
+const size_t kPrefetchThreads = 2;
+const size_t kPrefetchFrames = 16;
+const size_t kPrefetchBytes = 256 << 20;
+
+// Reads the frames of a video ahead of when they are needed, on a pool of decode threads,
+// so that the disk reads and image decoding overlap with tracking.
+// Once attached to videos, Video::LoadFrame and Video::LoadAnnotation take their images from
+// the prefetcher.  After loading frame i of a video, the prefetcher decodes frames i + 1,
+// i + 2, ... of the same video, and hands them out in order; loading any other frame
+// (or a frame of another video) discards the frames read ahead and starts again from there.
+// So the prefetcher helps only when frames are loaded in order, one video at a time.
+// Loading frames from several threads is safe, but each load waits for the others.
+class FramePrefetcher
+{
+public:
+  // Decode frames on num_threads threads, reading ahead up to max_frames frames, and keeping at most
+  // max_bytes of decoded frames that have not been loaded yet (but always decoding the next frame).
+  FramePrefetcher(const size_t num_threads, const size_t max_frames, const size_t max_bytes);
+  ~FramePrefetcher();
+
+  // Load the images of these videos with this prefetcher (which must outlive them).
+  void Attach(std::vector<Video>* videos);
+
+  // Get the image of frame frame_num of the video whose frames are the given files in folder.
+  // Returns an empty image if the file cannot be read (as cv::imread does).
+  void Load(const std::string& folder, const std::vector<std::string>& files,
+            const size_t frame_num, cv::Mat* image);
+
+private:
+  // A frame being read ahead.
+  struct PrefetchedFrame {
+    PrefetchedFrame() : ready(false) {}
+
+    // Whether the frame has been decoded, and its image.
+    bool ready;
+    cv::Mat image;
+  };
+
+  // Decode thread: decode the next frame to read ahead, until stopped.
+  void DecodeLoop();
+
+  // Whether a decode thread may start decoding another frame.  Requires mutex_.
+  bool CanDecode() const;
+
+  size_t max_frames_;
+  size_t max_bytes_;
+
+  // Serializes the calls to Load.
+  boost::mutex load_mutex_;
+
+  // Protects the state below.
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+
+  // The video being read ahead, and the number of its next frame to be loaded.
+  std::string folder_;
+  std::vector<std::string> files_;
+  size_t next_frame_;
+
+  // Frames next_frame_, next_frame_ + 1, ... that are being decoded or are ready.
+  std::deque<PrefetchedFrame> frames_;
+
+  // Size in bytes of the last frame decoded (the frames of a video all have the same size).
+  size_t frame_bytes_;
+
+  // Incremented when the frames read ahead are discarded, so that the decode threads
+  // drop the frames they were decoding.
+  size_t generation_;
+
+  bool stop_;
+  boost::thread_group threads_;
+};
+
+#endif // FRAME_PREFETCHER_H
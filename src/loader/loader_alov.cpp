@@ -96,6 +96,7 @@ LoaderAlov::LoaderAlov(const string& video_folder, const string& annotations_fol
 
       // Save the video.
       fclose(annotation_file_ptr);
+      video.BuildAnnotationIndex();
       videos_.push_back(video);
       category.videos.push_back(video);
     } // Process all annotation files in category
@@ -66,6 +66,7 @@ LoaderVOT::LoaderVOT(const std::string& vot_folder)
       video.annotations.push_back(frame);
     } // Process annotation file
     fclose(bbox_groundtruth_file_ptr);
+    video.BuildAnnotationIndex();
     videos_.push_back(video);
   } // Process all videos
 }
@@ -0,0 +1,263 @@
+#include "roi_frame_loader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#ifdef USE_ROI_DECODE
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+#include "helper/image_proc.h"
+#include "loader/video.h"
+
+using std::string;
+
+namespace {
+
+// Margin added around the search region when decoding it, as a fraction of its size on each side,
+// so that the target region decoded after tracking usually lies within it already.
+const double kSearchMargin = 0.25;
+
+// Size of the input to the network, which the search region is resized to.
+const int kNetInputSize = 227;
+
+// Largest denominator of the scales that JPEG frames are decoded at (1/2, 1/4 or 1/8).
+const int kMaxScaleDenom = 8;
+
+// Get the denominator of the smallest scale at which the search region around bbox_tight is at
+// least as large as the input to the network.
+int ChooseScaleDenom(const BoundingBox& bbox_tight) {
+  const double search_size = std::min(bbox_tight.compute_output_width(),
+                                      bbox_tight.compute_output_height());
+  int scale_denom = 1;
+  while (scale_denom < kMaxScaleDenom && search_size / (2 * scale_denom) >= kNetInputSize) {
+    scale_denom *= 2;
+  }
+  return scale_denom;
+}
+
+// Get the region of an image of the given size that is cropped around bbox_tight.
+cv::Rect CropRegion(const BoundingBox& bbox_tight, const cv::Size& image_size) {
+  BoundingBox pad_image_location;
+  double edge_spacing_x, edge_spacing_y;
+  cv::Rect roi;
+  cv::Size pad_image_size;
+  ComputeCropPadImageGeometry(bbox_tight, image_size, &pad_image_location,
+                              &edge_spacing_x, &edge_spacing_y, &roi, &pad_image_size);
+  return roi;
+}
+
+// Read the contents of file into data.  Returns false if the file cannot be read.
+bool ReadFile(const string& file, std::vector<unsigned char>* data) {
+  std::ifstream stream(file.c_str(), std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+  stream.seekg(0, std::ios::end);
+  data->resize(stream.tellg());
+  stream.seekg(0, std::ios::beg);
+  return !data->empty() && stream.read(reinterpret_cast<char*>(&(*data)[0]), data->size());
+}
+
+#ifdef USE_ROI_DECODE
+
+// Error handler for libjpeg that returns to the caller (by default, libjpeg exits the program).
+struct JpegErrorManager {
+  jpeg_error_mgr manager;
+  jmp_buf return_point;
+};
+
+void JpegErrorExit(j_common_ptr cinfo) {
+  longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->return_point, 1);
+}
+
+// Ignore warnings about corrupt data (as cv::imread does).
+void JpegOutputMessage(j_common_ptr cinfo) {
+}
+
+// Get the size of the JPEG image in data when decoded at scale 1 / scale_denom.
+// Returns false if data is not a JPEG image.
+bool ReadJpegSize(const std::vector<unsigned char>& data, const int scale_denom, cv::Size* size) {
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager error;
+  cinfo.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = JpegErrorExit;
+  error.manager.output_message = JpegOutputMessage;
+  if (setjmp(error.return_point)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<unsigned char*>(&data[0]), data.size());
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = scale_denom;
+  jpeg_calc_output_dimensions(&cinfo);
+  *size = cv::Size(cinfo.output_width, cinfo.output_height);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+// Decode rect of the JPEG image in data at scale 1 / scale_denom into image (which must have the
+// size of the scaled JPEG image), as BGR, leaving the rest of image unchanged.  Only the rows of
+// blocks that cover rect are decoded, and only the columns of blocks that cover it are converted
+// to pixels (through row).  Returns false if the image cannot be decoded.
+bool DecodeJpegRect(const std::vector<unsigned char>& data, const int scale_denom,
+                    const cv::Rect& rect, std::vector<unsigned char>* row, cv::Mat* image) {
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager error;
+  cinfo.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = JpegErrorExit;
+  error.manager.output_message = JpegOutputMessage;
+  if (setjmp(error.return_point)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<unsigned char*>(&data[0]), data.size());
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_EXT_BGR;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = scale_denom;
+  jpeg_start_decompress(&cinfo);
+  if (static_cast<int>(cinfo.output_width) != image->cols ||
+      static_cast<int>(cinfo.output_height) != image->rows ||
+      cinfo.output_components != 3) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  // Decode only the columns covering rect (extended to the edges of the blocks).  The upsampled
+  // chroma at the edges of the decoded columns differs from that of the whole image, so decode
+  // one more block on each side, and copy only the columns of rect into image.
+  // (Blocks are decoded to DCTSIZE / scale_denom pixels on a side).
+  const int block_width = DCTSIZE * cinfo.max_h_samp_factor / scale_denom;
+  const int left = std::max(rect.x - block_width, 0);
+  JDIMENSION x_offset = left;
+  JDIMENSION width = std::min(rect.x + rect.width + block_width, image->cols) - left;
+  jpeg_crop_scanline(&cinfo, &x_offset, &width);
+  row->resize(3 * width);
+  JSAMPROW row_ptr = &(*row)[0];
+  const int row_offset = 3 * (rect.x - x_offset);
+
+  // Skip the rows above rect, and stop after the rows of rect.
+  jpeg_skip_scanlines(&cinfo, rect.y);
+  while (static_cast<int>(cinfo.output_scanline) < rect.y + rect.height) {
+    unsigned char* image_row = image->ptr<unsigned char>(cinfo.output_scanline) + 3 * rect.x;
+    jpeg_read_scanlines(&cinfo, &row_ptr, 1);
+    memcpy(image_row, row_ptr + row_offset, 3 * rect.width);
+  }
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+#endif // USE_ROI_DECODE
+
+} // namespace
+
+RoiFrameLoader::RoiFrameLoader(const bool downscale) :
+  downscale_(downscale),
+  scale_denom_(1),
+  current_image_(0)
+{
+}
+
+bool RoiFrameLoader::LoadFrame(const Video& video, const int frame_num,
+                               const BoundingBox& bbox_prior_tight,
+                               cv::Mat* image, double* image_scale, BoundingBox* bbox_gt) {
+  // Get the annotation of the frame.
+  const bool draw_bounding_box = false;
+  const bool load_only_annotation = true;
+  const bool has_annotation = video.LoadFrame(frame_num, draw_bounding_box, load_only_annotation,
+                                              image, bbox_gt);
+
+  // Use the other buffer for this frame (the tracker may still use the previous frame).
+  current_image_ = 1 - current_image_;
+  cv::Mat& current_image = images_[current_image_];
+  decoded_rects_.clear();
+  const string& image_file = video.path + "/" + video.all_frames[frame_num];
+
+#ifdef USE_ROI_DECODE
+  // Choose the scale to decode the frame at.
+  scale_denom_ = downscale_ ? ChooseScaleDenom(bbox_prior_tight) : 1;
+  *image_scale = 1.0 / scale_denom_;
+
+  // Decode the search region, with a margin.
+  cv::Size image_size;
+  if (ReadFile(image_file, &file_data_) && ReadJpegSize(file_data_, scale_denom_, &image_size)) {
+    // Zero-fill a newly allocated image, so that its pixels outside the decoded regions are
+    // deterministic.
+    if (current_image.size() != image_size || current_image.type() != CV_8UC3) {
+      current_image.create(image_size, CV_8UC3);
+      current_image.setTo(cv::Scalar(0, 0, 0));
+    }
+    BoundingBox bbox_prior_scaled;
+    bbox_prior_tight.Rescale(*image_scale, &bbox_prior_scaled);
+    const cv::Rect search_region = CropRegion(bbox_prior_scaled, image_size);
+    const int margin_x = search_region.width * kSearchMargin;
+    const int margin_y = search_region.height * kSearchMargin;
+    const cv::Rect rect(search_region.x - margin_x, search_region.y - margin_y,
+                        search_region.width + 2 * margin_x, search_region.height + 2 * margin_y);
+    if (DecodeRect(rect & cv::Rect(0, 0, image_size.width, image_size.height))) {
+      *image = current_image;
+      return has_annotation;
+    }
+  }
+#endif
+
+  // Otherwise decode the whole frame, at full scale.
+  file_data_.clear();
+  scale_denom_ = 1;
+  *image_scale = 1;
+  current_image = cv::imread(image_file);
+  if (!current_image.data) {
+    printf("Could not find file: %s\n", image_file.c_str());
+  }
+  decoded_rects_.push_back(cv::Rect(0, 0, current_image.cols, current_image.rows));
+  *image = current_image;
+  return has_annotation;
+}
+
+void RoiFrameLoader::DecodeRegion(const BoundingBox& bbox_tight) {
+  const cv::Mat& current_image = images_[current_image_];
+  if (!current_image.data) {
+    return;
+  }
+
+  // Nothing to do if the region has been decoded already.
+  BoundingBox bbox_scaled;
+  bbox_tight.Rescale(1.0 / scale_denom_, &bbox_scaled);
+  const cv::Rect region = CropRegion(bbox_scaled, current_image.size());
+  for (size_t i = 0; i < decoded_rects_.size(); ++i) {
+    if ((decoded_rects_[i] & region) == region) {
+      return;
+    }
+  }
+
+  if (!DecodeRect(region)) {
+    printf("Error - could not decode a region of the current frame\n");
+  }
+}
+
+bool RoiFrameLoader::DecodeRect(const cv::Rect& rect) {
+#ifdef USE_ROI_DECODE
+  if (rect.area() == 0) {
+    return true;
+  }
+  if (file_data_.empty() || !DecodeJpegRect(file_data_, scale_denom_, rect, &row_,
+                                              &images_[current_image_])) {
+    return false;
+  }
+  decoded_rects_.push_back(rect);
+  return true;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,66 @@
+#ifndef ROI_FRAME_LOADER_H
+#define ROI_FRAME_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "helper/bounding_box.h"
+
+class Video;
+
+// Loads the frames of a video for tracking, decoding only the regions of each frame that the
+// tracker crops: the search region around the prior location of the target, and (once it has
+// been tracked) the region around the estimated target, which the next frame crops the target from.
+// Each image has the full size of the frame, so locations in it are those of the full frame,
+// but its pixels outside the decoded regions are black (in a newly allocated image) or left over
+// from an earlier frame.  The images alternate between two buffers, so each stays valid while the
+// next frame is loaded (and the tracker still uses it as the previous image), but is overwritten
+// by the frame after that.
+// JPEG frames are decoded by rows and columns of blocks with libjpeg-turbo, when built with
+// ROI_DECODE; other frames (or all frames, otherwise) are decoded whole.
+// If downscale, JPEG frames are also decoded at 1/2, 1/4 or 1/8 scale (by the inverse DCT, so at
+// a fraction of the cost) when the search region would still be at least as large as the input to
+// the network, since it is resized to that anyway.  The images are then the size of the scaled frame.
+class RoiFrameLoader
+{
+public:
+  RoiFrameLoader(const bool downscale);
+
+  // Load frame frame_num of video to track a target whose location in the frame is predicted to
+  // be bbox_prior_tight, decoding only the search region around it (with a margin).
+  // image_scale is set to the factor by which image has been resized from the frame.
+  // Returns whether the frame has an annotation (and if so, sets bbox_gt), as Video::LoadFrame does.
+  bool LoadFrame(const Video& video, const int frame_num, const BoundingBox& bbox_prior_tight,
+                 cv::Mat* image, double* image_scale, BoundingBox* bbox_gt);
+
+  // Decode the region around bbox_tight (in the full-size frame) in the last frame loaded (the
+  // region that the next frame crops the target from, when bbox_tight is the estimated target),
+  // unless already decoded.
+  void DecodeRegion(const BoundingBox& bbox_tight);
+
+private:
+  // Decode rect of the current file into the current image.  Returns false if the file is not
+  // a JPEG file that can be decoded by regions.
+  bool DecodeRect(const cv::Rect& rect);
+
+  // Whether to decode frames at a reduced scale.
+  bool downscale_;
+
+  // Contents of the file of the last frame loaded, and the scale it is decoded at (1 / scale_denom_).
+  std::vector<unsigned char> file_data_;
+  int scale_denom_;
+
+  // A row of decoded pixels.
+  std::vector<unsigned char> row_;
+
+  // The images of the last two frames loaded, and the one holding the last frame.
+  cv::Mat images_[2];
+  size_t current_image_;
+
+  // Regions of the current image that have been decoded.
+  std::vector<cv::Rect> decoded_rects_;
+};
+
+#endif // ROI_FRAME_LOADER_H
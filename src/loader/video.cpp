@@ -1,11 +1,19 @@
 #include "video.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
+#include "loader/frame_prefetcher.h"
+
 using std::string;
 using std::vector;
 
+Video::Video() :
+  prefetcher_(NULL)
+{
+}
+
 void Video::ShowVideo() const {
   const string& video_path = path;
 
@@ -21,7 +29,8 @@ void Video::ShowVideo() const {
   for (size_t image_frame_num = start_frame; image_frame_num <= end_frame; ++image_frame_num) {
     // Load the image.
     const string& image_file = video_path + "/" + image_files[image_frame_num];
-    cv::Mat image = cv::imread(image_file);
+    cv::Mat image;
+    LoadImage(image_frame_num, &image);
 
     // Get the frame number for the next annotation.
     const int annotated_frame_num = annotations[annotated_frame_index].frame_num;
@@ -82,14 +91,79 @@ void Video::LoadAnnotation(const int annotation_index,
 
   // Load the image corresponding to this annotation.
   const string& image_file = video_path + "/" + image_files[*frame_num];
-  *image = cv::imread(image_file);
+  LoadImage(*frame_num, image);
 
   if (!image->data) {
     printf("Could not find file: %s\n", image_file.c_str());
   }
 }
 
+void Video::LoadImage(const int frame_num, cv::Mat* image) const {
+  if (prefetcher_) {
+    prefetcher_->Load(path, all_frames, frame_num, image);
+  } else {
+    *image = cv::imread(path + "/" + all_frames[frame_num]);
+  }
+}
+
+void Video::BuildAnnotationIndex() {
+  // Find the last annotated frame.
+  int last_frame = -1;
+  for (size_t i = 0; i < annotations.size(); ++i) {
+    last_frame = std::max(last_frame, annotations[i].frame_num);
+  }
+
+  // Record the first annotation of each frame.
+  frame_annotations_.assign(last_frame + 1, -1);
+  for (size_t i = 0; i < annotations.size(); ++i) {
+    const int frame_num = annotations[i].frame_num;
+    if (frame_num >= 0 && frame_annotations_[frame_num] < 0) {
+      frame_annotations_[frame_num] = static_cast<int>(i);
+    }
+  }
+
+  // Record the next annotated frame at or after each frame, working backwards.
+  next_annotated_frames_.resize(last_frame + 1);
+  int next_frame = -1;
+  for (int frame_num = last_frame; frame_num >= 0; --frame_num) {
+    if (frame_annotations_[frame_num] >= 0) {
+      next_frame = frame_num;
+    }
+    next_annotated_frames_[frame_num] = next_frame;
+  }
+}
+
+int Video::NextAnnotatedFrame(const int frame_num) const {
+  const int first_frame = std::max(frame_num + 1, 0);
+
+  // Look up the next annotated frame in the index, if built.
+  if (!next_annotated_frames_.empty()) {
+    return first_frame < static_cast<int>(next_annotated_frames_.size()) ?
+        next_annotated_frames_[first_frame] : -1;
+  }
+
+  // Otherwise search all annotations.
+  int next_frame = -1;
+  for (size_t i = 0; i < annotations.size(); ++i) {
+    const int annotated_frame = annotations[i].frame_num;
+    if (annotated_frame >= first_frame && (next_frame < 0 || annotated_frame < next_frame)) {
+      next_frame = annotated_frame;
+    }
+  }
+  return next_frame;
+}
+
 bool Video::FindAnnotation(const int frame_num, BoundingBox* box) const {
+  // Look up the annotation in the index, if built.
+  if (!frame_annotations_.empty()) {
+    if (frame_num < 0 || frame_num >= static_cast<int>(frame_annotations_.size()) ||
+        frame_annotations_[frame_num] < 0) {
+      return false;
+    }
+    *box = annotations[frame_annotations_[frame_num]].bbox;
+    return true;
+  }
+
   // Iterate over all annotations.
   for (size_t i = 0; i < annotations.size(); ++i) {
     const Frame& frame = annotations[i];
@@ -108,13 +182,9 @@ bool Video::FindAnnotation(const int frame_num, BoundingBox* box) const {
 bool Video::LoadFrame(const int frame_num, const bool draw_bounding_box,
                      const bool load_only_annotation, cv::Mat* image,
                      BoundingBox* box) const {
-  const string& video_path = path;
-  const vector<string>& image_files = all_frames;
-
   // Load the image for this frame.
   if (!load_only_annotation) {
-    const string& image_file = video_path + "/" + image_files[frame_num];
-    *image = cv::imread(image_file);
+    LoadImage(frame_num, image);
   }
 
   // Find the annotation (if it exists) for the desired frame_num.
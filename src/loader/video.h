@@ -3,6 +3,8 @@
 
 #include "helper/bounding_box.h"
 
+class FramePrefetcher;
+
 // An image frame and corresponding annotation.
 struct Frame {
   int frame_num;
@@ -12,11 +14,21 @@ struct Frame {
 // Container for video data and the corresponding frame annotations.
 class Video {
 public:
+  Video();
+
   // For a given annotation index, get the corresponding frame number, image,
   // and bounding box.
   void LoadAnnotation(const int annotation_index, int* frame_num, cv::Mat* image,
                      BoundingBox* box) const;
 
+  // Index the annotations by frame number, so that finding the annotation of a frame takes
+  // constant time.  Called by the loaders once all annotations of the video are loaded;
+  // must be called again if the annotations change.  (Until then, the annotations are searched.)
+  void BuildAnnotationIndex();
+
+  // Get the number of the first annotated frame after frame_num, or -1 if there is none.
+  int NextAnnotatedFrame(const int frame_num) const;
+
   // Find and return the first frame with an annotation in this video.
   void LoadFirstAnnotation(int* first_frame, cv::Mat* image,
                           BoundingBox* box) const;
@@ -34,6 +46,9 @@ public:
   // Show video with all annotations.
   void ShowVideo() const;
 
+  // Load the images of this video with prefetcher (or directly from disk, if NULL).
+  void set_prefetcher(FramePrefetcher* prefetcher) { prefetcher_ = prefetcher; }
+
   // Path to the folder containing the image files for this video.
   std::string path;
 
@@ -49,6 +64,18 @@ private:
   // For a given frame num, find an annotation if it exists, and return true.
   // Otherwise return false.
   bool FindAnnotation(const int frame_num, BoundingBox* box) const;
+
+  // Load the image of frame frame_num.
+  void LoadImage(const int frame_num, cv::Mat* image) const;
+
+  // Reads the frames ahead of when they are loaded (or NULL).
+  FramePrefetcher* prefetcher_;
+
+  // For each frame number up to the last annotated frame, the index of its first annotation
+  // (or -1), and the number of the first annotated frame at or after it.
+  // Empty until BuildAnnotationIndex is called.
+  std::vector<int> frame_annotations_;
+  std::vector<int> next_annotated_frames_;
 };
 
 // A collection of videos.
@@ -0,0 +1,122 @@
+#include "async_regress_helper.h"
+
+#include <boost/bind.hpp>
+
+AsyncRegressHelper::AsyncRegressHelper(AsyncRegressStages* stages) :
+  stages_(stages),
+  next_slot_(0),
+  stop_(false)
+{
+}
+
+AsyncRegressHelper::~AsyncRegressHelper() {
+  Stop();
+}
+
+boost::shared_future<BoundingBox> AsyncRegressHelper::Start(const cv::Mat& image_curr,
+                                                            const BoundingBox& bbox_curr_prior_tight,
+                                                            const cv::Mat& image_prev,
+                                                            const BoundingBox& bbox_prev_tight) {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+
+  // Start the helper threads on the first call.
+  if (threads_.size() == 0) {
+    threads_.create_thread(boost::bind(&AsyncRegressHelper::PreprocessLoop, this));
+    threads_.create_thread(boost::bind(&AsyncRegressHelper::ForwardLoop, this));
+  }
+
+  // Wait for the next slot to be free.
+  Estimate& estimate = estimates_[next_slot_];
+  while (estimate.state != Estimate::kDone) {
+    condition_.wait(lock);
+  }
+  next_slot_ = (next_slot_ + 1) % kNumSlots;
+
+  // Hand the estimate to the preprocessing thread.
+  estimate.inputs.image_curr = image_curr;
+  estimate.inputs.bbox_curr_prior_tight = bbox_curr_prior_tight;
+  estimate.inputs.image_prev = image_prev;
+  estimate.inputs.bbox_prev_tight = bbox_prev_tight;
+  estimate.result.reset(new boost::promise<BoundingBox>);
+  estimate.state = Estimate::kStarted;
+  condition_.notify_all();
+  return estimate.result->get_future();
+}
+
+void AsyncRegressHelper::Wait() {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  for (size_t i = 0; i < kNumSlots; ++i) {
+    while (estimates_[i].state != Estimate::kDone) {
+      condition_.wait(lock);
+    }
+  }
+}
+
+void AsyncRegressHelper::Stop() {
+  Wait();
+
+  // Stop the helper threads.
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  threads_.join_all();
+}
+
+void AsyncRegressHelper::PreprocessLoop() {
+  for (size_t slot = 0; ; slot = (slot + 1) % kNumSlots) {
+    // Wait for the estimate in the next slot to be started.
+    Estimate& estimate = estimates_[slot];
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (estimate.state != Estimate::kStarted && !stop_) {
+        condition_.wait(lock);
+      }
+      if (stop_) {
+        return;
+      }
+    }
+
+    // Preprocess the inputs into this slot (while the network may be running on the other slot).
+    stages_->PreprocessAsync(slot, estimate.inputs);
+
+    // Hand the estimate to the forward thread.
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      estimate.state = Estimate::kPreprocessed;
+    }
+    condition_.notify_all();
+  }
+}
+
+void AsyncRegressHelper::ForwardLoop() {
+  stages_->StartForwardThread();
+
+  for (size_t slot = 0; ; slot = (slot + 1) % kNumSlots) {
+    // Wait for the estimate in the next slot to be preprocessed.
+    Estimate& estimate = estimates_[slot];
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (estimate.state != Estimate::kPreprocessed && !stop_) {
+        condition_.wait(lock);
+      }
+      if (stop_) {
+        return;
+      }
+    }
+
+    // Run the network on this slot.
+    const BoundingBox bbox = stages_->ForwardAsync(slot);
+
+    // Free the slot for the next estimate, then give this estimate its result.
+    const boost::shared_ptr<boost::promise<BoundingBox> > result = estimate.result;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      estimate.state = Estimate::kDone;
+      estimate.result.reset();
+    }
+    condition_.notify_all();
+    result->set_value(bbox);
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef ASYNC_REGRESS_HELPER_H
+#define ASYNC_REGRESS_HELPER_H
+
+#include <cstddef>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/future.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "helper/bounding_box.h"
+
+// The inputs of an estimate started with RegressorBase::RegressAsync.
+struct AsyncRegressInputs {
+  cv::Mat image_curr;
+  BoundingBox bbox_curr_prior_tight;
+  cv::Mat image_prev;
+  BoundingBox bbox_prev_tight;
+};
+
+// The stages of the estimates run by an AsyncRegressHelper, implemented by the regressor.
+// Each estimate is given one of AsyncRegressHelper::kNumSlots slots, in turn, and the regressor
+// keeps a set of network inputs for each slot.
+class AsyncRegressStages
+{
+public:
+  virtual ~AsyncRegressStages() {}
+
+  // Crop, resize and normalize inputs into the network inputs of slot.
+  // Called on the preprocessing thread, possibly while the network runs on another slot.
+  virtual void PreprocessAsync(const size_t slot, const AsyncRegressInputs& inputs) = 0;
+
+  // Run the network on the network inputs of slot, and return the estimated bounding box.
+  // Called on the forward thread.
+  virtual BoundingBox ForwardAsync(const size_t slot) = 0;
+
+  // Called on the forward thread before its first forward pass.
+  virtual void StartForwardThread() {}
+};
+
+// Runs RegressorBase::RegressAsync for a regressor, with double buffering: the inputs of each
+// estimate are preprocessed on a helper thread into one of two slots, while the network runs
+// on another helper thread on the other slot; so when several estimates are started before
+// waiting for them (e.g. one per video being tracked), the preprocessing of each overlaps the
+// forward pass of the one before it.  The estimates are run in the order they were started.
+class AsyncRegressHelper
+{
+public:
+  // Number of estimates that can be in progress at once (and of slots of network inputs).
+  static const size_t kNumSlots = 2;
+
+  // stages must outlive this helper (or call Stop before it is destroyed).
+  explicit AsyncRegressHelper(AsyncRegressStages* stages);
+
+  // Stops the helper threads.
+  ~AsyncRegressHelper();
+
+  // Start an estimate, starting the helper threads on the first call.
+  // Blocks while kNumSlots estimates are already in progress.
+  boost::shared_future<BoundingBox> Start(const cv::Mat& image_curr,
+                                          const BoundingBox& bbox_curr_prior_tight,
+                                          const cv::Mat& image_prev,
+                                          const BoundingBox& bbox_prev_tight);
+
+  // Wait until all estimates that have been started are done.  The regressor must call this
+  // before running the network itself.
+  void Wait();
+
+  // Wait for the estimates in progress, and stop the helper threads (after which no more
+  // estimates can be started).  The regressor must call this in its destructor, before its
+  // network inputs are destroyed.
+  void Stop();
+
+private:
+  // Helper threads: preprocess the inputs of each estimate, and run the network on the
+  // preprocessed inputs, in the order in which the estimates were started.
+  void PreprocessLoop();
+  void ForwardLoop();
+
+  // An estimate in a slot.
+  struct Estimate {
+    Estimate() : state(kDone) {}
+
+    // Done (so the slot is free), waiting to be preprocessed, or preprocessed and waiting
+    // for (or in) the forward pass.
+    enum State { kDone, kStarted, kPreprocessed };
+    State state;
+
+    AsyncRegressInputs inputs;
+    boost::shared_ptr<boost::promise<BoundingBox> > result;
+  };
+
+  AsyncRegressStages* stages_;
+
+  // Estimates in each slot (used in turn), and the slot of the next one to start.
+  Estimate estimates_[kNumSlots];
+  size_t next_slot_;
+
+  // Protects the state of the estimates, and the signal for the helper threads to exit.
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  bool stop_;
+
+  // Helper threads (started by the first call to Start).
+  boost::thread_group threads_;
+};
+
+#endif // ASYNC_REGRESS_HELPER_H
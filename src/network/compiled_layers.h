@@ -0,0 +1,169 @@
+#ifndef COMPILED_LAYERS_H
+#define COMPILED_LAYERS_H
+
+#include <cstring>
+
+#include "helper/thread_pool.h"
+#include "network/native_kernels.h"
+
+// The layers of a network compiled ahead of time (see network/compiled_net.h).
+// Each layer is a template whose parameters are its shapes, so that every loop of
+// network/native_kernels.h is compiled for the exact sizes of the layer that runs it.
+// Each computes the same output as the NativeNet layer of the same name, for a single image.
+
+// Convolution, with optional groups (and with a ReLU applied to the output, if kReLU).
+// columns must hold kColumnsCount values.
+template <int kChannels, int kHeight, int kWidth, int kNumOutput, int kKernelSize, int kStride,
+          int kPad, int kGroup, bool kReLU>
+class CompiledConvolution
+{
+public:
+  static const int kTopHeight = (kHeight + 2 * kPad - kKernelSize) / kStride + 1;
+  static const int kTopWidth = (kWidth + 2 * kPad - kKernelSize) / kStride + 1;
+  static const int kGroupChannels = kChannels / kGroup;
+  static const int kGroupOutputs = kNumOutput / kGroup;
+  static const int kPatchSize = kGroupChannels * kKernelSize * kKernelSize;
+  static const int kTopSize = kTopHeight * kTopWidth;
+  static const int kColumnsCount = kPatchSize * kTopSize;
+
+  static void Forward(const float* input, const float* weights, const float* bias,
+                      float* columns, float* output, ThreadPool* thread_pool) {
+    for (int group = 0; group < kGroup; ++group) {
+      // Copy the input patches of this group into columns.
+      Im2ColTask im2col(input + group * kGroupChannels * kHeight * kWidth, columns);
+      thread_pool->ParallelFor(kGroupChannels, 1, &im2col);
+
+      // Multiply the weights of this group by the columns.
+      GemmTask gemm(weights + group * kGroupOutputs * kPatchSize, columns,
+                    bias ? bias + group * kGroupOutputs : NULL,
+                    output + group * kGroupOutputs * kTopSize);
+      thread_pool->ParallelFor(kGroupOutputs, native_kernels::kTileRows, &gemm);
+    }
+  }
+
+private:
+  class Im2ColTask : public ParallelTask {
+  public:
+    Im2ColTask(const float* input, float* columns) : input_(input), columns_(columns) {}
+
+    virtual void Run(const size_t begin, const size_t end) {
+      native_kernels::Im2ColChannels(input_, kHeight, kWidth, kKernelSize, kStride, kPad,
+                                     kTopHeight, kTopWidth, begin, end, columns_);
+    }
+
+  private:
+    const float* input_;
+    float* columns_;
+  };
+
+  class GemmTask : public ParallelTask {
+  public:
+    GemmTask(const float* weights, const float* columns, const float* bias, float* output) :
+      weights_(weights), columns_(columns), bias_(bias), output_(output) {}
+
+    virtual void Run(const size_t begin, const size_t end) {
+      native_kernels::GemmRows(weights_, columns_, bias_, kPatchSize, kTopSize, begin, end,
+                               kReLU, output_);
+    }
+
+  private:
+    const float* weights_;
+    const float* columns_;
+    const float* bias_;
+    float* output_;
+  };
+};
+
+// Fully-connected layer (with a ReLU applied to the output, if kReLU).
+template <int kNumInputs, int kNumOutput, bool kReLU>
+class CompiledInnerProduct
+{
+public:
+  static void Forward(const float* input, const float* weights, const float* bias,
+                      float* output, ThreadPool* thread_pool) {
+    Task task(input, weights, bias, output);
+    const size_t grain = 16;
+    thread_pool->ParallelFor(kNumOutput, grain, &task);
+  }
+
+private:
+  class Task : public ParallelTask {
+  public:
+    Task(const float* input, const float* weights, const float* bias, float* output) :
+      input_(input), weights_(weights), bias_(bias), output_(output) {}
+
+    virtual void Run(const size_t begin, const size_t end) {
+      const int num_images = 1;
+      native_kernels::InnerProductRows(input_, num_images, kNumInputs, weights_, bias_,
+                                       kNumOutput, begin, end, kReLU, output_);
+    }
+
+  private:
+    const float* input_;
+    const float* weights_;
+    const float* bias_;
+    float* output_;
+  };
+};
+
+// Max pooling (the output size follows Caffe's rounding, and is computed by the generator).
+template <int kChannels, int kHeight, int kWidth, int kKernelSize, int kStride, int kPad,
+          int kTopHeight, int kTopWidth>
+class CompiledMaxPooling
+{
+public:
+  static void Forward(const float* input, float* output, ThreadPool* thread_pool) {
+    Task task(input, output);
+    thread_pool->ParallelFor(kChannels, 1, &task);
+  }
+
+private:
+  class Task : public ParallelTask {
+  public:
+    Task(const float* input, float* output) : input_(input), output_(output) {}
+
+    virtual void Run(const size_t begin, const size_t end) {
+      native_kernels::MaxPoolPlanes(input_ + begin * kHeight * kWidth, end - begin, kHeight,
+                                    kWidth, kKernelSize, kStride, kPad, kTopHeight, kTopWidth,
+                                    output_ + begin * kTopHeight * kTopWidth);
+    }
+
+  private:
+    const float* input_;
+    float* output_;
+  };
+};
+
+// Local response normalization across channels.  scale must hold kPlaneSize values.
+template <int kChannels, int kPlaneSize, int kLocalSize>
+class CompiledLRN
+{
+public:
+  static void Forward(const float* input, const float alpha, const float beta, const float k,
+                      float* scale, float* output) {
+    native_kernels::LRNImage(input, kChannels, kPlaneSize, kLocalSize, alpha, beta, k, scale,
+                             output);
+  }
+};
+
+// Rectified linear unit (for a ReLU that cannot be fused into the layer before it).
+template <int kCount>
+class CompiledReLU
+{
+public:
+  static void Forward(const float* input, const float negative_slope, float* output) {
+    native_kernels::ReLU(input, kCount, negative_slope, output);
+  }
+};
+
+// Copy of an activation (for a Concat whose inputs cannot be written in place).
+template <int kCount>
+class CompiledCopy
+{
+public:
+  static void Forward(const float* input, float* output) {
+    memcpy(output, input, kCount * sizeof(float));
+  }
+};
+
+#endif // COMPILED_LAYERS_H
@@ -0,0 +1,61 @@
+#ifndef COMPILED_NET_H
+#define COMPILED_NET_H
+
+#include <string>
+#include <vector>
+
+#include "network/native_net.h"
+
+class ThreadPool;
+class WeightFile;
+
+// A network compiled ahead of time from a Caffe .prototxt.
+// tools/generate_net.cpp reads the prototxt when building and emits the implementation of
+// this class (compiled_net.cpp, in the build directory) for that network: the forward pass
+// is a fixed sequence of layers from network/compiled_layers.h with the shape of every layer
+// as a compile-time constant, ReLUs fused into the convolution or fully-connected layer
+// before them, Dropout removed, and the inputs of a Concat written directly into its output.
+// All activations share a single buffer, at offsets planned by the generator so that
+// activations which are never needed at the same time reuse the same memory.
+// Runs one image at a time.
+class CompiledNet
+{
+public:
+  // Layers are run in parallel on thread_pool (which must outlive this object).
+  explicit CompiledNet(ThreadPool* thread_pool);
+
+  // Use the weights in weights (which must outlive this object).
+  // Returns false if a layer's weights are missing or do not have the compiled shape.
+  bool Init(const WeightFile& weights);
+
+  // The prototxt that the network was compiled from.
+  static const char* source_proto();
+
+  // Get the data of the input with the given name, or NULL if there is no such input
+  // (or it is not needed to compute the output).
+  float* mutable_input(const std::string& name);
+
+  // Shape of the input with the given name (empty if there is no such input).
+  static NativeShape input_shape(const std::string& name);
+
+  // Run the forward pass.
+  void Forward();
+
+  // The output of the network, and its number of values.
+  const float* output() const;
+  static size_t output_count();
+
+  // Size of the buffer holding all activations, in bytes.
+  size_t activation_bytes() const { return arena_.size() * sizeof(float); }
+
+private:
+  ThreadPool* thread_pool_;
+
+  // Weights and biases of the layers, in the order in which the compiled network uses them.
+  std::vector<const float*> weights_;
+
+  // All activations (and the scratch buffers of the layers).
+  std::vector<float> arena_;
+};
+
+#endif // COMPILED_NET_H
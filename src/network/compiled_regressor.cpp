@@ -0,0 +1,54 @@
+#include "compiled_regressor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+// Names of the network inputs.
+const char kTargetInput[] = "target";
+const char kImageInput[] = "image";
+
+} // namespace
+
+CompiledRegressor::CompiledRegressor(const std::string& weights_path, const size_t num_threads) :
+  thread_pool_(num_threads),
+  net_(&thread_pool_)
+{
+  // Load the weights (without copying them, if they are in a weight file).
+  if (!weights_.Open(weights_path)) {
+    exit(-1);
+  }
+  if (!net_.Init(weights_)) {
+    printf("Error - the weights in %s do not match the network compiled from %s\n",
+           weights_path.c_str(), CompiledNet::source_proto());
+    exit(-1);
+  }
+
+  target_input_ = net_.mutable_input(kTargetInput);
+  image_input_ = net_.mutable_input(kImageInput);
+  if (!target_input_ || !image_input_ ||
+      !SetInputShape(CompiledNet::input_shape(kImageInput), CompiledNet::input_shape(kTargetInput))) {
+    printf("Error - %s needs inputs %s and %s with the same shape, with 1 or 3 channels\n",
+           CompiledNet::source_proto(), kTargetInput, kImageInput);
+    exit(-1);
+  }
+
+  printf("Compiled network from %s on %zu threads (%zu bytes of activations)\n",
+         CompiledNet::source_proto(), thread_pool_.num_threads(), net_.activation_bytes());
+}
+
+void CompiledRegressor::EstimateSingle(const float* target, BoundingBox* bbox) {
+  // Copy the given target, if any, to the target input.
+  if (target) {
+    std::copy(target, target + input_size(), target_input_);
+  }
+
+  // Perform a forward pass of the network.
+  net_.Forward();
+
+  const float* output = net_.output();
+  bbox_estimation_.assign(output, output + CompiledNet::output_count());
+  *bbox = BoundingBox(bbox_estimation_);
+}
@@ -0,0 +1,40 @@
+#ifndef COMPILED_REGRESSOR_H
+#define COMPILED_REGRESSOR_H
+
+#include <string>
+
+#include "helper/bounding_box.h"
+#include "helper/thread_pool.h"
+#include "network/compiled_net.h"
+#include "network/cpu_regressor_base.h"
+#include "network/weight_file.h"
+
+// Runs the tracking network compiled ahead of time into the program (see
+// network/compiled_net.h), on the CPU.  Computes the same output as NativeRegressor for the
+// prototxt that was compiled (set with COMPILED_NET_PROTOTXT when building), without
+// reading the prototxt or allocating activations layer by layer when it starts.
+class CompiledRegressor : public CpuRegressorBase {
+ public:
+  // Use the model weights in weights_path (a .caffemodel or a weight file, see
+  // network/weight_file.h), which must match the compiled network.
+  // Each forward pass runs on num_threads threads (0 = one per CPU).
+  CompiledRegressor(const std::string& weights_path, const size_t num_threads);
+
+ private:
+  // The inputs of the compiled network have a fixed shape, so this does nothing.
+  virtual void ReshapeSingle() {}
+
+  // Run the network on the inputs that have been set (copying target, if given, to the
+  // target input first), and wrap its output in a bounding box.
+  virtual void EstimateSingle(const float* target, BoundingBox* bbox);
+
+  // The model weights (which the network points into).
+  WeightFile weights_;
+
+  // Threads that run the layers of the network.
+  ThreadPool thread_pool_;
+
+  CompiledNet net_;
+};
+
+#endif // COMPILED_REGRESSOR_H
@@ -0,0 +1,93 @@
+#include "cpu_regressor_base.h"
+
+#include <cstdio>
+
+CpuRegressorBase::CpuRegressorBase() :
+  target_input_(NULL),
+  image_input_(NULL),
+  num_channels_(0)
+{
+}
+
+bool CpuRegressorBase::SetInputShape(const NativeShape& image_shape,
+                                     const NativeShape& target_shape) {
+  if (image_shape.count() == 0 || image_shape.count() != target_shape.count() ||
+      (image_shape.channels != 1 && image_shape.channels != 3)) {
+    return false;
+  }
+  num_channels_ = image_shape.channels;
+  input_geometry_ = cv::Size(image_shape.width, image_shape.height);
+
+  // Same mean as Regressor.
+  mean_value_ = cv::Scalar(104, 117, 123);
+  return true;
+}
+
+void CpuRegressorBase::Regress(const cv::Mat& image_curr,
+                               const cv::Mat& image, const cv::Mat& target,
+                               BoundingBox* bbox) {
+  // Set the inputs to the network.
+  ReshapeSingle();
+  Preprocess(image, image_input_);
+  Preprocess(target, target_input_);
+
+  // Estimate the bounding box location of the target object in the current image.
+  EstimateSingle(NULL, bbox);
+}
+
+void CpuRegressorBase::RegressFromFullImages(const cv::Mat& image_curr,
+                                             const BoundingBox& bbox_curr_prior_tight,
+                                             const cv::Mat& image_prev,
+                                             const BoundingBox& bbox_prev_tight,
+                                             BoundingBox* bbox) {
+  ReshapeSingle();
+
+  // Crop, resize and normalize the search region and the target, writing them directly
+  // to the inputs of the network.
+  CropPadResizePlanar(bbox_curr_prior_tight, image_curr, input_geometry_, mean_value_,
+                      num_channels_, &resample_buffers_, image_input_);
+  CropPadResizePlanar(bbox_prev_tight, image_prev, input_geometry_, mean_value_,
+                      num_channels_, &resample_buffers_, target_input_);
+
+  // Estimate the bounding box location of the target object in the current image.
+  EstimateSingle(NULL, bbox);
+}
+
+void CpuRegressorBase::PrepareTarget(const cv::Mat& image, const BoundingBox& bbox_tight,
+                                     PreparedTarget* target) {
+  // Crop, resize and normalize the target into the form of the network input.
+  target->input.resize(input_size());
+  CropPadResizePlanar(bbox_tight, image, input_geometry_, mean_value_, num_channels_,
+                      &resample_buffers_, &target->input[0]);
+}
+
+void CpuRegressorBase::RegressFromTarget(const cv::Mat& image_curr,
+                                         const BoundingBox& bbox_curr_prior_tight,
+                                         const PreparedTarget& target, BoundingBox* bbox) {
+  if (target.input.size() != input_size()) {
+    printf("Error - the prepared target has %zu values but the network input has %zu\n",
+           target.input.size(), input_size());
+    return;
+  }
+
+  ReshapeSingle();
+
+  // Crop, resize and normalize the search region, writing it directly to the input of the network.
+  CropPadResizePlanar(bbox_curr_prior_tight, image_curr, input_geometry_, mean_value_,
+                      num_channels_, &resample_buffers_, image_input_);
+
+  // Estimate the bounding box location of the target object, with the prepared target.
+  EstimateSingle(&target.input[0], bbox);
+}
+
+void CpuRegressorBase::Preprocess(const cv::Mat& image, float* output) {
+  if (image.depth() == CV_8U) {
+    // Resize, convert to float, subtract the mean and split the channels in a single pass.
+    ResizePlanar(image, input_geometry_, mean_value_, num_channels_, &resample_buffers_, output);
+    return;
+  }
+
+  // ResizePlanar reads 8-bit images.
+  image.convertTo(image_8u_, CV_8U);
+  ResizePlanar(image_8u_, input_geometry_, mean_value_, num_channels_, &resample_buffers_, output);
+}
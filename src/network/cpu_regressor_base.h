@@ -0,0 +1,82 @@
+#ifndef CPU_REGRESSOR_BASE_H
+#define CPU_REGRESSOR_BASE_H
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+#include "helper/bounding_box.h"
+#include "helper/image_proc.h"
+#include "network/native_net.h"
+#include "network/regressor_base.h"
+
+// Base class of the regressors that run the tracking network on the CPU without Caffe
+// (NativeRegressor and CompiledRegressor).  Preprocesses the inputs directly into the network
+// inputs, with the same mean as Regressor, for a single image at a time; the subclass sets up
+// the network and runs it.
+class CpuRegressorBase : public RegressorBase {
+ public:
+  CpuRegressorBase();
+
+  // Estimate the location of the target object in the current image.
+  // image_curr is the entire current image.
+  // image is the best guess as to a crop of the current image that likely contains the target object.
+  // target is an image of the target object from the previous frame.
+  // Returns: bbox, an estimated location of the target object in the current image.
+  virtual void Regress(const cv::Mat& image_curr, const cv::Mat& image, const cv::Mat& target, BoundingBox* bbox);
+
+  // Estimate the location of the target object in the current image, preprocessing the
+  // search region and the target directly from the full images into the network inputs.
+  virtual void RegressFromFullImages(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                     const cv::Mat& image_prev, const BoundingBox& bbox_prev_tight,
+                                     BoundingBox* bbox);
+
+  // Crop, resize and normalize the target into the network input that it is kept as.
+  virtual void PrepareTarget(const cv::Mat& image, const BoundingBox& bbox_tight,
+                             PreparedTarget* target);
+
+  // Estimate the location of the target object in the current image, preprocessing the
+  // search region directly from the full image into the network input, with the prepared target.
+  virtual void RegressFromTarget(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                 const PreparedTarget& target, BoundingBox* bbox);
+
+ protected:
+  // Set the size of the inputs from the shapes of the image and target inputs of the network.
+  // Returns false unless both have the same shape, with 1 or 3 channels.
+  bool SetInputShape(const NativeShape& image_shape, const NativeShape& target_shape);
+
+  // Number of values in the input of the network for one image.
+  size_t input_size() const {
+    return num_channels_ * input_geometry_.width * input_geometry_.height;
+  }
+
+  // Shape the network for a single image, and point target_input_ and image_input_ to its inputs.
+  virtual void ReshapeSingle() = 0;
+
+  // Run the network on the inputs that have been set for a single image, and wrap its output
+  // in a bounding box.  If target is not NULL, the network is run on it (which it must not
+  // modify) instead of on the target input.
+  virtual void EstimateSingle(const float* target, BoundingBox* bbox) = 0;
+
+  // Resize, normalize and write the image to the input of the network at output.
+  void Preprocess(const cv::Mat& image, float* output);
+
+  // Input data of the network.
+  float* target_input_;
+  float* image_input_;
+
+  // Size of the input images.
+  cv::Size input_geometry_;
+
+  // Number of image channels: normally either 1 (black and white) or 3 (color).
+  int num_channels_;
+
+  // Per-channel mean value, subtracted from the inputs to make them 0-mean.
+  cv::Scalar mean_value_;
+
+  // Buffers reused across frames so that tracking does not allocate memory after the first frame.
+  ResampleBuffers resample_buffers_;
+  std::vector<float> bbox_estimation_;
+  cv::Mat image_8u_;
+};
+
+#endif // CPU_REGRESSOR_BASE_H
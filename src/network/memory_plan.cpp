@@ -0,0 +1,47 @@
+#include "memory_plan.h"
+
+#include <algorithm>
+#include <utility>
+
+size_t PlanMemory(std::vector<PlannedBuffer>* buffers) {
+  // Sort the buffers that are needed by when they are first needed, then by decreasing size.
+  std::vector<std::pair<std::pair<int, size_t>, int> > order;
+  for (size_t i = 0; i < buffers->size(); ++i) {
+    const PlannedBuffer& buffer = (*buffers)[i];
+    if (buffer.first <= buffer.last && buffer.count > 0) {
+      order.push_back(std::make_pair(std::make_pair(buffer.first, ~buffer.count), i));
+    }
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<int> placed;
+  std::vector<std::pair<size_t, size_t> > taken;
+  size_t block_size = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    PlannedBuffer& buffer = (*buffers)[order[i].second];
+    const size_t size = AlignPlanned(buffer.count);
+
+    // The ranges taken by the placed buffers that are needed at the same time, by offset.
+    taken.clear();
+    for (size_t j = 0; j < placed.size(); ++j) {
+      const PlannedBuffer& other = (*buffers)[placed[j]];
+      if (other.first <= buffer.last && buffer.first <= other.last) {
+        taken.push_back(std::make_pair(other.offset, other.offset + AlignPlanned(other.count)));
+      }
+    }
+    std::sort(taken.begin(), taken.end());
+
+    // Find the first gap that the buffer fits in.
+    size_t offset = 0;
+    for (size_t j = 0; j < taken.size(); ++j) {
+      if (taken[j].first >= offset + size) {
+        break;
+      }
+      offset = std::max(offset, taken[j].second);
+    }
+    buffer.offset = offset;
+    placed.push_back(order[i].second);
+    block_size = std::max(block_size, offset + size);
+  }
+  return block_size;
+}
@@ -0,0 +1,38 @@
+#ifndef MEMORY_PLAN_H
+#define MEMORY_PLAN_H
+
+#include <cstddef>
+#include <vector>
+
+// A buffer to be placed in a single block of memory shared by many buffers (such as the
+// activations of a network), which is needed from step first to step last (inclusive).
+// Steps are usually the layers of a network, in the order in which they are run.
+struct PlannedBuffer {
+  PlannedBuffer() : count(0), first(0), last(-1), offset(0) {}
+
+  // Number of floats in the buffer.
+  size_t count;
+
+  // Steps during which the buffer is needed (if last < first, it is never needed).
+  int first;
+  int last;
+
+  // Offset of the buffer in the block (in floats), set by PlanMemory.
+  size_t offset;
+};
+
+// Buffer offsets are aligned to this many floats (64 bytes).
+const size_t kPlanAlignment = 16;
+
+// Round count up to a multiple of kPlanAlignment.
+inline size_t AlignPlanned(const size_t count) {
+  return (count + kPlanAlignment - 1) / kPlanAlignment * kPlanAlignment;
+}
+
+// Set the offset of each buffer that is needed such that buffers needed during the same step
+// do not overlap, and return the size of the block (in floats).
+// Buffers are placed in order of when they are first needed (largest first), each at the
+// lowest offset that does not overlap a buffer placed before it and needed at the same time.
+size_t PlanMemory(std::vector<PlannedBuffer>* buffers);
+
+#endif // MEMORY_PLAN_H
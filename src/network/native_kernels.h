@@ -0,0 +1,400 @@
+#ifndef NATIVE_KERNELS_H
+#define NATIVE_KERNELS_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "helper/thread_pool.h"
+
+// The loops that compute the layers of NativeNet (see network/native_layers.h).
+// They are inline so that they can also be compiled for fixed shapes: when they are called
+// with constant sizes (as in network/compiled_layers.h), the compiler specializes each loop
+// for those sizes.
+namespace native_kernels {
+
+// Size of the tiles of the output computed by the matrix multiplication kernels.
+const int kTileRows = 4;
+const int kTileCols = 16;
+
+// Number of output rows computed together, so that their weights stay in cache.
+const int kBlockRows = 64;
+
+#if defined(__AVX__)
+// Multiply-add of 8 floats: a * b + c.
+inline __m256 MultiplyAdd(const __m256 a, const __m256 b, const __m256 c) {
+#if defined(__FMA__)
+  return _mm256_fmadd_ps(a, b, c);
+#else
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+// Sum of the 8 floats in a.
+inline float HorizontalSum(const __m256 a) {
+  const __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+  const __m128 sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+  const __m128 sum1 = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 1));
+  return _mm_cvtss_f32(sum1);
+}
+
+// Compute a 4 x (8 * kVectors) tile of C = bias + A * B, keeping the tile in registers
+// (and then setting negative values to 0, if relu is true).
+// A has lda values per row, B and C have ldb and ldc values per row.
+template <int kVectors>
+inline void GemmTile(const float* a, const int lda, const float* b, const int ldb,
+                     const float* bias, const int k_size, const bool relu, float* c,
+                     const int ldc) {
+  __m256 sums[kTileRows][kVectors];
+  for (int row = 0; row < kTileRows; ++row) {
+    const __m256 initial = _mm256_set1_ps(bias ? bias[row] : 0);
+    for (int v = 0; v < kVectors; ++v) {
+      sums[row][v] = initial;
+    }
+  }
+
+  for (int k = 0; k < k_size; ++k) {
+    __m256 b_values[kVectors];
+    for (int v = 0; v < kVectors; ++v) {
+      b_values[v] = _mm256_loadu_ps(b + k * ldb + 8 * v);
+    }
+    for (int row = 0; row < kTileRows; ++row) {
+      const __m256 a_value = _mm256_broadcast_ss(a + row * lda + k);
+      for (int v = 0; v < kVectors; ++v) {
+        sums[row][v] = MultiplyAdd(a_value, b_values[v], sums[row][v]);
+      }
+    }
+  }
+
+  for (int row = 0; row < kTileRows; ++row) {
+    for (int v = 0; v < kVectors; ++v) {
+      const __m256 sum = relu ? _mm256_max_ps(sums[row][v], _mm256_setzero_ps()) : sums[row][v];
+      _mm256_storeu_ps(c + row * ldc + 8 * v, sum);
+    }
+  }
+}
+#endif
+
+// Compute a rows x cols tile of C = bias + A * B (for tiles that do not fit the vector kernels).
+inline void GemmTileGeneric(const float* a, const int lda, const float* b, const int ldb,
+                            const float* bias, const int k_size, const int rows, const int cols,
+                            const bool relu, float* c, const int ldc) {
+  for (int row = 0; row < rows; ++row) {
+    float* c_row = c + row * ldc;
+    for (int col = 0; col < cols; ++col) {
+      c_row[col] = bias ? bias[row] : 0;
+    }
+    for (int k = 0; k < k_size; ++k) {
+      const float a_value = a[row * lda + k];
+      const float* b_row = b + k * ldb;
+      for (int col = 0; col < cols; ++col) {
+        c_row[col] += a_value * b_row[col];
+      }
+    }
+    if (relu) {
+      for (int col = 0; col < cols; ++col) {
+        c_row[col] = std::max(c_row[col], 0.0f);
+      }
+    }
+  }
+}
+
+// Compute rows [row_begin, row_end) of C = bias + A * B, where A is M x K, B is K x P
+// and C is M x P (all row-major), and bias (if not NULL) has one value per row.
+// If relu is true, negative outputs are set to 0 (fusing a following ReLU layer).
+// The output is computed in tiles that are kept in registers, in blocks of rows whose
+// values of A stay in cache while the columns of B are streamed past them.
+inline void GemmRows(const float* a, const float* b, const float* bias, const int k_size,
+                     const int p_size, const int row_begin, const int row_end, const bool relu,
+                     float* c) {
+  for (int block = row_begin; block < row_end; block += kBlockRows) {
+    const int block_end = std::min(block + kBlockRows, row_end);
+    for (int col = 0; col < p_size; ) {
+      const int cols_left = p_size - col;
+#if defined(__AVX__)
+      const int cols = cols_left >= 16 ? 16 : (cols_left >= 8 ? 8 : cols_left);
+#else
+      const int cols = std::min(kTileCols, cols_left);
+#endif
+      for (int row = block; row < block_end; row += kTileRows) {
+        const int rows = std::min(kTileRows, block_end - row);
+        const float* a_tile = a + row * k_size;
+        const float* b_tile = b + col;
+        const float* bias_tile = bias ? bias + row : NULL;
+        float* c_tile = c + row * p_size + col;
+#if defined(__AVX__)
+        if (rows == kTileRows && cols == 16) {
+          GemmTile<2>(a_tile, k_size, b_tile, p_size, bias_tile, k_size, relu, c_tile, p_size);
+          continue;
+        } else if (rows == kTileRows && cols == 8) {
+          GemmTile<1>(a_tile, k_size, b_tile, p_size, bias_tile, k_size, relu, c_tile, p_size);
+          continue;
+        }
+#endif
+        GemmTileGeneric(a_tile, k_size, b_tile, p_size, bias_tile, k_size, rows, cols, relu,
+                        c_tile, p_size);
+      }
+      col += cols;
+    }
+  }
+}
+
+// Runs GemmRows in parallel over the rows.
+class GemmTask : public ParallelTask {
+public:
+  GemmTask(const float* a, const float* b, const float* bias, const int k_size,
+           const int p_size, const bool relu, float* c) :
+    a_(a), b_(b), bias_(bias), k_size_(k_size), p_size_(p_size), relu_(relu), c_(c) {}
+
+  virtual void Run(const size_t begin, const size_t end) {
+    GemmRows(a_, b_, bias_, k_size_, p_size_, begin, end, relu_, c_);
+  }
+
+private:
+  const float* a_;
+  const float* b_;
+  const float* bias_;
+  int k_size_;
+  int p_size_;
+  bool relu_;
+  float* c_;
+};
+
+// Copy the input patches of channels [channel_begin, channel_end) of a convolution into
+// columns (im2col), so that the convolution becomes a matrix multiplication.
+inline void Im2ColChannels(const float* input, const int height, const int width,
+                           const int kernel_size, const int stride, const int pad,
+                           const int top_height, const int top_width, const size_t channel_begin,
+                           const size_t channel_end, float* columns) {
+  const int top_size = top_height * top_width;
+  for (size_t channel = channel_begin; channel < channel_end; ++channel) {
+    const float* channel_input = input + channel * height * width;
+    for (int kernel_y = 0; kernel_y < kernel_size; ++kernel_y) {
+      for (int kernel_x = 0; kernel_x < kernel_size; ++kernel_x) {
+        float* column = columns +
+            ((channel * kernel_size + kernel_y) * kernel_size + kernel_x) * top_size;
+        for (int top_y = 0; top_y < top_height; ++top_y) {
+          const int y = top_y * stride - pad + kernel_y;
+          float* column_row = column + top_y * top_width;
+          if (y < 0 || y >= height) {
+            memset(column_row, 0, top_width * sizeof(float));
+            continue;
+          }
+          const float* input_row = channel_input + y * width;
+          for (int top_x = 0; top_x < top_width; ++top_x) {
+            const int x = top_x * stride - pad + kernel_x;
+            column_row[top_x] = (x >= 0 && x < width) ? input_row[x] : 0;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Runs Im2ColChannels in parallel over the input channels.
+class Im2ColTask : public ParallelTask {
+public:
+  Im2ColTask(const float* input, const int height, const int width, const int kernel_size,
+             const int stride, const int pad, const int top_height, const int top_width,
+             float* columns) :
+    input_(input), height_(height), width_(width), kernel_size_(kernel_size), stride_(stride),
+    pad_(pad), top_height_(top_height), top_width_(top_width), columns_(columns) {}
+
+  virtual void Run(const size_t begin, const size_t end) {
+    Im2ColChannels(input_, height_, width_, kernel_size_, stride_, pad_, top_height_,
+                   top_width_, begin, end, columns_);
+  }
+
+private:
+  const float* input_;
+  int height_;
+  int width_;
+  int kernel_size_;
+  int stride_;
+  int pad_;
+  int top_height_;
+  int top_width_;
+  float* columns_;
+};
+
+// Dot product of a row of weights with the inputs of num_images images, for up to 4 images.
+inline void DotImages(const float* weights, const float* const* inputs, const int num_images,
+                      const int size, float* dots) {
+  int k = 0;
+#if defined(__AVX__)
+  __m256 sums[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(),
+                     _mm256_setzero_ps(), _mm256_setzero_ps() };
+  for (; k + 8 <= size; k += 8) {
+    const __m256 w = _mm256_loadu_ps(weights + k);
+    for (int i = 0; i < num_images; ++i) {
+      sums[i] = MultiplyAdd(w, _mm256_loadu_ps(inputs[i] + k), sums[i]);
+    }
+  }
+  for (int i = 0; i < num_images; ++i) {
+    dots[i] = HorizontalSum(sums[i]);
+  }
+#else
+  // Use several partial sums, so that the compiler can vectorize the loop.
+  float sums[4][8] = { { 0 } };
+  for (; k + 8 <= size; k += 8) {
+    for (int i = 0; i < num_images; ++i) {
+      for (int j = 0; j < 8; ++j) {
+        sums[i][j] += weights[k + j] * inputs[i][k + j];
+      }
+    }
+  }
+  for (int i = 0; i < num_images; ++i) {
+    dots[i] = 0;
+    for (int j = 0; j < 8; ++j) {
+      dots[i] += sums[i][j];
+    }
+  }
+#endif
+  for (; k < size; ++k) {
+    for (int i = 0; i < num_images; ++i) {
+      dots[i] += weights[k] * inputs[i][k];
+    }
+  }
+}
+
+// Compute outputs [begin, end) of a fully-connected layer for all images (setting negative
+// outputs to 0, if relu is true).  Each row of weights is read once for all of the images
+// (up to 4 at a time).
+inline void InnerProductRows(const float* input, const int num_images, const int num_inputs,
+                             const float* weights, const float* bias, const int num_output,
+                             const size_t begin, const size_t end, const bool relu,
+                             float* output) {
+  for (size_t output_num = begin; output_num < end; ++output_num) {
+    const float* weights_row = weights + output_num * num_inputs;
+    const float row_bias = bias ? bias[output_num] : 0;
+    for (int image = 0; image < num_images; image += 4) {
+      const int row_images = std::min(4, num_images - image);
+      const float* inputs[4];
+      for (int i = 0; i < row_images; ++i) {
+        inputs[i] = input + (image + i) * num_inputs;
+      }
+      float dots[4];
+      DotImages(weights_row, inputs, row_images, num_inputs, dots);
+      for (int i = 0; i < row_images; ++i) {
+        const float value = dots[i] + row_bias;
+        output[(image + i) * num_output + output_num] = relu ? std::max(value, 0.0f) : value;
+      }
+    }
+  }
+}
+
+// Runs InnerProductRows in parallel over the outputs.
+class InnerProductTask : public ParallelTask {
+public:
+  InnerProductTask(const float* input, const int num_images, const int num_inputs,
+                   const float* weights, const float* bias, const int num_output,
+                   const bool relu, float* output) :
+    input_(input), num_images_(num_images), num_inputs_(num_inputs), weights_(weights),
+    bias_(bias), num_output_(num_output), relu_(relu), output_(output) {}
+
+  virtual void Run(const size_t begin, const size_t end) {
+    InnerProductRows(input_, num_images_, num_inputs_, weights_, bias_, num_output_, begin, end,
+                     relu_, output_);
+  }
+
+private:
+  const float* input_;
+  int num_images_;
+  int num_inputs_;
+  const float* weights_;
+  const float* bias_;
+  int num_output_;
+  bool relu_;
+  float* output_;
+};
+
+// Max pooling of num_planes planes of height x width values, to top_height x top_width values.
+inline void MaxPoolPlanes(const float* input, const int num_planes, const int height,
+                          const int width, const int kernel_size, const int stride, const int pad,
+                          const int top_height, const int top_width, float* output) {
+  const int bottom_size = height * width;
+  const int top_size = top_height * top_width;
+  for (int plane = 0; plane < num_planes; ++plane) {
+    const float* plane_input = input + plane * bottom_size;
+    float* plane_output = output + plane * top_size;
+    for (int top_y = 0; top_y < top_height; ++top_y) {
+      const int y_start = std::max(top_y * stride - pad, 0);
+      const int y_end = std::min(top_y * stride - pad + kernel_size, height);
+      for (int top_x = 0; top_x < top_width; ++top_x) {
+        const int x_start = std::max(top_x * stride - pad, 0);
+        const int x_end = std::min(top_x * stride - pad + kernel_size, width);
+        float max_value = -FLT_MAX;
+        for (int y = y_start; y < y_end; ++y) {
+          for (int x = x_start; x < x_end; ++x) {
+            max_value = std::max(max_value, plane_input[y * width + x]);
+          }
+        }
+        plane_output[top_y * top_width + top_x] = max_value;
+      }
+    }
+  }
+}
+
+// Local response normalization across the channels of one image, with planes of plane_size
+// values.  scale is a buffer of plane_size values.
+// Same as Caffe: scale = k + alpha / local_size * (sum of squares over a window of channels
+// centered on this channel), and the output is the input * scale^-beta.
+// The sum over the window is updated as the window slides over the channels.
+inline void LRNImage(const float* input, const int channels, const int plane_size,
+                     const int local_size, const float alpha, const float beta, const float k,
+                     float* scale, float* output) {
+  const int pre_pad = (local_size - 1) / 2;
+  const float alpha_over_size = alpha / local_size;
+
+  // Sum for the first channel.
+  std::fill(scale, scale + plane_size, k);
+  for (int channel = 0; channel <= pre_pad && channel < channels; ++channel) {
+    const float* input_plane = input + channel * plane_size;
+    for (int i = 0; i < plane_size; ++i) {
+      scale[i] += alpha_over_size * input_plane[i] * input_plane[i];
+    }
+  }
+
+  for (int channel = 0; channel < channels; ++channel) {
+    if (channel > 0) {
+      // Slide the window: add the channel entering it and remove the channel leaving it.
+      const int head = channel + pre_pad;
+      const int tail = channel - pre_pad - 1;
+      if (head < channels) {
+        const float* input_plane = input + head * plane_size;
+        for (int i = 0; i < plane_size; ++i) {
+          scale[i] += alpha_over_size * input_plane[i] * input_plane[i];
+        }
+      }
+      if (tail >= 0) {
+        const float* input_plane = input + tail * plane_size;
+        for (int i = 0; i < plane_size; ++i) {
+          scale[i] -= alpha_over_size * input_plane[i] * input_plane[i];
+        }
+      }
+    }
+
+    const float* input_plane = input + channel * plane_size;
+    float* output_plane = output + channel * plane_size;
+    for (int i = 0; i < plane_size; ++i) {
+      output_plane[i] = input_plane[i] * pow(scale[i], -beta);
+    }
+  }
+}
+
+// Rectified linear unit of count values (can run in place).
+inline void ReLU(const float* input, const size_t count, const float negative_slope,
+                 float* output) {
+  for (size_t i = 0; i < count; ++i) {
+    output[i] = std::max(input[i], 0.0f) + negative_slope * std::min(input[i], 0.0f);
+  }
+}
+
+} // namespace native_kernels
+
+#endif // NATIVE_KERNELS_H
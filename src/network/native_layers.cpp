@@ -0,0 +1,453 @@
+#include "native_layers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "helper/thread_pool.h"
+#include "network/native_kernels.h"
+
+using native_kernels::GemmTask;
+using native_kernels::Im2ColTask;
+using native_kernels::InnerProductTask;
+using native_kernels::kTileRows;
+
+namespace {
+
+#if defined(__AVX2__)
+// Add the products of 4 adjacent pairs of unsigned 8-bit inputs and signed 8-bit weights
+// to each 32-bit sum in sums.
+inline __m256i DotAccumulate(const __m256i sums, const __m256i inputs, const __m256i weights) {
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+  return _mm256_dpbusd_epi32(sums, inputs, weights);
+#elif defined(__AVXVNNI__)
+  return _mm256_dpbusd_avx_epi32(sums, inputs, weights);
+#else
+  // Products of pairs summed to 16 bits (which cannot overflow with 7-bit inputs),
+  // then pairs of those summed to 32 bits.
+  const __m256i pair_sums = _mm256_maddubs_epi16(inputs, weights);
+  return _mm256_add_epi32(sums, _mm256_madd_epi16(pair_sums, _mm256_set1_epi16(1)));
+#endif
+}
+
+// Sum of the 8 32-bit integers in a.
+inline int HorizontalSum(const __m256i a) {
+  const __m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  const __m128i sum2 = _mm_add_epi32(sum4, _mm_unpackhi_epi64(sum4, sum4));
+  const __m128i sum1 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, 1));
+  return _mm_cvtsi128_si32(sum1);
+}
+#endif
+
+// Dot product of a row of 8-bit weights with the 8-bit inputs of num_images images,
+// for up to 4 images.
+void DotImagesQuantized(const signed char* weights, const unsigned char* const* inputs,
+                        const int num_images, const int size, int* dots) {
+  int k = 0;
+#if defined(__AVX2__)
+  __m256i sums[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(),
+                      _mm256_setzero_si256(), _mm256_setzero_si256() };
+  for (; k + 32 <= size; k += 32) {
+    const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + k));
+    for (int i = 0; i < num_images; ++i) {
+      sums[i] = DotAccumulate(sums[i],
+                              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputs[i] + k)), w);
+    }
+  }
+  for (int i = 0; i < num_images; ++i) {
+    dots[i] = HorizontalSum(sums[i]);
+  }
+#else
+  for (int i = 0; i < num_images; ++i) {
+    dots[i] = 0;
+  }
+#endif
+  // One image at a time, so that the compiler can vectorize the loop (the row of weights
+  // stays in cache between images).
+  for (int i = 0; i < num_images; ++i) {
+    int dot = 0;
+    for (int j = k; j < size; ++j) {
+      dot += weights[j] * inputs[i][j];
+    }
+    dots[i] += dot;
+  }
+}
+
+// Computes outputs [begin, end) of a quantized fully-connected layer for all images.
+class QuantizedInnerProductTask : public ParallelTask {
+public:
+  QuantizedInnerProductTask(const unsigned char* input, const int num_images, const int num_inputs,
+                            const signed char* weights, const float* weight_scales,
+                            const float input_scale, const float* bias, const int num_output,
+                            const bool relu, float* output) :
+    input_(input), num_images_(num_images), num_inputs_(num_inputs), weights_(weights),
+    weight_scales_(weight_scales), input_scale_(input_scale), bias_(bias),
+    num_output_(num_output), relu_(relu), output_(output) {}
+
+  virtual void Run(const size_t begin, const size_t end) {
+    for (size_t output_num = begin; output_num < end; ++output_num) {
+      const signed char* weights_row = weights_ + output_num * num_inputs_;
+      const float scale = input_scale_ * weight_scales_[output_num];
+      const float bias = bias_ ? bias_[output_num] : 0;
+      for (int image = 0; image < num_images_; image += 4) {
+        const int num_images = std::min(4, num_images_ - image);
+        const unsigned char* inputs[4];
+        for (int i = 0; i < num_images; ++i) {
+          inputs[i] = input_ + (image + i) * num_inputs_;
+        }
+        int dots[4];
+        DotImagesQuantized(weights_row, inputs, num_images, num_inputs_, dots);
+        for (int i = 0; i < num_images; ++i) {
+          const float value = dots[i] * scale + bias;
+          output_[(image + i) * num_output_ + output_num] = relu_ ? std::max(value, 0.0f) : value;
+        }
+      }
+    }
+  }
+
+private:
+  const unsigned char* input_;
+  int num_images_;
+  int num_inputs_;
+  const signed char* weights_;
+  const float* weight_scales_;
+  float input_scale_;
+  const float* bias_;
+  int num_output_;
+  bool relu_;
+  float* output_;
+};
+
+// Largest quantized weight and input.
+const int kMaxQuantizedWeight = 127;
+const int kMaxQuantizedInput = 127;
+
+} // namespace
+
+NativeConvolutionLayer::NativeConvolutionLayer(const int num_output, const int kernel_size,
+                                               const int stride, const int pad, const int group,
+                                               const float* weights, const size_t weights_count,
+                                               const float* bias, ThreadPool* thread_pool) :
+  num_output_(num_output),
+  kernel_size_(kernel_size),
+  stride_(stride),
+  pad_(pad),
+  group_(group),
+  weights_(weights),
+  weights_count_(weights_count),
+  bias_(bias),
+  thread_pool_(thread_pool),
+  relu_(false),
+  columns_count_(0),
+  columns_(NULL)
+{
+}
+
+bool NativeConvolutionLayer::Reshape(const std::vector<NativeShape>& bottom_shapes,
+                                     NativeShape* top_shape) {
+  if (bottom_shapes.size() != 1 || group_ <= 0 || stride_ <= 0 ||
+      bottom_shapes[0].channels % group_ != 0 || num_output_ % group_ != 0) {
+    return false;
+  }
+  bottom_shape_ = bottom_shapes[0];
+
+  // Check that the weights match the input.
+  const int group_channels = bottom_shape_.channels / group_;
+  if (weights_count_ != static_cast<size_t>(num_output_) * group_channels * kernel_size_ * kernel_size_) {
+    return false;
+  }
+
+  top_shape_.num = bottom_shape_.num;
+  top_shape_.channels = num_output_;
+  top_shape_.height = (bottom_shape_.height + 2 * pad_ - kernel_size_) / stride_ + 1;
+  top_shape_.width = (bottom_shape_.width + 2 * pad_ - kernel_size_) / stride_ + 1;
+  if (top_shape_.height <= 0 || top_shape_.width <= 0) {
+    return false;
+  }
+  *top_shape = top_shape_;
+
+  columns_count_ = static_cast<size_t>(group_channels) * kernel_size_ * kernel_size_ *
+      top_shape_.height * top_shape_.width;
+  return true;
+}
+
+void NativeConvolutionLayer::Forward(const std::vector<const float*>& bottoms, float* top) {
+  const int group_channels = bottom_shape_.channels / group_;
+  const int group_outputs = num_output_ / group_;
+  const int k_size = group_channels * kernel_size_ * kernel_size_;
+  const int top_size = top_shape_.height * top_shape_.width;
+  const size_t bottom_group_count = static_cast<size_t>(group_channels) *
+      bottom_shape_.height * bottom_shape_.width;
+
+  for (int image = 0; image < bottom_shape_.num; ++image) {
+    for (int group = 0; group < group_; ++group) {
+      // Copy the input patches of this group into columns.
+      const float* input = bottoms[0] + image * bottom_shape_.image_count() +
+          group * bottom_group_count;
+      Im2ColTask im2col(input, bottom_shape_.height, bottom_shape_.width, kernel_size_,
+                        stride_, pad_, top_shape_.height, top_shape_.width, columns_);
+      thread_pool_->ParallelFor(group_channels, 1, &im2col);
+
+      // Multiply the weights of this group by the columns.
+      const float* weights = weights_ + static_cast<size_t>(group) * group_outputs * k_size;
+      const float* bias = bias_ ? bias_ + group * group_outputs : NULL;
+      float* output = top + image * top_shape_.image_count() +
+          static_cast<size_t>(group) * group_outputs * top_size;
+      GemmTask gemm(weights, columns_, bias, k_size, top_size, relu_, output);
+      thread_pool_->ParallelFor(group_outputs, kTileRows, &gemm);
+    }
+  }
+}
+
+NativeInnerProductLayer::NativeInnerProductLayer(const int num_output, const float* weights,
+                                                 const size_t weights_count, const float* bias,
+                                                 ThreadPool* thread_pool) :
+  num_output_(num_output),
+  weights_(weights),
+  weights_count_(weights_count),
+  bias_(bias),
+  thread_pool_(thread_pool),
+  relu_(false)
+{
+}
+
+bool NativeInnerProductLayer::Reshape(const std::vector<NativeShape>& bottom_shapes,
+                                      NativeShape* top_shape) {
+  if (bottom_shapes.size() != 1 ||
+      weights_count_ != static_cast<size_t>(num_output_) * bottom_shapes[0].image_count()) {
+    return false;
+  }
+  bottom_shape_ = bottom_shapes[0];
+
+  top_shape->num = bottom_shape_.num;
+  top_shape->channels = num_output_;
+  top_shape->height = 1;
+  top_shape->width = 1;
+  return true;
+}
+
+void NativeInnerProductLayer::Forward(const std::vector<const float*>& bottoms, float* top) {
+  // Split the outputs between the threads.
+  InnerProductTask task(bottoms[0], bottom_shape_.num, bottom_shape_.image_count(),
+                        weights_, bias_, num_output_, relu_, top);
+  const size_t grain = 16;
+  thread_pool_->ParallelFor(num_output_, grain, &task);
+}
+
+NativeQuantizedInnerProductLayer::NativeQuantizedInnerProductLayer(
+    const int num_output, const float* weights, const size_t weights_count, const float* bias,
+    const float input_max, ThreadPool* thread_pool) :
+  num_output_(num_output),
+  weights_count_(weights_count),
+  bias_(bias),
+  thread_pool_(thread_pool),
+  relu_(false),
+  weights_(weights_count),
+  weight_scales_(num_output, 1),
+  input_scale_(input_max > 0 ? input_max / kMaxQuantizedInput : 1)
+{
+  if (num_output_ <= 0 || weights_count_ % num_output_ != 0) {
+    return;
+  }
+
+  // Quantize each row of weights with its own scale, so that its largest weight maps to
+  // kMaxQuantizedWeight.
+  const size_t row_size = weights_count_ / num_output_;
+  for (int row = 0; row < num_output_; ++row) {
+    const float* row_weights = weights + row * row_size;
+    float max_weight = 0;
+    for (size_t k = 0; k < row_size; ++k) {
+      max_weight = std::max(max_weight, static_cast<float>(fabs(row_weights[k])));
+    }
+    if (max_weight > 0) {
+      weight_scales_[row] = max_weight / kMaxQuantizedWeight;
+    }
+    const float inverse_scale = 1 / weight_scales_[row];
+    signed char* quantized = &weights_[row * row_size];
+    for (size_t k = 0; k < row_size; ++k) {
+      const int value = static_cast<int>(floor(row_weights[k] * inverse_scale + 0.5f));
+      quantized[k] = std::max(-kMaxQuantizedWeight, std::min(kMaxQuantizedWeight, value));
+    }
+  }
+}
+
+bool NativeQuantizedInnerProductLayer::Reshape(const std::vector<NativeShape>& bottom_shapes,
+                                               NativeShape* top_shape) {
+  if (bottom_shapes.size() != 1 || num_output_ <= 0 ||
+      weights_count_ != static_cast<size_t>(num_output_) * bottom_shapes[0].image_count()) {
+    return false;
+  }
+  bottom_shape_ = bottom_shapes[0];
+  inputs_.resize(bottom_shape_.count());
+
+  top_shape->num = bottom_shape_.num;
+  top_shape->channels = num_output_;
+  top_shape->height = 1;
+  top_shape->width = 1;
+  return true;
+}
+
+void NativeQuantizedInnerProductLayer::Forward(const std::vector<const float*>& bottoms, float* top) {
+  // Quantize the inputs (rounding to the nearest value; negative inputs become 0).
+  const float* input = bottoms[0];
+  const float inverse_scale = 1 / input_scale_;
+  for (size_t i = 0; i < inputs_.size(); ++i) {
+    const float value = std::max(input[i], 0.0f) * inverse_scale + 0.5f;
+    inputs_[i] = static_cast<int>(std::min(value, static_cast<float>(kMaxQuantizedInput)));
+  }
+
+  // Split the outputs between the threads.
+  QuantizedInnerProductTask task(&inputs_[0], bottom_shape_.num, bottom_shape_.image_count(),
+                                 &weights_[0], &weight_scales_[0], input_scale_, bias_,
+                                 num_output_, relu_, top);
+  const size_t grain = 16;
+  thread_pool_->ParallelFor(num_output_, grain, &task);
+}
+
+NativeMaxPoolingLayer::NativeMaxPoolingLayer(const int kernel_size, const int stride, const int pad) :
+  kernel_size_(kernel_size),
+  stride_(stride),
+  pad_(pad)
+{
+}
+
+bool NativeMaxPoolingLayer::Reshape(const std::vector<NativeShape>& bottom_shapes,
+                                    NativeShape* top_shape) {
+  if (bottom_shapes.size() != 1 || stride_ <= 0) {
+    return false;
+  }
+  bottom_shape_ = bottom_shapes[0];
+
+  // Same as Caffe: round up, but make sure the last window starts inside the image.
+  top_shape_ = bottom_shape_;
+  top_shape_.height = static_cast<int>(ceil(static_cast<float>(
+      bottom_shape_.height + 2 * pad_ - kernel_size_) / stride_)) + 1;
+  top_shape_.width = static_cast<int>(ceil(static_cast<float>(
+      bottom_shape_.width + 2 * pad_ - kernel_size_) / stride_)) + 1;
+  if (pad_ > 0) {
+    if ((top_shape_.height - 1) * stride_ >= bottom_shape_.height + pad_) {
+      top_shape_.height--;
+    }
+    if ((top_shape_.width - 1) * stride_ >= bottom_shape_.width + pad_) {
+      top_shape_.width--;
+    }
+  }
+  *top_shape = top_shape_;
+  return true;
+}
+
+void NativeMaxPoolingLayer::Forward(const std::vector<const float*>& bottoms, float* top) {
+  native_kernels::MaxPoolPlanes(bottoms[0], bottom_shape_.num * bottom_shape_.channels,
+                                bottom_shape_.height, bottom_shape_.width, kernel_size_, stride_,
+                                pad_, top_shape_.height, top_shape_.width, top);
+}
+
+NativeLRNLayer::NativeLRNLayer(const int local_size, const float alpha, const float beta,
+                               const float k) :
+  local_size_(local_size),
+  alpha_(alpha),
+  beta_(beta),
+  k_(k)
+{
+}
+
+bool NativeLRNLayer::Reshape(const std::vector<NativeShape>& bottom_shapes,
+                             NativeShape* top_shape) {
+  if (bottom_shapes.size() != 1 || local_size_ <= 0 || local_size_ % 2 == 0) {
+    return false;
+  }
+  shape_ = bottom_shapes[0];
+  *top_shape = shape_;
+  scale_.resize(shape_.height * shape_.width);
+  return true;
+}
+
+void NativeLRNLayer::Forward(const std::vector<const float*>& bottoms, float* top) {
+  const int plane_size = shape_.height * shape_.width;
+  for (int image = 0; image < shape_.num; ++image) {
+    native_kernels::LRNImage(bottoms[0] + image * shape_.image_count(), shape_.channels,
+                             plane_size, local_size_, alpha_, beta_, k_, &scale_[0],
+                             top + image * shape_.image_count());
+  }
+}
+
+NativeReLULayer::NativeReLULayer(const float negative_slope) :
+  negative_slope_(negative_slope),
+  count_(0)
+{
+}
+
+bool NativeReLULayer::Reshape(const std::vector<NativeShape>& bottom_shapes,
+                              NativeShape* top_shape) {
+  if (bottom_shapes.size() != 1) {
+    return false;
+  }
+  *top_shape = bottom_shapes[0];
+  count_ = bottom_shapes[0].count();
+  return true;
+}
+
+void NativeReLULayer::Forward(const std::vector<const float*>& bottoms, float* top) {
+  native_kernels::ReLU(bottoms[0], count_, negative_slope_, top);
+}
+
+NativeConcatLayer::NativeConcatLayer()
+{
+}
+
+bool NativeConcatLayer::Reshape(const std::vector<NativeShape>& bottom_shapes,
+                                NativeShape* top_shape) {
+  if (bottom_shapes.empty()) {
+    return false;
+  }
+  bottom_shapes_ = bottom_shapes;
+
+  // Concatenate along the channels; the other dimensions must match.
+  *top_shape = bottom_shapes[0];
+  top_shape->channels = 0;
+  for (size_t i = 0; i < bottom_shapes.size(); ++i) {
+    if (bottom_shapes[i].num != bottom_shapes[0].num ||
+        bottom_shapes[i].height != bottom_shapes[0].height ||
+        bottom_shapes[i].width != bottom_shapes[0].width) {
+      return false;
+    }
+    top_shape->channels += bottom_shapes[i].channels;
+  }
+  return true;
+}
+
+void NativeConcatLayer::Forward(const std::vector<const float*>& bottoms, float* top) {
+  const int num_images = bottom_shapes_[0].num;
+  for (int image = 0; image < num_images; ++image) {
+    for (size_t i = 0; i < bottoms.size(); ++i) {
+      const size_t count = bottom_shapes_[i].image_count();
+      memcpy(top, bottoms[i] + image * count, count * sizeof(float));
+      top += count;
+    }
+  }
+}
+
+NativeIdentityLayer::NativeIdentityLayer() :
+  count_(0)
+{
+}
+
+bool NativeIdentityLayer::Reshape(const std::vector<NativeShape>& bottom_shapes,
+                                  NativeShape* top_shape) {
+  if (bottom_shapes.size() != 1) {
+    return false;
+  }
+  *top_shape = bottom_shapes[0];
+  count_ = bottom_shapes[0].count();
+  return true;
+}
+
+void NativeIdentityLayer::Forward(const std::vector<const float*>& bottoms, float* top) {
+  if (bottoms[0] != top) {
+    memcpy(top, bottoms[0], count_ * sizeof(float));
+  }
+}
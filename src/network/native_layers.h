@@ -0,0 +1,196 @@
+#ifndef NATIVE_LAYERS_H
+#define NATIVE_LAYERS_H
+
+#include <vector>
+
+#include "network/native_net.h"
+
+class ThreadPool;
+
+// The layers supported by NativeNet.  Each computes the same output as the Caffe layer
+// with the same name (in the TEST phase).
+
+// Convolution, with optional groups.
+// weights (weights_count values) are num_output x (channels / group) x kernel_size x kernel_size;
+// bias (if not NULL) has num_output values.
+// Needs scratch memory for the input patches (see set_scratch).
+class NativeConvolutionLayer : public NativeLayer
+{
+public:
+  NativeConvolutionLayer(const int num_output, const int kernel_size, const int stride,
+                         const int pad, const int group, const float* weights,
+                         const size_t weights_count, const float* bias, ThreadPool* thread_pool);
+
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape);
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top);
+  virtual bool FuseReLU() { relu_ = true; return true; }
+  virtual size_t scratch_count() const { return columns_count_; }
+  virtual void set_scratch(float* scratch) { columns_ = scratch; }
+
+private:
+  int num_output_;
+  int kernel_size_;
+  int stride_;
+  int pad_;
+  int group_;
+  const float* weights_;
+  size_t weights_count_;
+  const float* bias_;
+  ThreadPool* thread_pool_;
+
+  // Whether to apply a ReLU to the output.
+  bool relu_;
+
+  NativeShape bottom_shape_;
+  NativeShape top_shape_;
+
+  // Scratch memory for the input patches of one group of one image (im2col).
+  size_t columns_count_;
+  float* columns_;
+};
+
+// Fully-connected layer.
+// weights (weights_count values) are num_output x (channels * height * width of the input);
+// bias (if not NULL) has num_output values.
+class NativeInnerProductLayer : public NativeLayer
+{
+public:
+  NativeInnerProductLayer(const int num_output, const float* weights, const size_t weights_count,
+                          const float* bias, ThreadPool* thread_pool);
+
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape);
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top);
+  virtual bool FuseReLU() { relu_ = true; return true; }
+
+private:
+  int num_output_;
+  const float* weights_;
+  size_t weights_count_;
+  const float* bias_;
+  ThreadPool* thread_pool_;
+
+  // Whether to apply a ReLU to the output.
+  bool relu_;
+
+  NativeShape bottom_shape_;
+};
+
+// Fully-connected layer with 8-bit weights and inputs (quantized from float weights).
+// Each row of weights is quantized symmetrically with its own scale; the inputs must not
+// be negative (e.g. the output of a ReLU), and are quantized to [0, 127] with a single
+// scale, such that input_max maps to 127.  (With 7-bit inputs, the 16-bit intermediate sums
+// of the AVX2 kernel cannot overflow, so all kernels give the same result.)
+// The products are accumulated in 32-bit integers, and the output is float.
+class NativeQuantizedInnerProductLayer : public NativeLayer
+{
+public:
+  NativeQuantizedInnerProductLayer(const int num_output, const float* weights,
+                                   const size_t weights_count, const float* bias,
+                                   const float input_max, ThreadPool* thread_pool);
+
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape);
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top);
+  virtual bool FuseReLU() { relu_ = true; return true; }
+
+private:
+  int num_output_;
+  size_t weights_count_;
+  const float* bias_;
+  ThreadPool* thread_pool_;
+
+  // Whether to apply a ReLU to the output.
+  bool relu_;
+
+  // Quantized weights, and the scale of each row (weight = quantized weight * scale).
+  std::vector<signed char> weights_;
+  std::vector<float> weight_scales_;
+
+  // Scale of the inputs (input = quantized input * scale).
+  float input_scale_;
+
+  NativeShape bottom_shape_;
+
+  // Quantized inputs.
+  std::vector<unsigned char> inputs_;
+};
+
+// Max pooling.
+class NativeMaxPoolingLayer : public NativeLayer
+{
+public:
+  NativeMaxPoolingLayer(const int kernel_size, const int stride, const int pad);
+
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape);
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top);
+
+private:
+  int kernel_size_;
+  int stride_;
+  int pad_;
+
+  NativeShape bottom_shape_;
+  NativeShape top_shape_;
+};
+
+// Local response normalization across channels.
+class NativeLRNLayer : public NativeLayer
+{
+public:
+  NativeLRNLayer(const int local_size, const float alpha, const float beta, const float k);
+
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape);
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top);
+
+private:
+  int local_size_;
+  float alpha_;
+  float beta_;
+  float k_;
+
+  NativeShape shape_;
+
+  // Sum of squares over the channel window, for one channel of one image.
+  std::vector<float> scale_;
+};
+
+// Rectified linear unit (can run in place).
+class NativeReLULayer : public NativeLayer
+{
+public:
+  NativeReLULayer(const float negative_slope);
+
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape);
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top);
+
+private:
+  float negative_slope_;
+  size_t count_;
+};
+
+// Concatenation along the channels.
+class NativeConcatLayer : public NativeLayer
+{
+public:
+  NativeConcatLayer();
+
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape);
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top);
+
+private:
+  std::vector<NativeShape> bottom_shapes_;
+};
+
+// Passes its input through unchanged (e.g. Dropout in the TEST phase; can run in place).
+class NativeIdentityLayer : public NativeLayer
+{
+public:
+  NativeIdentityLayer();
+
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape);
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top);
+
+private:
+  size_t count_;
+};
+
+#endif // NATIVE_LAYERS_H
@@ -0,0 +1,587 @@
+#include "native_net.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+
+#include "helper/thread_pool.h"
+#include "network/memory_plan.h"
+#include "network/native_layers.h"
+#include "network/prototxt.h"
+#include "network/quantization.h"
+#include "network/weight_file.h"
+
+namespace {
+
+// Whether the layer is run in the TEST phase (according to its include / exclude rules).
+bool IsTestPhaseLayer(const PrototxtMessage& layer_param) {
+  const std::vector<const PrototxtMessage*> includes = layer_param.GetMessages("include");
+  for (size_t i = 0; i < includes.size(); ++i) {
+    if (includes[i]->GetString("phase", "") == "TRAIN") {
+      return false;
+    }
+  }
+  const std::vector<const PrototxtMessage*> excludes = layer_param.GetMessages("exclude");
+  for (size_t i = 0; i < excludes.size(); ++i) {
+    if (excludes[i]->GetString("phase", "") == "TEST") {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Read a shape from a list of dimensions (which may have fewer than 4 axes, as for an
+// InnerProduct output); the first dimension is the number of images and is not used.
+bool ShapeFromDims(const std::vector<std::string>& dims, NativeShape* shape) {
+  if (dims.empty() || dims.size() > 4) {
+    return false;
+  }
+  int values[4] = { 1, 1, 1, 1 };
+  for (size_t i = 0; i < dims.size(); ++i) {
+    values[i] = atoi(dims[i].c_str());
+    if (values[i] <= 0) {
+      return false;
+    }
+  }
+  shape->num = 1;
+  shape->channels = values[1];
+  shape->height = values[2];
+  shape->width = values[3];
+  return true;
+}
+
+} // namespace
+
+NativeNet::NativeNet() :
+  output_activation_(-1),
+  num_images_(0),
+  arena_size_(0),
+  thread_pool_(NULL)
+{
+}
+
+bool NativeNet::Init(const std::string& deploy_proto, const WeightFile& weights,
+                     const std::string& output_name, ThreadPool* thread_pool,
+                     const QuantizationTable* quantization) {
+  thread_pool_ = thread_pool;
+
+  PrototxtMessage net_param;
+  if (!net_param.ParseFile(deploy_proto)) {
+    return false;
+  }
+
+  // Get the inputs and the layers needed to compute the output.
+  std::vector<const PrototxtMessage*> layers;
+  std::vector<std::pair<std::string, NativeShape> > inputs;
+  if (!GetTestLayers(net_param, output_name, &layers, &inputs)) {
+    printf("Error - could not read the inputs of %s\n", deploy_proto.c_str());
+    return false;
+  }
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    const int index = ActivationIndex(inputs[i].first);
+    activations_[index].shape = inputs[i].second;
+    input_activations_.push_back(index);
+  }
+
+  // Create the layers.
+  for (size_t i = 0; i < layers.size(); ++i) {
+    const PrototxtMessage& layer_param = *layers[i];
+    const std::string name = layer_param.GetString("name", "");
+    const std::string type = layer_param.GetString("type", "");
+
+    const std::vector<std::string> bottoms = layer_param.GetValues("bottom");
+    const std::vector<std::string> tops = layer_param.GetValues("top");
+    if (tops.size() != 1) {
+      printf("Error - layer %s must have a single output\n", name.c_str());
+      return false;
+    }
+
+    // Dropout does nothing in the TEST phase, so one that runs in place is not needed.
+    if (type == "Dropout" && bottoms.size() == 1 && bottoms[0] == tops[0]) {
+      continue;
+    }
+
+    // A ReLU that runs in place on the output of the previous layer is applied by that layer,
+    // if it can.
+    const PrototxtMessage* relu_param = layer_param.GetMessage("relu_param");
+    if (type == "ReLU" && bottoms.size() == 1 && bottoms[0] == tops[0] && !layers_.empty() &&
+        activations_[layer_tops_.back()].name == tops[0] &&
+        (!relu_param || relu_param->GetFloat("negative_slope", 0) == 0) &&
+        layers_.back()->FuseReLU()) {
+      continue;
+    }
+
+    NativeLayer* layer = CreateLayer(layer_param, weights, quantization);
+    if (!layer) {
+      printf("Error - layer %s (%s) is not supported\n", name.c_str(), type.c_str());
+      return false;
+    }
+    layers_.push_back(boost::shared_ptr<NativeLayer>(layer));
+    layer_names_.push_back(name);
+    layer_types_.push_back(type);
+
+    // Layers whose output has the same name as their input run in place, sharing the activation.
+    std::vector<int> bottom_indices;
+    for (size_t j = 0; j < bottoms.size(); ++j) {
+      bottom_indices.push_back(ActivationIndex(bottoms[j]));
+    }
+    layer_bottoms_.push_back(bottom_indices);
+    layer_tops_.push_back(ActivationIndex(tops[0]));
+  }
+
+  // Find the output.
+  output_activation_ = -1;
+  for (size_t i = 0; i < activations_.size(); ++i) {
+    if (activations_[i].name == output_name) {
+      output_activation_ = i;
+    }
+  }
+  if (output_activation_ < 0) {
+    printf("Error - %s has no blob named %s\n", deploy_proto.c_str(), output_name.c_str());
+    return false;
+  }
+
+  // Find the Concat layers that do not need to be run (with a single image).
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    if (CanConcatInPlace(i)) {
+      in_place_concats_.push_back(i);
+    }
+  }
+
+  // Set up the layers for a single image.
+  num_images_ = 0;
+  return Reshape(1);
+}
+
+bool NativeNet::GetTestLayers(const PrototxtMessage& net_param, const std::string& output_name,
+                              std::vector<const PrototxtMessage*>* layers,
+                              std::vector<std::pair<std::string, NativeShape> >* inputs) {
+  // Get the inputs declared at the top of the prototxt.
+  if (!GetInputs(net_param, inputs)) {
+    return false;
+  }
+
+  // Get the layers run in the TEST phase.
+  const std::vector<const PrototxtMessage*> all_layers = net_param.GetMessages("layer");
+  std::vector<const PrototxtMessage*> test_layers;
+  for (size_t i = 0; i < all_layers.size(); ++i) {
+    if (IsTestPhaseLayer(*all_layers[i])) {
+      test_layers.push_back(all_layers[i]);
+    }
+  }
+
+  // Find the layers needed to compute the output, walking backwards from the output:
+  // a layer is needed if one of its outputs is needed, and then its inputs are needed too.
+  std::set<std::string> needed_blobs;
+  needed_blobs.insert(output_name);
+  std::vector<bool> layer_needed(test_layers.size(), false);
+  for (int i = static_cast<int>(test_layers.size()) - 1; i >= 0; --i) {
+    const std::vector<std::string> tops = test_layers[i]->GetValues("top");
+    for (size_t j = 0; j < tops.size(); ++j) {
+      if (needed_blobs.count(tops[j])) {
+        layer_needed[i] = true;
+      }
+    }
+    if (layer_needed[i]) {
+      const std::vector<std::string> bottoms = test_layers[i]->GetValues("bottom");
+      needed_blobs.insert(bottoms.begin(), bottoms.end());
+    }
+  }
+
+  for (size_t i = 0; i < test_layers.size(); ++i) {
+    const PrototxtMessage& layer_param = *test_layers[i];
+
+    // Input layers declare inputs rather than computing anything.
+    if (layer_param.GetString("type", "") == "Input") {
+      const std::vector<std::string> tops = layer_param.GetValues("top");
+      const PrototxtMessage* input_param = layer_param.GetMessage("input_param");
+      const std::vector<const PrototxtMessage*> shapes = input_param ?
+          input_param->GetMessages("shape") : std::vector<const PrototxtMessage*>();
+      for (size_t j = 0; j < tops.size(); ++j) {
+        const PrototxtMessage* shape = shapes.size() == 1 ? shapes[0] :
+            (j < shapes.size() ? shapes[j] : NULL);
+        NativeShape input_shape;
+        if (!shape || !ShapeFromDims(shape->GetValues("dim"), &input_shape)) {
+          printf("Error - could not read the shape of input %s\n", tops[j].c_str());
+          return false;
+        }
+        inputs->push_back(std::make_pair(tops[j], input_shape));
+      }
+      continue;
+    }
+
+    if (layer_needed[i]) {
+      layers->push_back(test_layers[i]);
+    }
+  }
+  return true;
+}
+
+bool NativeNet::GetInputs(const PrototxtMessage& net_param,
+                          std::vector<std::pair<std::string, NativeShape> >* inputs) {
+  const std::vector<std::string> names = net_param.GetValues("input");
+  const std::vector<std::string> input_dims = net_param.GetValues("input_dim");
+  const std::vector<const PrototxtMessage*> input_shapes = net_param.GetMessages("input_shape");
+
+  for (size_t i = 0; i < names.size(); ++i) {
+    NativeShape shape;
+    if (!input_shapes.empty()) {
+      // Shapes given as input_shape { dim: ... }.
+      if (i >= input_shapes.size() ||
+          !ShapeFromDims(input_shapes[i]->GetValues("dim"), &shape)) {
+        return false;
+      }
+    } else {
+      // Shapes given as 4 input_dim values per input.
+      if (input_dims.size() < 4 * (i + 1)) {
+        return false;
+      }
+      const std::vector<std::string> dims(input_dims.begin() + 4 * i,
+                                          input_dims.begin() + 4 * (i + 1));
+      if (!ShapeFromDims(dims, &shape)) {
+        return false;
+      }
+    }
+    inputs->push_back(std::make_pair(names[i], shape));
+  }
+  return true;
+}
+
+NativeLayer* NativeNet::CreateLayer(const PrototxtMessage& layer_param, const WeightFile& weights,
+                                    const QuantizationTable* quantization) {
+  const std::string name = layer_param.GetString("name", "");
+  const std::string type = layer_param.GetString("type", "");
+
+  if (type == "Convolution" || type == "InnerProduct") {
+    const bool convolution = type == "Convolution";
+    const PrototxtMessage* param = layer_param.GetMessage(
+        convolution ? "convolution_param" : "inner_product_param");
+    if (!param) {
+      return NULL;
+    }
+    const int num_output = param->GetInt("num_output", 0);
+    const bool bias_term = param->GetString("bias_term", "true") == "true";
+
+    // Get the weights and bias of the layer.
+    const WeightBlob* weight_blob = weights.FindBlob(name, 0);
+    const WeightBlob* bias_blob = bias_term ? weights.FindBlob(name, 1) : NULL;
+    if (!weight_blob || (bias_term && !bias_blob) ||
+        (bias_blob && bias_blob->count() != static_cast<size_t>(num_output))) {
+      printf("Error - missing or invalid weights for layer %s\n", name.c_str());
+      return NULL;
+    }
+    const float* bias = bias_blob ? bias_blob->data : NULL;
+
+    if (!convolution) {
+      if (param->GetInt("axis", 1) != 1 || param->GetString("transpose", "false") != "false") {
+        return NULL;
+      }
+
+      // Quantize the layer if its inputs have been calibrated and are never negative.
+      float input_min;
+      float input_max;
+      if (quantization && quantization->GetRange(name, &input_min, &input_max) && input_min >= 0) {
+        return new NativeQuantizedInnerProductLayer(num_output, weight_blob->data,
+                                                    weight_blob->count(), bias, input_max,
+                                                    thread_pool_);
+      }
+      return new NativeInnerProductLayer(num_output, weight_blob->data, weight_blob->count(),
+                                         bias, thread_pool_);
+    }
+
+    // Only square kernels, strides and padding are supported.
+    if (param->Has("kernel_h") || param->Has("stride_h") || param->Has("pad_h") ||
+        param->GetValues("kernel_size").size() > 1 || param->GetValues("stride").size() > 1 ||
+        param->GetValues("pad").size() > 1 || param->GetInt("dilation", 1) != 1) {
+      return NULL;
+    }
+    return new NativeConvolutionLayer(num_output, param->GetInt("kernel_size", 0),
+                                      param->GetInt("stride", 1), param->GetInt("pad", 0),
+                                      param->GetInt("group", 1), weight_blob->data,
+                                      weight_blob->count(), bias, thread_pool_);
+  } else if (type == "Pooling") {
+    const PrototxtMessage* param = layer_param.GetMessage("pooling_param");
+    if (!param || param->GetString("pool", "MAX") != "MAX" || param->Has("kernel_h") ||
+        param->GetString("global_pooling", "false") != "false") {
+      return NULL;
+    }
+    return new NativeMaxPoolingLayer(param->GetInt("kernel_size", 0), param->GetInt("stride", 1),
+                                     param->GetInt("pad", 0));
+  } else if (type == "LRN") {
+    const PrototxtMessage* param = layer_param.GetMessage("lrn_param");
+    PrototxtMessage default_param;
+    if (!param) {
+      param = &default_param;
+    }
+    if (param->GetString("norm_region", "ACROSS_CHANNELS") != "ACROSS_CHANNELS") {
+      return NULL;
+    }
+    return new NativeLRNLayer(param->GetInt("local_size", 5), param->GetFloat("alpha", 1),
+                              param->GetFloat("beta", 0.75), param->GetFloat("k", 1));
+  } else if (type == "ReLU") {
+    const PrototxtMessage* param = layer_param.GetMessage("relu_param");
+    return new NativeReLULayer(param ? param->GetFloat("negative_slope", 0) : 0);
+  } else if (type == "Concat") {
+    const PrototxtMessage* param = layer_param.GetMessage("concat_param");
+    if (param && (param->GetInt("axis", 1) != 1 || param->GetInt("concat_dim", 1) != 1)) {
+      return NULL;
+    }
+    return new NativeConcatLayer();
+  } else if (type == "Dropout") {
+    // Dropout does nothing in the TEST phase.
+    return new NativeIdentityLayer();
+  }
+
+  return NULL;
+}
+
+int NativeNet::ActivationIndex(const std::string& name) {
+  for (size_t i = 0; i < activations_.size(); ++i) {
+    if (activations_[i].name == name) {
+      return i;
+    }
+  }
+  Activation activation;
+  activation.name = name;
+  activations_.push_back(activation);
+  return activations_.size() - 1;
+}
+
+bool NativeNet::CanConcatInPlace(const int layer) const {
+  if (layer_types_[layer] != "Concat") {
+    return false;
+  }
+
+  // Each input must be computed by a layer before the Concat (other than another Concat whose
+  // own inputs may be in its output), be a different activation from the other inputs, and
+  // not be changed by a layer after the Concat; the output must not be changed after the
+  // Concat either.
+  const std::vector<int>& bottoms = layer_bottoms_[layer];
+  for (size_t i = 0; i < bottoms.size(); ++i) {
+    if (std::count(bottoms.begin(), bottoms.end(), bottoms[i]) > 1) {
+      return false;
+    }
+    bool computed = false;
+    for (int j = 0; j < layer; ++j) {
+      if (layer_tops_[j] == bottoms[i]) {
+        computed = layer_types_[j] != "Concat";
+      }
+    }
+    if (!computed) {
+      return false;
+    }
+  }
+  for (size_t j = layer + 1; j < layers_.size(); ++j) {
+    if (layer_tops_[j] == layer_tops_[layer] ||
+        std::count(bottoms.begin(), bottoms.end(), layer_tops_[j]) > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool NativeNet::Reshape(const size_t num_images) {
+  if (num_images == num_images_) {
+    return true;
+  }
+
+  // Set the number of images of each input.
+  for (size_t i = 0; i < input_activations_.size(); ++i) {
+    activations_[input_activations_[i]].shape.num = num_images;
+  }
+
+  // Compute the shape of the output of each layer.
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    std::vector<NativeShape> bottom_shapes;
+    for (size_t j = 0; j < layer_bottoms_[i].size(); ++j) {
+      const NativeShape& shape = activations_[layer_bottoms_[i][j]].shape;
+      if (shape.num != static_cast<int>(num_images)) {
+        printf("Error - input %s of layer %s is not computed\n",
+               activations_[layer_bottoms_[i][j]].name.c_str(), layer_names_[i].c_str());
+        return false;
+      }
+      bottom_shapes.push_back(shape);
+    }
+
+    Activation& top = activations_[layer_tops_[i]];
+    if (!layers_[i]->Reshape(bottom_shapes, &top.shape)) {
+      printf("Error - the inputs of layer %s do not fit the layer\n", layer_names_[i].c_str());
+      return false;
+    }
+  }
+  num_images_ = num_images;
+
+  // Place the activations for the new shapes.
+  PlanActivations();
+
+  // Store the input pointers of each layer (which do not change until the next reshape).
+  bottom_data_.resize(layers_.size());
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    bottom_data_[i].clear();
+    for (size_t j = 0; j < layer_bottoms_[i].size(); ++j) {
+      bottom_data_[i].push_back(activations_[layer_bottoms_[i][j]].values);
+    }
+  }
+  return true;
+}
+
+void NativeNet::PlanActivations() {
+  // With a single image, concatenating along the channels places the inputs one after another,
+  // so each input of a Concat can be computed in its part of the output instead of being copied.
+  // storage[i] is the activation whose memory holds activation i, at storage_offset[i] floats.
+  std::vector<int> storage(activations_.size());
+  std::vector<size_t> storage_offset(activations_.size(), 0);
+  for (size_t i = 0; i < activations_.size(); ++i) {
+    storage[i] = i;
+  }
+  skip_layer_.assign(layers_.size(), false);
+  if (num_images_ == 1) {
+    for (size_t i = 0; i < in_place_concats_.size(); ++i) {
+      const int layer = in_place_concats_[i];
+      size_t offset = 0;
+      for (size_t j = 0; j < layer_bottoms_[layer].size(); ++j) {
+        const int bottom = layer_bottoms_[layer][j];
+        storage[bottom] = layer_tops_[layer];
+        storage_offset[bottom] = offset;
+        offset += activations_[bottom].shape.count();
+      }
+      skip_layer_[layer] = true;
+    }
+  }
+
+  // The layers during which each activation is needed: from the first layer that writes it
+  // (or an activation stored in it) to the last layer that reads it (or an activation stored
+  // in it).  Inputs are needed from the start and the output until the end.  The scratch
+  // memory of each layer (after the activations) is only needed while the layer runs.
+  const int num_layers = layers_.size();
+  const size_t num_activations = activations_.size();
+  std::vector<PlannedBuffer> buffers(num_activations + num_layers);
+  for (size_t i = 0; i < num_activations; ++i) {
+    buffers[i].count = activations_[i].shape.count();
+    buffers[i].first = num_layers;
+  }
+  for (int i = 0; i < num_layers; ++i) {
+    if (skip_layer_[i]) {
+      continue;
+    }
+    PlannedBuffer& top = buffers[storage[layer_tops_[i]]];
+    top.first = std::min(top.first, i);
+    top.last = std::max(top.last, i);
+    for (size_t j = 0; j < layer_bottoms_[i].size(); ++j) {
+      PlannedBuffer& bottom = buffers[storage[layer_bottoms_[i][j]]];
+      bottom.last = std::max(bottom.last, i);
+    }
+
+    PlannedBuffer& scratch = buffers[num_activations + i];
+    scratch.count = layers_[i]->scratch_count();
+    scratch.first = i;
+    scratch.last = i;
+  }
+  buffers[storage[output_activation_]].last = num_layers;
+  for (size_t i = 0; i < input_activations_.size(); ++i) {
+    PlannedBuffer& input = buffers[input_activations_[i]];
+    if (input.last >= 0) {
+      input.first = -1;
+    }
+  }
+
+  // Place them, and only reallocate if more memory is needed.
+  arena_size_ = PlanMemory(&buffers);
+  if (arena_.size() < arena_size_) {
+    std::vector<float>().swap(arena_);
+    arena_.resize(arena_size_);
+  }
+
+  for (size_t i = 0; i < num_activations; ++i) {
+    const PlannedBuffer& buffer = buffers[storage[i]];
+    activations_[i].own_values = buffer.first <= buffer.last ?
+        &arena_[buffer.offset + storage_offset[i]] : NULL;
+    activations_[i].values = activations_[i].own_values;
+  }
+  for (int i = 0; i < num_layers; ++i) {
+    const PlannedBuffer& scratch = buffers[num_activations + i];
+    layers_[i]->set_scratch(scratch.count > 0 ? &arena_[scratch.offset] : NULL);
+  }
+}
+
+size_t NativeNet::unplanned_activation_bytes() const {
+  size_t count = 0;
+  for (size_t i = 0; i < activations_.size(); ++i) {
+    count += activations_[i].shape.count();
+  }
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    count += layers_[i]->scratch_count();
+  }
+  return count * sizeof(float);
+}
+
+float* NativeNet::mutable_input(const std::string& name) {
+  for (size_t i = 0; i < input_activations_.size(); ++i) {
+    Activation& input = activations_[input_activations_[i]];
+    if (input.name == name && input.values) {
+      return input.values;
+    }
+  }
+  return NULL;
+}
+
+bool NativeNet::set_input(const std::string& name, float* data) {
+  for (size_t i = 0; i < input_activations_.size(); ++i) {
+    Activation& input = activations_[input_activations_[i]];
+    if (input.name != name || !input.own_values) {
+      continue;
+    }
+
+    // Point the layers that read the input at its new values.
+    float* values = data ? data : input.own_values;
+    for (size_t j = 0; j < layers_.size(); ++j) {
+      for (size_t k = 0; k < layer_bottoms_[j].size(); ++k) {
+        if (layer_bottoms_[j][k] == input_activations_[i]) {
+          bottom_data_[j][k] = values;
+        }
+      }
+    }
+    input.values = values;
+    return true;
+  }
+  return false;
+}
+
+NativeShape NativeNet::input_shape(const std::string& name) const {
+  for (size_t i = 0; i < input_activations_.size(); ++i) {
+    const Activation& input = activations_[input_activations_[i]];
+    if (input.name == name) {
+      NativeShape shape = input.shape;
+      shape.num = 1;
+      return shape;
+    }
+  }
+  return NativeShape();
+}
+
+void NativeNet::Forward() {
+  ForwardFromTo(0, layers_.size() - 1);
+}
+
+void NativeNet::ForwardFromTo(const int start, const int end) {
+  for (int i = start; i <= end; ++i) {
+    if (!skip_layer_[i]) {
+      layers_[i]->Forward(bottom_data_[i], activations_[layer_tops_[i]].values);
+    }
+  }
+}
+
+const float* NativeNet::layer_input(const int layer, NativeShape* shape) const {
+  const Activation& input = activations_[layer_bottoms_[layer][0]];
+  *shape = input.shape;
+  return input.values;
+}
+
+const float* NativeNet::output() const {
+  return activations_[output_activation_].values;
+}
+
+const NativeShape& NativeNet::output_shape() const {
+  return activations_[output_activation_].shape;
+}
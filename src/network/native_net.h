@@ -0,0 +1,205 @@
+#ifndef NATIVE_NET_H
+#define NATIVE_NET_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+class PrototxtMessage;
+class QuantizationTable;
+class ThreadPool;
+class WeightFile;
+
+// Shape of an activation: num x channels x height x width.
+struct NativeShape {
+  NativeShape() : num(0), channels(0), height(0), width(0) {}
+
+  int num;
+  int channels;
+  int height;
+  int width;
+
+  // Number of values per image.
+  size_t image_count() const { return static_cast<size_t>(channels) * height * width; }
+
+  // Number of values.
+  size_t count() const { return num * image_count(); }
+};
+
+// A layer of a NativeNet.
+class NativeLayer
+{
+public:
+  virtual ~NativeLayer() {}
+
+  // Compute the shape of the output for the given input shapes, and allocate any buffers needed.
+  // Returns false if the inputs do not fit the layer.
+  virtual bool Reshape(const std::vector<NativeShape>& bottom_shapes, NativeShape* top_shape) = 0;
+
+  // Compute the output from the inputs (which have the shapes given to Reshape).
+  // The output may be the same as the input, for layers that run in place.
+  virtual void Forward(const std::vector<const float*>& bottoms, float* top) = 0;
+
+  // Apply a ReLU to the output as part of Forward, rather than in a separate pass over it.
+  // Returns false if the layer cannot.
+  virtual bool FuseReLU() { return false; }
+
+  // Number of floats of scratch memory that Forward needs (for the shapes given to Reshape).
+  virtual size_t scratch_count() const { return 0; }
+
+  // Use scratch (which holds scratch_count() floats, and may be used by other layers between
+  // calls to Forward) as the scratch memory of Forward.  Must be called after Reshape.
+  virtual void set_scratch(float* /*scratch*/) {}
+};
+
+// Runs the forward pass of a Caffe network on the CPU, without depending on Caffe.
+// The network architecture is read from a Caffe .prototxt and the weights from a WeightFile.
+// Supports the layers used by GOTURN (Convolution, ReLU, Pooling, LRN, Concat, InnerProduct
+// and Dropout); only the layers needed to compute the requested output are run.
+// A ReLU that runs in place after a convolution or fully-connected layer is applied by that
+// layer, a Dropout that runs in place is not run, and with a single image the inputs of a
+// Concat are computed directly in its output, so that the Concat is not run.
+// All activations (and the scratch memory of the layers) share a single buffer: each is only
+// kept from the layer that computes it to the last layer that reads it, and activations that
+// are never needed at the same time are placed in the same memory (see network/memory_plan.h).
+// So after a forward pass, only the inputs and the output still hold their values.
+class NativeNet
+{
+public:
+  NativeNet();
+
+  // Set up the network with the architecture in deploy_proto and the weights in weights
+  // (which must outlive this object), to compute the blob named output_name.
+  // Layers are run in parallel on thread_pool (which must outlive this object).
+  // If quantization is not NULL, the fully-connected layers with a non-negative input range
+  // in quantization are run with 8-bit weights and inputs (see NativeQuantizedInnerProductLayer).
+  // Returns false if the network cannot be set up.
+  bool Init(const std::string& deploy_proto, const WeightFile& weights,
+            const std::string& output_name, ThreadPool* thread_pool,
+            const QuantizationTable* quantization);
+
+  // Get the layers of net_param that are run in the TEST phase and are needed to compute the
+  // blob named output_name (in order, without Input layers), and the names and shapes (for
+  // one image) of the inputs of the network.
+  // Returns false if the inputs cannot be read.
+  static bool GetTestLayers(const PrototxtMessage& net_param, const std::string& output_name,
+                            std::vector<const PrototxtMessage*>* layers,
+                            std::vector<std::pair<std::string, NativeShape> >* inputs);
+
+  // Set the number of images in each input.  Activations are only replanned when the
+  // number of images changes (and only reallocated when they need more memory).
+  // Returns false if the layers do not fit the shapes of their inputs.
+  bool Reshape(const size_t num_images);
+
+  // Number of images that the network is shaped for.
+  size_t num_images() const { return num_images_; }
+
+  // Get the data of the input with the given name, or NULL if there is no such input
+  // (or it is not needed to compute the output).
+  float* mutable_input(const std::string& name);
+
+  // Shape of the input with the given name (for one image).
+  NativeShape input_shape(const std::string& name) const;
+
+  // Read the input with the given name from data (which holds its values for the current number
+  // of images, and must not change during a forward pass) instead of from the network's own
+  // memory, or from its own memory again if data is NULL.  Lasts until the number of images
+  // changes.  Returns false if there is no such input (or it is not needed).
+  bool set_input(const std::string& name, float* data);
+
+  // Run the forward pass of all layers.
+  void Forward();
+
+  // Run the forward pass of the layers from start to end (inclusive).
+  void ForwardFromTo(const int start, const int end);
+
+  // Names of the layers that are run (in order).
+  const std::vector<std::string>& layer_names() const { return layer_names_; }
+
+  // Types of the layers that are run (as in the prototxt, e.g. "InnerProduct").
+  const std::vector<std::string>& layer_types() const { return layer_types_; }
+
+  // The first input of the given layer, and its shape (as it is when the layer is run, if
+  // called after running the layers before it).
+  const float* layer_input(const int layer, NativeShape* shape) const;
+
+  // The output of the network, and its shape.
+  const float* output() const;
+  const NativeShape& output_shape() const;
+
+  // Size of the buffer holding all activations, in bytes (for the current number of images).
+  size_t activation_bytes() const { return arena_size_ * sizeof(float); }
+
+  // Size that the activations would take if each had memory of its own (as in Caffe), in bytes.
+  size_t unplanned_activation_bytes() const;
+
+private:
+  // Get the inputs declared at the top of the prototxt.
+  static bool GetInputs(const PrototxtMessage& net_param,
+                        std::vector<std::pair<std::string, NativeShape> >* inputs);
+
+  // Create the layer described by layer_param.  Returns NULL if it is not supported.
+  NativeLayer* CreateLayer(const PrototxtMessage& layer_param, const WeightFile& weights,
+                           const QuantizationTable* quantization);
+
+  // Get the index of the activation with the given name, adding it if needed.
+  int ActivationIndex(const std::string& name);
+
+  // Whether the inputs of the given Concat layer can be computed directly in its output.
+  bool CanConcatInPlace(const int layer) const;
+
+  // Place the activations and the scratch memory of the layers (for the current shapes).
+  void PlanActivations();
+
+  // An activation (the output of a layer or an input).
+  struct Activation {
+    Activation() : values(NULL), own_values(NULL) {}
+
+    std::string name;
+    NativeShape shape;
+
+    // The values of the activation (in arena_, or set with set_input), or NULL if it is not needed.
+    float* values;
+
+    // The values of the activation in arena_.
+    float* own_values;
+  };
+
+  // All activations.
+  std::vector<Activation> activations_;
+
+  // Indices of the input activations.
+  std::vector<int> input_activations_;
+
+  // Layers to run, and the indices of their input and output activations.
+  std::vector<boost::shared_ptr<NativeLayer> > layers_;
+  std::vector<std::string> layer_names_;
+  std::vector<std::string> layer_types_;
+  std::vector<std::vector<int> > layer_bottoms_;
+  std::vector<int> layer_tops_;
+
+  // Concat layers whose inputs can be computed directly in their output.
+  std::vector<int> in_place_concats_;
+
+  // Whether each layer is skipped (for a Concat whose inputs are in its output), set when reshaping.
+  std::vector<bool> skip_layer_;
+
+  // Index of the output activation.
+  int output_activation_;
+
+  // Number of images that the network is shaped for.
+  size_t num_images_;
+
+  // Input pointers of each layer, set when reshaping.
+  std::vector<std::vector<const float*> > bottom_data_;
+
+  // All activations and the scratch memory of the layers, and the number of floats in use.
+  std::vector<float> arena_;
+  size_t arena_size_;
+
+  ThreadPool* thread_pool_;
+};
+
+#endif // NATIVE_NET_H
@@ -0,0 +1,190 @@
+#include "native_regressor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+// Names of the network inputs and output.
+const char kTargetInput[] = "target";
+const char kImageInput[] = "image";
+const char kOutput[] = "fc8";
+
+} // namespace
+
+NativeRegressor::NativeRegressor(const std::string& deploy_proto,
+                                 const std::string& weights_path,
+                                 const size_t num_threads) :
+  thread_pool_(num_threads),
+  calibration_(NULL),
+  async_(this)
+{
+  SetupNetwork(deploy_proto, weights_path, NULL);
+}
+
+NativeRegressor::NativeRegressor(const std::string& deploy_proto,
+                                 const std::string& weights_path,
+                                 const size_t num_threads,
+                                 const QuantizationTable& quantization) :
+  thread_pool_(num_threads),
+  calibration_(NULL),
+  async_(this)
+{
+  SetupNetwork(deploy_proto, weights_path, &quantization);
+}
+
+NativeRegressor::~NativeRegressor() {
+  async_.Stop();
+}
+
+void NativeRegressor::SetupNetwork(const std::string& deploy_proto,
+                                   const std::string& weights_path,
+                                   const QuantizationTable* quantization) {
+  // Load the weights (without copying them, if they are in a weight file).
+  if (!weights_.Open(weights_path)) {
+    exit(-1);
+  }
+
+  // Set up the layers needed to compute the output.
+  if (!net_.Init(deploy_proto, weights_, kOutput, &thread_pool_, quantization)) {
+    printf("Error - could not set up the network in %s\n", deploy_proto.c_str());
+    exit(-1);
+  }
+
+  if (!SetInputShape(net_.input_shape(kImageInput), net_.input_shape(kTargetInput))) {
+    printf("Error - %s needs inputs %s and %s with the same shape, with 1 or 3 channels\n",
+           deploy_proto.c_str(), kTargetInput, kImageInput);
+    exit(-1);
+  }
+
+  target_input_ = net_.mutable_input(kTargetInput);
+  image_input_ = net_.mutable_input(kImageInput);
+
+  printf("Native network: %zu layers on %zu threads, %zu bytes of activations per image\n",
+         net_.layer_names().size(), thread_pool_.num_threads(), net_.activation_bytes());
+}
+
+void NativeRegressor::ReshapeSingle() {
+  async_.Wait();
+
+  net_.Reshape(1);
+  target_input_ = net_.mutable_input(kTargetInput);
+  image_input_ = net_.mutable_input(kImageInput);
+}
+
+void NativeRegressor::EstimateSingle(const float* target, BoundingBox* bbox) {
+  // Run the network directly on the given target, if any.
+  if (target) {
+    net_.set_input(kTargetInput, const_cast<float*>(target));
+  }
+  Estimate(1, &bboxes_);
+  if (target) {
+    net_.set_input(kTargetInput, NULL);
+  }
+  *bbox = bboxes_[0];
+}
+
+void NativeRegressor::RegressFromFullImages(const std::vector<cv::Mat>& images_curr,
+                                            const std::vector<BoundingBox>& bboxes_curr_prior_tight,
+                                            const std::vector<cv::Mat>& images_prev,
+                                            const std::vector<BoundingBox>& bboxes_prev_tight,
+                                            std::vector<BoundingBox>* bboxes) {
+  async_.Wait();
+
+  const size_t num_images = images_curr.size();
+  if (images_prev.size() != num_images || bboxes_curr_prior_tight.size() != num_images ||
+      bboxes_prev_tight.size() != num_images) {
+    printf("Error - %zu images but %zu previous images, %zu priors and %zu targets\n",
+           num_images, images_prev.size(), bboxes_curr_prior_tight.size(), bboxes_prev_tight.size());
+    return;
+  }
+
+  bboxes->resize(num_images);
+  if (num_images == 0) {
+    return;
+  }
+
+  // Reshape the inputs to hold all of the images (only reallocates when the number changes).
+  if (!net_.Reshape(num_images)) {
+    return;
+  }
+  target_input_ = net_.mutable_input(kTargetInput);
+  image_input_ = net_.mutable_input(kImageInput);
+
+  // Crop, resize and normalize each search region and target, writing them directly
+  // to their place in the inputs of the network.
+  for (size_t i = 0; i < num_images; ++i) {
+    CropPadResizePlanar(bboxes_curr_prior_tight[i], images_curr[i], input_geometry_, mean_value_,
+                        num_channels_, &resample_buffers_, image_input_ + i * input_size());
+    CropPadResizePlanar(bboxes_prev_tight[i], images_prev[i], input_geometry_, mean_value_,
+                        num_channels_, &resample_buffers_, target_input_ + i * input_size());
+  }
+
+  // Estimate the locations of all targets in a single forward pass.
+  Estimate(num_images, bboxes);
+}
+
+void NativeRegressor::Estimate(const size_t num_images, std::vector<BoundingBox>* bboxes) {
+  // Perform a forward pass of the network.
+  if (calibration_) {
+    ForwardCalibrate();
+  } else {
+    net_.Forward();
+  }
+
+  // Split the output into one bounding box per image.
+  bboxes->resize(num_images);
+  const float* output = net_.output();
+  const size_t bbox_size = net_.output_shape().image_count();
+  for (size_t i = 0; i < num_images; ++i) {
+    bbox_estimation_.assign(output + i * bbox_size, output + (i + 1) * bbox_size);
+    (*bboxes)[i] = BoundingBox(bbox_estimation_);
+  }
+}
+
+void NativeRegressor::ForwardCalibrate() {
+  const std::vector<std::string>& layer_names = net_.layer_names();
+  const std::vector<std::string>& layer_types = net_.layer_types();
+  for (size_t i = 0; i < layer_names.size(); ++i) {
+    // Record the range of the input of each fully-connected layer, just before it is run.
+    if (layer_types[i] == "InnerProduct") {
+      NativeShape shape;
+      const float* input = net_.layer_input(i, &shape);
+      const float* input_end = input + shape.count();
+      calibration_->AddRange(layer_names[i], *std::min_element(input, input_end),
+                             *std::max_element(input, input_end));
+    }
+    net_.ForwardFromTo(i, i);
+  }
+}
+
+boost::shared_future<BoundingBox> NativeRegressor::RegressAsync(const cv::Mat& image_curr,
+                                                                const BoundingBox& bbox_curr_prior_tight,
+                                                                const cv::Mat& image_prev,
+                                                                const BoundingBox& bbox_prev_tight) {
+  return async_.Start(image_curr, bbox_curr_prior_tight, image_prev, bbox_prev_tight);
+}
+
+void NativeRegressor::PreprocessAsync(const size_t slot, const AsyncRegressInputs& inputs) {
+  // Crop, resize and normalize the search region and the target into the inputs of this slot.
+  async_image_inputs_[slot].resize(input_size());
+  async_target_inputs_[slot].resize(input_size());
+  CropPadResizePlanar(inputs.bbox_curr_prior_tight, inputs.image_curr, input_geometry_,
+                      mean_value_, num_channels_, &async_resample_buffers_,
+                      &async_image_inputs_[slot][0]);
+  CropPadResizePlanar(inputs.bbox_prev_tight, inputs.image_prev, input_geometry_,
+                      mean_value_, num_channels_, &async_resample_buffers_,
+                      &async_target_inputs_[slot][0]);
+}
+
+BoundingBox NativeRegressor::ForwardAsync(const size_t slot) {
+  // Run the network directly on the inputs of this slot.
+  net_.Reshape(1);
+  net_.set_input(kTargetInput, &async_target_inputs_[slot][0]);
+  net_.set_input(kImageInput, &async_image_inputs_[slot][0]);
+  Estimate(1, &async_bboxes_);
+  net_.set_input(kTargetInput, NULL);
+  net_.set_input(kImageInput, NULL);
+  return async_bboxes_[0];
+}
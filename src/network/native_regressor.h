@@ -0,0 +1,112 @@
+#ifndef NATIVE_REGRESSOR_H
+#define NATIVE_REGRESSOR_H
+
+#include <opencv2/core/core.hpp>
+#include <boost/thread/future.hpp>
+#include <string>
+#include <vector>
+
+#include "helper/bounding_box.h"
+#include "helper/image_proc.h"
+#include "helper/thread_pool.h"
+#include "network/async_regress_helper.h"
+#include "network/cpu_regressor_base.h"
+#include "network/native_net.h"
+#include "network/quantization.h"
+#include "network/weight_file.h"
+
+// Runs the tracking network on the CPU with NativeNet, without depending on Caffe.
+// Computes the same output as Regressor (up to floating-point rounding), from the same
+// deploy prototxt and either the .caffemodel or a weight file converted from it.
+class NativeRegressor : public CpuRegressorBase, private AsyncRegressStages {
+ public:
+  // Set up a network with the architecture specified in deploy_proto, with the model
+  // weights in weights_path (a .caffemodel or a weight file, see network/weight_file.h).
+  // Each forward pass runs on num_threads threads (0 = one per CPU).
+  NativeRegressor(const std::string& deploy_proto,
+                  const std::string& weights_path,
+                  const size_t num_threads);
+
+  // Waits for the estimates started with RegressAsync.
+  virtual ~NativeRegressor();
+
+  // The single-image methods are those of CpuRegressorBase.
+  using CpuRegressorBase::RegressFromFullImages;
+
+  // Estimate the locations of multiple target objects in a single batched forward pass.
+  virtual void RegressFromFullImages(const std::vector<cv::Mat>& images_curr,
+                                     const std::vector<BoundingBox>& bboxes_curr_prior_tight,
+                                     const std::vector<cv::Mat>& images_prev,
+                                     const std::vector<BoundingBox>& bboxes_prev_tight,
+                                     std::vector<BoundingBox>* bboxes);
+
+  // Start estimating the location of the target object, as RegressFromFullImages does.
+  // The estimates are double-buffered (see network/async_regress_helper.h), with a set of
+  // network inputs for each slot that the network runs on directly.  The other methods that
+  // run the network wait for all estimates in progress before running.
+  virtual boost::shared_future<BoundingBox> RegressAsync(const cv::Mat& image_curr,
+                                                         const BoundingBox& bbox_curr_prior_tight,
+                                                         const cv::Mat& image_prev,
+                                                         const BoundingBox& bbox_prev_tight);
+
+  // If calibration is not NULL, record the input range of each fully-connected layer into
+  // calibration on every forward pass (to choose the scales for quantizing those layers).
+  void set_calibration(QuantizationTable* calibration) { calibration_ = calibration; }
+
+ protected:
+  // Set up the network as above, running the fully-connected layers whose inputs have been
+  // calibrated in quantization with 8-bit weights and inputs.
+  NativeRegressor(const std::string& deploy_proto,
+                  const std::string& weights_path,
+                  const size_t num_threads,
+                  const QuantizationTable& quantization);
+
+ private:
+  // Set up the network, quantizing the layers in quantization (if not NULL).
+  void SetupNetwork(const std::string& deploy_proto,
+                    const std::string& weights_path,
+                    const QuantizationTable* quantization);
+
+  // Wait for the estimates started with RegressAsync, shape the network for a single image,
+  // and point the inputs into it.
+  virtual void ReshapeSingle();
+
+  // Run the network on the inputs for a single image (or on target instead of the target input).
+  virtual void EstimateSingle(const float* target, BoundingBox* bbox);
+
+  // Run the network on the inputs that have been set for num_images images,
+  // and wrap the output for each image in a bounding box.
+  void Estimate(const size_t num_images, std::vector<BoundingBox>* bboxes);
+
+  // Run the layers one at a time, recording the input range of each fully-connected layer.
+  void ForwardCalibrate();
+
+  // Stages of RegressAsync (see AsyncRegressStages).
+  virtual void PreprocessAsync(const size_t slot, const AsyncRegressInputs& inputs);
+  virtual BoundingBox ForwardAsync(const size_t slot);
+
+  // The model weights (which the network points into).
+  WeightFile weights_;
+
+  // Threads that run the layers of the network.
+  ThreadPool thread_pool_;
+
+  NativeNet net_;
+
+  // Input ranges recorded on each forward pass (if not NULL).
+  QuantizationTable* calibration_;
+
+  // Estimates of the last forward pass (reused across frames).
+  std::vector<BoundingBox> bboxes_;
+
+  // Network inputs of each slot of RegressAsync, and the buffers of its helper threads.
+  std::vector<float> async_target_inputs_[AsyncRegressHelper::kNumSlots];
+  std::vector<float> async_image_inputs_[AsyncRegressHelper::kNumSlots];
+  ResampleBuffers async_resample_buffers_;
+  std::vector<BoundingBox> async_bboxes_;
+
+  // Runs the estimates started with RegressAsync.
+  AsyncRegressHelper async_;
+};
+
+#endif // NATIVE_REGRESSOR_H
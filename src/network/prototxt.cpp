@@ -0,0 +1,187 @@
+#include "prototxt.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Skip whitespace and comments.
+void SkipSpace(const std::string& text, size_t* pos) {
+  while (*pos < text.size()) {
+    if (isspace(text[*pos])) {
+      (*pos)++;
+    } else if (text[*pos] == '#') {
+      while (*pos < text.size() && text[*pos] != '\n') {
+        (*pos)++;
+      }
+    } else {
+      break;
+    }
+  }
+}
+
+// Read a field name, number or enum value.
+std::string ReadWord(const std::string& text, size_t* pos) {
+  const size_t begin = *pos;
+  while (*pos < text.size() && (isalnum(text[*pos]) || text[*pos] == '_' || text[*pos] == '-' ||
+                                text[*pos] == '+' || text[*pos] == '.')) {
+    (*pos)++;
+  }
+  return text.substr(begin, *pos - begin);
+}
+
+// Read a quoted string (starting at the opening quote).  Returns false if it is not terminated.
+bool ReadString(const std::string& text, size_t* pos, std::string* value) {
+  const char quote = text[*pos];
+  (*pos)++;
+  value->clear();
+  while (*pos < text.size() && text[*pos] != quote) {
+    if (text[*pos] == '\\' && *pos + 1 < text.size()) {
+      (*pos)++;
+    }
+    value->push_back(text[*pos]);
+    (*pos)++;
+  }
+  if (*pos >= text.size()) {
+    return false;
+  }
+  (*pos)++;
+  return true;
+}
+
+} // namespace
+
+PrototxtMessage::PrototxtMessage()
+{
+}
+
+bool PrototxtMessage::ParseFile(const std::string& path) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    printf("Error - could not open %s\n", path.c_str());
+    return false;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  if (!Parse(text.str())) {
+    printf("Error - could not parse %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool PrototxtMessage::Parse(const std::string& text) {
+  values_.clear();
+  messages_.clear();
+  size_t pos = 0;
+  return ParseFields(text, &pos, false);
+}
+
+bool PrototxtMessage::ParseFields(const std::string& text, size_t* pos, const bool nested) {
+  while (true) {
+    SkipSpace(text, pos);
+    if (*pos >= text.size()) {
+      // Only the top-level message may end at the end of the text.
+      return !nested;
+    }
+    if (text[*pos] == '}') {
+      (*pos)++;
+      return nested;
+    }
+
+    // Read the field name.
+    const std::string& name = ReadWord(text, pos);
+    if (name.empty()) {
+      return false;
+    }
+    SkipSpace(text, pos);
+
+    // The colon is optional before a nested message.
+    if (*pos < text.size() && text[*pos] == ':') {
+      (*pos)++;
+      SkipSpace(text, pos);
+    }
+    if (*pos >= text.size()) {
+      return false;
+    }
+
+    if (text[*pos] == '{') {
+      // Nested message.
+      (*pos)++;
+      boost::shared_ptr<PrototxtMessage> message(new PrototxtMessage);
+      if (!message->ParseFields(text, pos, true)) {
+        return false;
+      }
+      messages_.push_back(std::make_pair(name, message));
+    } else if (text[*pos] == '"' || text[*pos] == '\'') {
+      // String value.
+      std::string value;
+      if (!ReadString(text, pos, &value)) {
+        return false;
+      }
+      values_.push_back(std::make_pair(name, value));
+    } else {
+      // Number or enum value.
+      const std::string& value = ReadWord(text, pos);
+      if (value.empty()) {
+        return false;
+      }
+      values_.push_back(std::make_pair(name, value));
+    }
+  }
+}
+
+bool PrototxtMessage::Has(const std::string& name) const {
+  return !GetValues(name).empty() || GetMessage(name) != NULL;
+}
+
+std::vector<std::string> PrototxtMessage::GetValues(const std::string& name) const {
+  std::vector<std::string> values;
+  for (size_t i = 0; i < values_.size(); ++i) {
+    if (values_[i].first == name) {
+      values.push_back(values_[i].second);
+    }
+  }
+  return values;
+}
+
+std::string PrototxtMessage::GetString(const std::string& name, const std::string& default_value) const {
+  for (size_t i = 0; i < values_.size(); ++i) {
+    if (values_[i].first == name) {
+      return values_[i].second;
+    }
+  }
+  return default_value;
+}
+
+int PrototxtMessage::GetInt(const std::string& name, const int default_value) const {
+  const std::string& value = GetString(name, "");
+  return value.empty() ? default_value : atoi(value.c_str());
+}
+
+float PrototxtMessage::GetFloat(const std::string& name, const float default_value) const {
+  const std::string& value = GetString(name, "");
+  return value.empty() ? default_value : atof(value.c_str());
+}
+
+std::vector<const PrototxtMessage*> PrototxtMessage::GetMessages(const std::string& name) const {
+  std::vector<const PrototxtMessage*> messages;
+  for (size_t i = 0; i < messages_.size(); ++i) {
+    if (messages_[i].first == name) {
+      messages.push_back(messages_[i].second.get());
+    }
+  }
+  return messages;
+}
+
+const PrototxtMessage* PrototxtMessage::GetMessage(const std::string& name) const {
+  for (size_t i = 0; i < messages_.size(); ++i) {
+    if (messages_[i].first == name) {
+      return messages_[i].second.get();
+    }
+  }
+  return NULL;
+}
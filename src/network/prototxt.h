@@ -0,0 +1,53 @@
+#ifndef PROTOTXT_H
+#define PROTOTXT_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+// A message read from a protobuf text file (such as a Caffe .prototxt), parsed
+// without the message definitions, so that the network architecture can be read
+// without depending on Caffe or protobuf.
+// Each field is either a value ("name: value") or a nested message ("name { ... }").
+class PrototxtMessage
+{
+public:
+  PrototxtMessage();
+
+  // Parse the text file at path.  Returns false if it cannot be read or parsed.
+  bool ParseFile(const std::string& path);
+
+  // Parse the given text.  Returns false if it cannot be parsed.
+  bool Parse(const std::string& text);
+
+  // Whether there is a value or a message with the given name.
+  bool Has(const std::string& name) const;
+
+  // All values of the fields with the given name, in order (with quotes removed from strings).
+  std::vector<std::string> GetValues(const std::string& name) const;
+
+  // Value of the first field with the given name, or default_value if there is none.
+  std::string GetString(const std::string& name, const std::string& default_value) const;
+  int GetInt(const std::string& name, const int default_value) const;
+  float GetFloat(const std::string& name, const float default_value) const;
+
+  // All nested messages with the given name, in order.
+  std::vector<const PrototxtMessage*> GetMessages(const std::string& name) const;
+
+  // First nested message with the given name, or NULL if there is none.
+  const PrototxtMessage* GetMessage(const std::string& name) const;
+
+private:
+  // Parse fields from text starting at *pos, until the end of the text or a closing brace.
+  bool ParseFields(const std::string& text, size_t* pos, const bool nested);
+
+  // Fields with values, as (name, value) pairs.
+  std::vector<std::pair<std::string, std::string> > values_;
+
+  // Nested messages, as (name, message) pairs.
+  std::vector<std::pair<std::string, boost::shared_ptr<PrototxtMessage> > > messages_;
+};
+
+#endif // PROTOTXT_H
@@ -0,0 +1,65 @@
+#include "quantization.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+QuantizationTable::QuantizationTable()
+{
+}
+
+void QuantizationTable::AddRange(const std::string& layer_name, const float min_value,
+                                 const float max_value) {
+  std::map<std::string, std::pair<float, float> >::iterator it = ranges_.find(layer_name);
+  if (it == ranges_.end()) {
+    ranges_[layer_name] = std::make_pair(min_value, max_value);
+  } else {
+    it->second.first = std::min(it->second.first, min_value);
+    it->second.second = std::max(it->second.second, max_value);
+  }
+}
+
+bool QuantizationTable::GetRange(const std::string& layer_name, float* min_value,
+                                 float* max_value) const {
+  std::map<std::string, std::pair<float, float> >::const_iterator it = ranges_.find(layer_name);
+  if (it == ranges_.end()) {
+    return false;
+  }
+  *min_value = it->second.first;
+  *max_value = it->second.second;
+  return true;
+}
+
+bool QuantizationTable::Load(const std::string& path) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    printf("Error - could not open calibration file %s\n", path.c_str());
+    return false;
+  }
+
+  ranges_.clear();
+  std::string layer_name;
+  float min_value;
+  float max_value;
+  while (file >> layer_name >> min_value >> max_value) {
+    AddRange(layer_name, min_value, max_value);
+  }
+  if (!file.eof()) {
+    printf("Error - could not parse calibration file %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool QuantizationTable::Save(const std::string& path) const {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    printf("Error - could not open %s for writing\n", path.c_str());
+    return false;
+  }
+  for (std::map<std::string, std::pair<float, float> >::const_iterator it = ranges_.begin();
+       it != ranges_.end(); ++it) {
+    fprintf(file, "%s %.9g %.9g\n", it->first.c_str(), it->second.first, it->second.second);
+  }
+  return fclose(file) == 0;
+}
@@ -0,0 +1,38 @@
+#ifndef QUANTIZATION_H
+#define QUANTIZATION_H
+
+#include <map>
+#include <string>
+#include <utility>
+
+// Ranges of the inputs of the layers of a network, measured by running the network on
+// calibration data, from which the scales of the quantized (8-bit) inputs are chosen.
+//
+// File format (text), one line per layer:
+//   layer_name min max
+class QuantizationTable
+{
+public:
+  QuantizationTable();
+
+  // Widen the input range of the given layer to include [min_value, max_value].
+  void AddRange(const std::string& layer_name, const float min_value, const float max_value);
+
+  // Get the input range of the given layer.  Returns false if the layer has no range.
+  bool GetRange(const std::string& layer_name, float* min_value, float* max_value) const;
+
+  // Read the ranges from the file at path.  Returns false if it cannot be read.
+  bool Load(const std::string& path);
+
+  // Write the ranges to the file at path.  Returns false if it cannot be written.
+  bool Save(const std::string& path) const;
+
+  // Number of layers with a range.
+  size_t num_layers() const { return ranges_.size(); }
+
+private:
+  // Input range (min, max) of each layer.
+  std::map<std::string, std::pair<float, float> > ranges_;
+};
+
+#endif // QUANTIZATION_H
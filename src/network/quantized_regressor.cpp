@@ -0,0 +1,24 @@
+#include "quantized_regressor.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+QuantizedRegressor::QuantizedRegressor(const std::string& deploy_proto,
+                                       const std::string& weights_path,
+                                       const std::string& calibration_path,
+                                       const size_t num_threads) :
+  NativeRegressor(deploy_proto, weights_path, num_threads, LoadCalibration(calibration_path))
+{
+}
+
+QuantizationTable QuantizedRegressor::LoadCalibration(const std::string& calibration_path) {
+  QuantizationTable calibration;
+  if (!calibration.Load(calibration_path)) {
+    exit(-1);
+  }
+  if (calibration.num_layers() == 0) {
+    printf("Error - calibration file %s has no layers\n", calibration_path.c_str());
+    exit(-1);
+  }
+  return calibration;
+}
@@ -1,6 +1,16 @@
 #include "regressor.h"
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+
+#include <caffe/util/math_functions.hpp>
+
+#include "helper/allocation_counter.h"
 #include "helper/high_res_timer.h"
+#include "helper/image_proc.h"
+#include "network/weight_file.h"
 
 // Credits:
 // This file was mostly taken from:
@@ -13,6 +23,15 @@ using std::string;
 // We need 2 inputs: one for the current frame and one for the previous frame.
 const int kNumInputs = 2;
 
+// Names of the layers used to run the image branch separately from the target branch.
+const char* kImageBranchStartLayer = "conv1_p";
+const char* kConcatLayer = "concat";
+const char* kFc6Layer = "fc6-new";
+const char* kTargetFeatures = "pool5";
+
+// Name of the blob containing the estimated bounding box.
+const char* kOutputFeatures = "fc8";
+
 Regressor::Regressor(const string& deploy_proto,
                      const string& caffe_model,
                      const int gpu_id,
@@ -20,10 +39,25 @@ Regressor::Regressor(const string& deploy_proto,
                      const bool do_train)
   : num_inputs_(num_inputs),
     caffe_model_(caffe_model),
-    modified_params_(false)
-
+    modified_params_(false),
+    gpu_id_(gpu_id),
+    input_batch_size_(0),
+    output_blob_(NULL),
+    cache_target_features_(true),
+    target_cache_valid_(false),
+    target_fc6_valid_(false),
+    image_branch_start_(-1),
+    concat_layer_(-1),
+    fc6_layer_(-1),
+    in_place_concat_layer_(-1),
+    concat_in_place_(false),
+    profile_(false),
+    preprocess_stage_(-1),
+    output_stage_(-1),
+    profile_timer_("Profile", CLOCK_MONOTONIC),
+    async_(this)
 {
-  SetupNetwork(deploy_proto, caffe_model, gpu_id, do_train);
+  SetupNetwork(deploy_proto, caffe_model, gpu_id, do_train, NULL);
 }
 
 Regressor::Regressor(const string& deploy_proto,
@@ -32,33 +66,98 @@ Regressor::Regressor(const string& deploy_proto,
                      const bool do_train)
   : num_inputs_(kNumInputs),
     caffe_model_(caffe_model),
-    modified_params_(false)
+    modified_params_(false),
+    gpu_id_(gpu_id),
+    input_batch_size_(0),
+    output_blob_(NULL),
+    cache_target_features_(true),
+    target_cache_valid_(false),
+    target_fc6_valid_(false),
+    image_branch_start_(-1),
+    concat_layer_(-1),
+    fc6_layer_(-1),
+    in_place_concat_layer_(-1),
+    concat_in_place_(false),
+    profile_(false),
+    preprocess_stage_(-1),
+    output_stage_(-1),
+    profile_timer_("Profile", CLOCK_MONOTONIC),
+    async_(this)
+{
+  SetupNetwork(deploy_proto, caffe_model, gpu_id, do_train, NULL);
+}
+
+Regressor::Regressor(const string& deploy_proto,
+                     const Regressor& shared_weights,
+                     const int gpu_id)
+  : num_inputs_(shared_weights.num_inputs_),
+    caffe_model_(shared_weights.caffe_model_),
+    modified_params_(false),
+    gpu_id_(gpu_id),
+    input_batch_size_(0),
+    output_blob_(NULL),
+    cache_target_features_(true),
+    target_cache_valid_(false),
+    target_fc6_valid_(false),
+    image_branch_start_(-1),
+    concat_layer_(-1),
+    fc6_layer_(-1),
+    in_place_concat_layer_(-1),
+    concat_in_place_(false),
+    profile_(false),
+    preprocess_stage_(-1),
+    output_stage_(-1),
+    profile_timer_("Profile", CLOCK_MONOTONIC),
+    async_(this)
 {
-  SetupNetwork(deploy_proto, caffe_model, gpu_id, do_train);
+  const bool do_train = false;
+  SetupNetwork(deploy_proto, caffe_model_, gpu_id, do_train, shared_weights.net_.get());
+}
+
+Regressor::~Regressor() {
+  async_.Stop();
 }
 
 void Regressor::SetupNetwork(const string& deploy_proto,
                              const string& caffe_model,
                              const int gpu_id,
-                             const bool do_train) {
+                             const bool do_train,
+                             const Net<float>* shared_net) {
 #ifdef CPU_ONLY
   printf("Setting up Caffe in CPU mode\n");
-  caffe::Caffe::set_mode(caffe::Caffe::CPU);
 #else
   printf("Setting up Caffe in GPU mode with ID: %d\n", gpu_id);
-  caffe::Caffe::SetDevice(gpu_id);
-  caffe::Caffe::set_mode(caffe::Caffe::GPU);
 #endif
+  SetCaffeMode();
 
+  // Read the network architecture.
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(deploy_proto, &net_param);
   if (do_train) {
     printf("Setting phase to train\n");
-    net_.reset(new Net<float>(deploy_proto, caffe::TRAIN));
+    net_param.mutable_state()->set_phase(caffe::TRAIN);
   } else {
     printf("Setting phase to test\n");
-    net_.reset(new Net<float>(deploy_proto, caffe::TEST));
+    net_param.mutable_state()->set_phase(caffe::TEST);
+
+    // Remove the layers that do nothing when tracking.
+    OptimizeForInference(&net_param);
   }
 
-  if (caffe_model != "NONE") {
+  // If the weights will be replaced without being copied, skip their (slow) random initialization.
+  const bool is_weight_file = WeightFile::IsWeightFile(caffe_model);
+  if (shared_net || is_weight_file) {
+    SkipWeightInitialization(&net_param);
+  }
+  net_.reset(new Net<float>(net_param));
+
+  if (shared_net) {
+    printf("Sharing the weights of an existing network\n");
+    ShareWeights(shared_net);
+  } else if (is_weight_file) {
+    printf("Mapping weight file %s\n", caffe_model.c_str());
+    MapWeights(caffe_model);
+  } else if (caffe_model != "NONE") {
     net_->CopyTrainedLayersFrom(caffe_model_);
   } else {
     printf("Not initializing network from pre-trained model\n");
@@ -78,18 +177,311 @@ void Regressor::SetupNetwork(const string& deploy_proto,
 
   // Load the binaryproto mean file.
   SetMean();
+
+  // Get the output blob once, rather than looking it up by name on every frame.
+  output_blob_ = net_->blob_by_name(kOutputFeatures).get();
+
+  // Find the layers needed to reuse the target-branch features.
+  SetupTargetCache();
+
+  // Find whether the concat layer can be skipped.
+  SetupInPlaceConcat();
+
+  // Set up the stages to profile: each layer, then the preprocessing and output.
+  const std::vector<string>& layer_names = net_->layer_names();
+  for (size_t i = 0; i < layer_names.size(); ++i) {
+    profiler_.AddStage(layer_names[i]);
+  }
+  preprocess_stage_ = profiler_.AddStage("preprocess");
+  output_stage_ = profiler_.AddStage("output");
+}
+
+void Regressor::SetupTargetCache() {
+  const std::vector<string>& layer_names = net_->layer_names();
+  for (int i = 0; i < layer_names.size(); ++i) {
+    if (layer_names[i] == kImageBranchStartLayer) {
+      image_branch_start_ = i;
+    } else if (layer_names[i] == kConcatLayer) {
+      concat_layer_ = i;
+    } else if (layer_names[i] == kFc6Layer) {
+      fc6_layer_ = i;
+    }
+  }
+
+  if (image_branch_start_ < 0 || !net_->has_blob(kTargetFeatures)) {
+    printf("Network has no separate image branch; target features will not be cached\n");
+    image_branch_start_ = -1;
+    concat_layer_ = -1;
+    fc6_layer_ = -1;
+    return;
+  }
+
+  // To split fc6, the concat layer must directly feed fc6 and the target features must be
+  // the first half of the concatenation.
+  const Blob<float>* target_features = net_->blob_by_name(kTargetFeatures).get();
+  if (concat_layer_ < image_branch_start_ || fc6_layer_ != concat_layer_ + 1 ||
+      net_->bottom_vecs()[concat_layer_].size() != 2 ||
+      net_->bottom_vecs()[concat_layer_][0] != target_features ||
+      net_->bottom_vecs()[fc6_layer_][0] != net_->top_vecs()[concat_layer_][0] ||
+      net_->layers()[fc6_layer_]->blobs().size() != 2) {
+    concat_layer_ = -1;
+    fc6_layer_ = -1;
+  }
+}
+
+void Regressor::SetupInPlaceConcat() {
+  in_place_concat_layer_ = -1;
+  if (net_->phase() != caffe::TEST) {
+    return;
+  }
+
+  const std::vector<string>& layer_names = net_->layer_names();
+  const std::vector<boost::shared_ptr<caffe::Layer<float> > >& layers = net_->layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    if (layer_names[i] != kConcatLayer) {
+      continue;
+    }
+
+    // For a single image, concatenating along the channels places the inputs one after another.
+    const caffe::ConcatParameter& concat_param = layers[i]->layer_param().concat_param();
+    if (string(layers[i]->type()) != "Concat" || concat_param.axis() != 1 ||
+        concat_param.has_concat_dim()) {
+      return;
+    }
+
+    // Each input must be computed by a layer of its own (a Split layer shares its output with its
+    // input, and a network input is set from outside), and must not be changed after the concat.
+    const std::vector<Blob<float>*>& bottoms = net_->bottom_vecs()[i];
+    for (size_t j = 0; j < bottoms.size(); ++j) {
+      const std::vector<Blob<float>*>& inputs = net_->input_blobs();
+      if (std::find(inputs.begin(), inputs.end(), bottoms[j]) != inputs.end()) {
+        return;
+      }
+      for (int k = 0; k < layers.size(); ++k) {
+        const std::vector<Blob<float>*>& tops = net_->top_vecs()[k];
+        if (std::find(tops.begin(), tops.end(), bottoms[j]) != tops.end() &&
+            (k > i || string(layers[k]->type()) == "Split")) {
+          return;
+        }
+      }
+    }
+    in_place_concat_layer_ = i;
+    return;
+  }
+}
+
+void Regressor::UpdateInPlaceConcat() {
+  concat_in_place_ = false;
+  if (in_place_concat_layer_ < 0 || input_batch_size_ != 1 ||
+      caffe::Caffe::mode() != caffe::Caffe::CPU) {
+    return;
+  }
+
+  // Point each input at its part of the output.  (When the network is reshaped for more images,
+  // the inputs outgrow the memory they point to and get memory of their own again.)
+  Blob<float>* concat = net_->top_vecs()[in_place_concat_layer_][0];
+  float* concat_data = concat->mutable_cpu_data();
+  const std::vector<Blob<float>*>& bottoms = net_->bottom_vecs()[in_place_concat_layer_];
+  int offset = 0;
+  for (size_t i = 0; i < bottoms.size(); ++i) {
+    bottoms[i]->set_cpu_data(concat_data + offset);
+    offset += bottoms[i]->count();
+  }
+  CHECK_EQ(offset, concat->count()) << "Concat output size does not match its inputs.";
+
+  // Any target-branch features computed before are no longer in the output.
+  target_cache_valid_ = false;
+  concat_in_place_ = true;
+}
+
+void Regressor::ShareWeights(const Net<float>* shared_net) {
+  // Point the parameter blobs of each layer at the parameters of shared_net.
+  // (The weights allocated when building the network are freed.)
+  net_->ShareTrainedLayersWith(shared_net);
+
+  // Copy the shared weights to the device (if needed) now, so that regressors on different
+  // threads do not all try to do so at once during their first forward pass.
+  const std::vector<boost::shared_ptr<caffe::Layer<float> > >& layers = net_->layers();
+  for (size_t i = 0; i < layers.size(); ++i) {
+    const std::vector<boost::shared_ptr<Blob<float> > >& blobs = layers[i]->blobs();
+    for (size_t j = 0; j < blobs.size(); ++j) {
+#ifdef CPU_ONLY
+      blobs[j]->cpu_data();
+#else
+      blobs[j]->gpu_data();
+#endif
+    }
+  }
+}
+
+void Regressor::MapWeights(const string& weight_file_path) {
+  weight_file_.reset(new WeightFile);
+  CHECK(weight_file_->Open(weight_file_path)) << "Could not map weight file " << weight_file_path;
+
+  // Point the parameter blobs of each layer into the mapped file.
+  const std::vector<string>& layer_names = net_->layer_names();
+  const std::vector<boost::shared_ptr<caffe::Layer<float> > >& layers = net_->layers();
+  for (size_t i = 0; i < layers.size(); ++i) {
+    const std::vector<boost::shared_ptr<Blob<float> > >& blobs = layers[i]->blobs();
+    for (size_t j = 0; j < blobs.size(); ++j) {
+      const WeightBlob* weight_blob = weight_file_->FindBlob(layer_names[i], j);
+      CHECK(weight_blob) << "Weight file has no blob " << j << " for layer " << layer_names[i];
+      CHECK(weight_blob->shape == blobs[j]->shape())
+          << "Weight file has the wrong shape for blob " << j << " of layer " << layer_names[i];
+
+      // The mapping is copy-on-write, so the network may write to its weights (when training).
+      // (The weights allocated when building the network are freed.)
+      blobs[j]->set_cpu_data(const_cast<float*>(weight_blob->data));
+    }
+  }
+}
+
+void Regressor::SkipWeightInitialization(caffe::NetParameter* net_param) {
+  // Initializing the weights to a constant is much faster than filling them with random values.
+  for (int i = 0; i < net_param->layer_size(); ++i) {
+    caffe::LayerParameter* layer_param = net_param->mutable_layer(i);
+    if (layer_param->has_convolution_param()) {
+      layer_param->mutable_convolution_param()->mutable_weight_filler()->set_type("constant");
+      layer_param->mutable_convolution_param()->mutable_bias_filler()->set_type("constant");
+    }
+    if (layer_param->has_inner_product_param()) {
+      layer_param->mutable_inner_product_param()->mutable_weight_filler()->set_type("constant");
+      layer_param->mutable_inner_product_param()->mutable_bias_filler()->set_type("constant");
+    }
+  }
+}
+
+void Regressor::OptimizeForInference(caffe::NetParameter* net_param) {
+  // Keep only the layers run in the TEST phase.
+  caffe::NetParameter test_param;
+  Net<float>::FilterNet(*net_param, &test_param);
+
+  // Remove Dropout.  The layers after a Dropout that does not run in place read its input instead.
+  std::vector<caffe::LayerParameter> layers;
+  std::map<string, string> renamed_blobs;
+  for (int i = 0; i < test_param.layer_size(); ++i) {
+    caffe::LayerParameter layer_param = test_param.layer(i);
+
+    // An output with the name of a removed Dropout's output is renamed too if the layer runs in
+    // place on it; otherwise it is a new blob, and later layers read it under its own name.
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      const std::map<string, string>::iterator renamed = renamed_blobs.find(layer_param.top(j));
+      if (renamed == renamed_blobs.end()) {
+        continue;
+      }
+      bool in_place = false;
+      for (int k = 0; k < layer_param.bottom_size(); ++k) {
+        in_place = in_place || layer_param.bottom(k) == layer_param.top(j);
+      }
+      if (in_place) {
+        layer_param.set_top(j, renamed->second);
+      } else {
+        renamed_blobs.erase(renamed);
+      }
+    }
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      const std::map<string, string>::const_iterator renamed =
+          renamed_blobs.find(layer_param.bottom(j));
+      if (renamed != renamed_blobs.end()) {
+        layer_param.set_bottom(j, renamed->second);
+      }
+    }
+
+    if (layer_param.type() == "Dropout" && layer_param.bottom_size() == 1 &&
+        layer_param.top_size() == 1) {
+      if (layer_param.top(0) != layer_param.bottom(0)) {
+        renamed_blobs[layer_param.top(0)] = layer_param.bottom(0);
+      }
+      continue;
+    }
+    layers.push_back(layer_param);
+  }
+
+  // Find the layers needed to compute the output, walking backwards from the output:
+  // a layer is needed if one of its outputs is needed, and then its inputs are needed too.
+  std::set<string> needed_blobs;
+  needed_blobs.insert(kOutputFeatures);
+  std::vector<bool> layer_needed(layers.size(), false);
+  bool has_output = false;
+  for (int i = static_cast<int>(layers.size()) - 1; i >= 0; --i) {
+    for (int j = 0; j < layers[i].top_size(); ++j) {
+      layer_needed[i] = layer_needed[i] || needed_blobs.count(layers[i].top(j)) > 0;
+    }
+    if (layer_needed[i]) {
+      for (int j = 0; j < layers[i].bottom_size(); ++j) {
+        needed_blobs.insert(layers[i].bottom(j));
+      }
+      has_output = true;
+    }
+  }
+
+  // Keep all layers of a network without the usual output.
+  if (!has_output) {
+    printf("Network has no %s output; not removing unneeded layers\n", kOutputFeatures);
+    layer_needed.assign(layers.size(), true);
+  }
+
+  // Keep the inputs and layers that are needed.
+  net_param->CopyFrom(test_param);
+  net_param->clear_input();
+  net_param->clear_input_shape();
+  net_param->clear_input_dim();
+  for (int i = 0; i < test_param.input_size(); ++i) {
+    if (has_output && !needed_blobs.count(test_param.input(i))) {
+      printf("Removing unneeded input %s\n", test_param.input(i).c_str());
+      continue;
+    }
+    net_param->add_input(test_param.input(i));
+    if (i < test_param.input_shape_size()) {
+      net_param->add_input_shape()->CopyFrom(test_param.input_shape(i));
+    }
+    for (int j = 4 * i; j < 4 * (i + 1) && j < test_param.input_dim_size(); ++j) {
+      net_param->add_input_dim(test_param.input_dim(j));
+    }
+  }
+  net_param->clear_layer();
+  for (size_t i = 0; i < layers.size(); ++i) {
+    if (layer_needed[i]) {
+      net_param->add_layer()->CopyFrom(layers[i]);
+    }
+  }
+  printf("Removed %d of %d layers not needed for inference\n",
+         test_param.layer_size() - net_param->layer_size(), test_param.layer_size());
+}
+
+void Regressor::SetCaffeMode() {
+#ifdef CPU_ONLY
+  caffe::Caffe::set_mode(caffe::Caffe::CPU);
+#else
+  caffe::Caffe::SetDevice(gpu_id_);
+  caffe::Caffe::set_mode(caffe::Caffe::GPU);
+#endif
 }
 
 void Regressor::SetMean() {
   // Set the mean image.
-  mean_ = cv::Mat(input_geometry_, CV_32FC3, cv::Scalar(104, 117, 123));
+  mean_value_ = cv::Scalar(104, 117, 123);
+  mean_ = cv::Mat(input_geometry_, CV_32FC3, mean_value_);
 }
 
 void Regressor::Init() {
+  async_.Wait();
+
+  // This may be a different thread from the one that set up the network.
+  SetCaffeMode();
+
   if (modified_params_ ) {
     printf("Reloading new params\n");
-    net_->CopyTrainedLayersFrom(caffe_model_);
+    if (weight_file_) {
+      // Map the weight file again, to discard the pages written to.
+      MapWeights(caffe_model_);
+    } else {
+      net_->CopyTrainedLayersFrom(caffe_model_);
+    }
     modified_params_ = false;
+
+    // The cached target features were computed with the old parameters.
+    target_cache_valid_ = false;
   }
 }
 
@@ -97,6 +489,7 @@ void Regressor::Regress(const cv::Mat& image_curr,
                         const cv::Mat& image, const cv::Mat& target,
                         BoundingBox* bbox) {
   assert(net_->phase() == caffe::TEST);
+  async_.Wait();
 
   // Estimate the bounding box location of the target object in the current image.
   std::vector<float> estimation;
@@ -106,23 +499,139 @@ void Regressor::Regress(const cv::Mat& image_curr,
   *bbox = BoundingBox(estimation);
 }
 
-void Regressor::Estimate(const cv::Mat& image, const cv::Mat& target, std::vector<float>* output) {
+void Regressor::RegressFromFullImages(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                      const cv::Mat& image_prev, const BoundingBox& bbox_prev_tight,
+                                      BoundingBox* bbox) {
   assert(net_->phase() == caffe::TEST);
+  async_.Wait();
 
   // Reshape the input blobs to be the appropriate size.
-  Blob<float>* input_target = net_->input_blobs()[0];
-  input_target->Reshape(1, num_channels_,
-                       input_geometry_.height, input_geometry_.width);
+  ReshapeInputs(1);
 
-  Blob<float>* input_image = net_->input_blobs()[1];
-  input_image->Reshape(1, num_channels_,
-                       input_geometry_.height, input_geometry_.width);
+  // Crop, resize and normalize the search region and the target, writing them directly
+  // to the input layers of the network.
+  StartProfile();
+  CropPadResizePlanar(bbox_curr_prior_tight, image_curr, input_geometry_, mean_value_,
+                      num_channels_, &resample_buffers_, net_->input_blobs()[1]->mutable_cpu_data());
+  CropPadResizePlanar(bbox_prev_tight, image_prev, input_geometry_, mean_value_,
+                      num_channels_, &resample_buffers_, net_->input_blobs()[0]->mutable_cpu_data());
+  StopProfile(preprocess_stage_);
 
-  Blob<float>* input_bbox = net_->input_blobs()[2];
-  input_bbox->Reshape(1, 4, 1, 1);
+  // Estimate the bounding box location of the target object in the current image.
+  ForwardSingle(&estimation_);
 
-  // Forward dimension change to all layers.
-  net_->Reshape();
+  // Wrap the estimation in a bounding box object.
+  *bbox = BoundingBox(estimation_);
+}
+
+void Regressor::PrepareTarget(const cv::Mat& image, const BoundingBox& bbox_tight,
+                              PreparedTarget* target) {
+  // Crop, resize and normalize the target into the form of the network input.
+  const size_t input_size = num_channels_ * input_geometry_.width * input_geometry_.height;
+  target->input.resize(input_size);
+  CropPadResizePlanar(bbox_tight, image, input_geometry_, mean_value_, num_channels_,
+                      &resample_buffers_, &target->input[0]);
+}
+
+void Regressor::RegressFromTarget(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                  const PreparedTarget& target, BoundingBox* bbox) {
+  assert(net_->phase() == caffe::TEST);
+  async_.Wait();
+
+  const size_t input_size = num_channels_ * input_geometry_.width * input_geometry_.height;
+  if (target.input.size() != input_size) {
+    printf("Error - the prepared target has %zu values but the network input has %zu\n",
+           target.input.size(), input_size);
+    return;
+  }
+
+  // Reshape the input blobs to be the appropriate size.
+  ReshapeInputs(1);
+
+  // Crop, resize and normalize the search region, writing it directly to the input layer of
+  // the network, and copy the prepared target to the other input layer.
+  StartProfile();
+  CropPadResizePlanar(bbox_curr_prior_tight, image_curr, input_geometry_, mean_value_,
+                      num_channels_, &resample_buffers_, net_->input_blobs()[1]->mutable_cpu_data());
+  std::copy(target.input.begin(), target.input.end(), net_->input_blobs()[0]->mutable_cpu_data());
+  StopProfile(preprocess_stage_);
+
+  // Estimate the bounding box location of the target object in the current image.
+  // (When the target features are cached, the prepared target is recognized as unchanged).
+  ForwardSingle(&estimation_);
+
+  // Wrap the estimation in a bounding box object.
+  *bbox = BoundingBox(estimation_);
+}
+
+void Regressor::RegressFromFullImages(const std::vector<cv::Mat>& images_curr,
+                                      const std::vector<BoundingBox>& bboxes_curr_prior_tight,
+                                      const std::vector<cv::Mat>& images_prev,
+                                      const std::vector<BoundingBox>& bboxes_prev_tight,
+                                      std::vector<BoundingBox>* bboxes) {
+  assert(net_->phase() == caffe::TEST);
+  async_.Wait();
+
+  const size_t num_images = images_curr.size();
+  if (images_prev.size() != num_images || bboxes_curr_prior_tight.size() != num_images ||
+      bboxes_prev_tight.size() != num_images) {
+    printf("Error - %zu images but %zu previous images, %zu priors and %zu targets\n",
+           num_images, images_prev.size(), bboxes_curr_prior_tight.size(), bboxes_prev_tight.size());
+    return;
+  }
+
+  bboxes->resize(num_images);
+  if (num_images == 0) {
+    return;
+  }
+
+  // A single target can use the single-image path (and its cached target features).
+  if (num_images == 1) {
+    RegressFromFullImages(images_curr[0], bboxes_curr_prior_tight[0],
+                          images_prev[0], bboxes_prev_tight[0], &(*bboxes)[0]);
+    return;
+  }
+
+  // The target-branch activations are about to be overwritten.
+  target_cache_valid_ = false;
+
+  // Reshape the input blobs to hold all of the images.
+  ReshapeInputs(num_images);
+
+  // Crop, resize and normalize each search region and target, writing them directly
+  // to their place in the input layers of the network.
+  const int input_size = num_channels_ * input_geometry_.width * input_geometry_.height;
+  float* image_data = net_->input_blobs()[1]->mutable_cpu_data();
+  float* target_data = net_->input_blobs()[0]->mutable_cpu_data();
+  StartProfile();
+  for (size_t i = 0; i < num_images; ++i) {
+    CropPadResizePlanar(bboxes_curr_prior_tight[i], images_curr[i], input_geometry_, mean_value_,
+                        num_channels_, &resample_buffers_, image_data + i * input_size);
+    CropPadResizePlanar(bboxes_prev_tight[i], images_prev[i], input_geometry_, mean_value_,
+                        num_channels_, &resample_buffers_, target_data + i * input_size);
+  }
+  StopProfile(preprocess_stage_);
+
+  // Estimate the locations of all targets in a single forward pass.
+  ForwardLayers(0, net_->layers().size() - 1);
+
+  // Split the output into one bounding box per target.
+  StartProfile();
+  GetOutput(&estimation_);
+  const size_t bbox_size = estimation_.size() / num_images;
+  for (size_t i = 0; i < num_images; ++i) {
+    bbox_estimation_.assign(estimation_.begin() + i * bbox_size,
+                            estimation_.begin() + (i + 1) * bbox_size);
+    (*bboxes)[i] = BoundingBox(bbox_estimation_);
+  }
+  StopProfile(output_stage_);
+}
+
+void Regressor::Estimate(const cv::Mat& image, const cv::Mat& target, std::vector<float>* output) {
+  assert(net_->phase() == caffe::TEST);
+
+  // Reshape the input blobs to be the appropriate size.
+  ReshapeInputs(1);
 
   // Process the inputs so we can set them.
   std::vector<cv::Mat> target_channels;
@@ -130,14 +639,174 @@ void Regressor::Estimate(const cv::Mat& image, const cv::Mat& target, std::vecto
   WrapInputLayer(&target_channels, &image_channels);
 
   // Set the inputs to the network.
+  StartProfile();
   Preprocess(image, &image_channels);
   Preprocess(target, &target_channels);
+  StopProfile(preprocess_stage_);
 
-  // Perform a forward-pass in the network.
-  net_->ForwardPrefilled();
+  // Perform a forward-pass in the network and get the output.
+  ForwardSingle(output);
+}
+
+void Regressor::ForwardLayers(const int start, const int end) {
+  // Skip the concat layer if its inputs were computed in its output.
+  if (concat_in_place_ && start <= in_place_concat_layer_ && in_place_concat_layer_ <= end) {
+    if (start < in_place_concat_layer_) {
+      ForwardLayers(start, in_place_concat_layer_ - 1);
+    }
+    if (in_place_concat_layer_ < end) {
+      ForwardLayers(in_place_concat_layer_ + 1, end);
+    }
+    return;
+  }
+
+  // (Caffe layers reshape their outputs on every forward pass, which allocates some small
+  // temporary shape vectors inside Caffe, so a forward pass is not free of allocations.)
+  if (!profile_) {
+    net_->ForwardFromTo(start, end);
+    return;
+  }
+
+  // Run and time each layer separately.
+  for (int i = start; i <= end; ++i) {
+    StartProfile();
+    net_->ForwardFromTo(i, i);
+    StopProfile(i);
+  }
+}
+
+void Regressor::StartProfile() {
+  if (profile_) {
+    profile_timer_.reset();
+    profile_timer_.start();
+  }
+}
+
+void Regressor::StopProfile(const int stage) {
+  if (!profile_) {
+    return;
+  }
+
+#ifndef CPU_ONLY
+  // Wait for the GPU to finish, so that its work is included in the time of this stage.
+  if (caffe::Caffe::mode() == caffe::Caffe::GPU) {
+    cudaDeviceSynchronize();
+  }
+#endif
+
+  profile_timer_.stop();
+
+  // Storing the samples allocates memory, which is not counted.
+  ScopedAllocationCounterPause pause_allocation_counter;
+  profiler_.AddSample(stage, profile_timer_.getMilliseconds());
+}
+
+void Regressor::ForwardSingle(std::vector<float>* output) {
+  if (TargetFeaturesCached()) {
+    // The target has not changed, so the target-branch features are still valid;
+    // only run the image branch and the fully-connected layers.
+    ForwardImageBranch();
+  } else {
+    // Perform a forward-pass in the network.
+    ForwardLayers(0, net_->layers().size() - 1);
+
+    // Remember which target these features were computed from.
+    CacheTargetFeatures();
+  }
 
   // Get the network output.
+  StartProfile();
   GetOutput(output);
+  StopProfile(output_stage_);
+}
+
+bool Regressor::TargetFeaturesCached() const {
+  if (!cache_target_features_ || !target_cache_valid_ || image_branch_start_ < 0) {
+    return false;
+  }
+
+  // Compare the preprocessed target with the one used to compute the cached features.
+  const Blob<float>* input_target = net_->input_blobs()[0];
+  if (input_target->count() != static_cast<int>(target_key_.size())) {
+    return false;
+  }
+  return memcmp(input_target->cpu_data(), &target_key_[0],
+                target_key_.size() * sizeof(float)) == 0;
+}
+
+void Regressor::CacheTargetFeatures() {
+  if (!cache_target_features_ || image_branch_start_ < 0) {
+    return;
+  }
+
+  const Blob<float>* input_target = net_->input_blobs()[0];
+  const float* begin = input_target->cpu_data();
+  target_key_.assign(begin, begin + input_target->count());
+  target_cache_valid_ = true;
+
+  // The target half of fc6 is computed on the first frame that reuses this target.
+  target_fc6_valid_ = false;
+}
+
+void Regressor::ForwardImageBranch() {
+  const int last_layer = net_->layers().size() - 1;
+
+  if (fc6_layer_ < 0 || caffe::Caffe::mode() != caffe::Caffe::CPU) {
+    // Run the image branch, then let the concat layer combine it with the
+    // cached target features.
+    ForwardLayers(image_branch_start_, last_layer);
+    return;
+  }
+
+  // Run the image branch.
+  ForwardLayers(image_branch_start_, concat_layer_ - 1);
+
+  // Compute fc6 without concatenating the two branches.
+  StartProfile();
+  ForwardFc6Split();
+  StopProfile(fc6_layer_);
+
+  // Run the remaining fully-connected layers.
+  ForwardLayers(fc6_layer_ + 1, last_layer);
+}
+
+void Regressor::ForwardFc6Split() {
+  // fc6 = W * [target; image] + b = (W_target * target + b) + W_image * image,
+  // where W_target and W_image are the left and right column blocks of W.
+  const std::vector<boost::shared_ptr<Blob<float> > >& fc6_params =
+      net_->layers()[fc6_layer_]->blobs();
+  const Blob<float>* weights = fc6_params[0].get();
+  const Blob<float>* bias = fc6_params[1].get();
+
+  const Blob<float>* target_features = net_->bottom_vecs()[concat_layer_][0];
+  const Blob<float>* image_features = net_->bottom_vecs()[concat_layer_][1];
+  Blob<float>* fc6 = net_->top_vecs()[fc6_layer_][0];
+
+  const int num_outputs = weights->shape(0);
+  const int num_inputs = weights->shape(1);
+  const int num_target_inputs = target_features->count();
+  const int num_image_inputs = image_features->count();
+  CHECK_EQ(num_target_inputs + num_image_inputs, num_inputs)
+      << "fc6 input size does not match the concatenated features.";
+
+  const float* W = weights->cpu_data();
+
+  if (!target_fc6_valid_) {
+    // Compute the target half of the product once per target.
+    const float* b = bias->cpu_data();
+    target_fc6_.assign(b, b + num_outputs);
+    cblas_sgemv(CblasRowMajor, CblasNoTrans, num_outputs, num_target_inputs,
+                1.0f, W, num_inputs, target_features->cpu_data(), 1,
+                1.0f, &target_fc6_[0], 1);
+    target_fc6_valid_ = true;
+  }
+
+  // Add the image half of the product.
+  float* fc6_data = fc6->mutable_cpu_data();
+  caffe::caffe_copy(num_outputs, &target_fc6_[0], fc6_data);
+  cblas_sgemv(CblasRowMajor, CblasNoTrans, num_outputs, num_image_inputs,
+              1.0f, W + num_target_inputs, num_inputs, image_features->cpu_data(), 1,
+              1.0f, fc6_data, 1);
 }
 
 void Regressor::ReshapeImageInputs(const size_t num_images) {
@@ -151,6 +820,34 @@ void Regressor::ReshapeImageInputs(const size_t num_images) {
                        input_geometry_.height, input_geometry_.width);
 }
 
+void Regressor::ReshapeInputs(const size_t num_images) {
+  // Reshaping the network is expensive (and allocates memory), so only do it
+  // when the number of images changes.
+  if (num_images == input_batch_size_) {
+    return;
+  }
+
+  // Reshape the image and target inputs.
+  ReshapeImageInputs(num_images);
+
+  // Reshape the bounding box input, if it exists (when training, the ground-truth
+  // bounding boxes are set separately, with the correct shape).
+  if (net_->input_blobs().size() > 2) {
+    Blob<float>* input_bbox = net_->input_blobs()[2];
+    if (input_bbox->shape(0) != static_cast<int>(num_images)) {
+      input_bbox->Reshape(num_images, 4, 1, 1);
+    }
+  }
+
+  // Forward dimension change to all layers.
+  net_->Reshape();
+
+  input_batch_size_ = num_images;
+
+  // Skip the concat layer where possible for this shape.
+  UpdateInPlaceConcat();
+}
+
 void Regressor::GetFeatures(const string& feature_name, std::vector<float>* output) const {
   //printf("Getting %s features\n", feature_name.c_str());
 
@@ -166,10 +863,10 @@ void Regressor::GetFeatures(const string& feature_name, std::vector<float>* outp
   }
   //printf("Total num elements: %d\n", num_elements);
 
-  // Copy all elements in this layer to a vector.
+  // Copy all elements in this layer to a vector (reusing its memory).
   const float* begin = layer->cpu_data();
   const float* end = begin + num_elements;
-  *output = std::vector<float>(begin, end);
+  output->assign(begin, end);
 }
 
 void Regressor::SetImages(const std::vector<cv::Mat>& images,
@@ -180,8 +877,11 @@ void Regressor::SetImages(const std::vector<cv::Mat>& images,
 
   const size_t num_images = images.size();
 
+  // The target-branch activations are about to be overwritten.
+  target_cache_valid_ = false;
+
   // Set network inputs to the appropriate size and number.
-  ReshapeImageInputs(num_images);
+  ReshapeInputs(num_images);
 
   // Wrap the network inputs with opencv objects.
   std::vector<std::vector<cv::Mat> > target_channels;
@@ -199,21 +899,23 @@ void Regressor::Estimate(const std::vector<cv::Mat>& images,
   assert(net_->phase() == caffe::TEST);
 
   // Set the inputs to the network.
+  StartProfile();
   SetImages(images, targets);
-
-  // Forward dimension change to all layers.
-  net_->Reshape();
+  StopProfile(preprocess_stage_);
 
   // Perform a forward-pass in the network.
-  net_->ForwardPrefilled();
+  ForwardLayers(0, net_->layers().size() - 1);
 
   // Get the network output.
+  StartProfile();
   GetOutput(output);
+  StopProfile(output_stage_);
 }
 
 void Regressor::GetOutput(std::vector<float>* output) {
   // Get the fc8 output features of the network (this contains the estimated bounding box).
-  GetFeatures("fc8", output);
+  const float* begin = output_blob_->cpu_data();
+  output->assign(begin, begin + output_blob_->count());
 }
 
 // Wrap the input layer of the network in separate cv::Mat objects
@@ -283,6 +985,15 @@ void Regressor::WrapInputLayer(const size_t num_images,
 
 void Regressor::Preprocess(const cv::Mat& img,
                             std::vector<cv::Mat>* input_channels) {
+  if (img.depth() == CV_8U) {
+    // Resize, convert to float, subtract the mean and split the channels in a single pass.
+    // The channels in input_channels are contiguous planes of the input layer, so this
+    // writes directly to the input layer of the network.
+    ResizePlanar(img, input_geometry_, mean_value_, num_channels_,
+                 reinterpret_cast<float*>(input_channels->at(0).data));
+    return;
+  }
+
   // Convert the input image to the input image format of the network.
   cv::Mat sample;
   if (img.channels() == 3 && num_channels_ == 1)
@@ -329,6 +1040,14 @@ void Regressor::Preprocess(const std::vector<cv::Mat>& images,
   for (size_t i = 0; i < images.size(); ++i) {
     const cv::Mat& img = images[i];
 
+    if (img.depth() == CV_8U) {
+      // Resize, convert to float, subtract the mean and split the channels in a single pass,
+      // writing directly to the input layer of the network.
+      ResizePlanar(img, input_geometry_, mean_value_, num_channels_,
+                   reinterpret_cast<float*>((*input_channels)[i][0].data));
+      continue;
+    }
+
     // Convert the input image to the input image format of the network.
     cv::Mat sample;
     if (img.channels() == 3 && num_channels_ == 1)
@@ -370,3 +1089,43 @@ void Regressor::Preprocess(const std::vector<cv::Mat>& images,
       << "Input channels are not wrapping the input layer of the network.";*/
   }
 }
+
+boost::shared_future<BoundingBox> Regressor::RegressAsync(const cv::Mat& image_curr,
+                                                          const BoundingBox& bbox_curr_prior_tight,
+                                                          const cv::Mat& image_prev,
+                                                          const BoundingBox& bbox_prev_tight) {
+  assert(net_->phase() == caffe::TEST);
+  return async_.Start(image_curr, bbox_curr_prior_tight, image_prev, bbox_prev_tight);
+}
+
+void Regressor::PreprocessAsync(const size_t slot, const AsyncRegressInputs& inputs) {
+  // Crop, resize and normalize the search region and the target into the buffers of this slot.
+  const size_t input_size = num_channels_ * input_geometry_.width * input_geometry_.height;
+  async_image_inputs_[slot].resize(input_size);
+  async_target_inputs_[slot].resize(input_size);
+  CropPadResizePlanar(inputs.bbox_curr_prior_tight, inputs.image_curr, input_geometry_,
+                      mean_value_, num_channels_, &async_resample_buffers_,
+                      &async_image_inputs_[slot][0]);
+  CropPadResizePlanar(inputs.bbox_prev_tight, inputs.image_prev, input_geometry_,
+                      mean_value_, num_channels_, &async_resample_buffers_,
+                      &async_target_inputs_[slot][0]);
+}
+
+BoundingBox Regressor::ForwardAsync(const size_t slot) {
+  // Copy the inputs of this slot into the input blobs and run the network.
+  // (The blobs keep their own memory, which Caffe may mirror on the GPU, so the inputs are
+  // copied rather than pointed to.  When the target features are cached, an unchanged target
+  // is recognized, as in RegressFromTarget.)
+  ReshapeInputs(1);
+  std::copy(async_image_inputs_[slot].begin(), async_image_inputs_[slot].end(),
+            net_->input_blobs()[1]->mutable_cpu_data());
+  std::copy(async_target_inputs_[slot].begin(), async_target_inputs_[slot].end(),
+            net_->input_blobs()[0]->mutable_cpu_data());
+  ForwardSingle(&async_estimation_);
+  return BoundingBox(async_estimation_);
+}
+
+void Regressor::StartForwardThread() {
+  // Caffe keeps its mode and device per thread.
+  SetCaffeMode();
+}
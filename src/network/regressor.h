@@ -2,6 +2,8 @@
 #define REGRESSOR_H
 
 #include <caffe/caffe.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/future.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -12,9 +14,15 @@
 #include <vector>
 
 #include "helper/bounding_box.h"
+#include "helper/high_res_timer.h"
+#include "helper/image_proc.h"
+#include "helper/profiler.h"
+#include "network/async_regress_helper.h"
 #include "network/regressor_base.h"
 
-class Regressor : public RegressorBase {
+class WeightFile;
+
+class Regressor : public RegressorBase, private AsyncRegressStages {
  public:
   // Set up a network with the architecture specified in deploy_proto,
   // with the model weights saved in caffe_model.
@@ -30,6 +38,18 @@ class Regressor : public RegressorBase {
             const int gpu_id,
             const bool do_train);
 
+  // Set up a network with the architecture specified in deploy_proto, which shares the
+  // (read-only) model weights of shared_weights rather than loading its own copy.
+  // Only the activations are allocated separately, so many regressors (e.g. one per
+  // tracking thread) can be created from a single copy of the weights.
+  // shared_weights must outlive this regressor, and must not be trained while it is in use.
+  Regressor(const std::string& deploy_proto,
+            const Regressor& shared_weights,
+            const int gpu_id);
+
+  // Waits for the estimates started with RegressAsync.
+  virtual ~Regressor();
+
   // Estimate the location of the target object in the current image.
   // image_curr is the entire current image.
   // image is the best guess as to a crop of the current image that likely contains the target object.
@@ -37,6 +57,45 @@ class Regressor : public RegressorBase {
   // Returns: bbox, an estimated location of the target object in the current image.
   virtual void Regress(const cv::Mat& image_curr, const cv::Mat& image, const cv::Mat& target, BoundingBox* bbox);
 
+  // Estimate the location of the target object in the current image, preprocessing the
+  // search region and the target directly from the full images into the network inputs.
+  virtual void RegressFromFullImages(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                     const cv::Mat& image_prev, const BoundingBox& bbox_prev_tight,
+                                     BoundingBox* bbox);
+
+  // Crop, resize and normalize the target into the network input that it is kept as.
+  virtual void PrepareTarget(const cv::Mat& image, const BoundingBox& bbox_tight,
+                             PreparedTarget* target);
+
+  // Estimate the location of the target object in the current image, preprocessing the
+  // search region directly from the full image into the network input, with the prepared target.
+  virtual void RegressFromTarget(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                 const PreparedTarget& target, BoundingBox* bbox);
+
+  // Estimate the locations of multiple target objects in a single batched forward pass.
+  virtual void RegressFromFullImages(const std::vector<cv::Mat>& images_curr,
+                                     const std::vector<BoundingBox>& bboxes_curr_prior_tight,
+                                     const std::vector<cv::Mat>& images_prev,
+                                     const std::vector<BoundingBox>& bboxes_prev_tight,
+                                     std::vector<BoundingBox>* bboxes);
+
+  // Start estimating the location of the target object, as RegressFromFullImages does.
+  // The estimates are double-buffered (see network/async_regress_helper.h), with a set of
+  // input buffers for each slot, which the forward thread copies into the input blobs.  The
+  // other methods that run the network wait for all estimates in progress before running.
+  virtual boost::shared_future<BoundingBox> RegressAsync(const cv::Mat& image_curr,
+                                                         const BoundingBox& bbox_curr_prior_tight,
+                                                         const cv::Mat& image_prev,
+                                                         const BoundingBox& bbox_prev_tight);
+
+  // Enable or disable profiling: timing each layer of the network, along with preprocessing
+  // the inputs and copying out the output, on every call.  (When enabled, the layers are run
+  // one at a time, which adds a small overhead.)
+  void set_profile(const bool profile) { profile_ = profile; }
+
+  // Timing statistics collected while profiling.
+  const Profiler& get_profiler() const { return profiler_; }
+
 protected:
   // Set the network inputs.
   void SetImages(const std::vector<cv::Mat>& images,
@@ -48,12 +107,29 @@ protected:
   // Reshape the image inputs to the network to match the expected size and number of images.
   virtual void ReshapeImageInputs(const size_t num_images);
 
+  // Reshape the inputs to the network for the given number of images, and propagate the
+  // new shape through the network.  Does nothing if the batch size has not changed.
+  void ReshapeInputs(const size_t num_images);
+
   // Get the features in the network with the given name, and copy their values to the output.
   void GetFeatures(const std::string& feature_name, std::vector<float>* output) const;
 
   // Pass the image and the target to the network; estimate the location of the target in the current image.
   void Estimate(const cv::Mat& image, const cv::Mat& target, std::vector<float>* output);
 
+  // Perform a forward pass on the single image and target that have been set in the
+  // network inputs, and get the network output.
+  void ForwardSingle(std::vector<float>* output);
+
+  // Run the forward pass of the network layers from start to end (inclusive).
+  void ForwardLayers(const int start, const int end);
+
+  // When profiling, start timing a stage of the computation.
+  void StartProfile();
+
+  // When profiling, record the time since StartProfile as a sample of the given profiler stage.
+  void StopProfile(const int stage);
+
   // Batch estimation, for tracking multiple targets.
   void Estimate(const std::vector<cv::Mat>& images,
                              const std::vector<cv::Mat>& targets,
@@ -77,17 +153,76 @@ protected:
   // If the parameters of the network have been modified, reinitialize the parameters to their original values.
   virtual void Init();
 
+  // Enable or disable reusing the target-branch features when the target input has not changed.
+  void set_cache_target_features(const bool cache_target_features) {
+    cache_target_features_ = cache_target_features; target_cache_valid_ = false;
+  }
+
+  boost::shared_ptr<caffe::Net<float> > net_;
+
  private:
   // Set up a network with the architecture specified in deploy_proto,
   // with the model weights saved in caffe_model.
+  // If shared_net is not NULL, its weights are shared instead of being loaded from caffe_model.
   void SetupNetwork(const std::string& deploy_proto,
                     const std::string& caffe_model,
                     const int gpu_id,
-                    const bool do_train);
+                    const bool do_train,
+                    const caffe::Net<float>* shared_net);
+
+  // Share the model weights of shared_net, which must have the same architecture.
+  void ShareWeights(const caffe::Net<float>* shared_net);
+
+  // Point the model weights into the weight file at weight_file_path (see network/weight_file.h),
+  // which is mapped into memory rather than loaded.  The mapping is copy-on-write, so the weights
+  // may still be trained.
+  void MapWeights(const std::string& weight_file_path);
+
+  // Change the network parameters so that building the network does not initialize
+  // the weights randomly (for when the weights will be replaced).
+  static void SkipWeightInitialization(caffe::NetParameter* net_param);
+
+  // Simplify the network parameters for inference: keep only the layers run in the TEST phase,
+  // remove Dropout (which does nothing in the TEST phase), and remove the layers and inputs
+  // that are not needed to compute the output (the loss and its bounding box input).
+  static void OptimizeForInference(caffe::NetParameter* net_param);
+
+  // Set the Caffe mode (CPU or GPU) and device.  Caffe keeps these per thread,
+  // so this must be called on each thread that uses the network.
+  void SetCaffeMode();
 
   // Set the mean input (used to normalize the inputs to be 0-mean).
   void SetMean();
 
+  // Find the layers needed to run only the image branch and the fully-connected head.
+  void SetupTargetCache();
+
+  // Find whether the inputs of the concat layer can be computed directly in its output.
+  void SetupInPlaceConcat();
+
+  // Point the inputs of the concat layer into its output, so that the concat layer does not
+  // need to be run, if possible for the current shape of the network (a single image on the CPU).
+  void UpdateInPlaceConcat();
+
+  // Returns true if the target input currently set in the network matches the target
+  // from which the target-branch features (conv1 - pool5) were last computed.
+  bool TargetFeaturesCached() const;
+
+  // Remember the current target input, whose target-branch features have just been computed.
+  void CacheTargetFeatures();
+
+  // Forward pass that reuses the cached target-branch features: runs the image
+  // branch (conv1_p - pool5_p) and the fully-connected layers.
+  void ForwardImageBranch();
+
+  // Compute fc6 as the cached target half of the product plus the image half.
+  void ForwardFc6Split();
+
+  // Stages of RegressAsync (see AsyncRegressStages).
+  virtual void PreprocessAsync(const size_t slot, const AsyncRegressInputs& inputs);
+  virtual BoundingBox ForwardAsync(const size_t slot);
+  virtual void StartForwardThread();
+
  private:
   // Number of inputs expected by the network.
   int num_inputs_;
@@ -101,11 +236,84 @@ protected:
   // Mean image, used to make the input 0-mean.
   cv::Mat mean_;
 
+  // Per-channel mean value (the value of each pixel of mean_).
+  cv::Scalar mean_value_;
+
   // Folder containing the model parameters.
   std::string caffe_model_;
 
   // Whether the model weights has been modified.
   bool modified_params_;
+
+  // GPU to run the network on (ignored in CPU mode).
+  int gpu_id_;
+
+  // Mapped weight file that the model weights point into (if loaded from a weight file).
+  boost::shared_ptr<WeightFile> weight_file_;
+
+  // Number of images that the network inputs are currently shaped for (0 if not yet shaped).
+  size_t input_batch_size_;
+
+  // Output of the network (the fc8 blob), which contains the estimated bounding box.
+  caffe::Blob<float>* output_blob_;
+
+  // Whether to reuse the target-branch features when the target input has not changed.
+  bool cache_target_features_;
+
+  // Whether the target-branch activations in the network were computed from target_key_.
+  bool target_cache_valid_;
+
+  // Preprocessed target input from which the cached target-branch features were computed.
+  std::vector<float> target_key_;
+
+  // Target half of the fc6 product (fc6 bias + fc6 weights x target pool5).
+  std::vector<float> target_fc6_;
+
+  // Whether target_fc6_ has been computed for the cached target.
+  bool target_fc6_valid_;
+
+  // Index of the first layer of the image branch (conv1_p), or -1 if the
+  // network does not support partial forward passes.
+  int image_branch_start_;
+
+  // Indices of the concat and fc6 layers, or -1 if fc6 cannot be split
+  // into a target half and an image half.
+  int concat_layer_;
+  int fc6_layer_;
+
+  // Index of the concat layer if its inputs can be computed directly in its output, or -1.
+  int in_place_concat_layer_;
+
+  // Whether the inputs of the concat layer currently point into its output (so the concat
+  // layer is not run).
+  bool concat_in_place_;
+
+  // Buffers reused across frames so that preparing the inputs and reading the outputs do not
+  // allocate memory after the first frame.  (The Caffe forward pass itself still allocates.)
+  ResampleBuffers resample_buffers_;
+  std::vector<float> estimation_;
+  std::vector<float> bbox_estimation_;
+
+  // Whether to profile each call.
+  bool profile_;
+
+  // Timing statistics, with one stage per layer (with the same index as the layer),
+  // followed by the preprocessing and output stages.
+  Profiler profiler_;
+  int preprocess_stage_;
+  int output_stage_;
+
+  // Times each profiled stage.
+  HighResTimer profile_timer_;
+
+  // Input buffers of each slot of RegressAsync, and the buffers of its helper threads.
+  std::vector<float> async_target_inputs_[AsyncRegressHelper::kNumSlots];
+  std::vector<float> async_image_inputs_[AsyncRegressHelper::kNumSlots];
+  ResampleBuffers async_resample_buffers_;
+  std::vector<float> async_estimation_;
+
+  // Runs the estimates started with RegressAsync.
+  AsyncRegressHelper async_;
 };
 
 #endif // REGRESSOR_H
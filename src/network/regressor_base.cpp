@@ -1,5 +1,64 @@
 #include "regressor_base.h"
 
+#include "helper/bounding_box.h"
+#include "helper/image_proc.h"
+
 RegressorBase::RegressorBase()
 {
 }
+
+void RegressorBase::RegressFromFullImages(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                          const cv::Mat& image_prev, const BoundingBox& bbox_prev_tight,
+                                          BoundingBox* bbox) {
+  // Get target from previous image.
+  cv::Mat target_pad;
+  CropPadImage(bbox_prev_tight, image_prev, &target_pad);
+
+  // Crop the current image based on predicted prior location of target.
+  cv::Mat curr_search_region;
+  CropPadImage(bbox_curr_prior_tight, image_curr, &curr_search_region);
+
+  // Estimate the bounding box location of the target, centered and scaled relative to the cropped image.
+  Regress(image_curr, curr_search_region, target_pad, bbox);
+}
+
+void RegressorBase::PrepareTarget(const cv::Mat& image, const BoundingBox& bbox_tight,
+                                  PreparedTarget* target) {
+  // Keep the padded crop of the target.
+  CropPadImage(bbox_tight, image, &target->image);
+}
+
+void RegressorBase::RegressFromTarget(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                      const PreparedTarget& target, BoundingBox* bbox) {
+  // Crop the current image based on predicted prior location of target.
+  cv::Mat curr_search_region;
+  CropPadImage(bbox_curr_prior_tight, image_curr, &curr_search_region);
+
+  // Estimate the bounding box location of the target, centered and scaled relative to the cropped image.
+  Regress(image_curr, curr_search_region, target.image, bbox);
+}
+
+void RegressorBase::RegressFromFullImages(const std::vector<cv::Mat>& images_curr,
+                                          const std::vector<BoundingBox>& bboxes_curr_prior_tight,
+                                          const std::vector<cv::Mat>& images_prev,
+                                          const std::vector<BoundingBox>& bboxes_prev_tight,
+                                          std::vector<BoundingBox>* bboxes) {
+  // Estimate the location of each target separately.
+  bboxes->resize(images_curr.size());
+  for (size_t i = 0; i < images_curr.size(); ++i) {
+    RegressFromFullImages(images_curr[i], bboxes_curr_prior_tight[i],
+                          images_prev[i], bboxes_prev_tight[i], &(*bboxes)[i]);
+  }
+}
+
+boost::shared_future<BoundingBox> RegressorBase::RegressAsync(const cv::Mat& image_curr,
+                                                              const BoundingBox& bbox_curr_prior_tight,
+                                                              const cv::Mat& image_prev,
+                                                              const BoundingBox& bbox_prev_tight) {
+  // Estimate the location now, and return it as a future that is already done.
+  BoundingBox bbox;
+  RegressFromFullImages(image_curr, bbox_curr_prior_tight, image_prev, bbox_prev_tight, &bbox);
+  boost::promise<BoundingBox> result;
+  result.set_value(bbox);
+  return result.get_future();
+}
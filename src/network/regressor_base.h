@@ -5,16 +5,28 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/future.hpp>
+#include <vector>
 
-#include <caffe/caffe.hpp>
+#include "helper/bounding_box.h"
 
-class BoundingBox;
+// The target, cropped from the previous image and preprocessed by RegressorBase::PrepareTarget,
+// so that the previous image need not be kept.
+struct PreparedTarget {
+  // The padded crop of the target, for regressors that take the crops as images.
+  cv::Mat image;
+
+  // The crop resized and normalized into the target input of the network, for regressors that
+  // write their inputs directly.
+  std::vector<float> input;
+};
 
 // A neural network for the tracker must inherit from this class.
 class RegressorBase
 {
 public:
   RegressorBase();
+  virtual ~RegressorBase() {}
 
   // Predict the bounding box.
   // image_curr is the entire current image.
@@ -23,14 +35,54 @@ public:
   // Returns: bbox, an estimated location of the target object in the current image.
   virtual void Regress(const cv::Mat& image_curr, const cv::Mat& image, const cv::Mat& target, BoundingBox* bbox) = 0;
 
-  // Called at the beginning of tracking a new object to initialize the network.
-  virtual void Init() { }
+  // Predict the bounding box, taking the network inputs directly from the full images.
+  // image_curr is the entire current image; the search region is its padded crop around bbox_curr_prior_tight.
+  // image_prev is the entire previous image; the target is its padded crop around bbox_prev_tight.
+  // (Both crops are defined as in CropPadImage.)
+  // Returns: bbox, an estimated location of the target object, relative to the search region (as in Regress).
+  // By default, the crops are built with CropPadImage and passed to Regress; subclasses can
+  // override this to avoid building the crops.
+  virtual void RegressFromFullImages(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                     const cv::Mat& image_prev, const BoundingBox& bbox_prev_tight,
+                                     BoundingBox* bbox);
 
-  //virtual boost::shared_ptr<caffe::Net<float> > get_net() { return net_; }
+  // Crop the target from image (its padded crop around bbox_tight, as in CropPadImage) and
+  // preprocess it into target, for RegressFromTarget.
+  // By default, the crop is built with CropPadImage and kept as an image; subclasses can
+  // override this to keep only the network input.
+  virtual void PrepareTarget(const cv::Mat& image, const BoundingBox& bbox_tight,
+                             PreparedTarget* target);
 
-protected:
-  boost::shared_ptr<caffe::Net<float> > net_;
+  // Predict the bounding box as RegressFromFullImages does, with the target prepared
+  // by PrepareTarget (from the previous image) instead of cropped from the previous image.
+  // By default, the search region is built with CropPadImage and passed to Regress.
+  virtual void RegressFromTarget(const cv::Mat& image_curr, const BoundingBox& bbox_curr_prior_tight,
+                                 const PreparedTarget& target, BoundingBox* bbox);
 
+  // Batch version of RegressFromFullImages, for tracking multiple targets at once.
+  // For each i, the search region is the padded crop of images_curr[i] around bboxes_curr_prior_tight[i]
+  // and the target is the padded crop of images_prev[i] around bboxes_prev_tight[i].
+  // Returns: bboxes, where bboxes[i] is the estimated location of target i, relative to its search region.
+  // By default, each target is estimated separately; subclasses can override this to
+  // estimate all targets in a single batch.
+  virtual void RegressFromFullImages(const std::vector<cv::Mat>& images_curr,
+                                     const std::vector<BoundingBox>& bboxes_curr_prior_tight,
+                                     const std::vector<cv::Mat>& images_prev,
+                                     const std::vector<BoundingBox>& bboxes_prev_tight,
+                                     std::vector<BoundingBox>* bboxes);
+
+  // Start estimating the location of the target object as RegressFromFullImages does, and return
+  // a future that gets the estimate once it is done.  The images must not be modified until then.
+  // Several estimates (e.g. of different videos) can be started before waiting for any of them.
+  // By default, the estimate is done before returning; subclasses can override this to
+  // preprocess the inputs of one estimate while the network runs on another.
+  virtual boost::shared_future<BoundingBox> RegressAsync(const cv::Mat& image_curr,
+                                                         const BoundingBox& bbox_curr_prior_tight,
+                                                         const cv::Mat& image_prev,
+                                                         const BoundingBox& bbox_prev_tight);
+
+  // Called at the beginning of tracking a new object to initialize the network.
+  virtual void Init() { }
 };
 
 #endif // REGRESSOR_BASE_H
@@ -34,6 +34,12 @@ void RegressorTrain::set_test_net(const std::string& test_proto) {
   solver_.set_test_net(test_net_);
 }
 
+void RegressorTrain::SaveWeights(const std::string& caffe_model) const {
+  caffe::NetParameter net_param;
+  net_->ToProto(&net_param);
+  caffe::WriteProtoToBinaryFile(net_param, caffe_model);
+}
+
 void RegressorTrain::set_bboxes_gt(const std::vector<BoundingBox>& bboxes_gt) {
   assert(net_->phase() == caffe::TRAIN);
 
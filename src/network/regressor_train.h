@@ -26,6 +26,9 @@ public:
   // Set up the solver with the given test file for validation testing.
   void set_test_net(const std::string& test_proto);
 
+  // Save the current model weights to caffe_model.
+  void SaveWeights(const std::string& caffe_model) const;
+
 private:
   // Train the network.
   void Step();
@@ -0,0 +1,490 @@
+#include "weight_file.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kWeightFileMagic[8] = "GOTURNW";
+const uint32_t kWeightFileVersion = 1;
+
+// Round offset up to a multiple of kWeightFileAlignment.
+uint64_t AlignOffset(const uint64_t offset) {
+  return (offset + kWeightFileAlignment - 1) / kWeightFileAlignment * kWeightFileAlignment;
+}
+
+// Size of the header describing a blob.
+uint64_t BlobHeaderSize(const WeightBlob& blob) {
+  return sizeof(uint32_t) + blob.layer_name.size() + 2 * sizeof(uint32_t) +
+      blob.shape.size() * sizeof(uint32_t) + sizeof(uint64_t);
+}
+
+void WriteUint32(const uint32_t value, FILE* file) {
+  fwrite(&value, sizeof(value), 1, file);
+}
+
+// Reads values from the header of a mapped file, checking that they are within the file.
+class HeaderReader {
+public:
+  HeaderReader(const char* data, const size_t size) :
+    data_(data), size_(size), offset_(0), ok_(true) {}
+
+  uint32_t ReadUint32() { uint32_t value = 0; Read(&value, sizeof(value)); return value; }
+  uint64_t ReadUint64() { uint64_t value = 0; Read(&value, sizeof(value)); return value; }
+  std::string ReadString(const size_t length) {
+    if (!Check(length)) {
+      return std::string();
+    }
+    std::string value(data_ + offset_, length);
+    offset_ += length;
+    return value;
+  }
+
+  bool ok() const { return ok_; }
+
+private:
+  bool Check(const size_t length) {
+    ok_ = ok_ && length <= size_ - offset_;
+    return ok_;
+  }
+  void Read(void* value, const size_t length) {
+    if (Check(length)) {
+      memcpy(value, data_ + offset_, length);
+      offset_ += length;
+    }
+  }
+
+  const char* data_;
+  size_t size_;
+  size_t offset_;
+  bool ok_;
+};
+
+// Field numbers used to decode a .caffemodel (from caffe.proto).
+const uint32_t kNetLayerField = 100;       // NetParameter.layer (LayerParameter)
+const uint32_t kNetLayersV1Field = 2;      // NetParameter.layers (V1LayerParameter)
+const uint32_t kLayerNameField = 1;        // LayerParameter.name
+const uint32_t kLayerBlobsField = 7;       // LayerParameter.blobs
+const uint32_t kLayerV1NameField = 4;      // V1LayerParameter.name
+const uint32_t kLayerV1BlobsField = 6;     // V1LayerParameter.blobs
+const uint32_t kBlobNumField = 1;          // BlobProto.num, channels, height, width (legacy shape)
+const uint32_t kBlobWidthField = 4;
+const uint32_t kBlobDataField = 5;         // BlobProto.data
+const uint32_t kBlobShapeField = 7;        // BlobProto.shape
+const uint32_t kBlobDoubleDataField = 8;   // BlobProto.double_data
+const uint32_t kShapeDimField = 1;         // BlobShape.dim
+
+// Protobuf wire types.
+const uint32_t kWireVarint = 0;
+const uint32_t kWireFixed64 = 1;
+const uint32_t kWireLengthDelimited = 2;
+const uint32_t kWireFixed32 = 5;
+
+// Reads the fields of an encoded protobuf message.
+class WireReader {
+public:
+  WireReader(const char* data, const size_t size) :
+    data_(reinterpret_cast<const unsigned char*>(data)), end_(data_ + size), ok_(true) {}
+
+  // Whether there are more fields to read.
+  bool HasMore() const { return ok_ && data_ < end_; }
+
+  bool ok() const { return ok_; }
+
+  // Read the tag of the next field.
+  void ReadTag(uint32_t* field, uint32_t* wire_type) {
+    const uint64_t tag = ReadVarint();
+    *field = tag >> 3;
+    *wire_type = tag & 7;
+  }
+
+  uint64_t ReadVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (data_ >= end_) {
+        ok_ = false;
+        return 0;
+      }
+      const unsigned char byte = *data_++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    ok_ = false;
+    return 0;
+  }
+
+  // Read a length-delimited field (a string, a message or a packed repeated field).
+  WireReader ReadLengthDelimited() {
+    const uint64_t size = ReadVarint();
+    if (!ok_ || size > static_cast<uint64_t>(end_ - data_)) {
+      ok_ = false;
+      return WireReader(NULL, 0);
+    }
+    const char* begin = reinterpret_cast<const char*>(data_);
+    data_ += size;
+    return WireReader(begin, size);
+  }
+
+  // Read fixed-size values.
+  void ReadFixed(void* value, const size_t size) {
+    if (size > static_cast<size_t>(end_ - data_)) {
+      ok_ = false;
+      return;
+    }
+    memcpy(value, data_, size);
+    data_ += size;
+  }
+
+  // Skip a field that is not needed.
+  void Skip(const uint32_t wire_type) {
+    if (wire_type == kWireVarint) {
+      ReadVarint();
+    } else if (wire_type == kWireFixed64) {
+      SkipBytes(8);
+    } else if (wire_type == kWireLengthDelimited) {
+      ReadLengthDelimited();
+    } else if (wire_type == kWireFixed32) {
+      SkipBytes(4);
+    } else {
+      ok_ = false;
+    }
+  }
+
+  // The remaining bytes.
+  const char* data() const { return reinterpret_cast<const char*>(data_); }
+  size_t size() const { return end_ - data_; }
+
+private:
+  void SkipBytes(const size_t size) {
+    if (size > static_cast<size_t>(end_ - data_)) {
+      ok_ = false;
+      return;
+    }
+    data_ += size;
+  }
+
+  const unsigned char* data_;
+  const unsigned char* end_;
+  bool ok_;
+};
+
+// Decode a BlobProto, appending its values to data.
+// Returns false if it is not valid.
+bool DecodeBlob(WireReader reader, std::vector<int>* shape, std::vector<float>* data) {
+  std::vector<int> legacy_shape(4, 1);
+  bool has_legacy_shape = false;
+  const size_t data_begin = data->size();
+  while (reader.HasMore()) {
+    uint32_t field, wire_type;
+    reader.ReadTag(&field, &wire_type);
+    if (field == kBlobShapeField && wire_type == kWireLengthDelimited) {
+      WireReader shape_reader = reader.ReadLengthDelimited();
+      while (shape_reader.HasMore()) {
+        uint32_t shape_field, shape_wire_type;
+        shape_reader.ReadTag(&shape_field, &shape_wire_type);
+        if (shape_field == kShapeDimField && shape_wire_type == kWireLengthDelimited) {
+          WireReader dims = shape_reader.ReadLengthDelimited();
+          while (dims.HasMore()) {
+            shape->push_back(dims.ReadVarint());
+          }
+        } else if (shape_field == kShapeDimField && shape_wire_type == kWireVarint) {
+          shape->push_back(shape_reader.ReadVarint());
+        } else {
+          shape_reader.Skip(shape_wire_type);
+        }
+      }
+      if (!shape_reader.ok()) {
+        return false;
+      }
+    } else if (field >= kBlobNumField && field <= kBlobWidthField && wire_type == kWireVarint) {
+      legacy_shape[field - kBlobNumField] = reader.ReadVarint();
+      has_legacy_shape = true;
+    } else if (field == kBlobDataField && wire_type == kWireLengthDelimited) {
+      // Packed floats.
+      WireReader values = reader.ReadLengthDelimited();
+      const size_t num_values = values.size() / sizeof(float);
+      data->resize(data->size() + num_values);
+      values.ReadFixed(&(*data)[data->size() - num_values], num_values * sizeof(float));
+    } else if (field == kBlobDataField && wire_type == kWireFixed32) {
+      float value;
+      reader.ReadFixed(&value, sizeof(value));
+      data->push_back(value);
+    } else if (field == kBlobDoubleDataField && wire_type == kWireLengthDelimited) {
+      // Packed doubles.
+      WireReader values = reader.ReadLengthDelimited();
+      while (values.HasMore()) {
+        double value;
+        values.ReadFixed(&value, sizeof(value));
+        data->push_back(value);
+      }
+    } else if (field == kBlobDoubleDataField && wire_type == kWireFixed64) {
+      double value;
+      reader.ReadFixed(&value, sizeof(value));
+      data->push_back(value);
+    } else {
+      reader.Skip(wire_type);
+    }
+  }
+
+  // Old models store the shape as num, channels, height and width.
+  if (shape->empty() && has_legacy_shape) {
+    *shape = legacy_shape;
+  }
+
+  // Check that the number of values matches the shape.
+  size_t count = 1;
+  for (size_t i = 0; i < shape->size(); ++i) {
+    count *= (*shape)[i];
+  }
+  return reader.ok() && !shape->empty() && count == data->size() - data_begin;
+}
+
+} // namespace
+
+size_t WeightBlob::count() const {
+  size_t count = 1;
+  for (size_t i = 0; i < shape.size(); ++i) {
+    count *= shape[i];
+  }
+  return count;
+}
+
+bool WriteWeightFile(const std::vector<WeightBlob>& blobs, const std::string& path) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    printf("Error - could not open %s for writing\n", path.c_str());
+    return false;
+  }
+
+  // Compute where the data of each blob will start.
+  uint64_t offset = sizeof(kWeightFileMagic) + 2 * sizeof(uint32_t);
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    offset += BlobHeaderSize(blobs[i]);
+  }
+  std::vector<uint64_t> data_offsets(blobs.size());
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    offset = AlignOffset(offset);
+    data_offsets[i] = offset;
+    offset += blobs[i].count() * sizeof(float);
+  }
+
+  // Write the header.
+  fwrite(kWeightFileMagic, sizeof(kWeightFileMagic), 1, file);
+  WriteUint32(kWeightFileVersion, file);
+  WriteUint32(blobs.size(), file);
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    const WeightBlob& blob = blobs[i];
+    WriteUint32(blob.layer_name.size(), file);
+    fwrite(blob.layer_name.data(), 1, blob.layer_name.size(), file);
+    WriteUint32(blob.blob_index, file);
+    WriteUint32(blob.shape.size(), file);
+    for (size_t j = 0; j < blob.shape.size(); ++j) {
+      WriteUint32(blob.shape[j], file);
+    }
+    fwrite(&data_offsets[i], sizeof(data_offsets[i]), 1, file);
+  }
+
+  // Write the data of each blob, padded to its aligned offset.
+  const char padding[kWeightFileAlignment] = { 0 };
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    const long position = ftell(file);
+    fwrite(padding, 1, data_offsets[i] - position, file);
+    fwrite(blobs[i].data, sizeof(float), blobs[i].count(), file);
+  }
+
+  const bool success = !ferror(file);
+  if (fclose(file) != 0 || !success) {
+    printf("Error - could not write %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+WeightFile::WeightFile() :
+  mapping_(NULL),
+  mapping_size_(0)
+{
+}
+
+WeightFile::~WeightFile() {
+  Close();
+}
+
+bool WeightFile::IsWeightFile(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  char magic[sizeof(kWeightFileMagic)];
+  const bool is_weight_file = fread(magic, sizeof(magic), 1, file) == 1 &&
+      memcmp(magic, kWeightFileMagic, sizeof(magic)) == 0;
+  fclose(file);
+  return is_weight_file;
+}
+
+bool WeightFile::Open(const std::string& path) {
+  Close();
+
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    printf("Error - could not open weight file %s\n", path.c_str());
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    printf("Error - could not read weight file %s\n", path.c_str());
+    close(fd);
+    return false;
+  }
+
+  // Map the file copy-on-write: all processes using the weight file share the same pages, but
+  // writing to the weights (e.g. training a network whose weights point into the mapping)
+  // copies the pages written to, rather than faulting or changing the file.
+  void* mapping = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    printf("Error - could not map weight file %s\n", path.c_str());
+    return false;
+  }
+  mapping_ = static_cast<const char*>(mapping);
+  mapping_size_ = file_stat.st_size;
+
+  if (mapping_size_ >= sizeof(kWeightFileMagic) &&
+      memcmp(mapping_, kWeightFileMagic, sizeof(kWeightFileMagic)) == 0) {
+    if (!ParseHeader()) {
+      printf("Error - %s is not a valid weight file\n", path.c_str());
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  // Not a weight file, so decode it as a .caffemodel.  The decoded weights are copied,
+  // so the file no longer needs to be mapped.
+  const bool decoded = DecodeCaffeModel();
+  munmap(const_cast<char*>(mapping_), mapping_size_);
+  mapping_ = NULL;
+  mapping_size_ = 0;
+  if (!decoded) {
+    printf("Error - %s is not a valid weight file or caffemodel\n", path.c_str());
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool WeightFile::DecodeCaffeModel() {
+  // Offset of the data of each blob in decoded_data_ (which may be reallocated while decoding).
+  std::vector<size_t> data_offsets;
+
+  WireReader reader(mapping_, mapping_size_);
+  while (reader.HasMore()) {
+    uint32_t field, wire_type;
+    reader.ReadTag(&field, &wire_type);
+    const bool v1_layer = field == kNetLayersV1Field;
+    if ((field != kNetLayerField && !v1_layer) || wire_type != kWireLengthDelimited) {
+      reader.Skip(wire_type);
+      continue;
+    }
+
+    // Decode the name and the blobs of the layer.
+    const uint32_t name_field = v1_layer ? kLayerV1NameField : kLayerNameField;
+    const uint32_t blobs_field = v1_layer ? kLayerV1BlobsField : kLayerBlobsField;
+    std::string layer_name;
+    size_t blob_index = 0;
+    WireReader layer_reader = reader.ReadLengthDelimited();
+    while (layer_reader.HasMore()) {
+      uint32_t layer_field, layer_wire_type;
+      layer_reader.ReadTag(&layer_field, &layer_wire_type);
+      if (layer_field == name_field && layer_wire_type == kWireLengthDelimited) {
+        WireReader name = layer_reader.ReadLengthDelimited();
+        layer_name.assign(name.data(), name.size());
+      } else if (layer_field == blobs_field && layer_wire_type == kWireLengthDelimited) {
+        WeightBlob blob;
+        blob.blob_index = blob_index++;
+        blob.data = NULL;
+        data_offsets.push_back(decoded_data_.size());
+        if (!DecodeBlob(layer_reader.ReadLengthDelimited(), &blob.shape, &decoded_data_)) {
+          return false;
+        }
+        blobs_.push_back(blob);
+      } else {
+        layer_reader.Skip(layer_wire_type);
+      }
+    }
+    if (!layer_reader.ok()) {
+      return false;
+    }
+
+    // The name may come after the blobs.
+    for (size_t i = blobs_.size() - blob_index; i < blobs_.size(); ++i) {
+      blobs_[i].layer_name = layer_name;
+    }
+  }
+
+  // Point each blob at its data.
+  for (size_t i = 0; i < blobs_.size(); ++i) {
+    blobs_[i].data = decoded_data_.empty() ? NULL : &decoded_data_[data_offsets[i]];
+  }
+  return reader.ok();
+}
+
+bool WeightFile::ParseHeader() {
+  HeaderReader reader(mapping_, mapping_size_);
+  const std::string& magic = reader.ReadString(sizeof(kWeightFileMagic));
+  if (!reader.ok() || memcmp(magic.data(), kWeightFileMagic, sizeof(kWeightFileMagic)) != 0 ||
+      reader.ReadUint32() != kWeightFileVersion) {
+    return false;
+  }
+
+  const uint32_t num_blobs = reader.ReadUint32();
+  for (uint32_t i = 0; i < num_blobs && reader.ok(); ++i) {
+    WeightBlob blob;
+    const uint32_t name_length = reader.ReadUint32();
+    blob.layer_name = reader.ReadString(name_length);
+    blob.blob_index = reader.ReadUint32();
+    const uint32_t num_axes = reader.ReadUint32();
+    for (uint32_t j = 0; j < num_axes && reader.ok(); ++j) {
+      blob.shape.push_back(reader.ReadUint32());
+    }
+    const uint64_t data_offset = reader.ReadUint64();
+
+    // Check that the data is aligned and lies within the file.
+    const uint64_t data_size = blob.count() * sizeof(float);
+    if (!reader.ok() || data_offset % kWeightFileAlignment != 0 ||
+        data_offset > mapping_size_ || data_size > mapping_size_ - data_offset) {
+      return false;
+    }
+    blob.data = reinterpret_cast<const float*>(mapping_ + data_offset);
+    blobs_.push_back(blob);
+  }
+  return reader.ok();
+}
+
+void WeightFile::Close() {
+  if (mapping_) {
+    munmap(const_cast<char*>(mapping_), mapping_size_);
+    mapping_ = NULL;
+    mapping_size_ = 0;
+  }
+  blobs_.clear();
+  decoded_data_.clear();
+}
+
+const WeightBlob* WeightFile::FindBlob(const std::string& layer_name, const size_t blob_index) const {
+  for (size_t i = 0; i < blobs_.size(); ++i) {
+    if (blobs_[i].layer_name == layer_name && blobs_[i].blob_index == blob_index) {
+      return &blobs_[i];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,99 @@
+#ifndef WEIGHT_FILE_H
+#define WEIGHT_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A flat binary file of network weights, which can be memory-mapped and used in place.
+// Loading a .caffemodel requires decoding the whole protobuf into newly allocated memory;
+// a weight file is instead mapped copy-on-write, so loading it is nearly free and all processes
+// using the same file share the same physical memory (until a process writes to its weights,
+// e.g. when training, which gives it a private copy of the pages written to).
+//
+// File layout (all values in native byte order):
+//   char magic[8]       "GOTURNW"
+//   uint32 version
+//   uint32 num_blobs
+//   For each blob:
+//     uint32 name_length, char name[name_length]   (name of the layer the blob belongs to)
+//     uint32 blob_index                           (index of the blob within its layer)
+//     uint32 num_axes, uint32 shape[num_axes]
+//     uint64 data_offset                          (from the start of the file)
+//   The float data of each blob, starting at a multiple of kWeightFileAlignment bytes.
+
+// Alignment of the data of each blob in the file (enough for any SIMD load).
+const size_t kWeightFileAlignment = 64;
+
+// A parameter blob of a layer.
+struct WeightBlob {
+  // Name of the layer that this blob belongs to.
+  std::string layer_name;
+
+  // Index of this blob within its layer (e.g. 0 for weights, 1 for biases).
+  size_t blob_index;
+
+  // Dimensions of the blob.
+  std::vector<int> shape;
+
+  // The values of the blob (shape[0] * shape[1] * ... floats).
+  const float* data;
+
+  // Number of values in the blob.
+  size_t count() const;
+};
+
+// Write the given blobs to a weight file at path.
+// Returns false if the file could not be written.
+bool WriteWeightFile(const std::vector<WeightBlob>& blobs, const std::string& path);
+
+// The weights of a network: either a weight file mapped into memory, or the weights
+// decoded from a .caffemodel (so that they can be read without depending on Caffe).
+class WeightFile
+{
+public:
+  WeightFile();
+  ~WeightFile();
+
+  // Returns true if the file at path is a weight file (rather than, e.g., a .caffemodel).
+  static bool IsWeightFile(const std::string& path);
+
+  // Map the weight file at path into memory (copy-on-write), or, if path is a .caffemodel
+  // rather than a weight file, decode the weights from it into memory.
+  // Returns false if the file could not be read or is not valid.
+  bool Open(const std::string& path);
+
+  // Get the blob with the given index in the given layer, or NULL if the file has no such blob.
+  // The data of the blob is valid while this object exists.
+  const WeightBlob* FindBlob(const std::string& layer_name, const size_t blob_index) const;
+
+  // All of the blobs in the file.
+  const std::vector<WeightBlob>& blobs() const { return blobs_; }
+
+private:
+  // Unmap the file, if mapped.
+  void Close();
+
+  // Parse the header of the mapped file.  Returns false if it is not valid.
+  bool ParseHeader();
+
+  // Decode the weights from the mapped file, which is a .caffemodel (a NetParameter protobuf).
+  // Returns false if it is not valid.
+  bool DecodeCaffeModel();
+
+  // The mapped file.
+  const char* mapping_;
+  size_t mapping_size_;
+
+  // The blobs in the file.
+  std::vector<WeightBlob> blobs_;
+
+  // Values of the blobs decoded from a .caffemodel (blobs_ point into this).
+  std::vector<float> decoded_data_;
+
+  // Not copyable (the mapping is owned by this object).
+  WeightFile(const WeightFile&);
+  WeightFile& operator=(const WeightFile&);
+};
+
+#endif // WEIGHT_FILE_H
@@ -9,6 +9,7 @@
 
 #include "helper/high_res_timer.h"
 #include "network/regressor.h"
+#include "loader/frame_prefetcher.h"
 #include "loader/loader_alov.h"
 #include "loader/loader_vot.h"
 #include "tracker/tracker.h"
@@ -46,6 +47,10 @@ int main (int argc, char *argv[]) {
   LoaderVOT loader(videos_folder);
   videos = loader.get_videos();
 
+  // Read the frames of each video ahead of the tracker.
+  FramePrefetcher prefetcher(kPrefetchThreads, kPrefetchFrames, kPrefetchBytes);
+  prefetcher.Attach(&videos);
+
   // Create a tracker object.
   const bool show_intermediate_output = false;
   Tracker tracker(show_intermediate_output);
@@ -0,0 +1,123 @@
+// Check that tracking does not allocate heap memory after the first tracked frame of each
+// video (see helper/allocation_counter.h).
+// Tracks the first frames of a few ALOV videos with the native CPU engine, and exits with a
+// non-zero status if any allocation was made while tracking a frame after the first one.
+// Must be built with COUNT_ALLOCATIONS (cmake -DCOUNT_ALLOCATIONS=ON).
+// (The Caffe Regressor is not checked: stock Caffe allocates on every forward pass.)
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "helper/allocation_counter.h"
+#include "loader/loader_alov.h"
+#include "network/native_regressor.h"
+#include "tracker/tracker.h"
+#include "tracker/tracker_manager.h"
+
+using std::string;
+
+namespace {
+
+// Counts the allocations made by the tracker in each frame.
+class AllocationChecker : public TrackerManager
+{
+public:
+  AllocationChecker(const std::vector<Video>& videos, RegressorBase* regressor, Tracker* tracker) :
+    TrackerManager(videos, regressor, tracker),
+    video_num_(0),
+    frames_tracked_(0),
+    allocations_before_(0),
+    num_failed_frames_(0)
+  {
+  }
+
+  virtual void VideoInit(const Video& video, const size_t video_num) {
+    video_num_ = video_num;
+    frames_tracked_ = 0;
+  }
+
+  virtual void SetupEstimate() {
+    allocations_before_ = AllocationCounter::count();
+  }
+
+  virtual void FinishEstimate(const size_t num_frames) {
+    const size_t num_allocations = AllocationCounter::count() - allocations_before_;
+
+    // The first tracked frame of each video may allocate the buffers reused by later frames.
+    if (frames_tracked_ > 0 && num_allocations > 0) {
+      printf("Error - tracked frame %zu of video %zu made %zu heap allocations\n",
+             frames_tracked_, video_num_, num_allocations);
+      num_failed_frames_++;
+    }
+    frames_tracked_ += num_frames;
+  }
+
+  // Number of frames that made allocations.
+  size_t num_failed_frames() const { return num_failed_frames_; }
+
+private:
+  // The video being tracked, and the number of its frames tracked so far.
+  size_t video_num_;
+  size_t frames_tracked_;
+
+  // Allocation count before tracking the current frame.
+  size_t allocations_before_;
+
+  size_t num_failed_frames_;
+};
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc < 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " videos_folder annotations_folder deploy.prototxt network.caffemodel"
+              << " [num_videos] [num_frames]" << std::endl;
+    return 1;
+  }
+
+  if (!AllocationCounter::enabled()) {
+    printf("Error - allocations are not counted; build with cmake -DCOUNT_ALLOCATIONS=ON\n");
+    return 1;
+  }
+
+  const string videos_folder      = argv[1];
+  const string annotations_folder = argv[2];
+  const string test_proto         = argv[3];
+  const string caffe_model        = argv[4];
+
+  // Number of videos to track, and the number of frames to track in each.
+  const size_t num_videos         = argc > 5 ? atoi(argv[5]) : 3;
+  const size_t num_frames         = argc > 6 ? atoi(argv[6]) : 30;
+
+  // Run the network on this thread only, since only the allocations of this thread are counted.
+  const size_t network_threads = 1;
+  NativeRegressor regressor(test_proto, caffe_model, network_threads);
+
+  // Get the first frames of the first videos of the validation set.
+  std::vector<Video> videos;
+  LoaderAlov loader(videos_folder, annotations_folder);
+  const bool use_train = false;
+  loader.get_videos(use_train, &videos);
+  videos.resize(std::min(videos.size(), num_videos));
+  for (size_t i = 0; i < videos.size(); ++i) {
+    videos[i].all_frames.resize(std::min(videos[i].all_frames.size(), num_frames));
+  }
+
+  // Track the videos, counting the allocations made in each frame.
+  const bool show_intermediate_output = false;
+  Tracker tracker(show_intermediate_output);
+  AllocationChecker checker(videos, &regressor, &tracker);
+  checker.TrackAll();
+
+  if (checker.num_failed_frames() > 0) {
+    printf("Error - %zu tracked frames made heap allocations\n", checker.num_failed_frames());
+    return 1;
+  }
+  printf("No heap allocations after the first tracked frame of %zu videos\n", videos.size());
+  return 0;
+}
@@ -0,0 +1,146 @@
+// Check the annotation index of Video (see Video::BuildAnnotationIndex) against a brute-force
+// scan of the annotations: for every frame, whether it has an annotation (and which one), and
+// the next annotated frame after it.
+// Checks randomly generated videos (with unsorted and repeated annotations), both before and
+// after the index is built, and, if given, the videos of ALOV.
+// Exits with a non-zero status if any frame does not match.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include "loader/loader_alov.h"
+#include "loader/video.h"
+
+using std::string;
+
+namespace {
+
+// Number of random videos to check, and the largest frame number that they annotate.
+const int kNumRandomVideos = 200;
+const int kMaxRandomFrame = 100;
+
+// Find the annotation of frame_num by scanning all annotations (the first one, if repeated).
+// Returns false if the frame is not annotated.
+bool ScanAnnotation(const Video& video, const int frame_num, BoundingBox* box) {
+  for (size_t i = 0; i < video.annotations.size(); ++i) {
+    if (video.annotations[i].frame_num == frame_num) {
+      *box = video.annotations[i].bbox;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Find the first annotated frame after frame_num by scanning all annotations, or -1.
+int ScanNextAnnotatedFrame(const Video& video, const int frame_num) {
+  int next_frame = -1;
+  for (size_t i = 0; i < video.annotations.size(); ++i) {
+    const int annotated_frame = video.annotations[i].frame_num;
+    if (annotated_frame > frame_num && (next_frame < 0 || annotated_frame < next_frame)) {
+      next_frame = annotated_frame;
+    }
+  }
+  return next_frame;
+}
+
+// Compare the annotation lookups of video with the brute-force scans, for every frame from
+// before the first frame to after the last annotated frame.
+// Returns the number of frames that do not match.
+int CheckVideo(const Video& video, const string& name) {
+  int last_frame = -1;
+  for (size_t i = 0; i < video.annotations.size(); ++i) {
+    last_frame = std::max(last_frame, video.annotations[i].frame_num);
+  }
+
+  int num_errors = 0;
+  for (int frame_num = -2; frame_num <= last_frame + 2; ++frame_num) {
+    // Find the annotation of this frame (without loading the image).
+    BoundingBox box;
+    BoundingBox scanned_box;
+    cv::Mat image;
+    const bool draw_bounding_box = false;
+    const bool load_only_annotation = true;
+    const bool has_annotation = video.LoadFrame(frame_num, draw_bounding_box,
+                                                load_only_annotation, &image, &box);
+    const bool scanned_annotation = ScanAnnotation(video, frame_num, &scanned_box);
+    if (has_annotation != scanned_annotation ||
+        (has_annotation && (box.x1_ != scanned_box.x1_ || box.y1_ != scanned_box.y1_ ||
+                            box.x2_ != scanned_box.x2_ || box.y2_ != scanned_box.y2_))) {
+      printf("Error - %s: wrong annotation for frame %d\n", name.c_str(), frame_num);
+      num_errors++;
+    }
+
+    // Find the next annotated frame.
+    const int next_frame = video.NextAnnotatedFrame(frame_num);
+    const int scanned_next_frame = ScanNextAnnotatedFrame(video, frame_num);
+    if (next_frame != scanned_next_frame) {
+      printf("Error - %s: next annotated frame after %d is %d, expected %d\n",
+             name.c_str(), frame_num, next_frame, scanned_next_frame);
+      num_errors++;
+    }
+  }
+  return num_errors;
+}
+
+// Make a video with random annotations (in random order, with some frames annotated twice).
+void MakeRandomVideo(Video* video) {
+  const int num_annotations = rand() % 20;
+  for (int i = 0; i < num_annotations; ++i) {
+    Frame frame;
+    frame.frame_num = rand() % (kMaxRandomFrame + 1);
+    frame.bbox.x1_ = rand() % 100;
+    frame.bbox.y1_ = rand() % 100;
+    frame.bbox.x2_ = frame.bbox.x1_ + 1 + rand() % 100;
+    frame.bbox.y2_ = frame.bbox.y1_ + 1 + rand() % 100;
+    video->annotations.push_back(frame);
+  }
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc != 1 && argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " [videos_folder annotations_folder]" << std::endl;
+    return 1;
+  }
+
+  int num_errors = 0;
+
+  // Check random videos, searching the annotations and then with the index.
+  srand(0);
+  for (int i = 0; i < kNumRandomVideos; ++i) {
+    Video video;
+    MakeRandomVideo(&video);
+    const string name = "random video " + boost::lexical_cast<string>(i);
+    num_errors += CheckVideo(video, name + " (not indexed)");
+    video.BuildAnnotationIndex();
+    num_errors += CheckVideo(video, name + " (indexed)");
+  }
+  printf("Checked %d random videos\n", kNumRandomVideos);
+
+  // Check the videos of ALOV (which the loader indexes).
+  if (argc == 3) {
+    LoaderAlov loader(argv[1], argv[2]);
+    for (int use_train = 0; use_train <= 1; ++use_train) {
+      std::vector<Video> videos;
+      loader.get_videos(use_train, &videos);
+      for (size_t i = 0; i < videos.size(); ++i) {
+        num_errors += CheckVideo(videos[i], videos[i].path);
+      }
+      printf("Checked %zu ALOV videos\n", videos.size());
+    }
+  }
+
+  if (num_errors > 0) {
+    printf("Error - %d lookups did not match the annotations\n", num_errors);
+    return 1;
+  }
+  printf("All lookups match the annotations\n");
+  return 0;
+}
@@ -0,0 +1,358 @@
+// Check the single-pass preprocessing of helper/image_proc.h against the OpenCV pipeline that
+// it replaces.
+// CropPadResizePlanar is compared with CropPadImage followed by the preprocessing of the Caffe
+// Regressor before it was fused (cv::cvtColor, cv::resize, convertTo, subtracting the mean and
+// splitting the channels), and ResizePlanar with the same preprocessing of an already cropped
+// image.  The boxes are random (from tiny, so that the crops are upscaled, to larger than the
+// image, so that they are downscaled and padded), plus boxes at the corners and edges of the
+// image, in gray, BGR and BGRA images, converted to 1 and 3 channels.
+// CropPadResize is compared with CropPadImage followed by cv::resize: the location, edge
+// spacing and size of the padded image should be the same, and so should the pixels, except
+// at the border of the padded image, where cv::resize replicates the edge pixels of the padded
+// image and CropPadResize blends them with black.
+// Exits with a non-zero status if any output differs by more than its tolerance.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "helper/bounding_box.h"
+#include "helper/image_proc.h"
+
+using std::string;
+
+namespace {
+
+// Size of the input to the network.
+const cv::Size kOutputSize(227, 227);
+
+// Number of random boxes checked in each image.
+const int kNumRandomBoxes = 200;
+
+// Largest difference of the planar outputs from those of the OpenCV pipeline, which rounds the
+// resized (and, for grayscale, the converted) image to 8 bits and resizes with fixed-point weights.
+const double kMaxPlanarDifference = 1.5;
+
+// Largest and mean difference of the pixels of CropPadResize from those of cv::resize, away
+// from the border of the padded image.  cv::warpAffine samples at 1/32 of a pixel, so the
+// difference grows with the gradient of the image, up to about 255 / 32 (plus rounding) at a
+// step of full contrast, such as where the image meets the black padding; and when a tiny crop
+// is upscaled about 100 times, these steps cover most of the output.
+const double kMaxWarpDifference = 9;
+const double kMaxWarpMeanDifference = 2;
+
+// An image to check, and the number of channels of the network that it is converted to.
+struct ImageCase {
+  string name;
+  cv::Mat image;
+  int num_channels;
+};
+
+// Make a test image with smooth gradients and some noise, with the given number of channels.
+cv::Mat MakeImage(const cv::Size& size, const int channels) {
+  cv::Mat image(size, CV_8UC(channels));
+  for (int y = 0; y < size.height; ++y) {
+    uchar* row = image.ptr<uchar>(y);
+    for (int x = 0; x < size.width; ++x) {
+      for (int c = 0; c < channels; ++c) {
+        const double value = 128 + 100 * sin(0.05 * x + c) * cos(0.07 * y - c) + rand() % 16;
+        row[x * channels + c] = cv::saturate_cast<uchar>(value);
+      }
+    }
+  }
+  return image;
+}
+
+// Make a random box in an image of the given size, from 1 pixel to 1.5 times the size of the
+// image, centered in the image.
+BoundingBox MakeRandomBox(const cv::Size& image_size) {
+  const double width = std::max(1.0, 1.5 * image_size.width * pow(static_cast<double>(rand()) / RAND_MAX, 2));
+  const double height = std::max(1.0, 1.5 * image_size.height * pow(static_cast<double>(rand()) / RAND_MAX, 2));
+  const double center_x = image_size.width * static_cast<double>(rand()) / RAND_MAX;
+  const double center_y = image_size.height * static_cast<double>(rand()) / RAND_MAX;
+  BoundingBox box;
+  box.x1_ = center_x - width / 2;
+  box.y1_ = center_y - height / 2;
+  box.x2_ = center_x + width / 2;
+  box.y2_ = center_y + height / 2;
+  return box;
+}
+
+// Make boxes of the given size centered at the corners, at the middle of the edges and at the
+// center of an image of image_size.
+void MakeEdgeBoxes(const cv::Size& image_size, const double width, const double height,
+                   std::vector<BoundingBox>* boxes) {
+  const double centers_x[] = { 0, image_size.width / 2.0, image_size.width - 1.0 };
+  const double centers_y[] = { 0, image_size.height / 2.0, image_size.height - 1.0 };
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      BoundingBox box;
+      box.x1_ = centers_x[i] - width / 2;
+      box.y1_ = centers_y[j] - height / 2;
+      box.x2_ = centers_x[i] + width / 2;
+      box.y2_ = centers_y[j] + height / 2;
+      boxes->push_back(box);
+    }
+  }
+}
+
+// Make the boxes to check in an image of image_size: boxes at the corners and edges of the
+// image (tiny, the size of the image and twice the size of the image) and random boxes.
+void MakeBoxes(const cv::Size& image_size, std::vector<BoundingBox>* boxes) {
+  MakeEdgeBoxes(image_size, 1, 1, boxes);
+  MakeEdgeBoxes(image_size, image_size.width, image_size.height, boxes);
+  MakeEdgeBoxes(image_size, 2 * image_size.width, 2 * image_size.height, boxes);
+  for (int i = 0; i < kNumRandomBoxes; ++i) {
+    boxes->push_back(MakeRandomBox(image_size));
+  }
+}
+
+// Preprocess image as the Caffe Regressor did before the preprocessing was fused: convert it
+// to the channels of the network, resize it, convert it to float, subtract the mean and split
+// the channels into planes in output.
+void ReferencePreprocess(const cv::Mat& image, const cv::Size& output_size, const cv::Scalar& mean,
+                         const int num_channels, std::vector<float>* output) {
+  // Convert the input image to the input image format of the network.
+  cv::Mat sample;
+  if (image.channels() == 3 && num_channels == 1)
+    cv::cvtColor(image, sample, CV_BGR2GRAY);
+  else if (image.channels() == 4 && num_channels == 1)
+    cv::cvtColor(image, sample, CV_BGRA2GRAY);
+  else if (image.channels() == 4 && num_channels == 3)
+    cv::cvtColor(image, sample, CV_BGRA2BGR);
+  else if (image.channels() == 1 && num_channels == 3)
+    cv::cvtColor(image, sample, CV_GRAY2BGR);
+  else
+    sample = image;
+
+  // Convert the input image to the expected size.
+  cv::Mat sample_resized;
+  if (sample.size() != output_size)
+    cv::resize(sample, sample_resized, output_size);
+  else
+    sample_resized = sample;
+
+  // Convert to float and subtract the mean.
+  cv::Mat sample_float;
+  sample_resized.convertTo(sample_float, num_channels == 3 ? CV_32FC3 : CV_32FC1);
+  cv::Mat sample_normalized;
+  cv::subtract(sample_float, mean, sample_normalized);
+
+  // Split the channels into planes.
+  std::vector<cv::Mat> channels;
+  cv::split(sample_normalized, channels);
+  const int plane_size = output_size.width * output_size.height;
+  output->resize(num_channels * plane_size);
+  for (int c = 0; c < num_channels; ++c) {
+    for (int y = 0; y < output_size.height; ++y) {
+      memcpy(&(*output)[c * plane_size + y * output_size.width], channels[c].ptr<float>(y),
+             output_size.width * sizeof(float));
+    }
+  }
+}
+
+// Get the largest difference between two outputs.
+double MaxDifference(const std::vector<float>& output, const std::vector<float>& reference) {
+  double max_difference = 0;
+  for (size_t i = 0; i < output.size(); ++i) {
+    max_difference = std::max(max_difference, static_cast<double>(fabs(output[i] - reference[i])));
+  }
+  return max_difference;
+}
+
+// Whether the crop of image around bbox is upscaled to output_size (rather than downscaled).
+bool IsUpscaled(const BoundingBox& bbox, const cv::Mat& image, const cv::Size& output_size) {
+  BoundingBox pad_image_location;
+  double edge_spacing_x, edge_spacing_y;
+  cv::Rect roi;
+  cv::Size pad_image_size;
+  ComputeCropPadImageGeometry(bbox, image.size(), &pad_image_location,
+                              &edge_spacing_x, &edge_spacing_y, &roi, &pad_image_size);
+  return pad_image_size.width * pad_image_size.height < output_size.width * output_size.height;
+}
+
+// Compare CropPadResizePlanar, and ResizePlanar of the crops, with the OpenCV pipeline for
+// each box in the image.  Returns the number of outputs that differ by more than the tolerance.
+int CheckPlanar(const ImageCase& image_case, const std::vector<BoundingBox>& boxes) {
+  const cv::Scalar mean(104, 117, 123);
+  ResampleBuffers buffers;
+  std::vector<float> output(image_case.num_channels * kOutputSize.width * kOutputSize.height);
+  std::vector<float> reference;
+
+  int num_errors = 0;
+  double max_differences[2] = { 0, 0 };
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    const BoundingBox& bbox = boxes[i];
+    cv::Mat pad_image;
+    CropPadImage(bbox, image_case.image, &pad_image);
+    ReferencePreprocess(pad_image, kOutputSize, mean, image_case.num_channels, &reference);
+    const bool upscaled = IsUpscaled(bbox, image_case.image, kOutputSize);
+
+    // Crop, resize and normalize in a single pass from the full image.
+    CropPadResizePlanar(bbox, image_case.image, kOutputSize, mean, image_case.num_channels,
+                        &buffers, &output[0]);
+    const double crop_difference = MaxDifference(output, reference);
+
+    // Resize and normalize the crop.
+    ResizePlanar(pad_image, kOutputSize, mean, image_case.num_channels, &buffers, &output[0]);
+    const double resize_difference = MaxDifference(output, reference);
+
+    max_differences[upscaled] = std::max(max_differences[upscaled],
+                                         std::max(crop_difference, resize_difference));
+    if (crop_difference > kMaxPlanarDifference || resize_difference > kMaxPlanarDifference) {
+      printf("Error - %s, box (%lf, %lf, %lf, %lf): CropPadResizePlanar differs by %lf and ResizePlanar by %lf\n",
+             image_case.name.c_str(), bbox.x1_, bbox.y1_, bbox.x2_, bbox.y2_,
+             crop_difference, resize_difference);
+      num_errors++;
+    }
+  }
+  printf("%-28s planar: max difference %lf (downscaled), %lf (upscaled), tolerance %lf\n",
+         image_case.name.c_str(), max_differences[0], max_differences[1], kMaxPlanarDifference);
+  return num_errors;
+}
+
+// Whether the location of an output pixel along an axis (of output_length pixels) is inside
+// the padded image (of pad_length pixels), so that cv::resize does not replicate the border.
+bool IsInsidePadImage(const int output_index, const int output_length, const int pad_length) {
+  const double location = (output_index + 0.5) * pad_length / output_length - 0.5;
+  return location >= 0 && location <= pad_length - 1;
+}
+
+// Compare CropPadResize with CropPadImage followed by cv::resize for each box in image.
+// Returns the number of boxes whose geometry differs, or whose pixels differ by more than the
+// tolerance away from the border of the padded image.
+int CheckCropPadResize(const string& name, const cv::Mat& image,
+                       const std::vector<BoundingBox>& boxes) {
+  const int channels = image.channels();
+
+  int num_errors = 0;
+  double max_inside_difference = 0;
+  double max_mean_difference = 0;
+  double max_border_difference = 0;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    const BoundingBox& bbox = boxes[i];
+
+    // Crop, pad and resize the image in two steps.
+    cv::Mat pad_image;
+    BoundingBox pad_image_location;
+    double edge_spacing_x, edge_spacing_y;
+    CropPadImage(bbox, image, &pad_image, &pad_image_location, &edge_spacing_x, &edge_spacing_y);
+    cv::Mat reference;
+    cv::resize(pad_image, reference, kOutputSize);
+
+    // Crop, pad and resize the image in a single warp.
+    cv::Mat output;
+    BoundingBox warp_location;
+    double warp_edge_spacing_x, warp_edge_spacing_y;
+    cv::Size warp_pad_image_size;
+    CropPadResize(bbox, image, kOutputSize, &output, &warp_location,
+                  &warp_edge_spacing_x, &warp_edge_spacing_y, &warp_pad_image_size);
+
+    // The geometry should be the same.
+    if (warp_location.x1_ != pad_image_location.x1_ || warp_location.y1_ != pad_image_location.y1_ ||
+        warp_location.x2_ != pad_image_location.x2_ || warp_location.y2_ != pad_image_location.y2_ ||
+        warp_edge_spacing_x != edge_spacing_x || warp_edge_spacing_y != edge_spacing_y ||
+        warp_pad_image_size != pad_image.size()) {
+      printf("Error - %s, box (%lf, %lf, %lf, %lf): CropPadResize gives location (%lf, %lf, %lf, %lf), edge spacing (%lf, %lf) and size %dx%d instead of (%lf, %lf, %lf, %lf), (%lf, %lf) and %dx%d\n",
+             name.c_str(), bbox.x1_, bbox.y1_, bbox.x2_, bbox.y2_,
+             warp_location.x1_, warp_location.y1_, warp_location.x2_, warp_location.y2_,
+             warp_edge_spacing_x, warp_edge_spacing_y,
+             warp_pad_image_size.width, warp_pad_image_size.height,
+             pad_image_location.x1_, pad_image_location.y1_, pad_image_location.x2_, pad_image_location.y2_,
+             edge_spacing_x, edge_spacing_y, pad_image.cols, pad_image.rows);
+      num_errors++;
+      continue;
+    }
+    if (output.size() != kOutputSize || output.type() != image.type()) {
+      printf("Error - %s: CropPadResize gives an image of %dx%d, type %d instead of %dx%d, type %d\n",
+             name.c_str(), output.cols, output.rows, output.type(),
+             kOutputSize.width, kOutputSize.height, image.type());
+      num_errors++;
+      continue;
+    }
+
+    // Compare the pixels, separately inside and at the border of the padded image.
+    double inside_difference = 0;
+    double total_inside_difference = 0;
+    int num_inside = 0;
+    for (int y = 0; y < kOutputSize.height; ++y) {
+      const bool inside_y = IsInsidePadImage(y, kOutputSize.height, pad_image.rows);
+      const uchar* output_row = output.ptr<uchar>(y);
+      const uchar* reference_row = reference.ptr<uchar>(y);
+      for (int x = 0; x < kOutputSize.width; ++x) {
+        const bool inside = inside_y && IsInsidePadImage(x, kOutputSize.width, pad_image.cols);
+        for (int c = 0; c < channels; ++c) {
+          const double difference = abs(output_row[x * channels + c] - reference_row[x * channels + c]);
+          if (inside) {
+            inside_difference = std::max(inside_difference, difference);
+            total_inside_difference += difference;
+            num_inside++;
+          } else {
+            max_border_difference = std::max(max_border_difference, difference);
+          }
+        }
+      }
+    }
+    const double mean_difference = num_inside > 0 ? total_inside_difference / num_inside : 0;
+    max_inside_difference = std::max(max_inside_difference, inside_difference);
+    max_mean_difference = std::max(max_mean_difference, mean_difference);
+    if (inside_difference > kMaxWarpDifference || mean_difference > kMaxWarpMeanDifference) {
+      printf("Error - %s, box (%lf, %lf, %lf, %lf): CropPadResize differs by up to %lf (%lf on average) inside the padded image\n",
+             name.c_str(), bbox.x1_, bbox.y1_, bbox.x2_, bbox.y2_, inside_difference, mean_difference);
+      num_errors++;
+    }
+  }
+  printf("%-28s CropPadResize: max difference %lf (tolerance %lf), mean %lf (tolerance %lf), %lf at the border of the padded image\n",
+         name.c_str(), max_inside_difference, kMaxWarpDifference, max_mean_difference,
+         kMaxWarpMeanDifference, max_border_difference);
+  return num_errors;
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  srand(0);
+
+  // Check gray, BGR and BGRA images, larger and smaller than the network input (converted to
+  // 1 and 3 channels for the planar outputs), with boxes at their corners and edges, and random boxes.
+  const cv::Size image_sizes[] = { cv::Size(640, 480), cv::Size(150, 100) };
+  const int image_channels[] = { 1, 3, 4 };
+  const int network_channels[] = { 1, 3 };
+  int num_errors = 0;
+  for (size_t i = 0; i < sizeof(image_sizes) / sizeof(image_sizes[0]); ++i) {
+    for (size_t j = 0; j < sizeof(image_channels) / sizeof(image_channels[0]); ++j) {
+      const cv::Mat image = MakeImage(image_sizes[i], image_channels[j]);
+      std::vector<BoundingBox> boxes;
+      MakeBoxes(image.size(), &boxes);
+
+      char name[64];
+      sprintf(name, "%dx%d, %d channels", image_sizes[i].width, image_sizes[i].height,
+              image_channels[j]);
+      num_errors += CheckCropPadResize(name, image, boxes);
+
+      for (size_t k = 0; k < sizeof(network_channels) / sizeof(network_channels[0]); ++k) {
+        sprintf(name, "%dx%d, %d to %d channels", image_sizes[i].width, image_sizes[i].height,
+                image_channels[j], network_channels[k]);
+        ImageCase image_case;
+        image_case.name = name;
+        image_case.image = image;
+        image_case.num_channels = network_channels[k];
+        num_errors += CheckPlanar(image_case, boxes);
+      }
+    }
+  }
+
+  if (num_errors > 0) {
+    printf("Error - %d outputs differ by more than their tolerance\n", num_errors);
+    return 1;
+  }
+  printf("All outputs match the OpenCV pipeline\n");
+  return 0;
+}
@@ -0,0 +1,167 @@
+// Check that MultiTracker (see tracker/multi_tracker.h) gives the same estimates as Tracker.
+// Tracks the first frames of a few ALOV videos with a Tracker, and with MultiTrackers tracking
+// the same target once and several times (so that the targets are estimated in a batch), on the
+// full-size frames and on frames resized by half (as when decoding them at a reduced scale).
+// Exits with a non-zero status if any estimate of MultiTracker differs from that of Tracker.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "loader/loader_alov.h"
+#include "network/native_regressor.h"
+#ifdef USE_CAFFE
+#include "network/regressor.h"
+#endif
+#include "tracker/multi_tracker.h"
+#include "tracker/tracker.h"
+
+using std::string;
+
+namespace {
+
+// Number of frames tracked in each video.
+const int kNumFrames = 20;
+
+// Number of copies of the target tracked by the batched MultiTracker.
+const size_t kNumCopies = 3;
+
+// Largest difference (in pixels) between the estimates of Tracker and MultiTracker.
+// Tracker runs the network on one image, and MultiTracker on a batch, which may change the
+// order of the floating-point operations.
+const double kMaxEstimateDifference = 1e-2;
+
+bool SameBoundingBox(const BoundingBox& a, const BoundingBox& b, const double max_difference) {
+  return fabs(a.x1_ - b.x1_) <= max_difference && fabs(a.y1_ - b.y1_) <= max_difference &&
+         fabs(a.x2_ - b.x2_) <= max_difference && fabs(a.y2_ - b.y2_) <= max_difference;
+}
+
+// Load a frame of video, resized by image_scale.
+void LoadFrame(const Video& video, const int frame_num, const double image_scale, cv::Mat* image) {
+  const bool draw_bounding_box = false;
+  const bool load_only_annotation = false;
+  cv::Mat full_image;
+  BoundingBox bbox_gt;
+  video.LoadFrame(frame_num, draw_bounding_box, load_only_annotation, &full_image, &bbox_gt);
+  if (image_scale == 1) {
+    *image = full_image;
+  } else {
+    cv::resize(full_image, *image, cv::Size(), image_scale, image_scale);
+  }
+}
+
+// Track the first frames of video with a Tracker and with a MultiTracker tracking num_copies
+// copies of the target, on frames resized by image_scale, and check that every copy gets the
+// same estimate as the Tracker.  Returns the number of frames whose estimates differ.
+int CheckVideo(const Video& video, const size_t num_copies, const double image_scale,
+               RegressorBase* regressor) {
+  // Skip videos without annotations.
+  if (video.annotations.empty()) {
+    return 0;
+  }
+  const int first_frame = video.annotations[0].frame_num;
+  const int last_frame = std::min<int>(first_frame + kNumFrames, video.all_frames.size() - 1);
+
+  // Initialize both trackers with the first annotation (the first frame is always full-size).
+  const bool show_intermediate_output = false;
+  cv::Mat image;
+  BoundingBox bbox_gt;
+  int frame_num;
+  video.LoadFirstAnnotation(&frame_num, &image, &bbox_gt);
+  Tracker tracker(show_intermediate_output);
+  tracker.Init(image, bbox_gt, regressor);
+  MultiTracker multi_tracker;
+  multi_tracker.Init(image, std::vector<BoundingBox>(num_copies, bbox_gt), regressor);
+
+  // Track the following frames with both trackers.
+  int num_different = 0;
+  BoundingBox bbox_estimate;
+  std::vector<BoundingBox> bboxes_estimate;
+  for (frame_num = first_frame + 1; frame_num <= last_frame; ++frame_num) {
+    LoadFrame(video, frame_num, image_scale, &image);
+    tracker.Track(image, image_scale, regressor, &bbox_estimate);
+    multi_tracker.Track(image, image_scale, regressor, &bboxes_estimate);
+
+    bool same = bboxes_estimate.size() == num_copies;
+    for (size_t i = 0; same && i < num_copies; ++i) {
+      same = SameBoundingBox(bboxes_estimate[i], bbox_estimate, kMaxEstimateDifference);
+    }
+    if (!same) {
+      printf("Error - %s, frame %d (%zu targets, scale %g): MultiTracker does not estimate (%lf, %lf, %lf, %lf) as Tracker does\n",
+             video.path.c_str(), frame_num, num_copies, image_scale,
+             bbox_estimate.x1_, bbox_estimate.y1_, bbox_estimate.x2_, bbox_estimate.y2_);
+      num_different++;
+    }
+  }
+  return num_different;
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc < 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " videos_folder annotations_folder deploy.prototxt network.caffemodel"
+              << " [gpu_id] [num_videos]" << std::endl
+              << "(gpu_id -1, the default, runs the network with the native CPU engine instead of Caffe)" << std::endl;
+    return 1;
+  }
+
+#ifdef USE_CAFFE
+  ::google::InitGoogleLogging(argv[0]);
+#endif
+
+  const string videos_folder      = argv[1];
+  const string annotations_folder = argv[2];
+  const string test_proto         = argv[3];
+  const string caffe_model        = argv[4];
+  const int gpu_id                = argc > 5 ? atoi(argv[5]) : -1;
+  const size_t num_videos         = argc > 6 ? atoi(argv[6]) : 5;
+
+  // Create the regressor.
+  boost::shared_ptr<RegressorBase> regressor;
+#ifdef USE_CAFFE
+  if (gpu_id >= 0) {
+    const bool do_train = false;
+    regressor.reset(new Regressor(test_proto, caffe_model, gpu_id, do_train));
+  }
+#endif
+  if (!regressor) {
+    const size_t network_threads = 0;
+    regressor.reset(new NativeRegressor(test_proto, caffe_model, network_threads));
+  }
+
+  // Get the first videos of the validation set.
+  std::vector<Video> videos;
+  LoaderAlov loader(videos_folder, annotations_folder);
+  const bool use_train = false;
+  loader.get_videos(use_train, &videos);
+  videos.resize(std::min(videos.size(), num_videos));
+
+  // Track each video with a single target and with a batch of copies of it, at full size
+  // and at half size.
+  const size_t copies[] = { 1, kNumCopies };
+  const double image_scales[] = { 1, 0.5 };
+  int num_errors = 0;
+  for (size_t i = 0; i < videos.size(); ++i) {
+    for (size_t j = 0; j < sizeof(copies) / sizeof(copies[0]); ++j) {
+      for (size_t k = 0; k < sizeof(image_scales) / sizeof(image_scales[0]); ++k) {
+        num_errors += CheckVideo(videos[i], copies[j], image_scales[k], regressor.get());
+      }
+    }
+  }
+  printf("Checked MultiTracker against Tracker in %zu videos\n", videos.size());
+
+  if (num_errors > 0) {
+    printf("Error - %d estimates of MultiTracker differ from those of Tracker\n", num_errors);
+    return 1;
+  }
+  printf("All estimates match\n");
+  return 0;
+}
@@ -0,0 +1,254 @@
+// Check that the regressors that run the network without Caffe give the same estimates as the
+// Caffe Regressor (see network/native_regressor.h, network/compiled_regressor.h and
+// network/quantized_regressor.h).
+// Loads pairs of consecutive annotated frames from the first ALOV videos, and estimates the
+// target in each with every regressor, through each way of running it: one image at a time,
+// with a prepared target, in batches, and with RegressAsync (on its helper threads).  The native
+// network is run both on a single thread and on all CPUs.  Reports the largest difference of the
+// output of fc8 (the estimated bounding box) from that of Regressor, run one image at a time.
+// Exits with a non-zero status if any difference is above its tolerance.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/thread/future.hpp>
+
+#include "loader/loader_alov.h"
+#ifdef USE_COMPILED_NET
+#include "network/compiled_regressor.h"
+#endif
+#include "network/native_regressor.h"
+#include "network/quantized_regressor.h"
+#include "network/regressor.h"
+
+using std::string;
+
+namespace {
+
+// Largest difference of fc8 from that of Regressor, for the float engines (the outputs are
+// around 0 to 10, so this allows only for differences in the order of floating-point operations),
+// and for the engine with 8-bit fully-connected layers.
+const double kMaxFloatDifference = 1e-3;
+const double kMaxQuantizedDifference = 0.2;
+
+// Number of images estimated in each batch.
+const size_t kBatchSize = 8;
+
+// The inputs of one estimate: the search region in the current frame and the target in the
+// previous frame.
+struct Crop {
+  cv::Mat image_curr;
+  BoundingBox bbox_curr_prior_tight;
+  cv::Mat image_prev;
+  BoundingBox bbox_prev_tight;
+};
+
+// Load up to max_crops pairs of consecutive annotated frames of videos, searching for the target
+// of the earlier frame around its location in the later frame (as the tracker does).
+void LoadCrops(const std::vector<Video>& videos, const size_t max_crops, std::vector<Crop>* crops) {
+  const bool draw_bounding_box = false;
+  const bool load_only_annotation = false;
+  for (size_t i = 0; i < videos.size() && crops->size() < max_crops; ++i) {
+    const Video& video = videos[i];
+    for (size_t j = 1; j < video.annotations.size() && crops->size() < max_crops; ++j) {
+      Crop crop;
+      BoundingBox bbox_curr_gt;
+      video.LoadFrame(video.annotations[j - 1].frame_num, draw_bounding_box, load_only_annotation,
+                      &crop.image_prev, &crop.bbox_prev_tight);
+      video.LoadFrame(video.annotations[j].frame_num, draw_bounding_box, load_only_annotation,
+                      &crop.image_curr, &bbox_curr_gt);
+      if (!crop.image_prev.data || !crop.image_curr.data) {
+        continue;
+      }
+      crop.bbox_curr_prior_tight = crop.bbox_prev_tight;
+      crops->push_back(crop);
+    }
+  }
+}
+
+// Estimate each crop one image at a time.
+void RegressSingle(const std::vector<Crop>& crops, RegressorBase* regressor,
+                   std::vector<BoundingBox>* bboxes) {
+  bboxes->resize(crops.size());
+  for (size_t i = 0; i < crops.size(); ++i) {
+    const Crop& crop = crops[i];
+    regressor->RegressFromFullImages(crop.image_curr, crop.bbox_curr_prior_tight,
+                                     crop.image_prev, crop.bbox_prev_tight, &(*bboxes)[i]);
+  }
+}
+
+// Estimate each crop one image at a time, with a prepared target.
+void RegressPrepared(const std::vector<Crop>& crops, RegressorBase* regressor,
+                     std::vector<BoundingBox>* bboxes) {
+  bboxes->resize(crops.size());
+  PreparedTarget target;
+  for (size_t i = 0; i < crops.size(); ++i) {
+    const Crop& crop = crops[i];
+    regressor->PrepareTarget(crop.image_prev, crop.bbox_prev_tight, &target);
+    regressor->RegressFromTarget(crop.image_curr, crop.bbox_curr_prior_tight, target, &(*bboxes)[i]);
+  }
+}
+
+// Estimate the crops in batches of kBatchSize (the last one may be smaller).
+void RegressBatched(const std::vector<Crop>& crops, RegressorBase* regressor,
+                    std::vector<BoundingBox>* bboxes) {
+  bboxes->clear();
+  for (size_t begin = 0; begin < crops.size(); begin += kBatchSize) {
+    const size_t end = std::min(begin + kBatchSize, crops.size());
+    std::vector<cv::Mat> images_curr;
+    std::vector<BoundingBox> bboxes_curr_prior_tight;
+    std::vector<cv::Mat> images_prev;
+    std::vector<BoundingBox> bboxes_prev_tight;
+    for (size_t i = begin; i < end; ++i) {
+      images_curr.push_back(crops[i].image_curr);
+      bboxes_curr_prior_tight.push_back(crops[i].bbox_curr_prior_tight);
+      images_prev.push_back(crops[i].image_prev);
+      bboxes_prev_tight.push_back(crops[i].bbox_prev_tight);
+    }
+    std::vector<BoundingBox> batch_bboxes;
+    regressor->RegressFromFullImages(images_curr, bboxes_curr_prior_tight,
+                                     images_prev, bboxes_prev_tight, &batch_bboxes);
+    bboxes->insert(bboxes->end(), batch_bboxes.begin(), batch_bboxes.end());
+  }
+}
+
+// Start estimating all crops with RegressAsync, then wait for the estimates.
+void RegressAllAsync(const std::vector<Crop>& crops, RegressorBase* regressor,
+                     std::vector<BoundingBox>* bboxes) {
+  std::vector<boost::shared_future<BoundingBox> > results;
+  for (size_t i = 0; i < crops.size(); ++i) {
+    const Crop& crop = crops[i];
+    results.push_back(regressor->RegressAsync(crop.image_curr, crop.bbox_curr_prior_tight,
+                                              crop.image_prev, crop.bbox_prev_tight));
+  }
+  bboxes->resize(crops.size());
+  for (size_t i = 0; i < crops.size(); ++i) {
+    (*bboxes)[i] = results[i].get();
+  }
+}
+
+// Get the largest difference of the outputs of fc8 (the coordinates of the bounding boxes).
+double MaxDifference(const std::vector<BoundingBox>& bboxes,
+                     const std::vector<BoundingBox>& reference_bboxes) {
+  if (bboxes.size() != reference_bboxes.size()) {
+    return HUGE_VAL;
+  }
+  double max_difference = 0;
+  for (size_t i = 0; i < bboxes.size(); ++i) {
+    const BoundingBox& a = bboxes[i];
+    const BoundingBox& b = reference_bboxes[i];
+    max_difference = std::max(max_difference,
+                              std::max(std::max(fabs(a.x1_ - b.x1_), fabs(a.y1_ - b.y1_)),
+                                       std::max(fabs(a.x2_ - b.x2_), fabs(a.y2_ - b.y2_))));
+  }
+  return max_difference;
+}
+
+// Estimate the crops with regressor in each way, and compare the estimates with
+// reference_bboxes.  Returns the number of ways whose difference is above max_difference.
+int CheckRegressor(const string& name, const std::vector<Crop>& crops, RegressorBase* regressor,
+                   const std::vector<BoundingBox>& reference_bboxes, const double max_difference) {
+  typedef void (*RegressFunction)(const std::vector<Crop>&, RegressorBase*,
+                                  std::vector<BoundingBox>*);
+  const RegressFunction functions[] = { RegressSingle, RegressPrepared, RegressBatched, RegressAllAsync };
+  const char* function_names[] = { "batch 1", "prepared target", "batch N", "RegressAsync" };
+
+  int num_failed = 0;
+  for (size_t i = 0; i < sizeof(functions) / sizeof(functions[0]); ++i) {
+    std::vector<BoundingBox> bboxes;
+    functions[i](crops, regressor, &bboxes);
+    const double difference = MaxDifference(bboxes, reference_bboxes);
+    printf("%-28s %-16s max fc8 difference %g (tolerance %g)\n", name.c_str(), function_names[i],
+           difference, max_difference);
+    if (difference > max_difference) {
+      printf("Error - %s (%s) differs from Regressor by more than %g\n", name.c_str(),
+             function_names[i], max_difference);
+      num_failed++;
+    }
+  }
+  return num_failed;
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc < 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " videos_folder annotations_folder deploy.prototxt network.caffemodel"
+              << " [gpu_id] [calibration_file] [num_crops]" << std::endl
+              << "(the quantized network is checked only if given a calibration file from calibrate_int8;"
+              << " the compiled network only if built with COMPILED_NET from the same prototxt)" << std::endl;
+    return 1;
+  }
+
+  ::google::InitGoogleLogging(argv[0]);
+
+  const string videos_folder      = argv[1];
+  const string annotations_folder = argv[2];
+  const string test_proto         = argv[3];
+  const string caffe_model        = argv[4];
+  const int gpu_id                = argc > 5 ? atoi(argv[5]) : 0;
+  const string calibration_file   = argc > 6 ? argv[6] : "";
+  const size_t num_crops          = argc > 7 ? atoi(argv[7]) : 64;
+
+  // Get the crops from the validation set.
+  std::vector<Video> videos;
+  LoaderAlov loader(videos_folder, annotations_folder);
+  const bool use_train = false;
+  loader.get_videos(use_train, &videos);
+  std::vector<Crop> crops;
+  LoadCrops(videos, num_crops, &crops);
+  if (crops.empty()) {
+    printf("Error - no pairs of annotated frames in %s\n", videos_folder.c_str());
+    return 1;
+  }
+  printf("Comparing the estimates of %zu crops\n", crops.size());
+
+  // Estimate the crops with Caffe, one image at a time.
+  const bool do_train = false;
+  Regressor reference(test_proto, caffe_model, gpu_id, do_train);
+  std::vector<BoundingBox> reference_bboxes;
+  RegressSingle(crops, &reference, &reference_bboxes);
+
+  // Compare the other ways of running Caffe, and each other regressor.
+  int num_failed = CheckRegressor("Regressor", crops, &reference, reference_bboxes,
+                                  kMaxFloatDifference);
+  {
+    const size_t network_threads = 1;
+    NativeRegressor regressor(test_proto, caffe_model, network_threads);
+    num_failed += CheckRegressor("NativeRegressor (1 thread)", crops, &regressor,
+                                 reference_bboxes, kMaxFloatDifference);
+  }
+  {
+    const size_t network_threads = 0;
+    NativeRegressor regressor(test_proto, caffe_model, network_threads);
+    num_failed += CheckRegressor("NativeRegressor (all CPUs)", crops, &regressor,
+                                 reference_bboxes, kMaxFloatDifference);
+  }
+#ifdef USE_COMPILED_NET
+  {
+    const size_t network_threads = 0;
+    CompiledRegressor regressor(caffe_model, network_threads);
+    num_failed += CheckRegressor("CompiledRegressor", crops, &regressor,
+                                 reference_bboxes, kMaxFloatDifference);
+  }
+#endif
+  if (!calibration_file.empty()) {
+    const size_t network_threads = 0;
+    QuantizedRegressor regressor(test_proto, caffe_model, calibration_file, network_threads);
+    num_failed += CheckRegressor("QuantizedRegressor", crops, &regressor,
+                                 reference_bboxes, kMaxQuantizedDifference);
+  }
+
+  if (num_failed > 0) {
+    printf("Error - %d estimates differ from Regressor by more than their tolerance\n", num_failed);
+    return 1;
+  }
+  printf("All estimates match Regressor\n");
+  return 0;
+}
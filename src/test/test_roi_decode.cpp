@@ -0,0 +1,338 @@
+// Check that decoding only the regions of each frame that the tracker crops (see
+// loader/roi_frame_loader.h) gives the same pixels in those regions as decoding the whole frame.
+// For the annotated frames of the first few ALOV videos, loads each frame with RoiFrameLoader
+// (at full scale, and at the reduced scale it chooses when downscaling) around the annotated
+// target and around random regions, and compares the decoded regions with the whole frame
+// decoded by libjpeg at the same scale.
+// Then, if given a network, tracks the videos with whole frames and again with region decoding
+// (at full scale), and checks that the estimates in the annotated frames are the same.
+// Exits with a non-zero status if any check fails.  Must be built with ROI_DECODE.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef USE_ROI_DECODE
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+#include <boost/shared_ptr.hpp>
+
+#include "helper/image_proc.h"
+#include "loader/loader_alov.h"
+#include "loader/roi_frame_loader.h"
+#include "network/native_regressor.h"
+#ifdef USE_CAFFE
+#include "network/regressor.h"
+#endif
+#include "tracker/tracker.h"
+#include "tracker/tracker_manager.h"
+
+using std::string;
+
+namespace {
+
+// Number of random regions to load around in each annotated frame (besides the target).
+const int kRandomRegionsPerFrame = 4;
+
+// Largest difference (in pixels) between the estimates with and without region decoding.
+const double kMaxRoiDecodeDifference = 1e-3;
+
+#ifdef USE_ROI_DECODE
+
+// Error handler for libjpeg that returns to the caller (by default, libjpeg exits the program).
+struct JpegErrorManager {
+  jpeg_error_mgr manager;
+  jmp_buf return_point;
+};
+
+void JpegErrorExit(j_common_ptr cinfo) {
+  longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->return_point, 1);
+}
+
+// Ignore warnings about corrupt data (as RoiFrameLoader does).
+void JpegOutputMessage(j_common_ptr cinfo) {
+}
+
+// Decode the whole JPEG image in file at scale 1 / scale_denom into image, as BGR.
+// Returns false if the file is not a JPEG image.
+bool DecodeJpeg(const string& file, const int scale_denom, cv::Mat* image) {
+  std::ifstream stream(file.c_str(), std::ios::binary);
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(stream)),
+                                  std::istreambuf_iterator<char>());
+  if (data.empty()) {
+    return false;
+  }
+
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager error;
+  cinfo.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = JpegErrorExit;
+  error.manager.output_message = JpegOutputMessage;
+  if (setjmp(error.return_point)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, &data[0], data.size());
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_EXT_BGR;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = scale_denom;
+  jpeg_start_decompress(&cinfo);
+  image->create(cinfo.output_height, cinfo.output_width, CV_8UC3);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = image->ptr<unsigned char>(cinfo.output_scanline);
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+#endif // USE_ROI_DECODE
+
+// Get the region of an image of the given size that the tracker crops around bbox_tight.
+cv::Rect CropRegion(const BoundingBox& bbox_tight, const cv::Size& image_size) {
+  BoundingBox pad_image_location;
+  double edge_spacing_x, edge_spacing_y;
+  cv::Rect roi;
+  cv::Size pad_image_size;
+  ComputeCropPadImageGeometry(bbox_tight, image_size, &pad_image_location,
+                              &edge_spacing_x, &edge_spacing_y, &roi, &pad_image_size);
+  return roi;
+}
+
+// Make a random box in a frame of the given size, from tiny to as large as the frame, which
+// may extend past the edges of the frame.
+BoundingBox MakeRandomBox(const cv::Size& frame_size) {
+  BoundingBox box;
+  const double width = frame_size.width * (0.02 + 0.98 * rand() / RAND_MAX);
+  const double height = frame_size.height * (0.02 + 0.98 * rand() / RAND_MAX);
+  box.x1_ = frame_size.width * (1.2 * rand() / RAND_MAX - 0.1) - width / 2;
+  box.y1_ = frame_size.height * (1.2 * rand() / RAND_MAX - 0.1) - height / 2;
+  box.x2_ = box.x1_ + width;
+  box.y2_ = box.y1_ + height;
+  return box;
+}
+
+// Counts of the frames checked by CheckRegions.
+struct RegionCounts {
+  RegionCounts() : num_loads(0), num_different(0), num_skipped(0) {}
+
+  // Number of frames loaded at each scale denominator.
+  std::map<int, size_t> num_scaled;
+  size_t num_loads;
+  size_t num_different;
+
+  // Number of frames that are not JPEG images (which are always decoded whole).
+  size_t num_skipped;
+};
+
+// Load frame_num of video with loader around bbox_prior_tight, decode the region around
+// bbox_tight, and compare both regions with the whole frame decoded at the same scale.
+// full_images holds the whole frame decoded at each scale denominator so far.
+void CheckRegions(const Video& video, const int frame_num, const BoundingBox& bbox_prior_tight,
+                  const BoundingBox& bbox_tight, RoiFrameLoader* loader,
+                  std::map<int, cv::Mat>* full_images, RegionCounts* counts) {
+#ifdef USE_ROI_DECODE
+  cv::Mat image;
+  double image_scale;
+  BoundingBox bbox_gt;
+  loader->LoadFrame(video, frame_num, bbox_prior_tight, &image, &image_scale, &bbox_gt);
+  loader->DecodeRegion(bbox_tight);
+  counts->num_loads++;
+
+  // Decode the whole frame at the same scale (unless already decoded).
+  const int scale_denom = static_cast<int>(1 / image_scale + 0.5);
+  if (full_images->find(scale_denom) == full_images->end() &&
+      !DecodeJpeg(video.path + "/" + video.all_frames[frame_num], scale_denom,
+                  &(*full_images)[scale_denom])) {
+    full_images->erase(scale_denom);
+    counts->num_skipped++;
+    return;
+  }
+  const cv::Mat& full_image = (*full_images)[scale_denom];
+  counts->num_scaled[scale_denom]++;
+  if (image.size() != full_image.size()) {
+    printf("Error - %s, frame %d: region-decoded image is %d x %d at scale 1/%d instead of %d x %d\n",
+           video.path.c_str(), frame_num, image.cols, image.rows, scale_denom,
+           full_image.cols, full_image.rows);
+    counts->num_different++;
+    return;
+  }
+
+  // The pixels of both regions should be the same.
+  const BoundingBox* boxes[] = { &bbox_prior_tight, &bbox_tight };
+  for (size_t i = 0; i < sizeof(boxes) / sizeof(boxes[0]); ++i) {
+    BoundingBox bbox_scaled;
+    boxes[i]->Rescale(image_scale, &bbox_scaled);
+    const cv::Rect region = CropRegion(bbox_scaled, image.size());
+    bool same = true;
+    for (int y = region.y; y < region.y + region.height && same; ++y) {
+      same = std::equal(image.ptr<unsigned char>(y) + 3 * region.x,
+                        image.ptr<unsigned char>(y) + 3 * (region.x + region.width),
+                        full_image.ptr<unsigned char>(y) + 3 * region.x);
+    }
+    if (!same) {
+      printf("Error - %s, frame %d: region (%d, %d, %d x %d) at scale 1/%d differs from the whole frame\n",
+             video.path.c_str(), frame_num, region.x, region.y, region.width, region.height,
+             scale_denom);
+      counts->num_different++;
+    }
+  }
+#endif
+}
+
+// Compare the regions decoded by RoiFrameLoader with whole frames, in the annotated frames of
+// videos.  Returns the number of regions that differ.
+size_t CheckRegionDecoding(const std::vector<Video>& videos) {
+  RoiFrameLoader full_scale_loader(false);
+  RoiFrameLoader downscale_loader(true);
+  RegionCounts counts;
+  srand(0);
+  for (size_t i = 0; i < videos.size(); ++i) {
+    const Video& video = videos[i];
+    for (size_t j = 0; j < video.annotations.size(); ++j) {
+      const int frame_num = video.annotations[j].frame_num;
+      const BoundingBox& bbox_gt = video.annotations[j].bbox;
+
+      // Get the size of the frame (by decoding only the region around the target).
+      cv::Mat image;
+      double image_scale;
+      BoundingBox frame_bbox_gt;
+      full_scale_loader.LoadFrame(video, frame_num, bbox_gt, &image, &image_scale, &frame_bbox_gt);
+
+      // Load around the target, and around random regions (some large enough to downscale).
+      std::vector<BoundingBox> boxes(1, bbox_gt);
+      for (int k = 0; k < kRandomRegionsPerFrame; ++k) {
+        boxes.push_back(MakeRandomBox(image.size()));
+      }
+      std::map<int, cv::Mat> full_images;
+      for (size_t k = 0; k < boxes.size(); ++k) {
+        // Decode the region around the prior, and (as after tracking) around another box.
+        const BoundingBox& bbox_prior = boxes[k];
+        const BoundingBox& bbox_target = boxes[(k + 1) % boxes.size()];
+        CheckRegions(video, frame_num, bbox_prior, bbox_target, &full_scale_loader,
+                     &full_images, &counts);
+        CheckRegions(video, frame_num, bbox_prior, bbox_target, &downscale_loader,
+                     &full_images, &counts);
+      }
+    }
+  }
+
+  printf("Checked region decoding in %zu loaded frames (", counts.num_loads);
+  for (std::map<int, size_t>::const_iterator it = counts.num_scaled.begin();
+       it != counts.num_scaled.end(); ++it) {
+    printf("%s%zu at scale 1/%d", it == counts.num_scaled.begin() ? "" : ", ",
+           it->second, it->first);
+  }
+  printf("; %zu not JPEG)\n", counts.num_skipped);
+  return counts.num_different;
+}
+
+// Track the videos with whole frames and again decoding only the regions that the tracker crops
+// (at full scale), and check that the estimates in the annotated frames are the same.
+// Returns the number of annotated frames whose estimates differ.
+size_t CheckTracking(const std::vector<Video>& videos, RegressorBase* regressor) {
+  const bool show_intermediate_output = false;
+  Tracker tracker(show_intermediate_output);
+  TrackerRecorder full_recorder(videos, regressor, &tracker);
+  full_recorder.TrackAll();
+  TrackerRecorder roi_recorder(videos, regressor, &tracker);
+  roi_recorder.set_roi_decode(true, false);
+  roi_recorder.TrackAll();
+
+  size_t num_frames = 0;
+  size_t num_different = 0;
+  for (std::map<size_t, std::vector<BoundingBox> >::const_iterator it =
+           full_recorder.estimates().begin(); it != full_recorder.estimates().end(); ++it) {
+    const std::vector<BoundingBox>& full_estimates = it->second;
+    const std::vector<BoundingBox>& roi_estimates = roi_recorder.estimates().find(it->first)->second;
+    for (size_t i = 0; i < full_estimates.size(); ++i) {
+      const BoundingBox& a = full_estimates[i];
+      const BoundingBox& b = roi_estimates[i];
+      const double difference = std::max(std::max(fabs(a.x1_ - b.x1_), fabs(a.y1_ - b.y1_)),
+                                          std::max(fabs(a.x2_ - b.x2_), fabs(a.y2_ - b.y2_)));
+      if (difference > kMaxRoiDecodeDifference) {
+        printf("Error - video %zu, annotated frame %zu: estimate differs by %lf pixels with region decoding\n",
+               it->first, i, difference);
+        num_different++;
+      }
+    }
+    num_frames += full_estimates.size();
+  }
+  printf("Region decoding changed the estimates in %zu of %zu annotated frames\n",
+         num_different, num_frames);
+  return num_different;
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " videos_folder annotations_folder [num_videos]"
+              << " [deploy.prototxt network.caffemodel [gpu_id]]" << std::endl
+              << "(gpu_id -1, the default, runs the network with the native CPU engine instead of Caffe)" << std::endl;
+    return 1;
+  }
+
+#ifndef USE_ROI_DECODE
+  printf("Error - built without ROI_DECODE, so frames are always decoded whole\n");
+  return 1;
+#endif
+
+  const string videos_folder      = argv[1];
+  const string annotations_folder = argv[2];
+  const size_t num_videos         = argc > 3 ? atoi(argv[3]) : 10;
+
+  // Get the first videos of the validation set.
+  std::vector<Video> videos;
+  LoaderAlov loader(videos_folder, annotations_folder);
+  const bool use_train = false;
+  loader.get_videos(use_train, &videos);
+  videos.resize(std::min(videos.size(), num_videos));
+
+  // Check the decoded pixels.
+  size_t num_errors = CheckRegionDecoding(videos);
+
+  // Check the estimates of the tracker.
+  if (argc > 5) {
+#ifdef USE_CAFFE
+    ::google::InitGoogleLogging(argv[0]);
+#endif
+    const string test_proto  = argv[4];
+    const string caffe_model = argv[5];
+    const int gpu_id         = argc > 6 ? atoi(argv[6]) : -1;
+
+    boost::shared_ptr<RegressorBase> regressor;
+#ifdef USE_CAFFE
+    if (gpu_id >= 0) {
+      const bool do_train = false;
+      regressor.reset(new Regressor(test_proto, caffe_model, gpu_id, do_train));
+    }
+#endif
+    if (!regressor) {
+      const size_t network_threads = 0;
+      regressor.reset(new NativeRegressor(test_proto, caffe_model, network_threads));
+    }
+    num_errors += CheckTracking(videos, regressor.get());
+  }
+
+  if (num_errors > 0) {
+    printf("Error - %zu checks failed\n", num_errors);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <string>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
 
 #include <opencv/cv.h>
@@ -8,7 +10,15 @@
 #include <opencv2/highgui/highgui.hpp>
 
 #include "helper/high_res_timer.h"
+#ifdef USE_COMPILED_NET
+#include "network/compiled_regressor.h"
+#endif
+#include "network/native_regressor.h"
+#include "network/quantized_regressor.h"
+#ifdef USE_CAFFE
 #include "network/regressor.h"
+#endif
+#include "loader/frame_prefetcher.h"
 #include "loader/loader_alov.h"
 #include "loader/loader_vot.h"
 #include "tracker/tracker.h"
@@ -20,11 +30,16 @@ int main (int argc, char *argv[]) {
   if (argc < 9) {
     std::cerr << "Usage: " << argv[0]
               << " videos_folder annotations_folder deploy.prototxt network.caffemodel"
-              << " outputfolder use_train save_videos gpu_id" << std::endl;
+              << " outputfolder use_train save_videos gpu_id [batch_size] [num_threads] [profile_file] [calibration_file] [pipelined] [decode_threads] [roi_decode]" << std::endl
+              << "(gpu_id -1 runs the network with the native CPU engine instead of Caffe," << std::endl
+              << " and -2 runs the network compiled into the program, if built with COMPILED_NET)" << std::endl
+              << "(profile_file is only supported with Caffe)" << std::endl;
     return 1;
   }
 
+#ifdef USE_CAFFE
   ::google::InitGoogleLogging(argv[0]);
+#endif
 
   string videos_folder          = argv[1];
   string annotations_folder     = argv[2];
@@ -35,10 +50,86 @@ int main (int argc, char *argv[]) {
   const bool save_videos        = atoi(argv[7]);
   int gpu_id                    = atoi(argv[8]);
 
+  // Number of videos to track at once (in lockstep, with batched network evaluation).
+  const size_t batch_size       = argc > 9 ? atoi(argv[9]) : 1;
+
+  // Number of threads to track videos on (each with its own network activations).
+  const size_t num_threads      = argc > 10 ? atoi(argv[10]) : 1;
+
+  // If given, profile the network and save the timing of each layer to this file (.json or .csv).
+  // Only used with Caffe.
+  const string profile_file     = argc > 11 ? argv[11] : "";
+
+  // If given, run the fully-connected layers with 8-bit weights, quantized with the input
+  // ranges in this file (from calibrate_int8).  Only used with the native CPU engine.
+  const string calibration_file = argc > 12 ? argv[12] : "";
+
+  // Whether to prepare the inputs of the next video in the batch while the network runs on
+  // the current one.
+  const bool pipelined          = argc > 13 ? atoi(argv[13]) : false;
+
+  // If more than 0, track the videos as a pipeline, with this many threads loading the frames
+  // ahead of the tracker and another thread saving the tracking output.
+  const size_t decode_threads   = argc > 14 ? atoi(argv[14]) : 0;
+
+  // Whether to decode only the regions of each frame that the tracker crops (when tracking
+  // one video at a time, and not saving videos): 1 to decode them at full scale, 2 to also
+  // decode frames with large targets at a reduced scale.
+  const int roi_decode          = argc > 15 ? atoi(argv[15]) : 0;
+
+  // Only the Caffe regressor has a profiler, so do not silently ignore profile_file otherwise.
+#ifdef USE_CAFFE
+  const bool can_profile = gpu_id >= 0;
+#else
+  const bool can_profile = false;
+#endif
+  if (!profile_file.empty() && !can_profile) {
+    printf("Error - profile_file can only be used when running the network with Caffe (gpu_id >= 0)\n");
+    return 1;
+  }
+
   boost::filesystem::create_directories(output_folder);
 
-  const bool do_train = false;
-  Regressor regressor(test_proto, caffe_model, gpu_id, do_train);
+  // Create a regressor for each thread that videos are tracked on.
+  const size_t num_regressors = std::max<size_t>(num_threads, 1);
+  std::vector<boost::shared_ptr<RegressorBase> > regressors;
+#ifdef USE_CAFFE
+  // The regressor whose layers are profiled (if profiling).
+  Regressor* profiled_regressor = NULL;
+  if (gpu_id >= 0) {
+    const bool do_train = false;
+    profiled_regressor = new Regressor(test_proto, caffe_model, gpu_id, do_train);
+    profiled_regressor->set_profile(!profile_file.empty());
+    regressors.push_back(boost::shared_ptr<RegressorBase>(profiled_regressor));
+
+    // The other regressors share the weights of the first regressor.
+    for (size_t i = 1; i < num_regressors; ++i) {
+      regressors.push_back(boost::shared_ptr<RegressorBase>(
+          new Regressor(test_proto, *profiled_regressor, gpu_id)));
+    }
+  }
+#endif
+  if (regressors.empty()) {
+    // Run the network without Caffe.  When tracking on several threads, each network runs on
+    // a single thread; otherwise the network runs on all CPUs.
+    const size_t network_threads = num_regressors > 1 ? 1 : 0;
+    for (size_t i = 0; i < num_regressors; ++i) {
+#ifdef USE_COMPILED_NET
+      if (gpu_id == -2) {
+        regressors.push_back(boost::shared_ptr<RegressorBase>(
+            new CompiledRegressor(caffe_model, network_threads)));
+        continue;
+      }
+#endif
+      if (calibration_file.empty()) {
+        regressors.push_back(boost::shared_ptr<RegressorBase>(
+            new NativeRegressor(test_proto, caffe_model, network_threads)));
+      } else {
+        regressors.push_back(boost::shared_ptr<RegressorBase>(
+            new QuantizedRegressor(test_proto, caffe_model, calibration_file, network_threads)));
+      }
+    }
+  }
 
   // Time how long tracking takes.
   HighResTimer hrt_total("Total evaluation (including loading videos)");
@@ -54,12 +145,39 @@ int main (int argc, char *argv[]) {
   Tracker tracker(show_intermediate_output);
 
   // Track all objects in all videos.
-  TrackerTesterAlov tracker_tester(videos, save_videos, &regressor, &tracker, output_folder);
-  tracker_tester.TrackAll();
+  TrackerTesterAlov tracker_tester(videos, save_videos, regressors[0].get(), &tracker, output_folder);
+  const int pause_val = 1;
+  if (num_threads > 1) {
+    std::vector<RegressorBase*> thread_regressors;
+    for (size_t i = 0; i < regressors.size(); ++i) {
+      thread_regressors.push_back(regressors[i].get());
+    }
+    tracker_tester.TrackAllParallel(thread_regressors, pause_val);
+  } else if (decode_threads > 0) {
+    tracker_tester.TrackAllPipelined(decode_threads, pause_val);
+  } else if (batch_size > 1 || pipelined) {
+    tracker_tester.TrackAllBatched(batch_size, pause_val, pipelined);
+  } else if (roi_decode && !save_videos) {
+    tracker_tester.set_roi_decode(true, roi_decode > 1);
+    tracker_tester.TrackAll();
+  } else {
+    // Read the frames of each video ahead of the tracker.
+    FramePrefetcher prefetcher(kPrefetchThreads, kPrefetchFrames, kPrefetchBytes);
+    prefetcher.Attach(&videos);
+    tracker_tester.TrackAll();
+  }
 
   // Print the timing information.
   hrt_total.stop();
   hrt_total.print();
 
+#ifdef USE_CAFFE
+  if (!profile_file.empty() && profiled_regressor) {
+    // Print and save the timing of each layer (of the first regressor, if tracking on several threads).
+    profiled_regressor->get_profiler().Print();
+    profiled_regressor->get_profiler().Save(profile_file);
+  }
+#endif
+
   return 0;
 }
@@ -0,0 +1,256 @@
+// Check saving and restoring the state of a tracker (see tracker/tracker_state.h).
+// First checks that states which are truncated, have extra data, or have the wrong magic or
+// version are rejected.  Then, if given the ALOV folders and a network, tracks the first frames
+// of a few videos, takes the state of the tracker in the middle of each video, restores it (after
+// writing it to a file and reading it back) into a new Tracker, and checks that both trackers
+// give the same estimates in the following frames.
+// Exits with a non-zero status if any check fails.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "loader/loader_alov.h"
+#include "network/native_regressor.h"
+#ifdef USE_CAFFE
+#include "network/regressor.h"
+#endif
+#include "tracker/tracker.h"
+#include "tracker/tracker_state.h"
+
+using std::string;
+
+namespace {
+
+// Number of frames tracked before the state is taken, and after it is restored.
+const int kFramesBeforeState = 10;
+const int kFramesAfterState = 10;
+
+// Largest difference (in pixels) between the estimates of the original and restored trackers.
+const double kMaxEstimateDifference = 1e-4;
+
+// Offset of the version in a serialized state (after the magic).
+const size_t kVersionOffset = 8;
+
+// Make a state with some arbitrary values.
+void MakeTestState(TrackerState* state) {
+  state->bbox_curr_prior_tight.x1_ = 10;
+  state->bbox_curr_prior_tight.y1_ = 20;
+  state->bbox_curr_prior_tight.x2_ = 110;
+  state->bbox_curr_prior_tight.y2_ = 220;
+  state->bbox_prev_tight.x1_ = 12;
+  state->bbox_prev_tight.y1_ = 18;
+  state->bbox_prev_tight.x2_ = 108;
+  state->bbox_prev_tight.y2_ = 224;
+  state->target_input.resize(3 * 227 * 227);
+  for (size_t i = 0; i < state->target_input.size(); ++i) {
+    state->target_input[i] = static_cast<float>(i % 255) - 128;
+  }
+}
+
+bool SameBoundingBox(const BoundingBox& a, const BoundingBox& b, const double max_difference) {
+  return fabs(a.x1_ - b.x1_) <= max_difference && fabs(a.y1_ - b.y1_) <= max_difference &&
+         fabs(a.x2_ - b.x2_) <= max_difference && fabs(a.y2_ - b.y2_) <= max_difference;
+}
+
+// Check that a state survives serialization, and that invalid data is rejected.
+// Returns the number of failed checks.
+int CheckSerialization() {
+  int num_errors = 0;
+
+  TrackerState state;
+  MakeTestState(&state);
+  std::vector<char> data;
+  SerializeTrackerState(state, &data);
+
+  // The state should be decoded exactly.
+  TrackerState decoded;
+  if (!DeserializeTrackerState(&data[0], data.size(), &decoded) ||
+      !SameBoundingBox(decoded.bbox_curr_prior_tight, state.bbox_curr_prior_tight, 0) ||
+      !SameBoundingBox(decoded.bbox_prev_tight, state.bbox_prev_tight, 0) ||
+      decoded.target_input != state.target_input) {
+    printf("Error - a serialized state was not decoded to the same state\n");
+    num_errors++;
+  }
+
+  // Truncated states (including one with only the magic and version) should be rejected.
+  const size_t header_size = kVersionOffset + sizeof(uint32_t);
+  const size_t truncated_sizes[] = { 0, 1, kVersionOffset, header_size, header_size + 1,
+                                     data.size() / 2, data.size() - 1 };
+  for (size_t i = 0; i < sizeof(truncated_sizes) / sizeof(truncated_sizes[0]); ++i) {
+    if (DeserializeTrackerState(&data[0], truncated_sizes[i], &decoded)) {
+      printf("Error - a state truncated to %zu of %zu bytes was accepted\n",
+             truncated_sizes[i], data.size());
+      num_errors++;
+    }
+  }
+
+  // A state with extra data should be rejected.
+  std::vector<char> extended(data);
+  extended.push_back(0);
+  if (DeserializeTrackerState(&extended[0], extended.size(), &decoded)) {
+    printf("Error - a state with extra data was accepted\n");
+    num_errors++;
+  }
+
+  // A state with the wrong magic should be rejected.
+  std::vector<char> wrong_magic(data);
+  wrong_magic[0] = 'X';
+  if (DeserializeTrackerState(&wrong_magic[0], wrong_magic.size(), &decoded)) {
+    printf("Error - a state with the wrong magic was accepted\n");
+    num_errors++;
+  }
+
+  // A state with the wrong version should be rejected.
+  std::vector<char> wrong_version(data);
+  uint32_t version;
+  memcpy(&version, &wrong_version[kVersionOffset], sizeof(version));
+  version++;
+  memcpy(&wrong_version[kVersionOffset], &version, sizeof(version));
+  if (DeserializeTrackerState(&wrong_version[0], wrong_version.size(), &decoded)) {
+    printf("Error - a state with version %u was accepted\n", version);
+    num_errors++;
+  }
+
+  return num_errors;
+}
+
+// Track the first frames of video, take the state of the tracker, restore it into a new tracker
+// (through state_file), and check that both trackers give the same estimates in the following
+// frames.  Returns the number of frames whose estimates differ (or 1 if the state could not be
+// taken or restored).
+int CheckVideo(const Video& video, RegressorBase* regressor, const string& state_file) {
+  // Skip videos that are too short.
+  if (video.annotations.empty()) {
+    return 0;
+  }
+  const int first_frame = video.annotations[0].frame_num;
+  const int state_frame = first_frame + kFramesBeforeState;
+  const int last_frame = std::min<int>(state_frame + kFramesAfterState,
+                                       video.all_frames.size() - 1);
+  if (state_frame >= last_frame) {
+    return 0;
+  }
+
+  const bool show_intermediate_output = false;
+  const bool draw_bounding_box = false;
+  const bool load_only_annotation = false;
+  cv::Mat image;
+  BoundingBox bbox_gt;
+
+  // Track the frames up to (and including) state_frame.
+  Tracker tracker(show_intermediate_output);
+  int frame_num;
+  video.LoadFirstAnnotation(&frame_num, &image, &bbox_gt);
+  tracker.Init(image, bbox_gt, regressor);
+  BoundingBox bbox_estimate;
+  for (frame_num = first_frame + 1; frame_num <= state_frame; ++frame_num) {
+    video.LoadFrame(frame_num, draw_bounding_box, load_only_annotation, &image, &bbox_gt);
+    tracker.Track(image, regressor, &bbox_estimate);
+  }
+
+  // Save the state, and restore it into a new tracker.
+  TrackerState state;
+  TrackerState restored_state;
+  if (!tracker.GetState(regressor, &state) || !WriteTrackerState(state, state_file) ||
+      !ReadTrackerState(state_file, &restored_state)) {
+    printf("Error - could not save and restore the state of the tracker on %s\n",
+           video.path.c_str());
+    return 1;
+  }
+  Tracker restored_tracker(show_intermediate_output);
+  restored_tracker.SetState(restored_state);
+
+  // Track the following frames with both trackers.
+  int num_different = 0;
+  for (frame_num = state_frame + 1; frame_num <= last_frame; ++frame_num) {
+    video.LoadFrame(frame_num, draw_bounding_box, load_only_annotation, &image, &bbox_gt);
+    BoundingBox restored_bbox_estimate;
+    tracker.Track(image, regressor, &bbox_estimate);
+    restored_tracker.Track(image, regressor, &restored_bbox_estimate);
+    if (!SameBoundingBox(bbox_estimate, restored_bbox_estimate, kMaxEstimateDifference)) {
+      printf("Error - %s, frame %d: the restored tracker estimates (%lf, %lf, %lf, %lf) instead of (%lf, %lf, %lf, %lf)\n",
+             video.path.c_str(), frame_num,
+             restored_bbox_estimate.x1_, restored_bbox_estimate.y1_,
+             restored_bbox_estimate.x2_, restored_bbox_estimate.y2_,
+             bbox_estimate.x1_, bbox_estimate.y1_, bbox_estimate.x2_, bbox_estimate.y2_);
+      num_different++;
+    }
+  }
+  return num_different;
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc != 1 && argc < 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " [videos_folder annotations_folder deploy.prototxt network.caffemodel"
+              << " [gpu_id] [num_videos]]" << std::endl
+              << "(gpu_id -1, the default, runs the network with the native CPU engine instead of Caffe)" << std::endl;
+    return 1;
+  }
+
+  // Check the serialized format.
+  int num_errors = CheckSerialization();
+  printf("Checked serializing tracker states\n");
+
+  if (argc >= 5) {
+#ifdef USE_CAFFE
+    ::google::InitGoogleLogging(argv[0]);
+#endif
+
+    const string videos_folder      = argv[1];
+    const string annotations_folder = argv[2];
+    const string test_proto         = argv[3];
+    const string caffe_model        = argv[4];
+    const int gpu_id                = argc > 5 ? atoi(argv[5]) : -1;
+    const size_t num_videos         = argc > 6 ? atoi(argv[6]) : 5;
+
+    // Create the regressor.
+    boost::shared_ptr<RegressorBase> regressor;
+#ifdef USE_CAFFE
+    if (gpu_id >= 0) {
+      const bool do_train = false;
+      regressor.reset(new Regressor(test_proto, caffe_model, gpu_id, do_train));
+    }
+#endif
+    if (!regressor) {
+      const size_t network_threads = 0;
+      regressor.reset(new NativeRegressor(test_proto, caffe_model, network_threads));
+    }
+
+    // Get the first videos of the validation set.
+    std::vector<Video> videos;
+    LoaderAlov loader(videos_folder, annotations_folder);
+    const bool use_train = false;
+    loader.get_videos(use_train, &videos);
+    videos.resize(std::min(videos.size(), num_videos));
+
+    // Save and restore the tracker in the middle of each video.
+    const string state_file = (boost::filesystem::temp_directory_path() /
+                               boost::filesystem::unique_path("tracker_state_%%%%%%%%")).string();
+    for (size_t i = 0; i < videos.size(); ++i) {
+      num_errors += CheckVideo(videos[i], regressor.get(), state_file);
+    }
+    boost::filesystem::remove(state_file);
+    printf("Checked restoring the tracker in %zu videos\n", videos.size());
+  }
+
+  if (num_errors > 0) {
+    printf("Error - %d checks failed\n", num_errors);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -6,7 +6,13 @@
 #include "native/vot.h"
 
 #include "tracker/tracker.h"
-#include "network/regressor_train.h"
+#ifdef USE_COMPILED_NET
+#include "network/compiled_regressor.h"
+#endif
+#include "network/native_regressor.h"
+#ifdef USE_CAFFE
+#include "network/regressor.h"
+#endif
 
 //using std::string;
 
@@ -14,11 +20,15 @@ int main (int argc, char *argv[]) {
   if (argc < 3) {
     std::cerr << "Usage: " << argv[0]
               << " deploy.prototxt network.caffemodel"
-              << " [gpu_id]" << std::endl;
+              << " [gpu_id]" << std::endl
+              << "(gpu_id -1 runs the network with the native CPU engine instead of Caffe," << std::endl
+              << " and -2 runs the network compiled into the program, if built with COMPILED_NET)" << std::endl;
     return 1;
   }
 
+#ifdef USE_CAFFE
   ::google::InitGoogleLogging(argv[0]);
+#endif
 
   const string& model_file   = argv[1];
   const string& trained_file = argv[2];
@@ -28,8 +38,25 @@ int main (int argc, char *argv[]) {
     gpu_id = atoi(argv[3]);
   }
 
-  const bool do_train = false;
-  Regressor regressor(model_file, trained_file, gpu_id, do_train);
+  boost::shared_ptr<RegressorBase> regressor;
+#ifdef USE_CAFFE
+  if (gpu_id >= 0) {
+    const bool do_train = false;
+    regressor.reset(new Regressor(model_file, trained_file, gpu_id, do_train));
+  }
+#endif
+  if (!regressor) {
+    // Run the network without Caffe, on all CPUs.
+    const size_t num_threads = 0;
+#ifdef USE_COMPILED_NET
+    if (gpu_id == -2) {
+      regressor.reset(new CompiledRegressor(trained_file, num_threads));
+    }
+#endif
+    if (!regressor) {
+      regressor.reset(new NativeRegressor(model_file, trained_file, num_threads));
+    }
+  }
 
   // Ensuring randomness for fairness.
   srandom(time(NULL));
@@ -45,7 +72,7 @@ int main (int argc, char *argv[]) {
   string path = vot.frame();
 
   // Load the first frame and use the initialization region to initialize the tracker.
-  tracker.Init(path, region, &regressor);
+  tracker.Init(path, region, regressor.get());
 
   //track
   while (true) {
@@ -57,7 +84,7 @@ int main (int argc, char *argv[]) {
 
       // Track and estimate the bounding box location.
       BoundingBox bbox_estimate;
-      tracker.Track(image, &regressor, &bbox_estimate);
+      tracker.Track(image, regressor.get(), &bbox_estimate);
 
       bbox_estimate.GetRegion(&region);
 
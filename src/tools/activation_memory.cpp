@@ -0,0 +1,82 @@
+// Report how much memory the activations of a network take when running it with the native
+// engine (see network/native_net.h), for a range of batch sizes: the size of the single buffer
+// that all activations share, next to the memory they would take if each had its own buffer
+// (as in Caffe, which keeps every layer output of both branches alive at once).
+//   activation_memory nets/tracker.prototxt tracker.weights 32
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "helper/thread_pool.h"
+#include "network/native_net.h"
+#include "network/weight_file.h"
+
+using std::string;
+
+namespace {
+
+// Name of the blob containing the estimated bounding box.
+const char* kOutput = "fc8";
+
+// Bytes in a megabyte.
+const double kMegabyte = 1024 * 1024;
+
+void PrintUsage(const char* program) {
+  std::cerr << "Usage: " << program
+            << " deploy.prototxt network.caffemodel [max_batch_size]" << std::endl;
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc < 3) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  const string deploy_proto = argv[1];
+  const string weights_path = argv[2];
+
+  // The largest batch size must be at least 1 (atoi gives 0 for a non-numeric value).
+  const int max_batch_size_arg = argc > 3 ? atoi(argv[3]) : 32;
+  if (max_batch_size_arg < 1) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  const size_t max_batch_size = max_batch_size_arg;
+
+  // Set up the network (no layers are run, so a single thread is enough).
+  WeightFile weights;
+  if (!weights.Open(weights_path)) {
+    return 1;
+  }
+  ThreadPool thread_pool(1);
+  NativeNet net;
+  const QuantizationTable* quantization = NULL;
+  if (!net.Init(deploy_proto, weights, kOutput, &thread_pool, quantization)) {
+    printf("Error - could not set up the network in %s\n", deploy_proto.c_str());
+    return 1;
+  }
+
+  // Double the batch size up to the largest one (and report that one too).
+  std::vector<size_t> batch_sizes;
+  for (size_t batch_size = 1; batch_size < max_batch_size; batch_size *= 2) {
+    batch_sizes.push_back(batch_size);
+  }
+  batch_sizes.push_back(max_batch_size);
+
+  printf("%10s %16s %16s %8s\n", "batch size", "planned (MB)", "unplanned (MB)", "ratio");
+  for (size_t i = 0; i < batch_sizes.size(); ++i) {
+    if (!net.Reshape(batch_sizes[i])) {
+      return 1;
+    }
+    const size_t planned = net.activation_bytes();
+    const size_t unplanned = net.unplanned_activation_bytes();
+    printf("%10zu %16.2f %16.2f %8.2f\n", batch_sizes[i], planned / kMegabyte,
+           unplanned / kMegabyte, static_cast<double>(unplanned) / planned);
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+// Quantize the fully-connected layers of the tracker network to 8 bits (see
+// network/quantized_regressor.h).
+// First the input range of each fully-connected layer is measured by tracking the
+// calibration videos with the float network, and saved to a calibration file.
+// Then the validation videos are tracked with both the float and the quantized network,
+// and the IoU drift of the quantized tracker is reported.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "helper/bounding_box.h"
+#include "loader/frame_prefetcher.h"
+#include "loader/loader_alov.h"
+#include "loader/loader_vot.h"
+#include "network/native_regressor.h"
+#include "network/quantization.h"
+#include "network/quantized_regressor.h"
+#include "tracker/tracker.h"
+#include "tracker/tracker_manager.h"
+
+using std::string;
+
+namespace {
+
+// Get the calibration and validation videos: the training and validation sets of ALOV,
+// or alternate videos of VOT (which has no validation set).
+bool LoadVideos(const std::vector<string>& args, const size_t max_videos,
+                std::vector<Video>* calibration_videos, std::vector<Video>* validation_videos) {
+  if (args[0] == "alov" && args.size() >= 3) {
+    LoaderAlov loader(args[1], args[2]);
+    loader.get_videos(true, calibration_videos);
+    loader.get_videos(false, validation_videos);
+  } else if (args[0] == "vot" && args.size() >= 2) {
+    LoaderVOT loader(args[1]);
+    const std::vector<Video>& videos = loader.get_videos();
+    for (size_t i = 0; i < videos.size(); ++i) {
+      (i % 2 == 0 ? calibration_videos : validation_videos)->push_back(videos[i]);
+    }
+  } else {
+    return false;
+  }
+
+  // Use only the first max_videos of each set, if given.
+  if (max_videos > 0) {
+    calibration_videos->resize(std::min(calibration_videos->size(), max_videos));
+    validation_videos->resize(std::min(validation_videos->size(), max_videos));
+  }
+  return true;
+}
+
+void PrintUsage(const char* program) {
+  std::cerr << "Usage: " << program
+            << " deploy.prototxt network.caffemodel output.calibration"
+            << " (alov videos_folder annotations_folder | vot vot_folder) [max_videos]" << std::endl;
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc < 6) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  const string deploy_proto     = argv[1];
+  const string weights          = argv[2];
+  const string calibration_file = argv[3];
+  std::vector<string> dataset_args(argv + 4, argv + argc);
+
+  // Check that all the folders of the dataset are given.
+  const size_t dataset_num_args = dataset_args[0] == "alov" ? 3 : 2;
+  if (dataset_args.size() < dataset_num_args) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  // Number of videos to use for calibration and for validation (0 = all).
+  const size_t max_videos = dataset_args.size() > dataset_num_args ?
+      atoi(dataset_args[dataset_num_args].c_str()) : 0;
+
+  std::vector<Video> calibration_videos;
+  std::vector<Video> validation_videos;
+  if (!LoadVideos(dataset_args, max_videos, &calibration_videos, &validation_videos)) {
+    printf("Error - unknown dataset %s\n", dataset_args[0].c_str());
+    return 1;
+  }
+
+  // Read the frames of each video ahead of the tracker.
+  FramePrefetcher prefetcher(kPrefetchThreads, kPrefetchFrames, kPrefetchBytes);
+  prefetcher.Attach(&calibration_videos);
+  prefetcher.Attach(&validation_videos);
+
+  const bool show_intermediate_output = false;
+  Tracker tracker(show_intermediate_output);
+
+  // Measure the input ranges of the fully-connected layers while tracking the calibration videos.
+  const size_t num_threads = 0;
+  NativeRegressor float_regressor(deploy_proto, weights, num_threads);
+  QuantizationTable calibration;
+  float_regressor.set_calibration(&calibration);
+  printf("Calibrating on %zu videos\n", calibration_videos.size());
+  TrackerRecorder calibration_recorder(calibration_videos, &float_regressor, &tracker);
+  calibration_recorder.TrackAll();
+  float_regressor.set_calibration(NULL);
+
+  if (!calibration.Save(calibration_file)) {
+    return 1;
+  }
+  printf("Saved the input ranges of %zu layers to %s\n", calibration.num_layers(),
+         calibration_file.c_str());
+
+  // Track the validation videos with the float and the quantized network.
+  printf("Validating on %zu videos\n", validation_videos.size());
+  QuantizedRegressor quantized_regressor(deploy_proto, weights, calibration_file, num_threads);
+  TrackerRecorder float_recorder(validation_videos, &float_regressor, &tracker);
+  float_recorder.TrackAll();
+  TrackerRecorder quantized_recorder(validation_videos, &quantized_regressor, &tracker);
+  quantized_recorder.TrackAll();
+
+  // Report the IoU of each tracker with the ground truth, and of the quantized tracker
+  // with the float tracker (its drift).
+  printf("%-6s %8s %12s %12s %12s\n", "Video", "Frames", "IoU float", "IoU int8", "IoU drift");
+  double total_float_iou = 0;
+  double total_quantized_iou = 0;
+  double total_drift_iou = 0;
+  size_t total_frames = 0;
+  for (std::map<size_t, std::vector<BoundingBox> >::const_iterator it =
+           float_recorder.estimates().begin(); it != float_recorder.estimates().end(); ++it) {
+    const size_t video_num = it->first;
+    const std::vector<BoundingBox>& float_estimates = it->second;
+    const std::vector<BoundingBox>& quantized_estimates =
+        quantized_recorder.estimates().find(video_num)->second;
+    const std::vector<BoundingBox>& ground_truth = float_recorder.ground_truth().find(video_num)->second;
+
+    double float_iou = 0;
+    double quantized_iou = 0;
+    double drift_iou = 0;
+    for (size_t i = 0; i < float_estimates.size(); ++i) {
+      float_iou += float_estimates[i].compute_iou(ground_truth[i]);
+      quantized_iou += quantized_estimates[i].compute_iou(ground_truth[i]);
+      drift_iou += quantized_estimates[i].compute_iou(float_estimates[i]);
+    }
+    const size_t num_frames = float_estimates.size();
+    if (num_frames > 0) {
+      printf("%-6zu %8zu %12.4f %12.4f %12.4f\n", video_num, num_frames, float_iou / num_frames,
+             quantized_iou / num_frames, drift_iou / num_frames);
+    }
+    total_float_iou += float_iou;
+    total_quantized_iou += quantized_iou;
+    total_drift_iou += drift_iou;
+    total_frames += num_frames;
+  }
+  if (total_frames > 0) {
+    printf("%-6s %8zu %12.4f %12.4f %12.4f\n", "All", total_frames, total_float_iou / total_frames,
+           total_quantized_iou / total_frames, total_drift_iou / total_frames);
+  }
+
+  // Report the speed of each network.
+  printf("Float: %.2f ms per frame, int8: %.2f ms per frame\n",
+         float_recorder.ms_per_frame(), quantized_recorder.ms_per_frame());
+
+  return 0;
+}
@@ -0,0 +1,545 @@
+// Compress the fully-connected layers of the tracker network with low-rank factorisation.
+// Each weight matrix W (outputs x inputs) is approximated by its truncated SVD U S V^T,
+// and the layer is replaced by two thinner fully-connected layers:
+//   name-a: inputs -> rank, weights sqrt(S) V^T, no bias
+//   name-b: rank -> outputs, weights U sqrt(S), the original bias
+// For each requested rank, this writes a prototxt / caffemodel pair that Regressor can load,
+// fine-tunes it briefly (the conv layers stay frozen, as in training), and tracks the
+// validation videos to print the speed and accuracy of each rank next to the original network.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <caffe/caffe.hpp>
+#include <caffe/util/math_functions.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "helper/bounding_box.h"
+#include "loader/frame_prefetcher.h"
+#include "loader/loader_alov.h"
+#include "network/regressor.h"
+#include "network/regressor_train.h"
+#include "tracker/tracker.h"
+#include "tracker/tracker_manager.h"
+#include "train/example_generator.h"
+#include "train/tracker_trainer.h"
+
+using std::string;
+
+namespace {
+
+// Fully-connected layers to compress.
+const char* const kCompressedLayers[] = { "fc6-new", "fc7-new", "fc7-newb" };
+const size_t kNumCompressedLayers = sizeof(kCompressedLayers) / sizeof(kCompressedLayers[0]);
+
+// Randomized SVD: extra columns sampled beyond the rank, and the number of power iterations
+// (which sharpen the estimate of the leading singular vectors).
+const int kOversampling = 10;
+const int kPowerIterations = 2;
+
+// Largest rank considered when the rank is chosen from an energy threshold.
+const int kMaxEnergyRank = 1024;
+
+// Fine-tuning settings (as in scripts/train.sh and nets/solver.prototxt).
+const double kLambdaShift = 5;
+const double kLambdaScale = 15;
+const double kMinScale = -0.4;
+const double kMaxScale = 0.4;
+const float kBaseLr = 0.000001;
+
+// A requested rank: either a fixed rank, or the smallest rank that keeps the given
+// fraction of the energy (sum of squared singular values) of each layer.
+struct RankSpec {
+  string label;
+  int rank;
+  double energy;
+};
+
+// Truncated SVD of a weight matrix, with the singular values in decreasing order.
+struct Factorization {
+  cv::Mat u;        // outputs x rank
+  cv::Mat s;        // rank x 1 (CV_64F)
+  cv::Mat vt;       // rank x inputs
+  double energy;    // squared Frobenius norm of the weight matrix
+  cv::Mat bias;     // outputs x 1, the bias of the original layer
+};
+
+// Parse a comma-separated list of ranks: integers are fixed ranks, and values below 1
+// (e.g. 0.9) are energy thresholds.
+bool ParseRanks(const string& ranks_arg, std::vector<RankSpec>* rank_specs) {
+  std::stringstream stream(ranks_arg);
+  string label;
+  while (std::getline(stream, label, ',')) {
+    RankSpec rank_spec;
+    rank_spec.label = label;
+    const double value = atof(label.c_str());
+    if (value <= 0) {
+      printf("Error - invalid rank %s\n", label.c_str());
+      return false;
+    }
+    if (value < 1) {
+      rank_spec.rank = 0;
+      rank_spec.energy = value;
+    } else {
+      rank_spec.rank = static_cast<int>(value);
+      rank_spec.energy = 0;
+    }
+    rank_specs->push_back(rank_spec);
+  }
+  return !rank_specs->empty();
+}
+
+// Compute c = op(a) * op(b), where op transposes the matrix if requested.
+void Multiply(const cv::Mat& a, const bool transpose_a, const cv::Mat& b, const bool transpose_b,
+              cv::Mat* c) {
+  const int m = transpose_a ? a.cols : a.rows;
+  const int k = transpose_a ? a.rows : a.cols;
+  const int n = transpose_b ? b.rows : b.cols;
+  c->create(m, n, CV_32F);
+  caffe::caffe_cpu_gemm<float>(transpose_a ? CblasTrans : CblasNoTrans,
+                               transpose_b ? CblasTrans : CblasNoTrans,
+                               m, n, k, 1, a.ptr<float>(), b.ptr<float>(), 0, c->ptr<float>());
+}
+
+// Replace the columns of y by an orthonormal basis of their span, computed from the
+// eigen-decomposition of y^T y (columns that are numerically dependent are dropped).
+void Orthonormalize(cv::Mat* y) {
+  cv::Mat gram;
+  Multiply(*y, true, *y, false, &gram);
+  gram.convertTo(gram, CV_64F);
+
+  cv::Mat eigenvalues;
+  cv::Mat eigenvectors;
+  cv::eigen(gram, eigenvalues, eigenvectors);
+
+  // Scale each eigenvector by 1 / sqrt(eigenvalue), so that y * transform is orthonormal.
+  const double min_eigenvalue = std::max(eigenvalues.at<double>(0), 0.0) * 1e-10;
+  int num_columns = 0;
+  while (num_columns < eigenvalues.rows && eigenvalues.at<double>(num_columns) > min_eigenvalue) {
+    ++num_columns;
+  }
+  cv::Mat transform(y->cols, num_columns, CV_32F);
+  for (int j = 0; j < num_columns; ++j) {
+    const double scale = 1 / sqrt(eigenvalues.at<double>(j));
+    for (int i = 0; i < y->cols; ++i) {
+      transform.at<float>(i, j) = eigenvectors.at<double>(j, i) * scale;
+    }
+  }
+
+  cv::Mat q;
+  Multiply(*y, false, transform, false, &q);
+  *y = q;
+}
+
+// Orthonormalize twice, to remove the rounding errors left by a single pass.
+void OrthonormalizeTwice(cv::Mat* y) {
+  Orthonormalize(y);
+  Orthonormalize(y);
+}
+
+// Compute the leading max_rank singular values and vectors of weights (outputs x inputs),
+// with a randomized SVD (Halko, Martinsson and Tropp, 2011).
+void ComputeTruncatedSVD(const cv::Mat& weights, const int max_rank, Factorization* factorization) {
+  const int num_samples = std::min(max_rank + kOversampling, std::min(weights.rows, weights.cols));
+
+  // Sample the range of the weights.
+  cv::Mat omega(weights.cols, num_samples, CV_32F);
+  cv::randn(omega, 0, 1);
+  cv::Mat q;
+  Multiply(weights, false, omega, false, &q);
+  OrthonormalizeTwice(&q);
+
+  // Refine the sample with power iterations.
+  cv::Mat z;
+  for (int i = 0; i < kPowerIterations; ++i) {
+    Multiply(weights, true, q, false, &z);
+    OrthonormalizeTwice(&z);
+    Multiply(weights, false, z, false, &q);
+    OrthonormalizeTwice(&q);
+  }
+
+  // Project the weights onto the sampled range: weights ~ q * b.
+  cv::Mat b;
+  Multiply(q, true, weights, false, &b);
+
+  // The SVD of b = E S V^T follows from the eigen-decomposition b b^T = E S^2 E^T.
+  cv::Mat b_bt;
+  Multiply(b, false, b, true, &b_bt);
+  b_bt.convertTo(b_bt, CV_64F);
+  cv::Mat eigenvalues;
+  cv::Mat eigenvectors;
+  cv::eigen(b_bt, eigenvalues, eigenvectors);
+
+  int rank = std::min(max_rank, eigenvalues.rows);
+  while (rank > 0 && eigenvalues.at<double>(rank - 1) <= 0) {
+    --rank;
+  }
+
+  // U = q E, V^T = S^-1 E^T b.
+  cv::Mat e(rank, eigenvectors.cols, CV_32F);
+  eigenvectors.rowRange(0, rank).convertTo(e, CV_32F);
+  Multiply(q, false, e, true, &factorization->u);
+  Multiply(e, false, b, false, &factorization->vt);
+  factorization->s.create(rank, 1, CV_64F);
+  for (int i = 0; i < rank; ++i) {
+    const double singular_value = sqrt(eigenvalues.at<double>(i));
+    factorization->s.at<double>(i) = singular_value;
+    cv::Mat vt_row = factorization->vt.row(i);
+    vt_row *= 1 / singular_value;
+  }
+
+  factorization->energy = cv::norm(weights, cv::NORM_L2SQR);
+}
+
+// Choose the rank of a layer for the rank spec, or 0 to leave the layer uncompressed
+// (when the two thinner layers would have at least as many weights as the original).
+int ChooseRank(const RankSpec& rank_spec, const Factorization& factorization,
+               const string& layer_name) {
+  const int num_outputs = factorization.u.rows;
+  const int num_inputs = factorization.vt.cols;
+  const int max_rank = factorization.s.rows;
+
+  int rank = std::min(rank_spec.rank, max_rank);
+  if (rank_spec.energy > 0) {
+    // Smallest rank whose singular values hold the requested fraction of the energy.
+    double energy = 0;
+    rank = 0;
+    while (rank < max_rank && energy < rank_spec.energy * factorization.energy) {
+      energy += factorization.s.at<double>(rank) * factorization.s.at<double>(rank);
+      ++rank;
+    }
+    if (energy < rank_spec.energy * factorization.energy) {
+      printf("Warning - %s keeps only %.4f of its energy at the largest rank %d\n",
+             layer_name.c_str(), energy / factorization.energy, max_rank);
+    }
+  }
+
+  if (static_cast<double>(rank) * (num_outputs + num_inputs) >=
+      static_cast<double>(num_outputs) * num_inputs) {
+    printf("Warning - rank %d does not reduce %s (%d x %d); leaving it uncompressed\n",
+           rank, layer_name.c_str(), num_outputs, num_inputs);
+    return 0;
+  }
+  return rank;
+}
+
+// Copy the rows x cols matrix to the data of blob.
+void SetBlob(const cv::Mat& matrix, caffe::Blob<float>* blob) {
+  if (blob->count() != matrix.rows * matrix.cols) {
+    printf("Error - blob of size %d does not match a %d x %d matrix\n", blob->count(),
+           matrix.rows, matrix.cols);
+    exit(-1);
+  }
+  const cv::Mat continuous = matrix.clone();
+  caffe::caffe_copy(blob->count(), continuous.ptr<float>(), blob->mutable_cpu_data());
+}
+
+// Make the network architecture with each layer in ranks replaced by its two factors.
+void MakeCompressedNet(const caffe::NetParameter& net_param, const std::map<string, int>& ranks,
+                       caffe::NetParameter* compressed_param) {
+  compressed_param->CopyFrom(net_param);
+  compressed_param->clear_layer();
+  for (int i = 0; i < net_param.layer_size(); ++i) {
+    const caffe::LayerParameter& layer = net_param.layer(i);
+    std::map<string, int>::const_iterator it = ranks.find(layer.name());
+    if (it == ranks.end() || it->second == 0) {
+      compressed_param->add_layer()->CopyFrom(layer);
+      continue;
+    }
+
+    // First factor: the original input to the rank, without a bias (so only the learning
+    // rate of the weights is kept).
+    caffe::LayerParameter* layer_a = compressed_param->add_layer();
+    layer_a->CopyFrom(layer);
+    layer_a->set_name(layer.name() + "-a");
+    layer_a->set_top(0, layer.name() + "-a");
+    layer_a->mutable_inner_product_param()->set_num_output(it->second);
+    layer_a->mutable_inner_product_param()->set_bias_term(false);
+    while (layer_a->param_size() > 1) {
+      layer_a->mutable_param()->RemoveLast();
+    }
+
+    // Second factor: the rank to the original output, with the original bias.
+    caffe::LayerParameter* layer_b = compressed_param->add_layer();
+    layer_b->CopyFrom(layer);
+    layer_b->set_name(layer.name() + "-b");
+    layer_b->set_bottom(0, layer.name() + "-a");
+  }
+}
+
+// Write the prototxt and the caffemodel of the network compressed to the given ranks.
+// The weights of the uncompressed layers are copied from caffe_model.
+void SaveCompressedNet(const caffe::NetParameter& net_param,
+                       const std::map<string, Factorization>& factorizations,
+                       const std::map<string, int>& ranks,
+                       const string& compressed_proto, const string& compressed_model,
+                       const string& caffe_model) {
+  caffe::NetParameter compressed_param;
+  MakeCompressedNet(net_param, ranks, &compressed_param);
+  caffe::WriteProtoToTextFile(compressed_param, compressed_proto);
+
+  // Copy the weights of the unchanged layers from the original model.
+  compressed_param.mutable_state()->set_phase(caffe::TEST);
+  caffe::Net<float> compressed_net(compressed_param);
+  compressed_net.CopyTrainedLayersFrom(caffe_model);
+
+  // Set the weights of the factors (and the bias of the second factor) from the SVD.
+  for (std::map<string, int>::const_iterator it = ranks.begin(); it != ranks.end(); ++it) {
+    const int rank = it->second;
+    if (rank == 0) {
+      continue;
+    }
+    const Factorization& factorization = factorizations.find(it->first)->second;
+    cv::Mat weights_a = factorization.vt.rowRange(0, rank).clone();
+    cv::Mat weights_b = factorization.u.colRange(0, rank).clone();
+    for (int i = 0; i < rank; ++i) {
+      const double scale = sqrt(factorization.s.at<double>(i));
+      cv::Mat row_a = weights_a.row(i);
+      cv::Mat column_b = weights_b.col(i);
+      row_a *= scale;
+      column_b *= scale;
+    }
+
+    const std::vector<boost::shared_ptr<caffe::Blob<float> > >& blobs_a =
+        compressed_net.layer_by_name(it->first + "-a")->blobs();
+    const std::vector<boost::shared_ptr<caffe::Blob<float> > >& blobs_b =
+        compressed_net.layer_by_name(it->first + "-b")->blobs();
+    SetBlob(weights_a, blobs_a[0].get());
+    SetBlob(weights_b, blobs_b[0].get());
+    SetBlob(factorization.bias, blobs_b[1].get());
+  }
+
+  caffe::NetParameter compressed_weights;
+  compressed_net.ToProto(&compressed_weights);
+  caffe::WriteProtoToBinaryFile(compressed_weights, compressed_model);
+}
+
+// Write a solver that fine-tunes the network in train_proto (with the settings of
+// nets/solver.prototxt, at a fixed learning rate) to solver_file.
+void SaveSolver(const string& train_proto, const int num_iterations, const int gpu_id,
+                const string& solver_file) {
+  caffe::SolverParameter solver_param;
+  solver_param.set_net(train_proto);
+  solver_param.set_base_lr(kBaseLr);
+  solver_param.set_lr_policy("fixed");
+  solver_param.set_momentum(0.9);
+  solver_param.set_weight_decay(0.0005);
+  solver_param.set_max_iter(num_iterations);
+  solver_param.set_display(20);
+  if (gpu_id < 0) {
+    solver_param.set_solver_mode(caffe::SolverParameter_SolverMode_CPU);
+  } else {
+    solver_param.set_device_id(gpu_id);
+  }
+  caffe::WriteProtoToTextFile(solver_param, solver_file);
+}
+
+// Train on a random pair of consecutive annotated frames from the videos (as in train.cpp).
+void TrainVideo(const std::vector<Video>& videos, TrackerTrainer* tracker_trainer) {
+  const Video& video = videos[rand() % videos.size()];
+  const std::vector<Frame>& annotations = video.annotations;
+  if (annotations.size() < 2) {
+    return;
+  }
+  const int annotation_index = rand() % (annotations.size() - 1);
+
+  int frame_num_prev;
+  cv::Mat image_prev;
+  BoundingBox bbox_prev;
+  video.LoadAnnotation(annotation_index, &frame_num_prev, &image_prev, &bbox_prev);
+
+  int frame_num_curr;
+  cv::Mat image_curr;
+  BoundingBox bbox_curr;
+  video.LoadAnnotation(annotation_index + 1, &frame_num_curr, &image_curr, &bbox_curr);
+
+  tracker_trainer->Train(image_prev, image_curr, bbox_prev, bbox_curr);
+}
+
+// Fine-tune the network in train_proto, starting from caffe_model, for num_iterations
+// batches, and overwrite caffe_model with the result.
+void FineTune(const string& train_proto, const string& caffe_model, const string& solver_file,
+              const std::vector<Video>& videos, const int num_iterations, const int gpu_id) {
+  SaveSolver(train_proto, num_iterations, gpu_id, solver_file);
+
+  ExampleGenerator example_generator(kLambdaShift, kLambdaScale, kMinScale, kMaxScale);
+  RegressorTrain regressor_train(train_proto, caffe_model, gpu_id, solver_file);
+  TrackerTrainer tracker_trainer(&example_generator, &regressor_train);
+  while (tracker_trainer.get_num_batches() < num_iterations) {
+    TrainVideo(videos, &tracker_trainer);
+  }
+  regressor_train.SaveWeights(caffe_model);
+}
+
+// Track the videos with the network and print its row of the table.
+void Evaluate(const string& label, const string& ranks, const double num_parameters,
+              const string& proto, const string& caffe_model, const int gpu_id,
+              const std::vector<Video>& videos, Tracker* tracker) {
+  const bool do_train = false;
+  Regressor regressor(proto, caffe_model, gpu_id, do_train);
+  TrackerRecorder recorder(videos, &regressor, tracker);
+  recorder.TrackAll();
+  printf("%-10s %-20s %12.2f %10.4f %10.2f\n", label.c_str(), ranks.c_str(),
+         num_parameters / 1e6, recorder.ComputeMeanIoU(), recorder.ms_per_frame());
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc < 8) {
+    std::cerr << "Usage: " << argv[0]
+              << " train.prototxt network.caffemodel output_prefix"
+              << " alov_videos_folder alov_annotations_folder"
+              << " ranks gpu_id [finetune_iterations] [max_videos]" << std::endl
+              << "  ranks: comma-separated ranks (e.g. 256,512) or energy fractions (e.g. 0.9)"
+              << std::endl;
+    return 1;
+  }
+
+  FLAGS_alsologtostderr = 1;
+
+  ::google::InitGoogleLogging(argv[0]);
+
+  int arg_index = 1;
+  const string train_proto             = argv[arg_index++];
+  const string caffe_model             = argv[arg_index++];
+  const string output_prefix           = argv[arg_index++];
+  const string alov_videos_folder      = argv[arg_index++];
+  const string alov_annotations_folder = argv[arg_index++];
+  const string ranks_arg               = argv[arg_index++];
+  const int gpu_id                     = atoi(argv[arg_index++]);
+  const int finetune_iterations = argc > arg_index ? atoi(argv[arg_index++]) : 0;
+  const size_t max_videos       = argc > arg_index ? atoi(argv[arg_index++]) : 0;
+
+  std::vector<RankSpec> rank_specs;
+  if (!ParseRanks(ranks_arg, &rank_specs)) {
+    return 1;
+  }
+
+  // Fine-tune on the training videos and evaluate on the validation videos.
+  LoaderAlov alov_video_loader(alov_videos_folder, alov_annotations_folder);
+  std::vector<Video> train_videos;
+  std::vector<Video> validation_videos;
+  alov_video_loader.get_videos(true, &train_videos);
+  alov_video_loader.get_videos(false, &validation_videos);
+  if (max_videos > 0) {
+    validation_videos.resize(std::min(validation_videos.size(), max_videos));
+  }
+
+  // Read the frames of each validation video ahead of the tracker.  (The training videos
+  // are sampled at random, so reading ahead would not help.)
+  FramePrefetcher prefetcher(kPrefetchThreads, kPrefetchFrames, kPrefetchBytes);
+  prefetcher.Attach(&validation_videos);
+  if (finetune_iterations > 0 && train_videos.empty()) {
+    printf("Error - no training videos to fine-tune on\n");
+    return 1;
+  }
+
+  // Largest rank needed from the SVD of each layer.
+  int max_rank = 0;
+  for (size_t i = 0; i < rank_specs.size(); ++i) {
+    max_rank = std::max(max_rank, rank_specs[i].energy > 0 ? kMaxEnergyRank : rank_specs[i].rank);
+  }
+
+  // Factorise each fully-connected layer once, at the largest rank needed.
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(train_proto, &net_param);
+  std::map<string, Factorization> factorizations;
+  std::map<string, double> num_layer_parameters;
+  {
+    caffe::Net<float> net(train_proto, caffe::TEST);
+    net.CopyTrainedLayersFrom(caffe_model);
+    for (size_t i = 0; i < kNumCompressedLayers; ++i) {
+      const string layer_name = kCompressedLayers[i];
+      if (!net.has_layer(layer_name)) {
+        printf("Error - %s has no layer %s\n", train_proto.c_str(), layer_name.c_str());
+        return 1;
+      }
+      const std::vector<boost::shared_ptr<caffe::Blob<float> > >& blobs =
+          net.layer_by_name(layer_name)->blobs();
+      const caffe::Blob<float>& weight_blob = *blobs[0];
+      const cv::Mat weights(weight_blob.shape(0), weight_blob.count(1), CV_32F,
+                            const_cast<float*>(weight_blob.cpu_data()));
+
+      printf("Factorising %s (%d x %d)\n", layer_name.c_str(), weights.rows, weights.cols);
+      Factorization& factorization = factorizations[layer_name];
+      ComputeTruncatedSVD(weights, max_rank, &factorization);
+      factorization.bias = cv::Mat(blobs[1]->count(), 1, CV_32F,
+                                   const_cast<float*>(blobs[1]->cpu_data())).clone();
+      num_layer_parameters[layer_name] = weights.rows * (weights.cols + 1.0);
+    }
+  }
+
+  const bool show_intermediate_output = false;
+  Tracker tracker(show_intermediate_output);
+
+  // Number of parameters of the original fully-connected layers.
+  double original_parameters = 0;
+  for (size_t i = 0; i < kNumCompressedLayers; ++i) {
+    original_parameters += num_layer_parameters[kCompressedLayers[i]];
+  }
+
+  // Compress the network to each rank, fine-tune it, and evaluate it.
+  std::vector<string> labels;
+  std::vector<string> rank_lists;
+  std::vector<double> parameters;
+  std::vector<string> protos;
+  std::vector<string> models;
+  for (size_t i = 0; i < rank_specs.size(); ++i) {
+    const RankSpec& rank_spec = rank_specs[i];
+
+    std::map<string, int> ranks;
+    std::stringstream rank_list;
+    double num_parameters = 0;
+    for (size_t j = 0; j < kNumCompressedLayers; ++j) {
+      const string layer_name = kCompressedLayers[j];
+      const Factorization& factorization = factorizations[layer_name];
+      const int rank = ChooseRank(rank_spec, factorization, layer_name);
+      ranks[layer_name] = rank;
+      rank_list << (j > 0 ? "/" : "") << (rank > 0 ? rank : -1);
+      num_parameters += rank > 0 ?
+          rank * (factorization.u.rows + factorization.vt.cols) + factorization.u.rows :
+          num_layer_parameters[layer_name];
+    }
+
+    const string compressed_proto = output_prefix + "_" + rank_spec.label + ".prototxt";
+    const string compressed_model = output_prefix + "_" + rank_spec.label + ".caffemodel";
+    printf("Writing %s and %s (ranks %s)\n", compressed_proto.c_str(), compressed_model.c_str(),
+           rank_list.str().c_str());
+    SaveCompressedNet(net_param, factorizations, ranks, compressed_proto, compressed_model,
+                      caffe_model);
+
+    if (finetune_iterations > 0) {
+      printf("Fine-tuning %s for %d iterations\n", compressed_model.c_str(), finetune_iterations);
+      const string solver_file = output_prefix + "_" + rank_spec.label + "_solver.prototxt";
+      FineTune(compressed_proto, compressed_model, solver_file, train_videos,
+               finetune_iterations, gpu_id);
+    }
+
+    labels.push_back(rank_spec.label);
+    rank_lists.push_back(rank_list.str());
+    parameters.push_back(num_parameters);
+    protos.push_back(compressed_proto);
+    models.push_back(compressed_model);
+  }
+
+  // Track the validation videos with the original and each compressed network.
+  // (Ranks of -1 mark layers left uncompressed.)
+  printf("Evaluating on %zu videos\n", validation_videos.size());
+  printf("%-10s %-20s %12s %10s %10s\n", "Rank", "Ranks per layer", "FC params (M)",
+         "Mean IoU", "ms/frame");
+  Evaluate("original", "-", original_parameters, train_proto, caffe_model, gpu_id,
+           validation_videos, &tracker);
+  for (size_t i = 0; i < labels.size(); ++i) {
+    Evaluate(labels[i], rank_lists[i], parameters[i], protos[i], models[i], gpu_id,
+             validation_videos, &tracker);
+  }
+
+  return 0;
+}
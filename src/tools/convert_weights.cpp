@@ -0,0 +1,56 @@
+// Convert a .caffemodel into a flat weight file (see network/weight_file.h), which
+// can be memory-mapped by the tracker instead of being decoded at startup.
+// The weight file can be used anywhere a .caffemodel is expected when tracking.
+
+#include <string>
+#include <vector>
+
+#include <caffe/caffe.hpp>
+
+#include "network/weight_file.h"
+
+using std::string;
+
+int main (int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " deploy.prototxt network.caffemodel output.weights" << std::endl;
+    return 1;
+  }
+
+  ::google::InitGoogleLogging(argv[0]);
+
+  const string deploy_proto = argv[1];
+  const string caffe_model  = argv[2];
+  const string output_file  = argv[3];
+
+  // Load the network with its trained weights.
+  caffe::Caffe::set_mode(caffe::Caffe::CPU);
+  caffe::Net<float> net(deploy_proto, caffe::TEST);
+  net.CopyTrainedLayersFrom(caffe_model);
+
+  // Collect the parameter blobs of each layer.
+  std::vector<WeightBlob> blobs;
+  const std::vector<string>& layer_names = net.layer_names();
+  for (size_t i = 0; i < net.layers().size(); ++i) {
+    const std::vector<boost::shared_ptr<caffe::Blob<float> > >& layer_blobs = net.layers()[i]->blobs();
+    for (size_t j = 0; j < layer_blobs.size(); ++j) {
+      WeightBlob blob;
+      blob.layer_name = layer_names[i];
+      blob.blob_index = j;
+      blob.shape = layer_blobs[j]->shape();
+      blob.data = layer_blobs[j]->cpu_data();
+      blobs.push_back(blob);
+
+      printf("%s[%zu]: %s\n", layer_names[i].c_str(), j, layer_blobs[j]->shape_string().c_str());
+    }
+  }
+
+  // Save the weights.
+  if (!WriteWeightFile(blobs, output_file)) {
+    return 1;
+  }
+  printf("Saved %zu blobs to %s\n", blobs.size(), output_file.c_str());
+
+  return 0;
+}
@@ -0,0 +1,653 @@
+// Compile a network ahead of time: read a Caffe .prototxt and write the implementation of
+// CompiledNet (see network/compiled_net.h) for it, as C++ code in which the shape of every
+// layer is a compile-time constant.
+// Run by the build (see CMakeLists.txt), but can also be run by hand:
+//   generate_net nets/tracker.prototxt fc8 compiled_net.cpp
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include "network/memory_plan.h"
+#include "network/native_layers.h"
+#include "network/native_net.h"
+#include "network/prototxt.h"
+
+using std::string;
+
+namespace {
+
+// An activation of the compiled network.  Layers that run in place (such as a ReLU after a
+// convolution) update the activation of their input rather than creating a new one.
+struct Value {
+  Value() : producer(-1), concat(-1), concat_offset(0), offset(0) {}
+
+  string name;
+  NativeShape shape;
+
+  // Index of the op that computes this value (-1 for inputs and scratch buffers).
+  int producer;
+
+  // If not -1, this value is stored inside the value concat (at concat_offset floats),
+  // so that the Concat that reads it does not need to copy it.
+  int concat;
+  size_t concat_offset;
+
+  // Offset in the buffer of all activations (in floats).
+  size_t offset;
+};
+
+// A layer of the compiled network.
+struct Op {
+  Op() : relu(false), top(-1), scratch(-1), weights(-1), bias(-1) {}
+
+  string name;
+  string type;
+  const PrototxtMessage* param;
+
+  // Whether a ReLU is fused into this (Convolution or InnerProduct) layer.
+  bool relu;
+
+  std::vector<int> bottoms;
+  int top;
+
+  // Scratch buffer used only while this layer runs (im2col columns or LRN scales), or -1.
+  int scratch;
+
+  // Indices of the weights and bias of this layer in CompiledNet::weights_, or -1.
+  int weights;
+  int bias;
+};
+
+// A blob of weights that the compiled network needs.
+struct Weight {
+  string layer_name;
+  int blob_index;
+  size_t count;
+};
+
+// Write a float as a C++ literal that reads back as the same float.
+string FloatLiteral(const float value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+  string literal = buffer;
+  if (literal.find_first_of(".e") == string::npos) {
+    literal += ".0";
+  }
+  return literal + "f";
+}
+
+// Builds the compiled network from the layers of the prototxt.
+class Generator
+{
+public:
+  // Read the network in deploy_proto needed to compute output_name.
+  // Returns false if the network cannot be compiled.
+  bool Read(const string& deploy_proto, const string& output_name);
+
+  // Assign the offset of each activation in the buffer of all activations.
+  void PlanMemory();
+
+  // Write the implementation of CompiledNet.
+  void Write(std::ostream* out) const;
+
+private:
+  // Add an op for the layer.  Returns false if the layer is not supported.
+  bool AddLayer(const PrototxtMessage& layer_param);
+
+  // Add a new value with the given name and shape, and return its index.
+  int AddValue(const string& name, const NativeShape& shape, const int producer);
+
+  // Add the weights of a layer (and its bias, if bias_count > 0) to the weights to load.
+  void AddWeights(const string& layer_name, const size_t weights_count, const size_t bias_count,
+                  Op* op);
+
+  // Store the inputs of each Concat directly in its output, where possible.
+  void ElideConcats();
+
+  // The value that holds the storage of value (the Concat it is stored in, if any).
+  int StorageValue(int value) const;
+
+  // Offset of value in the buffer of all activations.
+  size_t Offset(const int value) const;
+
+  // Write the code of the op.
+  void WriteOp(const Op& op, std::ostream* out) const;
+
+  // The network (which the ops point into).
+  string deploy_proto_;
+  PrototxtMessage net_param_;
+
+  std::vector<std::pair<string, int> > inputs_;
+  std::vector<Value> values_;
+  std::vector<Op> ops_;
+  std::vector<Weight> weights_;
+
+  // Current value of each blob name.
+  std::map<string, int> blobs_;
+
+  int output_;
+
+  // Whether each value has its own place in the buffer of all activations (values stored
+  // inside a Concat, and inputs that are not used, do not), and the size of the buffer.
+  std::vector<bool> stored_;
+  size_t arena_size_;
+};
+
+bool Generator::Read(const string& deploy_proto, const string& output_name) {
+  deploy_proto_ = deploy_proto;
+
+  if (!net_param_.ParseFile(deploy_proto)) {
+    return false;
+  }
+
+  std::vector<const PrototxtMessage*> layers;
+  std::vector<std::pair<string, NativeShape> > inputs;
+  if (!NativeNet::GetTestLayers(net_param_, output_name, &layers, &inputs)) {
+    printf("Error - could not read the inputs of %s\n", deploy_proto.c_str());
+    return false;
+  }
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    const int value = AddValue(inputs[i].first, inputs[i].second, -1);
+    inputs_.push_back(std::make_pair(inputs[i].first, value));
+    blobs_[inputs[i].first] = value;
+  }
+
+  for (size_t i = 0; i < layers.size(); ++i) {
+    if (!AddLayer(*layers[i])) {
+      return false;
+    }
+  }
+
+  if (!blobs_.count(output_name)) {
+    printf("Error - %s has no blob named %s\n", deploy_proto.c_str(), output_name.c_str());
+    return false;
+  }
+  output_ = blobs_[output_name];
+
+  ElideConcats();
+  return true;
+}
+
+int Generator::AddValue(const string& name, const NativeShape& shape, const int producer) {
+  Value value;
+  value.name = name;
+  value.shape = shape;
+  value.shape.num = 1;
+  value.producer = producer;
+  values_.push_back(value);
+  return values_.size() - 1;
+}
+
+void Generator::AddWeights(const string& layer_name, const size_t weights_count,
+                           const size_t bias_count, Op* op) {
+  Weight weight;
+  weight.layer_name = layer_name;
+  weight.blob_index = 0;
+  weight.count = weights_count;
+  op->weights = weights_.size();
+  weights_.push_back(weight);
+
+  if (bias_count > 0) {
+    weight.blob_index = 1;
+    weight.count = bias_count;
+    op->bias = weights_.size();
+    weights_.push_back(weight);
+  }
+}
+
+bool Generator::AddLayer(const PrototxtMessage& layer_param) {
+  Op op;
+  op.name = layer_param.GetString("name", "");
+  op.type = layer_param.GetString("type", "");
+  op.param = &layer_param;
+
+  const std::vector<string> bottoms = layer_param.GetValues("bottom");
+  const std::vector<string> tops = layer_param.GetValues("top");
+  if (tops.size() != 1 || bottoms.empty()) {
+    printf("Error - layer %s must have inputs and a single output\n", op.name.c_str());
+    return false;
+  }
+  for (size_t i = 0; i < bottoms.size(); ++i) {
+    if (!blobs_.count(bottoms[i])) {
+      printf("Error - input %s of layer %s is not computed\n", bottoms[i].c_str(),
+             op.name.c_str());
+      return false;
+    }
+    op.bottoms.push_back(blobs_[bottoms[i]]);
+  }
+  const NativeShape bottom_shape = values_[op.bottoms[0]].shape;
+  const bool in_place = tops[0] == bottoms[0];
+  const int op_index = ops_.size();
+
+  if (op.type == "Dropout") {
+    // Dropout does nothing in the TEST phase, so its output is its input.
+    blobs_[tops[0]] = op.bottoms[0];
+    return true;
+  }
+
+  if (op.type == "ReLU") {
+    const PrototxtMessage* param = layer_param.GetMessage("relu_param");
+    const float negative_slope = param ? param->GetFloat("negative_slope", 0) : 0;
+
+    // Fuse an in-place ReLU into the Convolution or InnerProduct layer that computed its input.
+    const int producer = values_[op.bottoms[0]].producer;
+    if (in_place && negative_slope == 0 && producer >= 0 && !ops_[producer].relu &&
+        (ops_[producer].type == "Convolution" || ops_[producer].type == "InnerProduct")) {
+      ops_[producer].relu = true;
+      return true;
+    }
+    op.top = in_place ? op.bottoms[0] : AddValue(tops[0], bottom_shape, op_index);
+  } else if (op.type == "Convolution" || op.type == "InnerProduct") {
+    const bool convolution = op.type == "Convolution";
+    const PrototxtMessage* param = layer_param.GetMessage(
+        convolution ? "convolution_param" : "inner_product_param");
+    if (!param || in_place) {
+      printf("Error - layer %s is not supported\n", op.name.c_str());
+      return false;
+    }
+    const int num_output = param->GetInt("num_output", 0);
+    const bool bias_term = param->GetString("bias_term", "true") == "true";
+
+    NativeShape top_shape;
+    top_shape.channels = num_output;
+    top_shape.height = 1;
+    top_shape.width = 1;
+    if (convolution) {
+      // Same restrictions as NativeNet.
+      const int kernel_size = param->GetInt("kernel_size", 0);
+      const int stride = param->GetInt("stride", 1);
+      const int pad = param->GetInt("pad", 0);
+      const int group = param->GetInt("group", 1);
+      if (param->Has("kernel_h") || param->Has("stride_h") || param->Has("pad_h") ||
+          param->GetValues("kernel_size").size() > 1 || param->GetValues("stride").size() > 1 ||
+          param->GetValues("pad").size() > 1 || param->GetInt("dilation", 1) != 1 ||
+          group <= 0 || stride <= 0 || bottom_shape.channels % group != 0 ||
+          num_output % group != 0) {
+        printf("Error - convolution %s is not supported\n", op.name.c_str());
+        return false;
+      }
+      top_shape.height = (bottom_shape.height + 2 * pad - kernel_size) / stride + 1;
+      top_shape.width = (bottom_shape.width + 2 * pad - kernel_size) / stride + 1;
+      if (top_shape.height <= 0 || top_shape.width <= 0) {
+        printf("Error - the input of convolution %s is too small\n", op.name.c_str());
+        return false;
+      }
+
+      const size_t patch_size = static_cast<size_t>(bottom_shape.channels / group) *
+          kernel_size * kernel_size;
+      AddWeights(op.name, num_output * patch_size, bias_term ? num_output : 0, &op);
+
+      // Buffer for the input patches of one group (im2col).
+      NativeShape columns_shape;
+      columns_shape.channels = patch_size;
+      columns_shape.height = top_shape.height;
+      columns_shape.width = top_shape.width;
+      op.scratch = AddValue(op.name + "_columns", columns_shape, -1);
+    } else {
+      if (param->GetInt("axis", 1) != 1 || param->GetString("transpose", "false") != "false") {
+        printf("Error - inner product %s is not supported\n", op.name.c_str());
+        return false;
+      }
+      AddWeights(op.name, num_output * bottom_shape.image_count(), bias_term ? num_output : 0,
+                 &op);
+    }
+    op.top = AddValue(tops[0], top_shape, op_index);
+  } else if (op.type == "Pooling") {
+    const PrototxtMessage* param = layer_param.GetMessage("pooling_param");
+    if (!param || param->GetString("pool", "MAX") != "MAX" || param->Has("kernel_h") ||
+        param->GetString("global_pooling", "false") != "false" || in_place) {
+      printf("Error - pooling %s is not supported\n", op.name.c_str());
+      return false;
+    }
+
+    // Use the pooling layer of NativeNet to compute the output shape (with Caffe's rounding).
+    NativeMaxPoolingLayer pooling(param->GetInt("kernel_size", 0), param->GetInt("stride", 1),
+                                  param->GetInt("pad", 0));
+    NativeShape top_shape;
+    if (!pooling.Reshape(std::vector<NativeShape>(1, bottom_shape), &top_shape)) {
+      printf("Error - pooling %s is not supported\n", op.name.c_str());
+      return false;
+    }
+    op.top = AddValue(tops[0], top_shape, op_index);
+  } else if (op.type == "LRN") {
+    const PrototxtMessage* param = layer_param.GetMessage("lrn_param");
+    const int local_size = param ? param->GetInt("local_size", 5) : 5;
+    if ((param && param->GetString("norm_region", "ACROSS_CHANNELS") != "ACROSS_CHANNELS") ||
+        local_size <= 0 || local_size % 2 == 0 || in_place) {
+      printf("Error - LRN %s is not supported\n", op.name.c_str());
+      return false;
+    }
+    NativeShape scale_shape;
+    scale_shape.channels = 1;
+    scale_shape.height = bottom_shape.height;
+    scale_shape.width = bottom_shape.width;
+    op.scratch = AddValue(op.name + "_scale", scale_shape, -1);
+    op.top = AddValue(tops[0], bottom_shape, op_index);
+  } else if (op.type == "Concat") {
+    const PrototxtMessage* param = layer_param.GetMessage("concat_param");
+    if ((param && (param->GetInt("axis", 1) != 1 || param->GetInt("concat_dim", 1) != 1)) ||
+        in_place) {
+      printf("Error - concat %s is not supported\n", op.name.c_str());
+      return false;
+    }
+    NativeShape top_shape = bottom_shape;
+    top_shape.channels = 0;
+    for (size_t i = 0; i < op.bottoms.size(); ++i) {
+      const NativeShape& shape = values_[op.bottoms[i]].shape;
+      if (shape.height != bottom_shape.height || shape.width != bottom_shape.width) {
+        printf("Error - the inputs of concat %s do not have the same size\n", op.name.c_str());
+        return false;
+      }
+      top_shape.channels += shape.channels;
+    }
+    op.top = AddValue(tops[0], top_shape, op_index);
+  } else {
+    printf("Error - layer %s (%s) is not supported\n", op.name.c_str(), op.type.c_str());
+    return false;
+  }
+
+  blobs_[tops[0]] = op.top;
+  ops_.push_back(op);
+  return true;
+}
+
+void Generator::ElideConcats() {
+  // Count the ops that read each value (in-place ops update it rather than only reading it).
+  std::vector<int> num_readers(values_.size(), 0);
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    for (size_t j = 0; j < ops_[i].bottoms.size(); ++j) {
+      if (ops_[i].bottoms[j] != ops_[i].top) {
+        num_readers[ops_[i].bottoms[j]]++;
+      }
+    }
+  }
+
+  // With a single image, concatenating along the channels places the inputs one after another,
+  // so each input computed only for the Concat can be computed in its place in the output.
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    const Op& op = ops_[i];
+    if (op.type != "Concat") {
+      continue;
+    }
+    bool elide = true;
+    for (size_t j = 0; j < op.bottoms.size(); ++j) {
+      const Value& bottom = values_[op.bottoms[j]];
+      if (bottom.producer < 0 || num_readers[op.bottoms[j]] != 1 || op.bottoms[j] == output_ ||
+          bottom.concat >= 0 ||
+          std::count(op.bottoms.begin(), op.bottoms.end(), op.bottoms[j]) != 1) {
+        elide = false;
+      }
+    }
+    if (!elide) {
+      continue;
+    }
+    size_t offset = 0;
+    for (size_t j = 0; j < op.bottoms.size(); ++j) {
+      Value& bottom = values_[op.bottoms[j]];
+      bottom.concat = op.top;
+      bottom.concat_offset = offset;
+      offset += bottom.shape.image_count();
+    }
+  }
+}
+
+int Generator::StorageValue(int value) const {
+  while (values_[value].concat >= 0) {
+    value = values_[value].concat;
+  }
+  return value;
+}
+
+size_t Generator::Offset(const int value) const {
+  if (values_[value].concat >= 0) {
+    return Offset(values_[value].concat) + values_[value].concat_offset;
+  }
+  return values_[value].offset;
+}
+
+void Generator::PlanMemory() {
+  // The ops during which each stored value is needed: from the first op that writes it (or
+  // any value stored inside it) to the last op that reads it (or any value stored inside it).
+  // Inputs are needed from the start and the output until the end.
+  const int num_ops = ops_.size();
+  std::vector<int> first(values_.size(), num_ops);
+  std::vector<int> last(values_.size(), -1);
+  for (int i = 0; i < num_ops; ++i) {
+    const Op& op = ops_[i];
+    const int top = StorageValue(op.top);
+    first[top] = std::min(first[top], i);
+    last[top] = std::max(last[top], i);
+    for (size_t j = 0; j < op.bottoms.size(); ++j) {
+      const int bottom = StorageValue(op.bottoms[j]);
+      last[bottom] = std::max(last[bottom], i);
+    }
+    if (op.scratch >= 0) {
+      first[op.scratch] = i;
+      last[op.scratch] = i;
+    }
+  }
+  last[StorageValue(output_)] = num_ops;
+  for (size_t i = 0; i < inputs_.size(); ++i) {
+    if (last[inputs_[i].second] >= 0) {
+      first[inputs_[i].second] = -1;
+    }
+  }
+
+  // Place the stored values (values stored inside a Concat are placed with it).
+  std::vector<PlannedBuffer> buffers(values_.size());
+  stored_.assign(values_.size(), false);
+  for (size_t i = 0; i < values_.size(); ++i) {
+    if (values_[i].concat < 0 && last[i] >= first[i]) {
+      stored_[i] = true;
+      buffers[i].count = values_[i].shape.count();
+      buffers[i].first = first[i];
+      buffers[i].last = last[i];
+    }
+  }
+  arena_size_ = ::PlanMemory(&buffers);
+  for (size_t i = 0; i < values_.size(); ++i) {
+    values_[i].offset = buffers[i].offset;
+  }
+}
+
+void Generator::WriteOp(const Op& op, std::ostream* out) const {
+  const Value& bottom = values_[op.bottoms[0]];
+  const NativeShape& in = bottom.shape;
+  const NativeShape& top = values_[op.top].shape;
+  const string weights = op.weights >= 0 ?
+      "weights_[" + boost::lexical_cast<string>(op.weights) + "]" : "NULL";
+  const string bias = op.bias >= 0 ? "weights_[" + boost::lexical_cast<string>(op.bias) + "]" : "NULL";
+  const string input = "arena + " + boost::lexical_cast<string>(Offset(op.bottoms[0]));
+  const string output = "arena + " + boost::lexical_cast<string>(Offset(op.top));
+
+  *out << "  // " << op.name << " (" << op.type << (op.relu ? " + ReLU" : "") << "): "
+       << in.channels << "x" << in.height << "x" << in.width << " -> "
+       << top.channels << "x" << top.height << "x" << top.width << "\n";
+
+  if (op.type == "Convolution") {
+    const PrototxtMessage* param = op.param->GetMessage("convolution_param");
+    *out << "  CompiledConvolution<" << in.channels << ", " << in.height << ", " << in.width
+         << ", " << top.channels << ", " << param->GetInt("kernel_size", 0) << ", "
+         << param->GetInt("stride", 1) << ", " << param->GetInt("pad", 0) << ", "
+         << param->GetInt("group", 1) << ", " << (op.relu ? "true" : "false") << ">::Forward(\n"
+         << "      " << input << ", " << weights << ", " << bias << ", arena + "
+         << Offset(op.scratch) << ", " << output << ", thread_pool_);\n";
+  } else if (op.type == "InnerProduct") {
+    *out << "  CompiledInnerProduct<" << in.image_count() << ", " << top.channels << ", "
+         << (op.relu ? "true" : "false") << ">::Forward(\n"
+         << "      " << input << ", " << weights << ", " << bias << ", " << output
+         << ", thread_pool_);\n";
+  } else if (op.type == "Pooling") {
+    const PrototxtMessage* param = op.param->GetMessage("pooling_param");
+    *out << "  CompiledMaxPooling<" << in.channels << ", " << in.height << ", " << in.width
+         << ", " << param->GetInt("kernel_size", 0) << ", " << param->GetInt("stride", 1) << ", "
+         << param->GetInt("pad", 0) << ", " << top.height << ", " << top.width << ">::Forward(\n"
+         << "      " << input << ", " << output << ", thread_pool_);\n";
+  } else if (op.type == "LRN") {
+    const PrototxtMessage* param = op.param->GetMessage("lrn_param");
+    PrototxtMessage default_param;
+    if (!param) {
+      param = &default_param;
+    }
+    *out << "  CompiledLRN<" << in.channels << ", " << in.height * in.width << ", "
+         << param->GetInt("local_size", 5) << ">::Forward(\n"
+         << "      " << input << ", " << FloatLiteral(param->GetFloat("alpha", 1)) << ", "
+         << FloatLiteral(param->GetFloat("beta", 0.75)) << ", "
+         << FloatLiteral(param->GetFloat("k", 1)) << ", arena + " << Offset(op.scratch) << ", "
+         << output << ");\n";
+  } else if (op.type == "ReLU") {
+    const PrototxtMessage* param = op.param->GetMessage("relu_param");
+    const float negative_slope = param ? param->GetFloat("negative_slope", 0) : 0;
+    *out << "  CompiledReLU<" << in.count() << ">::Forward(" << input << ", "
+         << FloatLiteral(negative_slope) << ", " << output << ");\n";
+  } else if (op.type == "Concat") {
+    size_t offset = 0;
+    for (size_t i = 0; i < op.bottoms.size(); ++i) {
+      const Value& value = values_[op.bottoms[i]];
+      if (value.concat == op.top) {
+        *out << "  // (" << value.name << " was computed in place)\n";
+      } else {
+        *out << "  CompiledCopy<" << value.shape.count() << ">::Forward(arena + "
+             << Offset(op.bottoms[i]) << ", arena + " << Offset(op.top) + offset << ");\n";
+      }
+      offset += value.shape.count();
+    }
+  }
+}
+
+void Generator::Write(std::ostream* out) const {
+  *out << "// Generated by generate_net from " << deploy_proto_ << ".  Do not edit.\n"
+       << "// Activations: " << arena_size_ * sizeof(float) << " bytes.\n"
+       << "\n"
+       << "#include \"network/compiled_net.h\"\n"
+       << "\n"
+       << "#include <cstdio>\n"
+       << "\n"
+       << "#include \"network/compiled_layers.h\"\n"
+       << "#include \"network/weight_file.h\"\n"
+       << "\n"
+       << "namespace {\n"
+       << "\n"
+       << "// The weights used by the network, in order.\n"
+       << "struct CompiledWeight {\n"
+       << "  const char* layer_name;\n"
+       << "  size_t blob_index;\n"
+       << "  size_t count;\n"
+       << "};\n"
+       << "const CompiledWeight kWeights[] = {\n";
+  for (size_t i = 0; i < weights_.size(); ++i) {
+    *out << "  { \"" << weights_[i].layer_name << "\", " << weights_[i].blob_index << ", "
+         << weights_[i].count << " },\n";
+  }
+  *out << "};\n"
+       << "const size_t kNumWeights = " << weights_.size() << ";\n"
+       << "\n"
+       << "// Size of the buffer of all activations (in floats).\n"
+       << "const size_t kArenaSize = " << arena_size_ << ";\n"
+       << "\n"
+       << "} // namespace\n"
+       << "\n"
+       << "CompiledNet::CompiledNet(ThreadPool* thread_pool) :\n"
+       << "  thread_pool_(thread_pool),\n"
+       << "  weights_(kNumWeights, static_cast<const float*>(NULL)),\n"
+       << "  arena_(kArenaSize)\n"
+       << "{\n"
+       << "}\n"
+       << "\n"
+       << "bool CompiledNet::Init(const WeightFile& weights) {\n"
+       << "  for (size_t i = 0; i < kNumWeights; ++i) {\n"
+       << "    const WeightBlob* blob = weights.FindBlob(kWeights[i].layer_name, kWeights[i].blob_index);\n"
+       << "    if (!blob || blob->count() != kWeights[i].count) {\n"
+       << "      printf(\"Error - missing or invalid weights for layer %s\\n\", kWeights[i].layer_name);\n"
+       << "      return false;\n"
+       << "    }\n"
+       << "    weights_[i] = blob->data;\n"
+       << "  }\n"
+       << "  return true;\n"
+       << "}\n"
+       << "\n"
+       << "const char* CompiledNet::source_proto() {\n"
+       << "  return \"" << deploy_proto_ << "\";\n"
+       << "}\n"
+       << "\n"
+       << "float* CompiledNet::mutable_input(const std::string& name) {\n";
+  for (size_t i = 0; i < inputs_.size(); ++i) {
+    if (stored_[inputs_[i].second]) {
+      *out << "  if (name == \"" << inputs_[i].first << "\") {\n"
+           << "    return &arena_[" << Offset(inputs_[i].second) << "];\n"
+           << "  }\n";
+    }
+  }
+  *out << "  return NULL;\n"
+       << "}\n"
+       << "\n"
+       << "NativeShape CompiledNet::input_shape(const std::string& name) {\n"
+       << "  NativeShape shape;\n";
+  for (size_t i = 0; i < inputs_.size(); ++i) {
+    const NativeShape& shape = values_[inputs_[i].second].shape;
+    *out << "  if (name == \"" << inputs_[i].first << "\") {\n"
+         << "    shape.num = 1;\n"
+         << "    shape.channels = " << shape.channels << ";\n"
+         << "    shape.height = " << shape.height << ";\n"
+         << "    shape.width = " << shape.width << ";\n"
+         << "  }\n";
+  }
+  *out << "  return shape;\n"
+       << "}\n"
+       << "\n"
+       << "void CompiledNet::Forward() {\n"
+       << "  float* arena = &arena_[0];\n";
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    *out << (i > 0 ? "\n" : "");
+    WriteOp(ops_[i], out);
+  }
+  *out << "}\n"
+       << "\n"
+       << "const float* CompiledNet::output() const {\n"
+       << "  return &arena_[" << Offset(output_) << "];\n"
+       << "}\n"
+       << "\n"
+       << "size_t CompiledNet::output_count() {\n"
+       << "  return " << values_[output_].shape.count() << ";\n"
+       << "}\n";
+}
+
+} // namespace
+
+int main (int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " deploy.prototxt output_blob compiled_net.cpp"
+              << std::endl;
+    return 1;
+  }
+
+  const string deploy_proto = argv[1];
+  const string output_name  = argv[2];
+  const string output_file  = argv[3];
+
+  Generator generator;
+  if (!generator.Read(deploy_proto, output_name)) {
+    return 1;
+  }
+  generator.PlanMemory();
+
+  // Write to a string first, so that a failed run does not leave a partial file.
+  std::stringstream code;
+  generator.Write(&code);
+  std::ofstream out(output_file.c_str());
+  out << code.str();
+  out.close();
+  if (!out) {
+    printf("Error - could not write %s\n", output_file.c_str());
+    return 1;
+  }
+  return 0;
+}
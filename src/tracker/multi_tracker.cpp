@@ -0,0 +1,59 @@
+#include "multi_tracker.h"
+
+MultiTracker::MultiTracker()
+{
+}
+
+void MultiTracker::Init(const cv::Mat& image, const std::vector<BoundingBox>& bboxes_gt,
+                        RegressorBase* regressor) {
+  // Initialize a tracker for each target, which predicts in the current frame that the
+  // location of the target will be approximately the same as in the previous frame.
+  const bool show_tracking = false;
+  trackers_.assign(bboxes_gt.size(), Tracker(show_tracking));
+  for (size_t i = 0; i < trackers_.size(); ++i) {
+    trackers_[i].Init(image, bboxes_gt[i], regressor);
+  }
+
+  // Initialize the neural network (which Tracker::Init does when there are targets).
+  if (trackers_.empty()) {
+    regressor->Init();
+  }
+}
+
+void MultiTracker::Track(const cv::Mat& image_curr, RegressorBase* regressor,
+                         std::vector<BoundingBox>* bboxes_estimate_uncentered) {
+  Track(image_curr, 1, regressor, bboxes_estimate_uncentered);
+}
+
+void MultiTracker::Track(const cv::Mat& image_curr, const double image_scale,
+                         RegressorBase* regressor,
+                         std::vector<BoundingBox>* bboxes_estimate_uncentered) {
+  const size_t num_targets = trackers_.size();
+
+  // Get the inputs of each target, in the (resized) current and previous images.
+  // All targets share the same current and previous images.
+  images_curr_.resize(num_targets);
+  bboxes_curr_prior_scaled_.resize(num_targets);
+  images_prev_.resize(num_targets);
+  bboxes_prev_scaled_.resize(num_targets);
+  for (size_t i = 0; i < num_targets; ++i) {
+    const Tracker& tracker = trackers_[i];
+    images_curr_[i] = image_curr;
+    tracker.get_bbox_curr_prior_tight().Rescale(image_scale, &bboxes_curr_prior_scaled_[i]);
+    images_prev_[i] = tracker.get_image_prev();
+    tracker.get_bbox_prev_tight().Rescale(tracker.get_image_prev_scale(), &bboxes_prev_scaled_[i]);
+  }
+
+  // Estimate the bounding box location of every target in a single batch, centered and
+  // scaled relative to the search region of each target.
+  regressor->RegressFromFullImages(images_curr_, bboxes_curr_prior_scaled_,
+                                   images_prev_, bboxes_prev_scaled_, &bboxes_estimate_);
+
+  // Find the location of each target in the full-size image, and save it as the location of
+  // the target and the prior prediction for the next image.
+  bboxes_estimate_uncentered->resize(num_targets);
+  for (size_t i = 0; i < num_targets; ++i) {
+    trackers_[i].Update(image_curr, image_scale, bboxes_estimate_[i],
+                        &(*bboxes_estimate_uncentered)[i]);
+  }
+}
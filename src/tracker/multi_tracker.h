@@ -0,0 +1,54 @@
+#ifndef MULTI_TRACKER_H
+#define MULTI_TRACKER_H
+
+#include <vector>
+
+#include <opencv/cv.h>
+#include <opencv2/core/core.hpp>
+
+#include "helper/bounding_box.h"
+#include "network/regressor_base.h"
+#include "tracker/tracker.h"
+
+// Tracks multiple target objects in the same video.
+// All of the targets are estimated together in a single batched pass of the network,
+// which is much cheaper than tracking each target separately.
+// Each target keeps the state of a Tracker, which maps the estimates to the image as it does
+// when tracking a single target; since the batch is cropped from the full images, the targets
+// are not prepared (see Tracker::PrepareTarget), and the previous image is kept instead.
+class MultiTracker
+{
+public:
+  MultiTracker();
+
+  // Initialize the tracker with the ground-truth bounding boxes of each target in the first frame.
+  void Init(const cv::Mat& image_curr, const std::vector<BoundingBox>& bboxes_gt,
+            RegressorBase* regressor);
+
+  // Estimate the location of each target object in the current image.
+  // bboxes_estimate_uncentered[i] is the estimated location of target i.
+  void Track(const cv::Mat& image_curr, RegressorBase* regressor,
+             std::vector<BoundingBox>* bboxes_estimate_uncentered);
+
+  // Estimate the location of each target object in the current image, which has been resized
+  // by image_scale (e.g. decoded at a reduced scale).  The locations of the targets are still
+  // those in the full-size images.
+  void Track(const cv::Mat& image_curr, const double image_scale, RegressorBase* regressor,
+             std::vector<BoundingBox>* bboxes_estimate_uncentered);
+
+  // Number of target objects being tracked.
+  size_t num_targets() const { return trackers_.size(); }
+
+private:
+  // The state of each target: trackers_[i] tracks target i.
+  std::vector<Tracker> trackers_;
+
+  // Buffers reused across frames to pass the batch to the regressor.
+  std::vector<cv::Mat> images_curr_;
+  std::vector<BoundingBox> bboxes_curr_prior_scaled_;
+  std::vector<cv::Mat> images_prev_;
+  std::vector<BoundingBox> bboxes_prev_scaled_;
+  std::vector<BoundingBox> bboxes_estimate_;
+};
+
+#endif // MULTI_TRACKER_H
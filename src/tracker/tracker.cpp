@@ -4,12 +4,18 @@
 
 #include "helper/helper.h"
 #include "helper/bounding_box.h"
-#include "network/regressor.h"
-#include "network/regressor_train.h"
 #include "helper/high_res_timer.h"
 #include "helper/image_proc.h"
 
+namespace {
+
+// Size that the target and search region are shown at (the size of the network input).
+const cv::Size kShowSize(227, 227);
+
+} // namespace
+
 Tracker::Tracker(const bool show_tracking) :
+  image_prev_scale_(1),
   show_tracking_(show_tracking)
 {
 }
@@ -17,6 +23,7 @@ Tracker::Tracker(const bool show_tracking) :
 void Tracker::Init(const cv::Mat& image, const BoundingBox& bbox_gt,
                    RegressorBase* regressor) {
   image_prev_ = image;
+  image_prev_scale_ = 1;
   bbox_prev_tight_ = bbox_gt;
 
   // Predict in the current frame that the location will be approximately the same
@@ -42,33 +49,121 @@ void Tracker::Init(const std::string& image_curr_path, const VOTRegion& region,
 
 void Tracker::Track(const cv::Mat& image_curr, RegressorBase* regressor,
                     BoundingBox* bbox_estimate_uncentered) {
-  // Get target from previous image.
-  cv::Mat target_pad;
-  CropPadImage(bbox_prev_tight_, image_prev_, &target_pad);
+  Track(image_curr, 1, regressor, bbox_estimate_uncentered);
+}
 
-  // Crop the current image based on predicted prior location of target.
-  cv::Mat curr_search_region;
-  BoundingBox search_location;
-  double edge_spacing_x, edge_spacing_y;
-  CropPadImage(bbox_curr_prior_tight_, image_curr, &curr_search_region, &search_location, &edge_spacing_x, &edge_spacing_y);
+void Tracker::Track(const cv::Mat& image_curr, const double image_scale, RegressorBase* regressor,
+                    BoundingBox* bbox_estimate_uncentered) {
+  // Estimate the location of the target.
+  Estimate(image_curr, image_scale, regressor, bbox_estimate_uncentered);
+
+  // Crop the target for the next image while the current image is still in cache,
+  // and release the current image.
+  PrepareTarget(regressor);
+}
+
+void Tracker::Estimate(const cv::Mat& image_curr, const double image_scale, RegressorBase* regressor,
+                       BoundingBox* bbox_estimate_uncentered) {
+  // Crop the target from the previous image, if that has not been done yet (e.g. after Init).
+  PrepareTarget(regressor);
+
+  // Get the predicted prior location of the target in the (resized) current image.
+  BoundingBox bbox_curr_prior_scaled;
+  bbox_curr_prior_tight_.Rescale(image_scale, &bbox_curr_prior_scaled);
 
   // Estimate the bounding box location of the target, centered and scaled relative to the cropped image.
+  // The regressor crops the search region from the current image.
   BoundingBox bbox_estimate;
-  regressor->Regress(image_curr, curr_search_region, target_pad, &bbox_estimate);
+  regressor->RegressFromTarget(image_curr, bbox_curr_prior_scaled, target_, &bbox_estimate);
 
-  // Unscale the estimation to the real image size.
-  BoundingBox bbox_estimate_unscaled;
-  bbox_estimate.Unscale(curr_search_region, &bbox_estimate_unscaled);
+  if (show_tracking_) {
+    // Crop the current image based on predicted prior location of target, resized for display.
+    cv::Mat curr_search_region;
+    CropPadResize(bbox_curr_prior_scaled, image_curr, kShowSize, &curr_search_region);
+
+    ShowTracking(target_show_, curr_search_region, bbox_estimate);
+  }
+
+  // Update the tracker with the new estimate.
+  Update(image_curr, image_scale, bbox_estimate, bbox_estimate_uncentered);
+}
+
+void Tracker::PrepareTarget(RegressorBase* regressor) {
+  if (!image_prev_.data) {
+    return;
+  }
 
-  // Find the estimated bounding box location relative to the current crop.
-  bbox_estimate_unscaled.Uncenter(image_curr, search_location, edge_spacing_x, edge_spacing_y, bbox_estimate_uncentered);
+  // Get the location of the target in the (resized) previous image.
+  BoundingBox bbox_prev_scaled;
+  bbox_prev_tight_.Rescale(image_prev_scale_, &bbox_prev_scaled);
 
+  // Crop and preprocess the target.
+  regressor->PrepareTarget(image_prev_, bbox_prev_scaled, &target_);
   if (show_tracking_) {
-    ShowTracking(target_pad, curr_search_region, bbox_estimate);
+    CropPadResize(bbox_prev_scaled, image_prev_, kShowSize, &target_show_);
   }
 
-  // Save the image.
+  // Only the prepared target is needed from now on.
+  image_prev_.release();
+}
+
+bool Tracker::GetState(RegressorBase* regressor, TrackerState* state) {
+  // Make sure that the target has been prepared from the previous image.
+  PrepareTarget(regressor);
+  if (target_.input.empty()) {
+    printf("Error - the regressor does not prepare targets as network inputs\n");
+    return false;
+  }
+
+  state->bbox_curr_prior_tight = bbox_curr_prior_tight_;
+  state->bbox_prev_tight = bbox_prev_tight_;
+  state->target_input = target_.input;
+  return true;
+}
+
+void Tracker::SetState(const TrackerState& state) {
+  bbox_curr_prior_tight_ = state.bbox_curr_prior_tight;
+  bbox_prev_tight_ = state.bbox_prev_tight;
+
+  // The target has already been prepared, so there is no previous image to prepare it from.
+  target_.input = state.target_input;
+  target_.image.release();
+  target_show_.release();
+  image_prev_.release();
+  image_prev_scale_ = 1;
+}
+
+void Tracker::Update(const cv::Mat& image_curr, const BoundingBox& bbox_estimate,
+                     BoundingBox* bbox_estimate_uncentered) {
+  Update(image_curr, 1, bbox_estimate, bbox_estimate_uncentered);
+}
+
+void Tracker::Update(const cv::Mat& image_curr, const double image_scale,
+                     const BoundingBox& bbox_estimate, BoundingBox* bbox_estimate_uncentered) {
+  // Get the location and size of the search region in the current image, based on the
+  // predicted prior location of the target.
+  BoundingBox bbox_curr_prior_scaled;
+  bbox_curr_prior_tight_.Rescale(image_scale, &bbox_curr_prior_scaled);
+  BoundingBox search_location;
+  double edge_spacing_x, edge_spacing_y;
+  cv::Rect search_roi;
+  cv::Size search_size;
+  ComputeCropPadImageGeometry(bbox_curr_prior_scaled, image_curr.size(), &search_location,
+                              &edge_spacing_x, &edge_spacing_y, &search_roi, &search_size);
+
+  // Unscale the estimation to the real image size.
+  BoundingBox bbox_estimate_unscaled;
+  bbox_estimate.Unscale(search_size, &bbox_estimate_unscaled);
+
+  // Find the estimated bounding box location relative to the current crop,
+  // and its location in the full-size image.
+  BoundingBox bbox_estimate_resized;
+  bbox_estimate_unscaled.Uncenter(image_curr, search_location, edge_spacing_x, edge_spacing_y, &bbox_estimate_resized);
+  bbox_estimate_resized.Rescale(1 / image_scale, bbox_estimate_uncentered);
+
+  // Save the image, to crop the target for the next image from.
   image_prev_ = image_curr;
+  image_prev_scale_ = image_scale;
 
   // Save the current estimate as the location of the target.
   bbox_prev_tight_ = *bbox_estimate_uncentered;
@@ -79,17 +174,12 @@ void Tracker::Track(const cv::Mat& image_curr, RegressorBase* regressor,
 }
 
 void Tracker::ShowTracking(const cv::Mat& target_pad, const cv::Mat& curr_search_region, const BoundingBox& bbox_estimate) const {
-  // Resize the target.
-  cv::Mat target_resize;
-  cv::resize(target_pad, target_resize, cv::Size(227, 227));
-
   // Show the resized target.
   cv::namedWindow("Target", cv::WINDOW_AUTOSIZE );// Create a window for display.
-  cv::imshow("Target", target_resize );                   // Show our image inside it.
+  cv::imshow("Target", target_pad );                   // Show our image inside it.
 
-  // Resize the image.
-  cv::Mat image_resize;
-  cv::resize(curr_search_region, image_resize, cv::Size(227, 227));
+  // The image has already been resized.
+  const cv::Mat& image_resize = curr_search_region;
 
   // Unscale the estimate to match the rescaled image.
   BoundingBox bbox_estimate_unscaled;
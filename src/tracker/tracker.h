@@ -7,7 +7,8 @@
 
 #include "helper/bounding_box.h"
 #include "train/example_generator.h"
-#include "network/regressor.h"
+#include "network/regressor_base.h"
+#include "tracker/tracker_state.h"
 
 class Tracker
 {
@@ -15,9 +16,28 @@ public:
   Tracker(const bool show_tracking);
 
   // Estimate the location of the target object in the current image.
+  // Before returning, the target for the next image is cropped from the current image
+  // (see PrepareTarget), so that the tracker does not keep the current image.
   virtual void Track(const cv::Mat& image_curr, RegressorBase* regressor,
              BoundingBox* bbox_estimate_uncentered);
 
+  // Estimate the location of the target object in the current image, which has been resized
+  // by image_scale (e.g. decoded at a reduced scale).  The locations of the target are still
+  // those in the full-size images.
+  void Track(const cv::Mat& image_curr, const double image_scale, RegressorBase* regressor,
+             BoundingBox* bbox_estimate_uncentered);
+
+  // Estimate the location of the target object as Track does, but keep the current image
+  // until PrepareTarget is called (e.g. once the region of the image that the target is
+  // cropped from has been decoded).
+  void Estimate(const cv::Mat& image_curr, const double image_scale, RegressorBase* regressor,
+                BoundingBox* bbox_estimate_uncentered);
+
+  // Crop the target from the last image given to Init, Estimate or Update, preprocessed by
+  // the regressor for the next image, and release the image.  Does nothing if the target
+  // has been prepared already (Track and Estimate prepare it if needed).
+  void PrepareTarget(RegressorBase* regressor);
+
   // Initialize the tracker with the ground-truth bounding box of the first frame.
   void Init(const cv::Mat& image_curr, const BoundingBox& bbox_gt,
             RegressorBase* regressor);
@@ -27,8 +47,39 @@ public:
   void Init(const std::string& image_curr_path, const VOTRegion& region,
             RegressorBase* regressor);
 
+  // Update the tracker with the regressor's estimate of the target location, centered and scaled
+  // relative to the search region in image_curr.  Track calls this after regressing; it can also be
+  // called directly when the regressor is run on several trackers at once.
+  // Returns: bbox_estimate_uncentered, the estimated location of the target in image_curr.
+  void Update(const cv::Mat& image_curr, const BoundingBox& bbox_estimate,
+              BoundingBox* bbox_estimate_uncentered);
+  void Update(const cv::Mat& image_curr, const double image_scale,
+              const BoundingBox& bbox_estimate, BoundingBox* bbox_estimate_uncentered);
+
+  // Get the state of the tracker between frames (after Init or Track), preparing the target
+  // with the regressor if needed.  Returns false if the regressor does not prepare targets
+  // as network inputs, which is all that the state holds of the previous frame.
+  // Supported regressors: Regressor (Caffe), NativeRegressor (and QuantizedRegressor) and
+  // CompiledRegressor.  A regressor that keeps the default RegressorBase::PrepareTarget, which
+  // only keeps the padded crop of the target, leaves the target input empty, so this fails.
+  bool GetState(RegressorBase* regressor, TrackerState* state);
+
+  // Restore a state returned by GetState (e.g. in another process, or to resume tracking a
+  // video from the middle), to track the frame after the one it was taken at.
+  // The regressor must have the same network inputs as the one that prepared the target.
+  void SetState(const TrackerState& state);
+
+  // Inputs to the regressor for the next call to Track or Update.
+  // The locations are those in the full-size images; image_prev has been resized by image_prev_scale.
+  // image_prev is empty once the target has been prepared from it.
+  const BoundingBox& get_bbox_curr_prior_tight() const { return bbox_curr_prior_tight_; }
+  const BoundingBox& get_bbox_prev_tight() const { return bbox_prev_tight_; }
+  const cv::Mat& get_image_prev() const { return image_prev_; }
+  double get_image_prev_scale() const { return image_prev_scale_; }
+
 private:
   // Show the tracking output, for debugging.
+  // The target and search region have been cropped and resized to the size of the network input.
   void ShowTracking(const cv::Mat& target_pad, const cv::Mat& curr_search_region, const BoundingBox& bbox_estimate) const;
 
   // Predicted prior location of the target object in the current image.
@@ -39,8 +90,16 @@ private:
   // Estimated previous location of the target object.
   BoundingBox bbox_prev_tight_;
 
-  // Full previous image.
+  // Full previous image, and the factor by which it has been resized, until the target
+  // is prepared from it.
   cv::Mat image_prev_;
+  double image_prev_scale_;
+
+  // The target in the previous image, preprocessed for the regressor.
+  PreparedTarget target_;
+
+  // The target in the previous image, resized to be shown (if show_tracking_).
+  cv::Mat target_show_;
 
   // Whether to visualize the tracking results
   bool show_tracking_;
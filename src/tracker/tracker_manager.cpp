@@ -1,9 +1,15 @@
 #include "tracker_manager.h"
 
+#include <algorithm>
+#include <deque>
 #include <string>
 
+#include <boost/bind.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/thread.hpp>
+
 #include "helper/helper.h"
-#include "train/tracker_trainer.h"
+#include "loader/roi_frame_loader.h"
 
 using std::string;
 
@@ -11,7 +17,10 @@ TrackerManager::TrackerManager(const std::vector<Video>& videos,
                                RegressorBase* regressor, Tracker* tracker) :
   videos_(videos),
   regressor_(regressor),
-  tracker_(tracker)
+  tracker_(tracker),
+  tracking_in_parallel_(false),
+  roi_decode_(false),
+  downscale_decode_(false)
 {
 }
 
@@ -22,50 +31,588 @@ void TrackerManager::TrackAll() {
 void TrackerManager::TrackAll(const size_t start_video_num, const int pause_val) {
   // Iterate over all videos and track the target object in each.
   for (size_t video_num = start_video_num; video_num < videos_.size(); ++video_num) {
-    // Get the video.
-    const Video& video = videos_[video_num];
+    TrackVideo(video_num, tracker_, regressor_, pause_val);
+  }
+  PostProcessAll();
+}
+
+void TrackerManager::TrackVideo(const size_t video_num, Tracker* tracker,
+                                RegressorBase* regressor, const int pause_val) {
+  // Get the video.
+  const Video& video = videos_[video_num];
+
+  // Perform any pre-processing steps on this video.
+  VideoInit(video, video_num);
+
+  // Get the first frame of this video with the initial ground-truth bounding box (to initialize the tracker).
+  int first_frame;
+  cv::Mat image_curr;
+  BoundingBox bbox_gt;
+  video.LoadFirstAnnotation(&first_frame, &image_curr, &bbox_gt);
 
-    // Perform any pre-processing steps on this video.
-    VideoInit(video, video_num);
+  // Initialize the tracker.
+  tracker->Init(image_curr, bbox_gt, regressor);
 
-    // Get the first frame of this video with the initial ground-truth bounding box (to initialize the tracker).
-    int first_frame;
+  // Loads the frames when decoding only the regions that the tracker crops.
+  RoiFrameLoader roi_frame_loader(downscale_decode_);
+
+  // Iterate over the remaining frames of the video.
+  for (size_t frame_num = first_frame + 1; frame_num < video.all_frames.size(); ++frame_num) {
+
+    // Get image for the current frame.
+    // (The ground-truth bounding box is used only for visualization).
+    // (The image may have been resized by image_scale when decoding only the regions that the tracker crops).
     cv::Mat image_curr;
+    double image_scale = 1;
     BoundingBox bbox_gt;
-    video.LoadFirstAnnotation(&first_frame, &image_curr, &bbox_gt);
+    bool has_annotation;
+    if (roi_decode_) {
+      has_annotation = roi_frame_loader.LoadFrame(video, frame_num,
+                                                  tracker->get_bbox_curr_prior_tight(),
+                                                  &image_curr, &image_scale, &bbox_gt);
+    } else {
+      const bool draw_bounding_box = false;
+      const bool load_only_annotation = false;
+      has_annotation = video.LoadFrame(frame_num,
+                                       draw_bounding_box,
+                                       load_only_annotation,
+                                       &image_curr, &bbox_gt);
+    }
+
+    // Get ready to track the object.
+    SetupEstimate();
+
+    // Track and estimate the target's bounding box location in the current image.
+    // Important: this method cannot receive bbox_gt (the ground-truth bounding box) as an input.
+    // (When decoding only the regions that the tracker crops, the target for the next frame
+    // is cropped from this frame only after its region has been decoded, below).
+    BoundingBox bbox_estimate_uncentered;
+    if (roi_decode_) {
+      tracker->Estimate(image_curr, image_scale, regressor, &bbox_estimate_uncentered);
+    } else {
+      tracker->Track(image_curr, image_scale, regressor, &bbox_estimate_uncentered);
+    }
+    FinishEstimate(1);
+
+    // Decode the region of this frame that the target for the next frame is cropped from,
+    // and crop it.
+    if (roi_decode_) {
+      roi_frame_loader.DecodeRegion(tracker->get_bbox_prev_tight());
+      tracker->PrepareTarget(regressor);
+    }
+
+    // Process the output (e.g. visualize / save results).
+    ProcessTrackOutput(video_num, frame_num, image_curr, has_annotation, bbox_gt,
+                         bbox_estimate_uncentered, pause_val);
+  }
+  PostProcessVideo(video_num);
+}
+
+// Hands out videos to the worker threads of TrackAllParallel.
+// Each worker has its own queue of videos, sorted longest first.  A worker whose
+// queue is empty steals the shortest remaining video from the worker with the most
+// videos left, so that no thread sits idle while videos remain.
+class VideoScheduler
+{
+public:
+  VideoScheduler(const std::vector<Video>& videos, const size_t num_workers);
+
+  // Get the next video for worker worker_num to track.
+  // Returns false when there are no videos left.
+  bool NextVideo(const size_t worker_num, size_t* video_num);
+
+private:
+  // Videos waiting to be tracked by each worker.
+  std::vector<std::deque<size_t> > queues_;
+
+  // Protects queues_.  (Workers take a video only once per video, so a single lock is
+  // not a bottleneck.)
+  boost::mutex mutex_;
+};
+
+namespace {
+
+// Sort videos by decreasing number of frames.
+struct LongerVideo {
+  LongerVideo(const std::vector<Video>& videos) : videos_(videos) {}
+  bool operator()(const size_t a, const size_t b) const {
+    return videos_[a].all_frames.size() > videos_[b].all_frames.size();
+  }
+  const std::vector<Video>& videos_;
+};
+
+} // namespace
+
+VideoScheduler::VideoScheduler(const std::vector<Video>& videos, const size_t num_workers) :
+  queues_(num_workers)
+{
+  // Order the videos longest first.
+  std::vector<size_t> video_nums(videos.size());
+  for (size_t i = 0; i < videos.size(); ++i) {
+    video_nums[i] = i;
+  }
+  std::stable_sort(video_nums.begin(), video_nums.end(), LongerVideo(videos));
+
+  // Deal the videos out to the workers, so that each queue is also sorted longest first.
+  for (size_t i = 0; i < video_nums.size(); ++i) {
+    queues_[i % num_workers].push_back(video_nums[i]);
+  }
+}
+
+bool VideoScheduler::NextVideo(const size_t worker_num, size_t* video_num) {
+  boost::mutex::scoped_lock lock(mutex_);
+
+  // Take the longest remaining video from this worker's own queue.
+  std::deque<size_t>& queue = queues_[worker_num];
+  if (!queue.empty()) {
+    *video_num = queue.front();
+    queue.pop_front();
+    return true;
+  }
+
+  // Otherwise steal the shortest video from the worker with the most videos left.
+  size_t victim = worker_num;
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    if (queues_[i].size() > queues_[victim].size()) {
+      victim = i;
+    }
+  }
+  if (queues_[victim].empty()) {
+    return false;
+  }
+  *video_num = queues_[victim].back();
+  queues_[victim].pop_back();
+  return true;
+}
+
+void TrackerManager::TrackAllParallel(const std::vector<RegressorBase*>& regressors,
+                                      const int pause_val) {
+  if (regressors.empty()) {
+    printf("Error - cannot track videos in parallel without any regressors\n");
+    return;
+  }
+
+  tracking_in_parallel_ = true;
+
+  // Start one worker thread per regressor.
+  VideoScheduler scheduler(videos_, regressors.size());
+  boost::thread_group workers;
+  for (size_t worker_num = 0; worker_num < regressors.size(); ++worker_num) {
+    workers.create_thread(boost::bind(&TrackerManager::TrackVideos, this, &scheduler,
+                                      worker_num, regressors[worker_num], pause_val));
+  }
+
+  // Wait for all videos to be tracked.
+  workers.join_all();
+
+  tracking_in_parallel_ = false;
 
-    // Initialize the tracker.
-    tracker_->Init(image_curr, bbox_gt, regressor_);
+  PostProcessAll();
+}
+
+void TrackerManager::TrackVideos(VideoScheduler* scheduler, const size_t worker_num,
+                                 RegressorBase* regressor, const int pause_val) {
+  // Each worker has its own copy of the tracker.
+  Tracker tracker(*tracker_);
+
+  // Track videos until there are none left.
+  size_t video_num;
+  while (scheduler->NextVideo(worker_num, &video_num)) {
+    TrackVideo(video_num, &tracker, regressor, pause_val);
+  }
+}
+
+namespace {
+
+// A video being tracked as part of a batch.
+struct BatchedVideo {
+  BatchedVideo() :
+    video_num(0),
+    frame_num(0),
+    tracker(false),
+    has_annotation(false)
+  {
+  }
+
+  // Index of the video.
+  size_t video_num;
+
+  // Next frame to track.
+  size_t frame_num;
+
+  // Tracking state of the video.
+  Tracker tracker;
+
+  // Current frame and its ground-truth bounding box (if annotated).
+  cv::Mat image_curr;
+  BoundingBox bbox_gt;
+  bool has_annotation;
+};
 
-    // Iterate over the remaining frames of the video.
-    for (size_t frame_num = first_frame + 1; frame_num < video.all_frames.size(); ++frame_num) {
+} // namespace
+
+void TrackerManager::TrackAllBatched(const size_t batch_size, const int pause_val,
+                                     const bool pipelined) {
+  if (batch_size == 0) {
+    printf("Error - cannot track videos with a batch size of 0\n");
+    return;
+  }
+
+  // Videos currently being tracked, and the next video to start tracking.
+  std::vector<BatchedVideo> batch;
+  size_t next_video_num = 0;
+
+  // Inputs and outputs of the regressor for each video in the batch.
+  std::vector<cv::Mat> images_curr;
+  std::vector<BoundingBox> bboxes_curr_prior_tight;
+  std::vector<cv::Mat> images_prev;
+  std::vector<BoundingBox> bboxes_prev_tight;
+  std::vector<BoundingBox> bboxes_estimate;
+
+  // Estimates of each video in the batch that are still being computed (when pipelined).
+  std::vector<boost::shared_future<BoundingBox> > estimates;
+
+  while (true) {
+    // Fill the empty places in the batch with the remaining videos.
+    while (batch.size() < batch_size && next_video_num < videos_.size()) {
+      const size_t video_num = next_video_num++;
+      const Video& video = videos_[video_num];
+
+      // Perform any pre-processing steps on this video.
+      VideoInit(video, video_num);
+
+      // Get the first frame of this video with the initial ground-truth bounding box (to initialize the tracker).
+      int first_frame;
+      cv::Mat image_curr;
+      BoundingBox bbox_gt;
+      video.LoadFirstAnnotation(&first_frame, &image_curr, &bbox_gt);
+
+      // Skip videos with no frames left to track.
+      if (first_frame + 1 >= static_cast<int>(video.all_frames.size())) {
+        PostProcessVideo(video_num);
+        continue;
+      }
+
+      // Initialize the tracker for this video.
+      batch.push_back(BatchedVideo());
+      BatchedVideo& batched_video = batch.back();
+      batched_video.video_num = video_num;
+      batched_video.frame_num = first_frame + 1;
+      batched_video.tracker.Init(image_curr, bbox_gt, regressor_);
+    }
+
+    if (batch.empty()) {
+      break;
+    }
+
+    // Get the current frame of each video, along with the inputs to the regressor.
+    const size_t num_videos = batch.size();
+    images_curr.resize(num_videos);
+    bboxes_curr_prior_tight.resize(num_videos);
+    images_prev.resize(num_videos);
+    bboxes_prev_tight.resize(num_videos);
+    for (size_t i = 0; i < num_videos; ++i) {
+      BatchedVideo& batched_video = batch[i];
 
-      // Get image for the current frame.
       // (The ground-truth bounding box is used only for visualization).
       const bool draw_bounding_box = false;
       const bool load_only_annotation = false;
-      cv::Mat image_curr;
-      BoundingBox bbox_gt;
-      bool has_annotation = video.LoadFrame(frame_num,
-                                            draw_bounding_box,
-                                            load_only_annotation,
-                                            &image_curr, &bbox_gt);
+      batched_video.has_annotation = videos_[batched_video.video_num].LoadFrame(
+            batched_video.frame_num, draw_bounding_box, load_only_annotation,
+            &batched_video.image_curr, &batched_video.bbox_gt);
+
+      images_curr[i] = batched_video.image_curr;
+      bboxes_curr_prior_tight[i] = batched_video.tracker.get_bbox_curr_prior_tight();
+      images_prev[i] = batched_video.tracker.get_image_prev();
+      bboxes_prev_tight[i] = batched_video.tracker.get_bbox_prev_tight();
+    }
+
+    // Get ready to track the objects.
+    SetupEstimate();
+
+    // Estimate the target's bounding box location in the current frame of every video at once.
+    // Important: the ground-truth bounding boxes cannot be used as an input.
+    if (pipelined) {
+      // Queue every frame before waiting for any of the estimates.
+      estimates.resize(num_videos);
+      for (size_t i = 0; i < num_videos; ++i) {
+        estimates[i] = regressor_->RegressAsync(images_curr[i], bboxes_curr_prior_tight[i],
+                                                images_prev[i], bboxes_prev_tight[i]);
+      }
+      bboxes_estimate.resize(num_videos);
+      for (size_t i = 0; i < num_videos; ++i) {
+        bboxes_estimate[i] = estimates[i].get();
+      }
+    } else {
+      regressor_->RegressFromFullImages(images_curr, bboxes_curr_prior_tight,
+                                        images_prev, bboxes_prev_tight, &bboxes_estimate);
+    }
+    for (size_t i = 0; i < num_videos; ++i) {
+      BatchedVideo& batched_video = batch[i];
+      BoundingBox bbox_estimate_uncentered;
+      batched_video.tracker.Update(batched_video.image_curr, bboxes_estimate[i],
+                                   &bbox_estimate_uncentered);
+      bboxes_estimate[i] = bbox_estimate_uncentered;
+    }
+    FinishEstimate(num_videos);
+
+    // Process the output of each video (e.g. visualize / save results) and move on to the next frame.
+    for (size_t i = 0; i < num_videos; ++i) {
+      BatchedVideo& batched_video = batch[i];
+      ProcessTrackOutput(batched_video.video_num, batched_video.frame_num, batched_video.image_curr,
+                         batched_video.has_annotation, batched_video.bbox_gt, bboxes_estimate[i],
+                         pause_val);
+      batched_video.frame_num++;
+    }
+
+    // Remove the videos that have finished.
+    size_t num_remaining = 0;
+    for (size_t i = 0; i < num_videos; ++i) {
+      if (batch[i].frame_num < videos_[batch[i].video_num].all_frames.size()) {
+        if (num_remaining != i) {
+          batch[num_remaining] = batch[i];
+        }
+        num_remaining++;
+      } else {
+        PostProcessVideo(batch[i].video_num);
+      }
+    }
+    batch.resize(num_remaining);
+  }
+  PostProcessAll();
+}
+
+namespace {
+
+// Number of frames that each queue between the stages of TrackAllPipelined can hold.
+const size_t kPipelineQueueSize = 8;
+
+// Number of times that a stage of TrackAllPipelined yields while waiting for its queue,
+// before it starts sleeping instead.
+const int kPipelineSpins = 100;
+
+// A frame passed between the stages of TrackAllPipelined.
+struct PipelinedFrame {
+  PipelinedFrame() :
+    video_num(0),
+    frame_num(0),
+    has_annotation(false),
+    first_frame(false),
+    last_frame(false)
+  {
+  }
+
+  // Index of the video and of the frame within the video.
+  size_t video_num;
+  size_t frame_num;
+
+  // The image of the frame and its ground-truth bounding box (if annotated).
+  cv::Mat image;
+  BoundingBox bbox_gt;
+  bool has_annotation;
+
+  // Whether this is the first frame of the video (which initializes the tracker),
+  // and whether it is the last.
+  bool first_frame;
+  bool last_frame;
+
+  // Estimated location of the target (set by the tracking stage).
+  BoundingBox bbox_estimate;
+};
 
+// A bounded single-producer, single-consumer queue between two stages of TrackAllPipelined.
+// Push waits while the queue is full, and Pop waits while it is empty.
+class StageQueue
+{
+public:
+  StageQueue() : queue_(kPipelineQueueSize) {}
+
+  void Push(const PipelinedFrame& frame) {
+    for (int spins = 0; !queue_.push(frame); ++spins) {
+      Wait(spins);
+    }
+  }
+
+  void Pop(PipelinedFrame* frame) {
+    for (int spins = 0; !queue_.pop(*frame); ++spins) {
+      Wait(spins);
+    }
+  }
+
+private:
+  // Yield to the other stages at first, then sleep so that a stage that is waiting for
+  // a long time does not take CPU time from the others.
+  static void Wait(const int spins) {
+    if (spins < kPipelineSpins) {
+      boost::this_thread::yield();
+    } else {
+      boost::this_thread::sleep(boost::posix_time::microseconds(100));
+    }
+  }
+
+  boost::lockfree::spsc_queue<PipelinedFrame> queue_;
+};
+
+} // namespace
+
+// The frames to track with TrackAllPipelined, and the queues between its stages.
+// The frames of all videos are numbered in the order in which they are tracked.
+// Decoder i loads frames i, i + num_decoders, ... into its own queue, so the tracking stage
+// gets the frames in order by taking them from each decoder's queue in turn.
+class FramePipeline
+{
+public:
+  FramePipeline(const std::vector<Video>& videos, const size_t num_decoders);
+
+  // Number of frames to track, over all videos.
+  size_t num_frames() const { return frames_.size(); }
+
+  // Decode stage: load the frames of decoder decoder_num.
+  void Decode(const size_t decoder_num);
+
+  // Get frame frame_index (in order) from the decode stage.
+  void PopDecoded(const size_t frame_index, PipelinedFrame* frame);
+
+  // Queue of tracked frames, from the tracking stage to the output stage.
+  StageQueue* tracked() { return &tracked_; }
+
+private:
+  const std::vector<Video>& videos_;
+
+  // The frames to track, without their images.
+  std::vector<PipelinedFrame> frames_;
+
+  // Frames loaded by each decoder.
+  std::vector<boost::shared_ptr<StageQueue> > decoded_;
+
+  StageQueue tracked_;
+};
+
+FramePipeline::FramePipeline(const std::vector<Video>& videos, const size_t num_decoders) :
+  videos_(videos),
+  decoded_(num_decoders)
+{
+  for (size_t i = 0; i < num_decoders; ++i) {
+    decoded_[i].reset(new StageQueue);
+  }
+
+  // Track every video from its first annotated frame (which initializes the tracker)
+  // to its last frame.
+  for (size_t video_num = 0; video_num < videos.size(); ++video_num) {
+    const Video& video = videos[video_num];
+    if (video.annotations.empty()) {
+      printf("Error - no annotations for video at path: %s\n", video.path.c_str());
+      continue;
+    }
+    const size_t first_frame = video.annotations[0].frame_num;
+    for (size_t frame_num = first_frame;
+         frame_num == first_frame || frame_num < video.all_frames.size(); ++frame_num) {
+      PipelinedFrame frame;
+      frame.video_num = video_num;
+      frame.frame_num = frame_num;
+      frame.first_frame = frame_num == first_frame;
+      frame.last_frame = frame_num + 1 >= video.all_frames.size();
+      frames_.push_back(frame);
+    }
+  }
+}
+
+void FramePipeline::Decode(const size_t decoder_num) {
+  StageQueue* decoded = decoded_[decoder_num].get();
+  for (size_t i = decoder_num; i < frames_.size(); i += decoded_.size()) {
+    PipelinedFrame frame = frames_[i];
+    const Video& video = videos_[frame.video_num];
+    if (frame.first_frame) {
+      // Load the first annotated frame, with the ground-truth bounding box that initializes the tracker.
+      int first_frame;
+      video.LoadFirstAnnotation(&first_frame, &frame.image, &frame.bbox_gt);
+      frame.has_annotation = true;
+    } else {
+      // (The ground-truth bounding box is used only for visualization).
+      const bool draw_bounding_box = false;
+      const bool load_only_annotation = false;
+      frame.has_annotation = video.LoadFrame(frame.frame_num, draw_bounding_box,
+                                             load_only_annotation, &frame.image, &frame.bbox_gt);
+    }
+    decoded->Push(frame);
+  }
+}
+
+void FramePipeline::PopDecoded(const size_t frame_index, PipelinedFrame* frame) {
+  decoded_[frame_index % decoded_.size()]->Pop(frame);
+}
+
+void TrackerManager::TrackAllPipelined(const size_t num_decode_threads, const int pause_val) {
+  if (num_decode_threads == 0) {
+    printf("Error - cannot track videos without any threads to load the frames\n");
+    return;
+  }
+
+  // The hooks are called from several threads (so the timing uses the wall-clock time).
+  tracking_in_parallel_ = true;
+
+  // Start the decode stage and the output stage.
+  FramePipeline pipeline(videos_, num_decode_threads);
+  boost::thread_group stages;
+  for (size_t i = 0; i < num_decode_threads; ++i) {
+    stages.create_thread(boost::bind(&FramePipeline::Decode, &pipeline, i));
+  }
+  stages.create_thread(boost::bind(&TrackerManager::ProcessTrackedFrames, this, &pipeline,
+                                   pause_val));
+
+  // Track the frames in order, recording how long tracking waits for the decode stage.
+  HighResTimer hrt_wait("Waiting for decoded frames", CLOCK_MONOTONIC);
+  PipelinedFrame frame;
+  for (size_t i = 0; i < pipeline.num_frames(); ++i) {
+    hrt_wait.start();
+    pipeline.PopDecoded(i, &frame);
+    hrt_wait.stop();
+
+    if (frame.first_frame) {
+      // Initialize the tracker.
+      tracker_->Init(frame.image, frame.bbox_gt, regressor_);
+    } else {
       // Get ready to track the object.
       SetupEstimate();
 
       // Track and estimate the target's bounding box location in the current image.
       // Important: this method cannot receive bbox_gt (the ground-truth bounding box) as an input.
-      BoundingBox bbox_estimate_uncentered;
-      tracker_->Track(image_curr, regressor_, &bbox_estimate_uncentered);
+      tracker_->Track(frame.image, regressor_, &frame.bbox_estimate);
+      FinishEstimate(1);
+    }
+
+    // Hand the frame to the output stage.
+    pipeline.tracked()->Push(frame);
+  }
 
+  // Wait for the output of the last frame to be processed.
+  stages.join_all();
+  hrt_wait.print();
+
+  tracking_in_parallel_ = false;
+
+  PostProcessAll();
+}
+
+void TrackerManager::ProcessTrackedFrames(FramePipeline* pipeline, const int pause_val) {
+  PipelinedFrame frame;
+  for (size_t i = 0; i < pipeline->num_frames(); ++i) {
+    pipeline->tracked()->Pop(&frame);
+    const Video& video = videos_[frame.video_num];
+
+    // Perform any pre-processing steps on each video, before processing its output.
+    if (frame.first_frame) {
+      VideoInit(video, frame.video_num);
+    } else {
       // Process the output (e.g. visualize / save results).
-      ProcessTrackOutput(frame_num, image_curr, has_annotation, bbox_gt,
-                           bbox_estimate_uncentered, pause_val);
+      ProcessTrackOutput(frame.video_num, frame.frame_num, frame.image, frame.has_annotation,
+                         frame.bbox_gt, frame.bbox_estimate, pause_val);
+    }
+
+    if (frame.last_frame) {
+      PostProcessVideo(frame.video_num);
     }
-    PostProcessVideo();
   }
-  PostProcessAll();
 }
 
 TrackerVisualizer::TrackerVisualizer(const std::vector<Video>& videos,
@@ -76,7 +623,7 @@ TrackerVisualizer::TrackerVisualizer(const std::vector<Video>& videos,
 
 
 void TrackerVisualizer::ProcessTrackOutput(
-    const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
+    const size_t video_num, const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
     const BoundingBox& bbox_gt, const BoundingBox& bbox_estimate_uncentered,
     const int pause_val) {
   cv::Mat full_output;
@@ -108,7 +655,6 @@ TrackerTesterAlov::TrackerTesterAlov(const std::vector<Video>& videos,
                                      const std::string& output_folder) :
   TrackerManager(videos, regressor, tracker),
   output_folder_(output_folder),
-  hrt_("Tracker"),
   total_ms_(0),
   num_frames_(0),
   save_videos_(save_videos)
@@ -123,7 +669,11 @@ void TrackerTesterAlov::VideoInit(const Video& video, const size_t video_num) {
 
   // Open a file for saving the tracking output.
   const string& output_file = output_folder_ + "/" + video_name;
-  output_file_ptr_ = fopen(output_file.c_str(), "w");
+  FILE* output_file_ptr = fopen(output_file.c_str(), "w");
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    output_file_ptrs_[video_num] = output_file_ptr;
+  }
 
   if (save_videos_) {
     // Make a folder to save the tracking videos.
@@ -137,37 +687,61 @@ void TrackerTesterAlov::VideoInit(const Video& video, const size_t video_num) {
 
     // Open a video_writer object to save the tracking videos.
     const string video_out_name = video_out_folder + "/Video" + num2str(static_cast<int>(video_num)) + ".avi";
-    video_writer_.open(video_out_name, CV_FOURCC('M','J','P','G'), 50, image.size());
+    cv::VideoWriter* video_writer;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      video_writer = &video_writers_[video_num];
+    }
+    video_writer->open(video_out_name, CV_FOURCC('M','J','P','G'), 50, image.size());
   }
 }
 
 void TrackerTesterAlov::SetupEstimate() {
+  // Each thread has its own timer.  When tracking on several threads, the process
+  // CPU time includes the time used by the other threads, so measure the wall-clock time instead.
+  if (!hrt_.get()) {
+    hrt_.reset(new HighResTimer("Tracker", tracking_in_parallel_ ? CLOCK_MONOTONIC :
+                                                                  CLOCK_PROCESS_CPUTIME_ID));
+  }
+
   // Record the time before starting to track.
-  hrt_.reset();
-  hrt_.start();
+  hrt_->reset();
+  hrt_->start();
 }
 
-void TrackerTesterAlov::ProcessTrackOutput(
-    const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
-    const BoundingBox& bbox_gt, const BoundingBox& bbox_estimate,
-    const int pause_val) {
-  // Stop the timer and print the time needed for tracking.
-  hrt_.stop();
-  const double ms = hrt_.getMilliseconds();
+void TrackerTesterAlov::FinishEstimate(const size_t num_frames) {
+  // Stop the timer and record the time needed for tracking.
+  hrt_->stop();
+  const double ms = hrt_->getMilliseconds();
 
   // Update the total time needed for tracking.  (Other time is used to save the tracking
   // output to a video and to write tracking data to a file for evaluation purposes).
+  boost::mutex::scoped_lock lock(mutex_);
   total_ms_ += ms;
-  num_frames_++;
+  num_frames_ += num_frames;
+}
 
+void TrackerTesterAlov::ProcessTrackOutput(
+    const size_t video_num, const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
+    const BoundingBox& bbox_gt, const BoundingBox& bbox_estimate,
+    const int pause_val) {
   // Get the tracking output.
   const double width = fabs(bbox_estimate.get_width());
   const double height = fabs(bbox_estimate.get_height());
   const double x_min = std::min(bbox_estimate.x1_, bbox_estimate.x2_);
   const double y_min = std::min(bbox_estimate.y1_, bbox_estimate.y2_);
 
+  // Get the files for saving the output of this video.
+  FILE* output_file_ptr;
+  cv::VideoWriter* video_writer;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    output_file_ptr = output_file_ptrs_[video_num];
+    video_writer = &video_writers_[video_num];
+  }
+
   // Save the trackign output to a file inthe appropriate format for the ALOV dataset.
-  fprintf(output_file_ptr_, "%zu %lf %lf %lf %lf\n", frame_num + 1, x_min, y_min, width,
+  fprintf(output_file_ptr, "%zu %lf %lf %lf %lf\n", frame_num + 1, x_min, y_min, width,
           height);
 
   if (save_videos_) {
@@ -183,13 +757,19 @@ void TrackerTesterAlov::ProcessTrackOutput(
     bbox_estimate.Draw(255, 0, 0, &full_output);
 
     // Save the image to a tracking video.
-    video_writer_.write(full_output);
+    video_writer->write(full_output);
   }
 }
 
-void TrackerTesterAlov::PostProcessVideo() {
+void TrackerTesterAlov::PostProcessVideo(const size_t video_num) {
+  boost::mutex::scoped_lock lock(mutex_);
+
   // Close the file that saves the tracking data.
-  fclose(output_file_ptr_);
+  fclose(output_file_ptrs_[video_num]);
+  output_file_ptrs_.erase(video_num);
+
+  // Finish the tracking video.
+  video_writers_.erase(video_num);
 }
 
 void TrackerTesterAlov::PostProcessAll() {
@@ -199,3 +779,48 @@ void TrackerTesterAlov::PostProcessAll() {
   const double mean_time_ms = total_ms_ / num_frames_;
   printf("Mean time: %lf ms\n", mean_time_ms);
 }
+
+TrackerRecorder::TrackerRecorder(const std::vector<Video>& videos,
+                                 RegressorBase* regressor, Tracker* tracker) :
+  TrackerManager(videos, regressor, tracker),
+  hrt_("Tracking", CLOCK_MONOTONIC),
+  num_frames_(0)
+{
+}
+
+void TrackerRecorder::SetupEstimate() {
+  hrt_.start();
+}
+
+void TrackerRecorder::FinishEstimate(const size_t num_frames) {
+  hrt_.stop();
+  num_frames_ += num_frames;
+}
+
+void TrackerRecorder::ProcessTrackOutput(
+    const size_t video_num, const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
+    const BoundingBox& bbox_gt, const BoundingBox& bbox_estimate,
+    const int pause_val) {
+  if (has_annotation) {
+    estimates_[video_num].push_back(bbox_estimate);
+    ground_truth_[video_num].push_back(bbox_gt);
+  }
+}
+
+double TrackerRecorder::ComputeMeanIoU() const {
+  double total_iou = 0;
+  size_t num_frames = 0;
+  for (std::map<size_t, std::vector<BoundingBox> >::const_iterator it = estimates_.begin();
+       it != estimates_.end(); ++it) {
+    const std::vector<BoundingBox>& ground_truth = ground_truth_.find(it->first)->second;
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      total_iou += it->second[i].compute_iou(ground_truth[i]);
+    }
+    num_frames += it->second.size();
+  }
+  return num_frames > 0 ? total_iou / num_frames : 0;
+}
+
+double TrackerRecorder::ms_per_frame() const {
+  return num_frames_ > 0 ? hrt_.getMilliseconds() / num_frames_ : 0;
+}
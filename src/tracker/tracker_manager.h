@@ -1,11 +1,19 @@
 #ifndef TRACKER_MANAGER_H
 #define TRACKER_MANAGER_H
 
-#include "network/regressor.h"
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "network/regressor_base.h"
 #include "tracker/tracker.h"
 #include "loader/video.h"
 #include "helper/high_res_timer.h"
 
+class FramePipeline;
+class VideoScheduler;
+
 // Manage the iteration over all videos and tracking the objects inside.
 class TrackerManager
 {
@@ -21,25 +29,69 @@ public:
   // pause_val is normally ignored.
   void TrackAll(const size_t start_video_num, const int pause_val);
 
+  // Iterate over all videos and track the target object in each, advancing batch_size
+  // videos in lockstep (one frame of each per step) with a single batched regressor call per step.
+  // When a video ends, the next remaining video takes its place in the batch.
+  // The tracking output of each video is the same as with TrackAll, but the subclass
+  // hooks for different videos are interleaved.
+  // If pipelined, the frames of the batch are given to the regressor one at a time with
+  // RegressAsync instead, so that the regressor can prepare the inputs of one video while
+  // running the network on the previous one.
+  void TrackAllBatched(const size_t batch_size, const int pause_val,
+                       const bool pipelined = false);
+
+  // Iterate over all videos and track the target object in each, using one worker thread
+  // per regressor (each worker has its own regressor and its own copy of the tracker).
+  // Videos are handed out longest first, and idle workers steal videos from busy ones.
+  // The subclass hooks are called from the worker threads, so they must be thread-safe.
+  void TrackAllParallel(const std::vector<RegressorBase*>& regressors, const int pause_val);
+
+  // Iterate over all videos and track the target object in each, as a pipeline of stages
+  // connected by bounded lock-free queues: num_decode_threads threads load the frames ahead of
+  // the tracker, the calling thread tracks the frames in order (cropping the inputs and running
+  // the network), and another thread processes the tracking output (e.g. writes files and videos).
+  // The tracking output is the same as with TrackAll.  VideoInit, ProcessTrackOutput and
+  // PostProcessVideo are called from the output thread, while the calling thread calls
+  // SetupEstimate and FinishEstimate, which therefore time only the tracking.
+  void TrackAllPipelined(const size_t num_decode_threads, const int pause_val);
+
+  // If roi_decode, TrackAll and TrackAllParallel decode only the regions of each frame that the
+  // tracker crops (see loader/roi_frame_loader.h).  The images passed to ProcessTrackOutput are
+  // then not those of the frame outside of those regions, so this is only for measuring the tracker.
+  // If also downscale, frames with large targets are decoded at a reduced scale, and the images
+  // passed to ProcessTrackOutput are smaller than the frames (the bounding boxes are not).
+  void set_roi_decode(const bool roi_decode, const bool downscale) {
+    roi_decode_ = roi_decode;
+    downscale_decode_ = downscale;
+  }
+
   // Functions for subclasses that get called at appropriate times.
   virtual void VideoInit(const Video& video, const size_t video_num) {}
 
   // Called immediately before estimating the current location of the target object.
   virtual void SetupEstimate() {}
 
-  // Called immediately after estimating the current location of the target object.
+  // Called immediately after estimating the current location of the target object
+  // in num_frames frames (more than 1 when tracking videos in a batch).
+  virtual void FinishEstimate(const size_t num_frames) {}
+
+  // Called after estimating the current location of the target object in video video_num.
   virtual void ProcessTrackOutput(
-      const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
+      const size_t video_num, const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
       const BoundingBox& bbox_gt, const BoundingBox& bbox_estimate_uncentered,
       const int pause_val) {}
 
-  // Called after finishing tracking a video. (Used by subclasses)
-  virtual void PostProcessVideo() {}
+  // Called after finishing tracking video video_num. (Used by subclasses)
+  virtual void PostProcessVideo(const size_t video_num) {}
 
   // Called after finishing tracking all videos. (Used by subclasses)
   virtual void PostProcessAll() {}
 
 protected:
+  // Track the target object in video video_num, using the given tracker and regressor.
+  void TrackVideo(const size_t video_num, Tracker* tracker, RegressorBase* regressor,
+                  const int pause_val);
+
   // Videos to track.
   const std::vector<Video>& videos_;
 
@@ -48,6 +100,21 @@ protected:
 
   // Tracker.
   Tracker* tracker_;
+
+  // Whether videos are currently being tracked on several threads.
+  bool tracking_in_parallel_;
+
+  // Whether to decode only the regions of the frames that the tracker crops.
+  bool roi_decode_;
+  bool downscale_decode_;
+
+private:
+  // Worker thread for TrackAllParallel: track videos from the scheduler until none are left.
+  void TrackVideos(VideoScheduler* scheduler, const size_t worker_num,
+                   RegressorBase* regressor, const int pause_val);
+
+  // Output stage of TrackAllPipelined: process the tracked frames in order.
+  void ProcessTrackedFrames(FramePipeline* pipeline, const int pause_val);
 };
 
 // Track objects and visualize the tracker output.
@@ -62,7 +129,7 @@ public:
 
   // Show the tracking estimate and the ground-truth target location.
   virtual void ProcessTrackOutput(
-      const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
+      const size_t video_num, const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
       const BoundingBox& bbox_gt, const BoundingBox& bbox_estimate,
       const int pause_val);
 };
@@ -82,14 +149,17 @@ public:
   // Record the time before starting to track.
   virtual void SetupEstimate();
 
-  // Record timing info and save the tracking output.
+  // Record timing info.
+  virtual void FinishEstimate(const size_t num_frames);
+
+  // Save the tracking output.
   virtual void ProcessTrackOutput(
-      const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
+      const size_t video_num, const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
       const BoundingBox& bbox_gt, const BoundingBox& bbox_estimate,
       const int pause_val);
 
   // Close the file that saves the tracking data.
-  virtual void PostProcessVideo();
+  virtual void PostProcessVideo(const size_t video_num);
 
   virtual void PostProcessAll();
 
@@ -97,11 +167,14 @@ private:
   // Folder to save all tracking output.
   std::string output_folder_;
 
-  // File for saving tracking output coordinates (for evaluation).
-  FILE* output_file_ptr_;
+  // Files for saving tracking output coordinates (for evaluation), for each video being tracked.
+  std::map<size_t, FILE*> output_file_ptrs_;
 
-  // Timer.
-  HighResTimer hrt_;
+  // Timer for each thread.
+  boost::thread_specific_ptr<HighResTimer> hrt_;
+
+  // Protects the output files, video writers and timing totals, which are shared by all threads.
+  boost::mutex mutex_;
 
   // Total time used for tracking (Other time is used to save the tracking
   // output to a video and to write tracking data to a file for evaluation purposes).
@@ -110,12 +183,50 @@ private:
   // Number of frames tracked.
   int num_frames_;
 
-  // Used to save tracking visualization data.
-  cv::VideoWriter video_writer_;
+  // Used to save tracking visualization data, for each video being tracked.
+  std::map<size_t, cv::VideoWriter> video_writers_;
 
   // Whether to save tracking videos.  Videos take up a lot of space, so use this only when needed.
   bool save_videos_;
 };
 
+// Record the estimated location of the target in each annotated frame, to compare trackers.
+// (Not thread-safe, so not for use with TrackAllParallel.)
+class TrackerRecorder : public TrackerManager
+{
+public:
+  TrackerRecorder(const std::vector<Video>& videos,
+                  RegressorBase* regressor, Tracker* tracker);
+
+  // Record the time before starting to track.
+  virtual void SetupEstimate();
+
+  // Record the tracking time.
+  virtual void FinishEstimate(const size_t num_frames);
+
+  // Record the estimate and the ground truth, if this frame is annotated.
+  virtual void ProcessTrackOutput(
+      const size_t video_num, const size_t frame_num, const cv::Mat& image_curr, const bool has_annotation,
+      const BoundingBox& bbox_gt, const BoundingBox& bbox_estimate,
+      const int pause_val);
+
+  // Estimated and ground-truth locations of the target in the annotated frames of each video.
+  const std::map<size_t, std::vector<BoundingBox> >& estimates() const { return estimates_; }
+  const std::map<size_t, std::vector<BoundingBox> >& ground_truth() const { return ground_truth_; }
+
+  // Mean IoU of the estimates with the ground truth, over all annotated frames.
+  double ComputeMeanIoU() const;
+
+  // Mean time to track a frame, in milliseconds.
+  double ms_per_frame() const;
+
+private:
+  std::map<size_t, std::vector<BoundingBox> > estimates_;
+  std::map<size_t, std::vector<BoundingBox> > ground_truth_;
+
+  // Time spent tracking, and the number of frames tracked.
+  HighResTimer hrt_;
+  size_t num_frames_;
+};
 
 #endif // TRACKER_MANAGER_H
@@ -0,0 +1,135 @@
+#include "tracker_state.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <stdint.h>
+
+namespace {
+
+const char kTrackerStateMagic[8] = "GOTURNS";
+const uint32_t kTrackerStateVersion = 1;
+
+// Append size bytes at value to data.
+void Append(const void* value, const size_t size, std::vector<char>* data) {
+  const char* bytes = static_cast<const char*>(value);
+  data->insert(data->end(), bytes, bytes + size);
+}
+
+void AppendBoundingBox(const BoundingBox& bbox, std::vector<char>* data) {
+  const double coordinates[4] = { bbox.x1_, bbox.y1_, bbox.x2_, bbox.y2_ };
+  Append(coordinates, sizeof(coordinates), data);
+}
+
+// Reads values from serialized data, checking that they are within the data.
+class StateReader {
+public:
+  StateReader(const char* data, const size_t size) :
+    data_(data), size_(size), offset_(0), ok_(true) {}
+
+  void Read(void* value, const size_t length) {
+    ok_ = ok_ && length <= size_ - offset_;
+    if (ok_) {
+      memcpy(value, data_ + offset_, length);
+      offset_ += length;
+    }
+  }
+
+  void ReadBoundingBox(BoundingBox* bbox) {
+    double coordinates[4] = { 0, 0, 0, 0 };
+    Read(coordinates, sizeof(coordinates));
+    bbox->x1_ = coordinates[0];
+    bbox->y1_ = coordinates[1];
+    bbox->x2_ = coordinates[2];
+    bbox->y2_ = coordinates[3];
+  }
+
+  // Number of bytes left to read.
+  size_t remaining() const { return size_ - offset_; }
+
+  bool ok() const { return ok_; }
+
+private:
+  const char* data_;
+  size_t size_;
+  size_t offset_;
+  bool ok_;
+};
+
+} // namespace
+
+void SerializeTrackerState(const TrackerState& state, std::vector<char>* data) {
+  data->clear();
+  Append(kTrackerStateMagic, sizeof(kTrackerStateMagic), data);
+  Append(&kTrackerStateVersion, sizeof(kTrackerStateVersion), data);
+  AppendBoundingBox(state.bbox_curr_prior_tight, data);
+  AppendBoundingBox(state.bbox_prev_tight, data);
+  const uint32_t num_target_values = state.target_input.size();
+  Append(&num_target_values, sizeof(num_target_values), data);
+  if (num_target_values > 0) {
+    Append(&state.target_input[0], num_target_values * sizeof(float), data);
+  }
+}
+
+bool DeserializeTrackerState(const char* data, const size_t size, TrackerState* state) {
+  StateReader reader(data, size);
+
+  // Check the magic and the version.
+  char magic[sizeof(kTrackerStateMagic)];
+  uint32_t version = 0;
+  reader.Read(magic, sizeof(magic));
+  reader.Read(&version, sizeof(version));
+  if (!reader.ok() || memcmp(magic, kTrackerStateMagic, sizeof(magic)) != 0) {
+    printf("Error - not a tracker state\n");
+    return false;
+  }
+  if (version != kTrackerStateVersion) {
+    printf("Error - tracker state has version %u, expected %u\n", version, kTrackerStateVersion);
+    return false;
+  }
+
+  // Read the locations of the target and the prepared target.
+  reader.ReadBoundingBox(&state->bbox_curr_prior_tight);
+  reader.ReadBoundingBox(&state->bbox_prev_tight);
+  uint32_t num_target_values = 0;
+  reader.Read(&num_target_values, sizeof(num_target_values));
+  if (!reader.ok() || reader.remaining() != num_target_values * sizeof(float)) {
+    printf("Error - tracker state is truncated or has the wrong size\n");
+    return false;
+  }
+  state->target_input.resize(num_target_values);
+  if (num_target_values > 0) {
+    reader.Read(&state->target_input[0], num_target_values * sizeof(float));
+  }
+  return reader.ok();
+}
+
+bool WriteTrackerState(const TrackerState& state, const std::string& path) {
+  std::vector<char> data;
+  SerializeTrackerState(state, &data);
+
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    printf("Error - could not open %s for writing\n", path.c_str());
+    return false;
+  }
+  const bool written = fwrite(&data[0], 1, data.size(), file) == data.size();
+  return fclose(file) == 0 && written;
+}
+
+bool ReadTrackerState(const std::string& path, TrackerState* state) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file) {
+    printf("Error - could not open tracker state %s\n", path.c_str());
+    return false;
+  }
+  const std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+  if (data.empty()) {
+    printf("Error - tracker state %s is empty\n", path.c_str());
+    return false;
+  }
+  return DeserializeTrackerState(&data[0], data.size(), state);
+}
@@ -0,0 +1,44 @@
+#ifndef TRACKER_STATE_H
+#define TRACKER_STATE_H
+
+#include <string>
+#include <vector>
+
+#include "helper/bounding_box.h"
+
+// The state of a Tracker between two frames: everything it needs to track the next frame.
+// Instead of the previous frame, it holds the target cropped from it, already preprocessed
+// into the network input, so it is small (a few hundred KB), and it can be saved and
+// restored (see Tracker::GetState and Tracker::SetState) to move a track to another process
+// or to resume tracking a video from the middle.
+//
+// Binary layout (all values in native byte order):
+//   char magic[8]       "GOTURNS"
+//   uint32 version
+//   float64 bbox_curr_prior_tight[4], bbox_prev_tight[4]   (x1, y1, x2, y2)
+//   uint32 num_target_values, float target_input[num_target_values]
+struct TrackerState {
+  // Predicted prior location of the target object in the next frame.
+  BoundingBox bbox_curr_prior_tight;
+
+  // Estimated location of the target object in the previous frame.
+  BoundingBox bbox_prev_tight;
+
+  // The target in the previous frame, preprocessed by the regressor into the input of the
+  // network (see RegressorBase::PrepareTarget).
+  std::vector<float> target_input;
+};
+
+// Encode state in the binary layout above, into data.
+void SerializeTrackerState(const TrackerState& state, std::vector<char>* data);
+
+// Decode a state encoded by SerializeTrackerState from size bytes at data.
+// Returns false if the data is not a valid state of this version.
+bool DeserializeTrackerState(const char* data, const size_t size, TrackerState* state);
+
+// Write state to a file at path, or read it back.
+// Returns false if the file could not be written or read, or is not valid.
+bool WriteTrackerState(const TrackerState& state, const std::string& path);
+bool ReadTrackerState(const std::string& path, TrackerState* state);
+
+#endif // TRACKER_STATE_H
@@ -14,6 +14,10 @@ using std::string;
 // Choose whether to shift boxes using the motion model or using a uniform distribution.
 const bool shift_motion_model = true;
 
+// Size of the cropped target and search regions (the size of the network input, which the
+// regressor would otherwise resize them to).
+const cv::Size kExampleSize(227, 227);
+
 ExampleGenerator::ExampleGenerator(const double lambda_shift,
                                    const double lambda_scale,
                                    const double min_scale,
@@ -30,7 +34,7 @@ void ExampleGenerator::Reset(const BoundingBox& bbox_prev,
                              const cv::Mat& image_prev,
                              const cv::Mat& image_curr) {
   // Get padded target from previous image to feed the network.
-  CropPadImage(bbox_prev, image_prev, &target_pad_);
+  CropPadResize(bbox_prev, image_prev, kExampleSize, &target_pad_);
 
   // Save the current image.
   image_curr_ = image_curr;
@@ -75,14 +79,16 @@ void ExampleGenerator::MakeTrueExample(cv::Mat* curr_search_region,
   // to define a search region within the current image.
   BoundingBox curr_search_location;
   double edge_spacing_x, edge_spacing_y;
-  CropPadImage(curr_prior_tight, image_curr_, curr_search_region, &curr_search_location, &edge_spacing_x, &edge_spacing_y);
+  cv::Size curr_search_size;
+  CropPadResize(curr_prior_tight, image_curr_, kExampleSize, curr_search_region,
+                &curr_search_location, &edge_spacing_x, &edge_spacing_y, &curr_search_size);
 
   // Recenter the ground-truth bbox relative to the search location.
   BoundingBox bbox_gt_recentered;
   bbox_curr_gt_.Recenter(curr_search_location, edge_spacing_x, edge_spacing_y, &bbox_gt_recentered);
 
-  // Scale the bounding box relative to current crop.
-  bbox_gt_recentered.Scale(*curr_search_region, bbox_gt_scaled);
+  // Scale the bounding box relative to current crop (before it was resized).
+  bbox_gt_recentered.Scale(curr_search_size, bbox_gt_scaled);
 }
 
 void ExampleGenerator::get_default_bb_params(BBParams* default_params) const {
@@ -139,15 +145,17 @@ void ExampleGenerator::MakeTrainingExampleBBShift(const bool visualize_example,
   // Crop the image based at the new location (after applying translation and scale changes).
   double edge_spacing_x, edge_spacing_y;
   BoundingBox rand_search_location;
-  CropPadImage(bbox_curr_shift, image_curr_, rand_search_region, &rand_search_location,
-               &edge_spacing_x, &edge_spacing_y);
+  cv::Size rand_search_size;
+  CropPadResize(bbox_curr_shift, image_curr_, kExampleSize, rand_search_region,
+                &rand_search_location, &edge_spacing_x, &edge_spacing_y, &rand_search_size);
 
   // Find the shifted ground-truth bounding box location relative to the image crop.
   BoundingBox bbox_gt_recentered;
   bbox_curr_gt_.Recenter(rand_search_location, edge_spacing_x, edge_spacing_y, &bbox_gt_recentered);
 
-  // Scale the ground-truth bounding box relative to the random transformation.
-  bbox_gt_recentered.Scale(*rand_search_region, bbox_gt_scaled);
+  // Scale the ground-truth bounding box relative to the random transformation
+  // (and to the crop before it was resized).
+  bbox_gt_recentered.Scale(rand_search_size, bbox_gt_scaled);
 
   if (visualize_example) {
     VisualizeExample(*target_pad, *rand_search_region, *bbox_gt_scaled);
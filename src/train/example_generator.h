@@ -18,6 +18,7 @@ struct BBParams {
 
 // Generates additional training examples by taking random crops of the target object,
 // causing apparent translation and scale changes.
+// The crops are resized to the size of the network input (227x227) as they are taken.
 class ExampleGenerator
 {
 public:
@@ -7,6 +7,7 @@
 #include <opencv2/highgui/highgui.hpp>
 
 #include "network/regressor.h"
+#include "loader/frame_prefetcher.h"
 #include "loader/loader_alov.h"
 #include "loader/loader_vot.h"
 #include "tracker/tracker.h"
@@ -56,6 +57,10 @@ int main (int argc, char *argv[]) {
   LoaderVOT loader(videos_folder);
   std::vector<Video> videos = loader.get_videos();
 
+  // Read the frames of each video ahead of the tracker.
+  FramePrefetcher prefetcher(kPrefetchThreads, kPrefetchFrames, kPrefetchBytes);
+  prefetcher.Attach(&videos);
+
   // Visualize the tracker performance.
   TrackerVisualizer tracker_visualizer(videos, &regressor, &tracker);
   tracker_visualizer.TrackAll(start_video_num, pause_val);